@@ -0,0 +1,399 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+namespace Allocator {
+
+    constexpr uint32_t kScopeCount = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+    constexpr uint32_t kHistogramBuckets = 16;   // <=16B, <=32B, ... , >256KiB
+    constexpr uint32_t kMaxTags = 64;            // tag 0 is "untagged"
+
+    struct ScopeStats {
+        uint64_t liveBytes = 0;
+        uint64_t peakBytes = 0;
+        uint64_t allocations = 0;
+        uint64_t reallocations = 0;
+        uint64_t frees = 0;
+        uint64_t failures = 0;
+        uint64_t histogram[kHistogramBuckets] = {};
+    };
+
+    // Driver-internal (e.g. executable) memory reported through pfnInternalAllocation/pfnInternalFree.
+    struct InternalStats {
+        uint64_t liveBytes = 0;
+        uint64_t peakBytes = 0;
+        uint64_t allocations = 0;
+        uint64_t frees = 0;
+    };
+
+    // Attribution of allocations to the Vulkan call that caused them (see ScopedAllocationTag).
+    struct TagStats {
+        const char* name = nullptr;
+        uint64_t liveBytes = 0;
+        uint64_t allocations = 0;
+        uint64_t internalBytes = 0;
+    };
+
+    struct HostAllocationStats {
+        ScopeStats scopes[kScopeCount];
+        InternalStats internal[kScopeCount];
+        std::vector<TagStats> tags;
+        uint64_t frame = 0;
+        uint64_t lastFrameAllocations = 0;   // allocation calls during the last completed frame
+        uint64_t maxFrameAllocations = 0;    // worst frame seen so far, for spotting allocation storms
+    };
+
+    inline const char* scopeName(uint32_t scope) {
+        switch (scope) {
+        case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND: return "COMMAND";
+        case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT: return "OBJECT";
+        case VK_SYSTEM_ALLOCATION_SCOPE_CACHE: return "CACHE";
+        case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE: return "DEVICE";
+        case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE: return "INSTANCE";
+        default: return "UNKNOWN";
+        }
+    }
+
+    inline uint32_t histogramBucket(size_t size) {
+        uint32_t bucket = 0;
+        size_t limit = 16;
+        while (bucket + 1 < kHistogramBuckets && size > limit) {
+            limit <<= 1;
+            ++bucket;
+        }
+        return bucket;
+    }
+
+    // Tracks every host allocation made through the callbacks. Call counts and the histogram live in
+    // per-thread blocks of relaxed atomics that only their owner thread writes; live/peak bytes are
+    // single atomics per scope so the peak is exact. Nothing on the allocation path takes a lock.
+    class AllocationTelemetry {
+    public:
+        static AllocationTelemetry& Instance() {
+            static AllocationTelemetry* telemetry = new AllocationTelemetry();
+            return *telemetry;
+        }
+
+        void recordAllocation(size_t size, VkSystemAllocationScope scope, uint8_t tag) {
+            ThreadCounters& counters = threadCounters();
+            bump(counters.allocations[scope]);
+            bump(counters.histogram[scope][histogramBucket(size)]);
+            bump(counters.frameAllocations);
+            addLive(scope, static_cast<int64_t>(size));
+            tags[tag].allocations.fetch_add(1, std::memory_order_relaxed);
+            tags[tag].liveBytes.fetch_add(size, std::memory_order_relaxed);
+        }
+
+        void recordReallocation(size_t oldSize, size_t newSize, VkSystemAllocationScope scope, uint8_t oldTag, uint8_t newTag) {
+            ThreadCounters& counters = threadCounters();
+            bump(counters.reallocations[scope]);
+            bump(counters.histogram[scope][histogramBucket(newSize)]);
+            bump(counters.frameAllocations);
+            addLive(scope, static_cast<int64_t>(newSize) - static_cast<int64_t>(oldSize));
+            tags[oldTag].liveBytes.fetch_sub(oldSize, std::memory_order_relaxed);
+            tags[newTag].liveBytes.fetch_add(newSize, std::memory_order_relaxed);
+        }
+
+        void recordFree(size_t size, VkSystemAllocationScope scope, uint8_t tag) {
+            bump(threadCounters().frees[scope]);
+            addLive(scope, -static_cast<int64_t>(size));
+            tags[tag].liveBytes.fetch_sub(size, std::memory_order_relaxed);
+        }
+
+        void recordFailure(VkSystemAllocationScope scope) {
+            bump(threadCounters().failures[scope]);
+        }
+
+        void recordInternalAllocation(size_t size, VkSystemAllocationScope scope) {
+            InternalCounters& counters = internal[scope];
+            counters.allocations.fetch_add(1, std::memory_order_relaxed);
+            uint64_t live = counters.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+            raisePeak(counters.peakBytes, live);
+            tags[currentTag()].internalBytes.fetch_add(size, std::memory_order_relaxed);
+        }
+
+        void recordInternalFree(size_t size, VkSystemAllocationScope scope) {
+            internal[scope].frees.fetch_add(1, std::memory_order_relaxed);
+            internal[scope].liveBytes.fetch_sub(size, std::memory_order_relaxed);
+        }
+
+        // Tag applied to allocations made on the calling thread; see ScopedAllocationTag.
+        static uint8_t& currentTag() {
+            thread_local uint8_t tag = 0;
+            return tag;
+        }
+
+        // Call sites pass string literals, so a pointer compare finds the tag without locking after the
+        // first registration. Overflowing tags collapse into "untagged".
+        uint8_t registerTag(const char* name) {
+            uint32_t count = tagCount.load(std::memory_order_acquire);
+            for (uint32_t i = 1; i < count; ++i) {
+                if (tags[i].name.load(std::memory_order_relaxed) == name) {
+                    return static_cast<uint8_t>(i);
+                }
+            }
+            std::lock_guard<std::mutex> lock(registryMutex);
+            count = tagCount.load(std::memory_order_relaxed);
+            for (uint32_t i = 1; i < count; ++i) {
+                const char* existing = tags[i].name.load(std::memory_order_relaxed);
+                if (existing == name || std::strcmp(existing, name) == 0) {
+                    return static_cast<uint8_t>(i);
+                }
+            }
+            if (count == kMaxTags) {
+                return 0;
+            }
+            tags[count].name.store(name, std::memory_order_relaxed);
+            tagCount.store(count + 1, std::memory_order_release);
+            return static_cast<uint8_t>(count);
+        }
+
+        HostAllocationStats query() {
+            HostAllocationStats stats;
+            {
+                std::lock_guard<std::mutex> lock(registryMutex);
+                for (ThreadCounters* counters : threads) {
+                    for (uint32_t scope = 0; scope < kScopeCount; ++scope) {
+                        ScopeStats& out = stats.scopes[scope];
+                        out.allocations += load(counters->allocations[scope]);
+                        out.reallocations += load(counters->reallocations[scope]);
+                        out.frees += load(counters->frees[scope]);
+                        out.failures += load(counters->failures[scope]);
+                        for (uint32_t bucket = 0; bucket < kHistogramBuckets; ++bucket) {
+                            out.histogram[bucket] += load(counters->histogram[scope][bucket]);
+                        }
+                    }
+                }
+            }
+            for (uint32_t scope = 0; scope < kScopeCount; ++scope) {
+                stats.scopes[scope].liveBytes = static_cast<uint64_t>(load(live[scope].bytes));
+                stats.scopes[scope].peakBytes = load(live[scope].peak);
+                stats.internal[scope].liveBytes = load(internal[scope].liveBytes);
+                stats.internal[scope].peakBytes = load(internal[scope].peakBytes);
+                stats.internal[scope].allocations = load(internal[scope].allocations);
+                stats.internal[scope].frees = load(internal[scope].frees);
+            }
+            uint32_t count = tagCount.load(std::memory_order_acquire);
+            for (uint32_t i = 0; i < count; ++i) {
+                TagStats tag;
+                tag.name = i == 0 ? "(untagged)" : tags[i].name.load(std::memory_order_relaxed);
+                tag.liveBytes = load(tags[i].liveBytes);
+                tag.allocations = load(tags[i].allocations);
+                tag.internalBytes = load(tags[i].internalBytes);
+                stats.tags.push_back(tag);
+            }
+            stats.frame = load(frame);
+            stats.lastFrameAllocations = load(lastFrameAllocations);
+            stats.maxFrameAllocations = load(maxFrameAllocations);
+            return stats;
+        }
+
+        // Closes the per-frame allocation window and prints a report when the dump interval elapsed.
+        // The interval comes from VKL_ALLOC_STATS_INTERVAL (seconds, 0 or unset disables it) so it can
+        // be turned on in a deployed build without recompiling.
+        void endFrame() {
+            uint64_t total = 0;
+            {
+                std::lock_guard<std::mutex> lock(registryMutex);
+                for (ThreadCounters* counters : threads) {
+                    total += load(counters->frameAllocations);
+                }
+            }
+            uint64_t previous = frameAllocationsSeen;
+            frameAllocationsSeen = total;
+            lastFrameAllocations.store(total - previous, std::memory_order_relaxed);
+            if (total - previous > load(maxFrameAllocations)) {
+                maxFrameAllocations.store(total - previous, std::memory_order_relaxed);
+            }
+            frame.fetch_add(1, std::memory_order_relaxed);
+
+            if (dumpInterval.count() > 0) {
+                auto now = std::chrono::steady_clock::now();
+                if (now - lastDump >= dumpInterval) {
+                    lastDump = now;
+                    dump(std::cout);
+                }
+            }
+        }
+
+        void dump(std::ostream& out) {
+            HostAllocationStats stats = query();
+            out << "Host allocation stats (frame " << stats.frame << ", last frame "
+                << stats.lastFrameAllocations << " allocs, worst frame " << stats.maxFrameAllocations << " allocs):" << std::endl;
+            for (uint32_t scope = 0; scope < kScopeCount; ++scope) {
+                const ScopeStats& s = stats.scopes[scope];
+                const InternalStats& i = stats.internal[scope];
+                out << " - " << std::left << std::setw(9) << scopeName(scope) << std::right
+                    << " live " << s.liveBytes << " B, peak " << s.peakBytes << " B, allocs " << s.allocations
+                    << ", reallocs " << s.reallocations << ", frees " << s.frees << ", failures " << s.failures
+                    << ", internal live " << i.liveBytes << " B (peak " << i.peakBytes << " B)" << std::endl;
+                if (s.allocations + s.reallocations == 0) {
+                    continue;
+                }
+                out << "   sizes:";
+                size_t limit = 16;
+                for (uint32_t bucket = 0; bucket < kHistogramBuckets; ++bucket, limit <<= 1) {
+                    if (s.histogram[bucket]) {
+                        out << (bucket + 1 == kHistogramBuckets ? " >" : " <=") << (bucket + 1 == kHistogramBuckets ? limit >> 1 : limit)
+                            << ":" << s.histogram[bucket];
+                    }
+                }
+                out << std::endl;
+            }
+            out << " By Vulkan call:" << std::endl;
+            for (const TagStats& tag : stats.tags) {
+                if (tag.allocations == 0 && tag.internalBytes == 0) {
+                    continue;
+                }
+                out << " - " << tag.name << ": live " << tag.liveBytes << " B, allocs " << tag.allocations
+                    << ", internal " << tag.internalBytes << " B" << std::endl;
+            }
+        }
+
+    private:
+        AllocationTelemetry() {
+            tags[0].name.store("(untagged)", std::memory_order_relaxed);
+            if (const char* interval = std::getenv("VKL_ALLOC_STATS_INTERVAL")) {
+                dumpInterval = std::chrono::duration<double>(std::atof(interval));
+            }
+            lastDump = std::chrono::steady_clock::now();
+        }
+
+        // Only the owning thread writes these, so relaxed increments never contend on a cache line.
+        struct alignas(64) ThreadCounters {
+            std::atomic<uint64_t> allocations[kScopeCount] = {};
+            std::atomic<uint64_t> reallocations[kScopeCount] = {};
+            std::atomic<uint64_t> frees[kScopeCount] = {};
+            std::atomic<uint64_t> failures[kScopeCount] = {};
+            std::atomic<uint64_t> histogram[kScopeCount][kHistogramBuckets] = {};
+            std::atomic<uint64_t> frameAllocations{ 0 };
+        };
+
+        struct alignas(64) LiveCounter {
+            std::atomic<int64_t> bytes{ 0 };
+            std::atomic<uint64_t> peak{ 0 };
+        };
+
+        struct alignas(64) InternalCounters {
+            std::atomic<uint64_t> liveBytes{ 0 };
+            std::atomic<uint64_t> peakBytes{ 0 };
+            std::atomic<uint64_t> allocations{ 0 };
+            std::atomic<uint64_t> frees{ 0 };
+        };
+
+        struct TagCounters {
+            std::atomic<const char*> name{ nullptr };
+            std::atomic<uint64_t> liveBytes{ 0 };
+            std::atomic<uint64_t> allocations{ 0 };
+            std::atomic<uint64_t> internalBytes{ 0 };
+        };
+
+        // Counter blocks outlive their threads so the totals stay correct; a block whose thread exited
+        // is handed to the next new thread.
+        struct ThreadSlot {
+            ThreadCounters* counters = nullptr;
+            ~ThreadSlot() {
+                if (counters) {
+                    AllocationTelemetry::Instance().retire(counters);
+                }
+            }
+        };
+
+        ThreadCounters& threadCounters() {
+            thread_local ThreadSlot slot;
+            if (slot.counters == nullptr) {
+                slot.counters = adopt();
+            }
+            return *slot.counters;
+        }
+
+        ThreadCounters* adopt() {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            if (!retired.empty()) {
+                ThreadCounters* counters = retired.back();
+                retired.pop_back();
+                return counters;
+            }
+            threads.push_back(new ThreadCounters());
+            return threads.back();
+        }
+
+        void retire(ThreadCounters* counters) {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            retired.push_back(counters);
+        }
+
+        void addLive(VkSystemAllocationScope scope, int64_t delta) {
+            int64_t now = live[scope].bytes.fetch_add(delta, std::memory_order_relaxed) + delta;
+            if (delta > 0) {
+                raisePeak(live[scope].peak, static_cast<uint64_t>(now));
+            }
+        }
+
+        static void raisePeak(std::atomic<uint64_t>& peak, uint64_t value) {
+            uint64_t current = peak.load(std::memory_order_relaxed);
+            while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+            }
+        }
+
+        // Owner-thread-only counters: a plain load/store pair avoids a locked RMW.
+        template <typename T>
+        static void bump(std::atomic<T>& counter) {
+            counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        template <typename T>
+        static T load(const std::atomic<T>& counter) {
+            return counter.load(std::memory_order_relaxed);
+        }
+
+        LiveCounter live[kScopeCount];
+        InternalCounters internal[kScopeCount];
+        TagCounters tags[kMaxTags];
+        std::atomic<uint32_t> tagCount{ 1 };
+
+        std::mutex registryMutex;
+        std::vector<ThreadCounters*> threads;
+        std::vector<ThreadCounters*> retired;
+
+        uint64_t frameAllocationsSeen = 0;
+        std::atomic<uint64_t> frame{ 0 };
+        std::atomic<uint64_t> lastFrameAllocations{ 0 };
+        std::atomic<uint64_t> maxFrameAllocations{ 0 };
+        std::chrono::duration<double> dumpInterval{ 0.0 };
+        std::chrono::steady_clock::time_point lastDump;
+    };
+
+    // Attributes host allocations made on this thread to a Vulkan call for as long as it is in scope:
+    //     Allocator::ScopedAllocationTag tag("vkCreateDevice");
+    class ScopedAllocationTag {
+    public:
+        explicit ScopedAllocationTag(const char* name) : previous(AllocationTelemetry::currentTag()) {
+            AllocationTelemetry::currentTag() = AllocationTelemetry::Instance().registerTag(name);
+        }
+        ~ScopedAllocationTag() {
+            AllocationTelemetry::currentTag() = previous;
+        }
+        ScopedAllocationTag(const ScopedAllocationTag&) = delete;
+        ScopedAllocationTag& operator=(const ScopedAllocationTag&) = delete;
+
+    private:
+        uint8_t previous;
+    };
+
+    inline HostAllocationStats QueryAllocationStats() {
+        return AllocationTelemetry::Instance().query();
+    }
+
+    inline void DumpAllocationStats(std::ostream& out) {
+        AllocationTelemetry::Instance().dump(out);
+    }
+}
@@ -1,21 +1,475 @@
-#include "Classheader.hpp"
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include "AllocationTelemetry.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
 namespace Allocator {
-    void* CustomAllocation(void* pUserData, size_t size, size_t alignment, VkSystemAllocationScope allocationScope) {
-        void* ptr = malloc(size);
-       // printf("Allocated %zu bytes\n", size);
+
+    // Every block handed to the driver is preceded by this header so that free and
+    // realloc can tell where the block came from without any lookup.
+    struct BlockHeader {
+        uint64_t size;        // bytes requested by the driver
+        uint32_t offset;      // distance from the start of the slot/raw block to the user pointer
+        uint8_t kind;         // BlockKind
+        uint8_t scope;        // VkSystemAllocationScope
+        uint8_t sizeClass;    // only meaningful for BlockKind::Pooled
+        uint8_t tag;          // AllocationTelemetry tag of the Vulkan call that made the block
+    };
+    static_assert(sizeof(BlockHeader) == 16, "BlockHeader must stay 16 bytes to keep user pointers 16-aligned");
+
+    enum BlockKind : uint8_t {
+        Pooled = 0,   // size-class slot from a thread cache / central free list
+        Arena = 1,    // bump allocation in a per-thread command arena
+        Large = 2     // straight from the system allocator
+    };
+
+    constexpr size_t kHeaderSize = sizeof(BlockHeader);
+    constexpr size_t kMinAlignment = 16;
+    constexpr size_t kSlabSize = 64 * 1024;
+    constexpr size_t kArenaChunkSize = 256 * 1024;
+    constexpr size_t kArenaMaxAllocation = kArenaChunkSize / 4;
+    constexpr uint32_t kCacheBatch = 32;      // nodes moved between a thread cache and the central list at once
+    constexpr uint32_t kCacheLimit = 128;     // per-thread, per-class node limit before spilling back
+
+    // User-visible payload sizes of the small-object classes. Slots are header + payload, so every
+    // class is a multiple of 16 and slots stay 16-aligned inside a slab.
+    constexpr uint32_t kSizeClasses[] = { 16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048 };
+    constexpr uint32_t kSizeClassCount = sizeof(kSizeClasses) / sizeof(kSizeClasses[0]);
+    constexpr uint32_t kMaxPooledSize = kSizeClasses[kSizeClassCount - 1];
+
+    // OBJECT/CACHE allocations churn with object lifetimes, DEVICE/INSTANCE ones live for the whole run.
+    // Keeping them in separate pools stops a handful of long-lived blocks from pinning slabs.
+    enum PoolKind : uint32_t {
+        ObjectPool = 0,
+        LongLivedPool = 1,
+        PoolCount = 2
+    };
+
+    inline size_t alignUp(size_t value, size_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    inline BlockHeader* headerOf(void* userPtr) {
+        return reinterpret_cast<BlockHeader*>(static_cast<char*>(userPtr) - kHeaderSize);
+    }
+
+    inline void* AlignedSystemAlloc(size_t size, size_t alignment) {
+#if defined(_WIN32)
+        return _aligned_malloc(size, alignment);
+#else
+        return std::aligned_alloc(alignment, alignUp(size, alignment));
+#endif
+    }
+
+    inline void AlignedSystemFree(void* ptr) {
+#if defined(_WIN32)
+        _aligned_free(ptr);
+#else
+        std::free(ptr);
+#endif
+    }
+
+    inline uint32_t sizeClassFor(size_t size) {
+        for (uint32_t i = 0; i < kSizeClassCount; ++i) {
+            if (size <= kSizeClasses[i]) {
+                return i;
+            }
+        }
+        return kSizeClassCount;
+    }
+
+    inline PoolKind poolFor(VkSystemAllocationScope scope) {
+        return (scope == VK_SYSTEM_ALLOCATION_SCOPE_DEVICE || scope == VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE)
+            ? LongLivedPool : ObjectPool;
+    }
+
+    // Places a header in front of an aligned user pointer carved out of [slot, slot + capacity).
+    inline void* placeBlock(char* slot, size_t size, size_t alignment, BlockKind kind, VkSystemAllocationScope scope, uint32_t sizeClass) {
+        char* user = reinterpret_cast<char*>(alignUp(reinterpret_cast<uintptr_t>(slot) + kHeaderSize, alignment));
+        BlockHeader* header = headerOf(user);
+        header->size = size;
+        header->offset = static_cast<uint32_t>(user - slot);
+        header->kind = kind;
+        header->scope = static_cast<uint8_t>(scope);
+        header->sizeClass = static_cast<uint8_t>(sizeClass);
+        header->tag = 0;
+        return user;
+    }
+
+    struct FreeNode {
+        FreeNode* next;
+    };
+
+    // Central free list for one (pool, size class) pair. Only touched when a thread cache runs dry or
+    // overflows, so the mutex is off the common path.
+    struct CentralList {
+        std::mutex mutex;
+        FreeNode* head = nullptr;
+        uint32_t count = 0;
+        std::vector<void*> slabs;
+    };
+
+    // Bump allocator for VK_SYSTEM_ALLOCATION_SCOPE_COMMAND. Command-scope memory only lives for the
+    // duration of a single Vulkan call, so the arena rewinds as soon as it drains, and at most once per
+    // frame it also gives back chunks that were grown during a spike.
+    struct CommandArena {
+        std::vector<char*> chunks;
+        size_t chunkIndex = 0;
+        size_t cursor = 0;
+        uint64_t epoch = 0;
+        std::atomic<uint32_t> live{ 0 };
+    };
+
+    // Chunks are aligned to their own size so a free from any thread can find the owning arena by masking.
+    struct ArenaChunkHeader {
+        CommandArena* owner;
+    };
+
+    class HostHeap {
+    public:
+        // Intentionally leaked: driver frees can arrive from thread-exit paths after static destruction.
+        static HostHeap& Instance() {
+            static HostHeap* heap = new HostHeap();
+            return *heap;
+        }
+
+        void* allocate(size_t size, size_t alignment, VkSystemAllocationScope scope) {
+            if (size == 0) {
+                return nullptr;
+            }
+            if (alignment < kMinAlignment) {
+                alignment = kMinAlignment;
+            }
+            if (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND) {
+                if (void* ptr = allocateArena(size, alignment)) {
+                    return ptr;
+                }
+            }
+            // Alignment padding beyond the header's natural 16 bytes has to fit inside the slot too.
+            size_t needed = size + (alignment - kMinAlignment);
+            if (needed <= kMaxPooledSize) {
+                return allocatePooled(size, alignment, scope, sizeClassFor(needed));
+            }
+            return allocateLarge(size, alignment, scope);
+        }
+
+        void* reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+            if (original == nullptr) {
+                return allocate(size, alignment, scope);
+            }
+            if (size == 0) {
+                release(original);
+                return nullptr;
+            }
+            BlockHeader* header = headerOf(original);
+            // Pools are per scope, so a scope change always moves to a block of the new pool.
+            if (header->kind == Pooled && header->scope == static_cast<uint8_t>(scope)) {
+                size_t capacity = kSizeClasses[header->sizeClass] + kHeaderSize - header->offset;
+                if (size <= capacity && (reinterpret_cast<uintptr_t>(original) & (alignment - 1)) == 0) {
+                    header->size = size;
+                    return original;
+                }
+            }
+            void* ptr = allocate(size, alignment, scope);
+            if (ptr == nullptr) {
+                return nullptr; // the original block stays valid, as the spec requires
+            }
+            std::memcpy(ptr, original, static_cast<size_t>(header->size < size ? header->size : size));
+            release(original);
+            return ptr;
+        }
+
+        void release(void* ptr) {
+            if (ptr == nullptr) {
+                return;
+            }
+            BlockHeader* header = headerOf(ptr);
+            char* slot = static_cast<char*>(ptr) - header->offset;
+            switch (header->kind) {
+            case Pooled:
+                releasePooled(slot, poolFor(static_cast<VkSystemAllocationScope>(header->scope)), header->sizeClass);
+                break;
+            case Arena: {
+                auto* chunk = reinterpret_cast<ArenaChunkHeader*>(reinterpret_cast<uintptr_t>(ptr) & ~(uintptr_t)(kArenaChunkSize - 1));
+                chunk->owner->live.fetch_sub(1, std::memory_order_release);
+                break;
+            }
+            default:
+                AlignedSystemFree(slot);
+                break;
+            }
+        }
+
+        // Marks a frame boundary; command arenas trim back to a single chunk the next time they drain.
+        void beginFrame() {
+            frameEpoch.fetch_add(1, std::memory_order_relaxed);
+        }
+
+    private:
+        HostHeap() = default;
+
+        struct ThreadCache {
+            FreeNode* heads[PoolCount][kSizeClassCount] = {};
+            uint32_t counts[PoolCount][kSizeClassCount] = {};
+            CommandArena* arena = nullptr;
+
+            ~ThreadCache() {
+                HostHeap& heap = HostHeap::Instance();
+                for (uint32_t pool = 0; pool < PoolCount; ++pool) {
+                    for (uint32_t cls = 0; cls < kSizeClassCount; ++cls) {
+                        if (heads[pool][cls]) {
+                            heap.spill(pool, cls, heads[pool][cls], counts[pool][cls]);
+                        }
+                    }
+                }
+                if (arena) {
+                    heap.returnArena(arena);
+                }
+            }
+        };
+
+        static ThreadCache& threadCache() {
+            thread_local ThreadCache cache;
+            return cache;
+        }
+
+        void* allocatePooled(size_t size, size_t alignment, VkSystemAllocationScope scope, uint32_t sizeClass) {
+            PoolKind pool = poolFor(scope);
+            ThreadCache& cache = threadCache();
+            FreeNode*& head = cache.heads[pool][sizeClass];
+            if (head == nullptr) {
+                cache.counts[pool][sizeClass] = refill(pool, sizeClass, head);
+                if (head == nullptr) {
+                    return nullptr;
+                }
+            }
+            FreeNode* node = head;
+            head = node->next;
+            --cache.counts[pool][sizeClass];
+            return placeBlock(reinterpret_cast<char*>(node), size, alignment, Pooled, scope, sizeClass);
+        }
+
+        void releasePooled(char* slot, uint32_t pool, uint32_t sizeClass) {
+            ThreadCache& cache = threadCache();
+            FreeNode* node = reinterpret_cast<FreeNode*>(slot);
+            node->next = cache.heads[pool][sizeClass];
+            cache.heads[pool][sizeClass] = node;
+            if (++cache.counts[pool][sizeClass] > kCacheLimit) {
+                // Hand a batch back so memory freed on one thread can be reused by the others.
+                FreeNode* batch = cache.heads[pool][sizeClass];
+                FreeNode* tail = batch;
+                for (uint32_t i = 1; i < kCacheBatch; ++i) {
+                    tail = tail->next;
+                }
+                cache.heads[pool][sizeClass] = tail->next;
+                cache.counts[pool][sizeClass] -= kCacheBatch;
+                tail->next = nullptr;
+                spill(pool, sizeClass, batch, kCacheBatch);
+            }
+        }
+
+        uint32_t refill(uint32_t pool, uint32_t sizeClass, FreeNode*& head) {
+            CentralList& list = central[pool][sizeClass];
+            std::lock_guard<std::mutex> lock(list.mutex);
+            if (list.head == nullptr && !carveSlab(list, sizeClass)) {
+                return 0;
+            }
+            uint32_t taken = 0;
+            FreeNode* batch = list.head;
+            FreeNode* tail = batch;
+            while (++taken < kCacheBatch && tail->next) {
+                tail = tail->next;
+            }
+            list.head = tail->next;
+            list.count -= taken;
+            tail->next = head;
+            head = batch;
+            return taken;
+        }
+
+        void spill(uint32_t pool, uint32_t sizeClass, FreeNode* batch, uint32_t count) {
+            FreeNode* tail = batch;
+            while (tail->next) {
+                tail = tail->next;
+            }
+            CentralList& list = central[pool][sizeClass];
+            std::lock_guard<std::mutex> lock(list.mutex);
+            tail->next = list.head;
+            list.head = batch;
+            list.count += count;
+        }
+
+        bool carveSlab(CentralList& list, uint32_t sizeClass) {
+            char* slab = static_cast<char*>(AlignedSystemAlloc(kSlabSize, kMinAlignment));
+            if (slab == nullptr) {
+                return false;
+            }
+            list.slabs.push_back(slab);
+            size_t stride = kSizeClasses[sizeClass] + kHeaderSize;
+            size_t slots = kSlabSize / stride;
+            for (size_t i = slots; i-- > 0;) {
+                FreeNode* node = reinterpret_cast<FreeNode*>(slab + i * stride);
+                node->next = list.head;
+                list.head = node;
+            }
+            list.count += static_cast<uint32_t>(slots);
+            return true;
+        }
+
+        void* allocateArena(size_t size, size_t alignment) {
+            if (size + alignment > kArenaMaxAllocation) {
+                return nullptr;
+            }
+            ThreadCache& cache = threadCache();
+            if (cache.arena == nullptr) {
+                cache.arena = acquireArena();
+            }
+            CommandArena& arena = *cache.arena;
+            if (arena.live.load(std::memory_order_acquire) == 0) {
+                uint64_t epoch = frameEpoch.load(std::memory_order_relaxed);
+                if (arena.epoch != epoch) {
+                    arena.epoch = epoch;
+                    while (arena.chunks.size() > 1) {
+                        AlignedSystemFree(arena.chunks.back());
+                        arena.chunks.pop_back();
+                    }
+                }
+                arena.chunkIndex = 0;
+                arena.cursor = sizeof(ArenaChunkHeader);
+            }
+            for (;;) {
+                if (arena.chunkIndex == arena.chunks.size()) {
+                    char* chunk = static_cast<char*>(AlignedSystemAlloc(kArenaChunkSize, kArenaChunkSize));
+                    if (chunk == nullptr) {
+                        return nullptr;
+                    }
+                    reinterpret_cast<ArenaChunkHeader*>(chunk)->owner = &arena;
+                    arena.chunks.push_back(chunk);
+                }
+                char* base = arena.chunks[arena.chunkIndex];
+                uintptr_t user = alignUp(reinterpret_cast<uintptr_t>(base) + arena.cursor + kHeaderSize, alignment);
+                size_t end = user - reinterpret_cast<uintptr_t>(base) + size;
+                if (end <= kArenaChunkSize) {
+                    char* slot = base + arena.cursor;
+                    arena.cursor = alignUp(end, kMinAlignment);
+                    arena.live.fetch_add(1, std::memory_order_relaxed);
+                    return placeBlock(slot, size, alignment, Arena, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND, 0);
+                }
+                ++arena.chunkIndex;
+                arena.cursor = sizeof(ArenaChunkHeader);
+            }
+        }
+
+        void* allocateLarge(size_t size, size_t alignment, VkSystemAllocationScope scope) {
+            size_t lead = alignment > kHeaderSize ? alignment : kHeaderSize;
+            char* raw = static_cast<char*>(AlignedSystemAlloc(lead + size, alignment));
+            if (raw == nullptr) {
+                return nullptr;
+            }
+            // Large blocks are freed from the raw pointer, so the offset is measured from there.
+            void* user = placeBlock(raw + lead - kHeaderSize, size, alignment, Large, scope, 0);
+            headerOf(user)->offset = static_cast<uint32_t>(lead);
+            return user;
+        }
+
+        CommandArena* acquireArena() {
+            std::lock_guard<std::mutex> lock(arenaMutex);
+            if (!spareArenas.empty()) {
+                CommandArena* arena = spareArenas.back();
+                spareArenas.pop_back();
+                return arena;
+            }
+            return new CommandArena();
+        }
+
+        // Arenas outlive their threads: a block may still be live on another thread when this one exits.
+        void returnArena(CommandArena* arena) {
+            std::lock_guard<std::mutex> lock(arenaMutex);
+            spareArenas.push_back(arena);
+        }
+
+        CentralList central[PoolCount][kSizeClassCount];
+        std::mutex arenaMutex;
+        std::vector<CommandArena*> spareArenas;
+        std::atomic<uint64_t> frameEpoch{ 0 };
+    };
+
+    inline HostHeap& heapFrom(void* pUserData) {
+        return pUserData ? *static_cast<HostHeap*>(pUserData) : HostHeap::Instance();
+    }
+
+    inline void BeginFrame() {
+        HostHeap::Instance().beginFrame();
+        AllocationTelemetry::Instance().endFrame();
+    }
+
+    inline void* CustomAllocation(void* pUserData, size_t size, size_t alignment, VkSystemAllocationScope allocationScope) {
+        void* ptr = heapFrom(pUserData).allocate(size, alignment, allocationScope);
+        AllocationTelemetry& telemetry = AllocationTelemetry::Instance();
+        if (ptr == nullptr) {
+            telemetry.recordFailure(allocationScope);
+            return nullptr;
+        }
+        uint8_t tag = AllocationTelemetry::currentTag();
+        headerOf(ptr)->tag = tag;
+        telemetry.recordAllocation(size, allocationScope, tag);
         return ptr;
     }
 
     // Custom reallocation function
-    void* CustomReallocation(void* pUserData, void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope allocationScope) {
-        void* ptr = realloc(pOriginal, size);
-        //printf("Reallocated to %zu bytes\n", size);
+    inline void* CustomReallocation(void* pUserData, void* pOriginal, size_t size, size_t alignment, VkSystemAllocationScope allocationScope) {
+        if (pOriginal == nullptr) {
+            return CustomAllocation(pUserData, size, alignment, allocationScope);
+        }
+        BlockHeader* original = headerOf(pOriginal);
+        size_t oldSize = static_cast<size_t>(original->size);
+        uint8_t oldTag = original->tag;
+        VkSystemAllocationScope oldScope = static_cast<VkSystemAllocationScope>(original->scope);
+        void* ptr = heapFrom(pUserData).reallocate(pOriginal, size, alignment, allocationScope);
+        AllocationTelemetry& telemetry = AllocationTelemetry::Instance();
+        if (size == 0) {
+            telemetry.recordFree(oldSize, oldScope, oldTag);
+            return nullptr;
+        }
+        if (ptr == nullptr) {
+            telemetry.recordFailure(allocationScope);
+            return nullptr;
+        }
+        uint8_t tag = AllocationTelemetry::currentTag();
+        headerOf(ptr)->tag = tag;
+        if (oldScope != allocationScope) {
+            telemetry.recordFree(oldSize, oldScope, oldTag);
+            telemetry.recordAllocation(size, allocationScope, tag);
+        }
+        else {
+            telemetry.recordReallocation(oldSize, size, allocationScope, oldTag, tag);
+        }
         return ptr;
     }
 
     // Custom free function
-    void CustomFree(void* pUserData, void* pMemory) {
-        free(pMemory);
-       // printf("Freed memory\n");
+    inline void CustomFree(void* pUserData, void* pMemory) {
+        if (pMemory == nullptr) {
+            return;
+        }
+        BlockHeader* header = headerOf(pMemory);
+        AllocationTelemetry::Instance().recordFree(static_cast<size_t>(header->size), static_cast<VkSystemAllocationScope>(header->scope), header->tag);
+        heapFrom(pUserData).release(pMemory);
+    }
+
+    inline void InternalAllocationNotification(void* pUserData, size_t size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope) {
+        AllocationTelemetry::Instance().recordInternalAllocation(size, allocationScope);
+    }
+
+    inline void InternalFreeNotification(void* pUserData, size_t size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope) {
+        AllocationTelemetry::Instance().recordInternalFree(size, allocationScope);
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,911 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "DeferredDeletion.hpp"
+#include "DeviceMemory.hpp"
+#include "JobSystem.hpp"
+#include "Lz4.hpp"
+#include "PipelineCache.hpp"
+#include "StagingUpload.hpp"
+#include "VulkanDispatch.hpp"
+
+namespace vulkan {
+
+    // Packed meshes and textures. Layout (little-endian): header, asset table, chunk table, chunk data.
+    // Tables and chunks start on AssetPackAlignment. Each asset is split into chunks of at most
+    // AssetPackChunkSize decoded bytes (whole rows for textures), stored raw or as one LZ4 block, so
+    // a chunk is the unit of reading, decoding and uploading.
+    constexpr char AssetPackMagic[8] = { 'V', 'K', 'L', 'P', 'A', 'C', 'K', '\0' };
+    constexpr uint32_t AssetPackVersion = 1;
+    constexpr uint64_t AssetPackAlignment = 64;
+    constexpr uint32_t AssetPackChunkSize = 256u << 10;
+
+    enum class AssetKind : uint32_t {
+        Mesh = 1,       // vertices, then uint32_t indices
+        Texture = 2     // mip 0 of a 2D image, rows tightly packed
+    };
+
+    enum class ChunkCodec : uint32_t {
+        None = 0,
+        Lz4 = 1
+    };
+
+    struct AssetPackHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t assetCount;
+        uint32_t chunkCount;
+        uint32_t reserved;
+        uint64_t assetTableOffset;
+        uint64_t chunkTableOffset;
+        uint64_t fileSize;
+        uint64_t tableChecksum;     // FNV-1a over both tables
+    };
+
+    struct PackAsset {
+        char name[48];              // zero-terminated
+        AssetKind kind;
+        uint32_t firstChunk;
+        uint32_t chunkCount;
+        uint32_t format;            // VkFormat of a texture
+        uint64_t size;              // decoded bytes
+        uint32_t width;
+        uint32_t height;
+        uint32_t bytesPerTexel;
+        uint32_t vertexStride;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+    };
+
+    struct PackChunk {
+        uint64_t fileOffset;
+        uint64_t assetOffset;       // where the decoded bytes go within the asset
+        uint32_t storedSize;
+        uint32_t size;              // decoded bytes
+        ChunkCodec codec;
+        uint32_t reserved;
+    };
+
+    static_assert(sizeof(AssetPackHeader) == 56, "AssetPackHeader is part of the file format");
+    static_assert(sizeof(PackAsset) == 96, "PackAsset is part of the file format");
+    static_assert(sizeof(PackChunk) == 32, "PackChunk is part of the file format");
+
+    inline uint64_t alignPackOffset(uint64_t offset) {
+        return (offset + AssetPackAlignment - 1) & ~(AssetPackAlignment - 1);
+    }
+
+    // Texel size of the uncompressed colour formats a pack may hold; 0 for anything else.
+    inline uint32_t packTexelSize(VkFormat format) {
+        switch (format) {
+        case VK_FORMAT_R8_UNORM:
+        case VK_FORMAT_R8_SRGB:
+            return 1;
+        case VK_FORMAT_R8G8_UNORM:
+        case VK_FORMAT_R16_SFLOAT:
+            return 2;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+        case VK_FORMAT_R16G16_SFLOAT:
+        case VK_FORMAT_R32_SFLOAT:
+            return 4;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+        case VK_FORMAT_R32G32_SFLOAT:
+            return 8;
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            return 16;
+        default:
+            return 0;
+        }
+    }
+
+    // Bytes of the process currently resident in RAM, or 0 where that is not available.
+    inline uint64_t residentBytes() {
+#if defined(__linux__)
+        unsigned long long pages = 0, resident = 0;
+        FILE* statm = std::fopen("/proc/self/statm", "r");
+        if (statm == nullptr) {
+            return 0;
+        }
+        int read = std::fscanf(statm, "%llu %llu", &pages, &resident);
+        std::fclose(statm);
+        return read == 2 ? resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE)) : 0;
+#else
+        return 0;
+#endif
+    }
+
+    // Read-only view of a whole file. Pages are faulted in from the page cache on first touch, so
+    // reading a chunk costs no heap copy; release() hands consumed pages back to keep the resident
+    // set bounded by what is being decoded, not by the size of the file.
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile() {
+            close();
+        }
+
+        bool open(const std::string& path) {
+            close();
+#if defined(_WIN32)
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (file == INVALID_HANDLE_VALUE) {
+                return false;
+            }
+            LARGE_INTEGER fileSize{};
+            GetFileSizeEx(file, &fileSize);
+            length = static_cast<uint64_t>(fileSize.QuadPart);
+            if (length > 0) {
+                mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                bytes = mapping ? static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+            }
+#else
+            descriptor = ::open(path.c_str(), O_RDONLY);
+            if (descriptor < 0) {
+                return false;
+            }
+            struct stat info {};
+            fstat(descriptor, &info);
+            length = static_cast<uint64_t>(info.st_size);
+            if (length > 0) {
+                void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+                bytes = view != MAP_FAILED ? static_cast<const uint8_t*>(view) : nullptr;
+            }
+#endif
+            if (bytes == nullptr) {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        void close() {
+#if defined(_WIN32)
+            if (bytes) {
+                UnmapViewOfFile(bytes);
+            }
+            if (mapping) {
+                CloseHandle(mapping);
+            }
+            if (file != INVALID_HANDLE_VALUE) {
+                CloseHandle(file);
+            }
+            mapping = nullptr;
+            file = INVALID_HANDLE_VALUE;
+#else
+            if (bytes) {
+                munmap(const_cast<uint8_t*>(bytes), length);
+            }
+            if (descriptor >= 0) {
+                ::close(descriptor);
+            }
+            descriptor = -1;
+#endif
+            bytes = nullptr;
+            length = 0;
+        }
+
+        const uint8_t* data() const {
+            return bytes;
+        }
+
+        uint64_t size() const {
+            return length;
+        }
+
+        // Starts reading [offset, offset + size) from disk ahead of use.
+        void prefetch(uint64_t offset, uint64_t size) const {
+#if !defined(_WIN32)
+            uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+            uint64_t begin = offset / page * page;
+            madvise(const_cast<uint8_t*>(bytes) + begin, static_cast<size_t>(offset + size - begin), MADV_WILLNEED);
+#endif
+        }
+
+        // Drops the pages that lie entirely inside [offset, offset + size). They are clean, so touching
+        // them again just faults them back in.
+        void release(uint64_t offset, uint64_t size) const {
+#if defined(_WIN32)
+            const uint64_t page = 4096;
+#else
+            uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#endif
+            uint64_t begin = (offset + page - 1) / page * page;
+            uint64_t end = (offset + size) / page * page;
+            if (begin >= end) {
+                return;
+            }
+#if defined(_WIN32)
+            VirtualUnlock(const_cast<uint8_t*>(bytes) + begin, static_cast<SIZE_T>(end - begin)); // Unlocked pages leave the working set
+#else
+            madvise(const_cast<uint8_t*>(bytes) + begin, static_cast<size_t>(end - begin), MADV_DONTNEED);
+#endif
+        }
+
+    private:
+        const uint8_t* bytes = nullptr;
+        uint64_t length = 0;
+#if defined(_WIN32)
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+#else
+        int descriptor = -1;
+#endif
+    };
+
+    // A validated, mapped pack. Everything read from the file is range-checked in open(), so the
+    // accessors and read() can trust the tables.
+    class AssetPack {
+    public:
+        bool open(const std::string& path) {
+            close();
+            if (!file.open(path)) {
+                std::cout << "Asset pack: cannot open " << path << "." << std::endl;
+                return false;
+            }
+            if (!validate()) {
+                std::cout << "Asset pack: " << path << " is corrupt or from another version." << std::endl;
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        void close() {
+            file.close();
+            header = nullptr;
+            assetTable = nullptr;
+            chunkTable = nullptr;
+        }
+
+        bool isOpen() const {
+            return header != nullptr;
+        }
+
+        const MappedFile& mapped() const {
+            return file;
+        }
+
+        uint32_t assetCount() const {
+            return header->assetCount;
+        }
+
+        uint32_t chunkCount() const {
+            return header->chunkCount;
+        }
+
+        const PackAsset& asset(uint32_t index) const {
+            return assetTable[index];
+        }
+
+        const PackChunk& chunk(uint32_t index) const {
+            return chunkTable[index];
+        }
+
+        // UINT32_MAX if there is no asset with that name.
+        uint32_t find(const std::string& name) const {
+            for (uint32_t i = 0; i < header->assetCount; i++) {
+                if (name == assetTable[i].name) {
+                    return i;
+                }
+            }
+            return UINT32_MAX;
+        }
+
+        // Decodes chunk.size bytes into dst. Thread-safe; false if an LZ4 block is corrupt.
+        bool read(uint32_t index, void* dst) const {
+            const PackChunk& entry = chunkTable[index];
+            const uint8_t* source = file.data() + entry.fileOffset;
+            if (entry.codec == ChunkCodec::None) {
+                std::memcpy(dst, source, entry.size);
+                return true;
+            }
+            return lz4::decompress(source, entry.storedSize, static_cast<uint8_t*>(dst), entry.size);
+        }
+
+    private:
+        bool validate() {
+            const uint8_t* base = file.data();
+            uint64_t fileSize = file.size();
+            if (fileSize < sizeof(AssetPackHeader)) {
+                return false;
+            }
+            header = reinterpret_cast<const AssetPackHeader*>(base);
+            uint64_t assetBytes = uint64_t(header->assetCount) * sizeof(PackAsset);
+            uint64_t chunkBytes = uint64_t(header->chunkCount) * sizeof(PackChunk);
+            if (std::memcmp(header->magic, AssetPackMagic, sizeof(AssetPackMagic)) != 0 || header->version != AssetPackVersion ||
+                header->fileSize != fileSize || header->assetTableOffset % AssetPackAlignment != 0 || header->chunkTableOffset % AssetPackAlignment != 0 ||
+                header->assetTableOffset > fileSize || assetBytes > fileSize - header->assetTableOffset ||
+                header->chunkTableOffset > fileSize || chunkBytes > fileSize - header->chunkTableOffset) {
+                return false;
+            }
+            assetTable = reinterpret_cast<const PackAsset*>(base + header->assetTableOffset);
+            chunkTable = reinterpret_cast<const PackChunk*>(base + header->chunkTableOffset);
+            uint64_t checksum = fnv1a64(base + header->assetTableOffset, static_cast<size_t>(assetBytes)) ^
+                fnv1a64(base + header->chunkTableOffset, static_cast<size_t>(chunkBytes));
+            if (checksum != header->tableChecksum) {
+                return false;
+            }
+
+            for (uint32_t i = 0; i < header->chunkCount; i++) {
+                const PackChunk& entry = chunkTable[i];
+                if (entry.fileOffset > fileSize || entry.storedSize > fileSize - entry.fileOffset || entry.size > AssetPackChunkSize ||
+                    (entry.codec != ChunkCodec::None && entry.codec != ChunkCodec::Lz4) ||
+                    (entry.codec == ChunkCodec::None && entry.storedSize != entry.size)) {
+                    return false;
+                }
+            }
+            for (uint32_t i = 0; i < header->assetCount; i++) {
+                const PackAsset& entry = assetTable[i];
+                if (std::memchr(entry.name, '\0', sizeof(entry.name)) == nullptr ||
+                    entry.firstChunk > header->chunkCount || entry.chunkCount > header->chunkCount - entry.firstChunk) {
+                    return false;
+                }
+                uint64_t expected = 0;
+                uint64_t rowBytes = 1;
+                if (entry.kind == AssetKind::Mesh) {
+                    expected = uint64_t(entry.vertexCount) * entry.vertexStride + uint64_t(entry.indexCount) * sizeof(uint32_t);
+                }
+                else if (entry.kind == AssetKind::Texture) {
+                    rowBytes = uint64_t(entry.width) * entry.bytesPerTexel;
+                    expected = rowBytes * entry.height;
+                    // The upload copies rows of bytesPerTexel texels into an image of this format
+                    if (rowBytes == 0 || packTexelSize(static_cast<VkFormat>(entry.format)) != entry.bytesPerTexel) {
+                        return false;
+                    }
+                }
+                else {
+                    return false;
+                }
+                // Chunks must tile the asset exactly, in order
+                uint64_t covered = 0;
+                for (uint32_t c = entry.firstChunk; c < entry.firstChunk + entry.chunkCount; c++) {
+                    const PackChunk& part = chunkTable[c];
+                    if (part.assetOffset != covered || part.size == 0 || part.assetOffset % rowBytes != 0 || part.size % rowBytes != 0) {
+                        return false;
+                    }
+                    covered += part.size;
+                }
+                if (entry.size != expected || covered != expected || expected == 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        MappedFile file;
+        const AssetPackHeader* header = nullptr;
+        const PackAsset* assetTable = nullptr;
+        const PackChunk* chunkTable = nullptr;
+    };
+
+    // Builds a pack. Assets are kept in memory until write(), which compresses one chunk at a time
+    // and keeps a chunk raw whenever LZ4 does not make it smaller.
+    class AssetPackWriter {
+    public:
+        void addMesh(const std::string& name, const void* vertices, uint32_t vertexCount, uint32_t vertexStride, const uint32_t* indices, uint32_t indexCount) {
+            Source source = makeSource(name, AssetKind::Mesh);
+            source.info.vertexStride = vertexStride;
+            source.info.vertexCount = vertexCount;
+            source.info.indexCount = indexCount;
+            size_t vertexBytes = size_t(vertexCount) * vertexStride;
+            source.data.resize(vertexBytes + size_t(indexCount) * sizeof(uint32_t));
+            std::memcpy(source.data.data(), vertices, vertexBytes);
+            std::memcpy(source.data.data() + vertexBytes, indices, size_t(indexCount) * sizeof(uint32_t));
+            push(std::move(source));
+        }
+
+        void addTexture(const std::string& name, uint32_t width, uint32_t height, VkFormat format, uint32_t bytesPerTexel, const void* texels) {
+            if (packTexelSize(format) == 0 || packTexelSize(format) != bytesPerTexel) {
+                throw std::runtime_error("Texture " + name + " has an unsupported format or the wrong texel size!");
+            }
+            if (size_t(width) * bytesPerTexel > AssetPackChunkSize) {
+                throw std::runtime_error("Texture row of " + name + " is larger than a pack chunk!");
+            }
+            Source source = makeSource(name, AssetKind::Texture);
+            source.info.format = static_cast<uint32_t>(format);
+            source.info.width = width;
+            source.info.height = height;
+            source.info.bytesPerTexel = bytesPerTexel;
+            source.data.resize(size_t(width) * height * bytesPerTexel);
+            std::memcpy(source.data.data(), texels, source.data.size());
+            push(std::move(source));
+        }
+
+        // Written to "<path>.tmp" and renamed over path, so readers never see a partial pack.
+        bool write(const std::string& path, bool compress) const {
+            std::vector<PackAsset> assets;
+            std::vector<PackChunk> chunks;
+            for (const Source& source : sources) {
+                PackAsset asset = source.info;
+                asset.size = source.data.size();
+                asset.firstChunk = static_cast<uint32_t>(chunks.size());
+                uint64_t step = AssetPackChunkSize;
+                if (asset.kind == AssetKind::Texture) {
+                    uint64_t rowBytes = uint64_t(asset.width) * asset.bytesPerTexel;
+                    step = AssetPackChunkSize / rowBytes * rowBytes;
+                }
+                for (uint64_t offset = 0; offset < asset.size; offset += step) {
+                    PackChunk chunk{};
+                    chunk.assetOffset = offset;
+                    chunk.size = static_cast<uint32_t>(std::min(step, asset.size - offset));
+                    chunks.push_back(chunk);
+                }
+                asset.chunkCount = static_cast<uint32_t>(chunks.size()) - asset.firstChunk;
+                assets.push_back(asset);
+            }
+
+            AssetPackHeader header{};
+            std::memcpy(header.magic, AssetPackMagic, sizeof(AssetPackMagic));
+            header.version = AssetPackVersion;
+            header.assetCount = static_cast<uint32_t>(assets.size());
+            header.chunkCount = static_cast<uint32_t>(chunks.size());
+            header.assetTableOffset = alignPackOffset(sizeof(AssetPackHeader));
+            header.chunkTableOffset = alignPackOffset(header.assetTableOffset + assets.size() * sizeof(PackAsset));
+            uint64_t dataEnd = header.chunkTableOffset + chunks.size() * sizeof(PackChunk);
+            uint64_t offset = alignPackOffset(dataEnd);
+
+            std::string temp = path + ".tmp";
+            {
+                std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+                std::vector<uint8_t> compressed(lz4::compressBound(AssetPackChunkSize));
+                uint32_t chunkIndex = 0;
+                for (size_t a = 0; a < assets.size(); a++) {
+                    for (uint32_t c = 0; c < assets[a].chunkCount; c++, chunkIndex++) {
+                        PackChunk& chunk = chunks[chunkIndex];
+                        const uint8_t* raw = sources[a].data.data() + chunk.assetOffset;
+                        size_t packed = compress ? lz4::compress(raw, chunk.size, compressed.data(), chunk.size - 1) : 0;
+                        chunk.codec = packed != 0 ? ChunkCodec::Lz4 : ChunkCodec::None;
+                        chunk.storedSize = packed != 0 ? static_cast<uint32_t>(packed) : chunk.size;
+                        chunk.fileOffset = offset;
+                        file.seekp(static_cast<std::streamoff>(offset));
+                        file.write(reinterpret_cast<const char*>(packed != 0 ? compressed.data() : raw), chunk.storedSize);
+                        dataEnd = offset + chunk.storedSize;
+                        offset = alignPackOffset(dataEnd);
+                    }
+                }
+                header.fileSize = offset;
+                header.tableChecksum = fnv1a64(reinterpret_cast<const uint8_t*>(assets.data()), assets.size() * sizeof(PackAsset)) ^
+                    fnv1a64(reinterpret_cast<const uint8_t*>(chunks.data()), chunks.size() * sizeof(PackChunk));
+                // Padding the tail makes fileSize the real file length; an aligned end needs none, and
+                // writing there would clobber the last data byte
+                if (offset > dataEnd) {
+                    file.seekp(static_cast<std::streamoff>(offset - 1));
+                    file.put('\0');
+                }
+                file.seekp(0);
+                file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                file.seekp(static_cast<std::streamoff>(header.assetTableOffset));
+                file.write(reinterpret_cast<const char*>(assets.data()), static_cast<std::streamsize>(assets.size() * sizeof(PackAsset)));
+                file.seekp(static_cast<std::streamoff>(header.chunkTableOffset));
+                file.write(reinterpret_cast<const char*>(chunks.data()), static_cast<std::streamsize>(chunks.size() * sizeof(PackChunk)));
+                file.flush();
+                if (!file) {
+                    std::cout << "Asset pack: failed to write " << temp << std::endl;
+                    return false;
+                }
+            }
+            std::error_code error;
+            std::filesystem::rename(temp, path, error);
+            if (error) {
+                std::cout << "Asset pack: failed to replace " << path << ": " << error.message() << std::endl;
+                std::filesystem::remove(temp, error);
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        struct Source {
+            PackAsset info{};
+            std::vector<uint8_t> data;
+        };
+
+        void push(Source source) {
+            if (source.data.empty()) {
+                throw std::runtime_error(std::string("Asset ") + source.info.name + " is empty!");
+            }
+            sources.push_back(std::move(source));
+        }
+
+        static Source makeSource(const std::string& name, AssetKind kind) {
+            if (name.size() >= sizeof(PackAsset::name)) {
+                throw std::runtime_error("Asset name " + name + " is too long!");
+            }
+            Source source;
+            std::memcpy(source.info.name, name.c_str(), name.size() + 1);
+            source.info.kind = kind;
+            return source;
+        }
+
+        std::vector<Source> sources;
+    };
+
+    struct AssetLoadStats {
+        uint32_t assets = 0;
+        uint32_t failed = 0;                // assets with a corrupt chunk; never become ready
+        uint64_t bytes = 0;                 // decoded bytes uploaded
+        uint64_t storedBytes = 0;           // bytes read from the pack
+        double seconds = 0.0;               // open() until the last upload is visible to the graphics queue
+        uint64_t peakResidentGrowth = 0;    // resident set above its size at open(), sampled every pump()
+        bool complete = false;
+    };
+
+    // Streams a pack into device-local buffers (meshes) and images (textures) while frames keep
+    // rendering. Each pump() reserves staging spans for the next chunks, up to a byte budget, and
+    // fills them on the job system: raw chunks are copied straight from the mapping into the span,
+    // LZ4 chunks are decoded in parallel. The job that fills a span also records its copy, so the
+    // frame never waits for a decode. An asset is usable once isReady() says so; one with a corrupt
+    // chunk is skipped and never becomes ready, while the rest of the pack keeps streaming.
+    class AssetLoader {
+    public:
+        void init(DeviceMemoryAllocator& memory, const DeviceDispatch& dispatch, const VkAllocationCallbacks* callbacks, DeletionQueue& deletion,
+            UploadManager& uploads, Jobs::JobSystem& jobs, VkDeviceSize budgetPerFrame) {
+            this->memory = &memory;
+            this->dispatch = &dispatch;
+            this->callbacks = callbacks;
+            this->deletion = &deletion;
+            this->uploads = &uploads;
+            this->jobs = &jobs;
+            this->budgetPerFrame = budgetPerFrame;
+        }
+
+        // Creates every resource up front and queues all chunks; returns false if the pack is unusable.
+        bool open(const std::string& path) {
+            startTime = std::chrono::steady_clock::now();
+            baselineResident = residentBytes();
+            if (!pack.open(path)) {
+                return false;
+            }
+            for (uint32_t i = 0; i < pack.chunkCount(); i++) {
+                if (pack.chunk(i).size > uploads->chunkSize()) {
+                    std::cout << "Asset pack: " << path << " has chunks larger than the staging ring allows." << std::endl;
+                    pack.close();
+                    return false;
+                }
+            }
+            directDecode = uploads->ringIsCached();
+            std::vector<LoadedAsset>(pack.assetCount()).swap(assets);
+            for (uint32_t i = 0; i < pack.assetCount(); i++) {
+                createResource(i);
+            }
+            nextChunk = 0;
+            currentAsset = 0;
+            stats = {};
+            stats.assets = pack.assetCount();
+            std::cout << "Asset pack: streaming " << pack.assetCount() << " assets (" << (pack.mapped().size() >> 10) << " KiB) from " << path
+                << (directDecode ? "" : ", decoding through cached scratch") << "." << std::endl;
+            return true;
+        }
+
+        // Expects the device to be idle.
+        void destroy() {
+            if (jobs == nullptr) {
+                return;
+            }
+            jobs->wait(fills);
+            uint64_t lastUse = deletion->lastSubmitted();
+            for (LoadedAsset& asset : assets) {
+                if (asset.buffer != VK_NULL_HANDLE) {
+                    deletion->retire(asset.buffer, asset.allocation, lastUse);
+                }
+                if (asset.image != VK_NULL_HANDLE) {
+                    deletion->retire(asset.image, asset.allocation, lastUse);
+                }
+            }
+            assets.clear();
+            pack.close();
+            jobs = nullptr;
+        }
+
+        // Call once per frame, before UploadManager::pump() submits the batch.
+        void pump() {
+            if (!pack.isOpen()) {
+                return;
+            }
+            uint64_t resident = residentBytes();
+            stats.peakResidentGrowth = std::max(stats.peakResidentGrowth, resident - std::min(resident, baselineResident));
+            startFills();
+            if (nextChunk == pack.chunkCount() && fills.finished() && allReady()) {
+                stats.bytes = decodedBytes.load();
+                stats.storedBytes = storedBytes.load();
+                stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+                stats.complete = true;
+                for (const LoadedAsset& asset : assets) {
+                    stats.failed += asset.failed.load(std::memory_order_relaxed) ? 1 : 0;
+                }
+                std::cout << "Asset pack: " << stats.assets << " assets (" << stats.failed << " failed), " << (stats.bytes >> 10) << " KiB (" << (stats.storedBytes >> 10)
+                    << " KiB stored) in " << stats.seconds * 1000.0 << " ms, resident set peaked " << (stats.peakResidentGrowth >> 10)
+                    << " KiB above its starting size." << std::endl;
+                pack.close(); // Nothing reads the mapping any more
+            }
+        }
+
+        bool isReady(uint32_t asset) const {
+            const LoadedAsset& entry = assets[asset];
+            return entry.finished.load(std::memory_order_acquire) && !entry.failed.load(std::memory_order_relaxed) && uploads->isComplete(entry.ticket);
+        }
+
+        bool isFailed(uint32_t asset) const {
+            return assets[asset].failed.load(std::memory_order_acquire);
+        }
+
+        uint32_t assetCount() const {
+            return static_cast<uint32_t>(assets.size());
+        }
+
+        // The mesh buffer holds the vertices, then the indices at indexOffset().
+        VkBuffer buffer(uint32_t asset) const {
+            return assets[asset].buffer;
+        }
+
+        VkDeviceSize indexOffset(uint32_t asset) const {
+            return assets[asset].indexOffset;
+        }
+
+        VkImage image(uint32_t asset) const {
+            return assets[asset].image;
+        }
+
+        const AssetLoadStats& loadStats() const {
+            return stats;
+        }
+
+        // Moves ready mesh buffers out of sparse device memory blocks into fuller ones, up to maxBytes.
+        // Each moved mesh gets a new buffer at its reserved range and a copy recorded into commandBuffer;
+        // the old buffer and memory are retired after value, the frame timeline value that
+        // commandBuffer's submission signals. buffer() returns the new handle from now on.
+        VkDeviceSize defragment(VkCommandBuffer commandBuffer, uint64_t value, VkDeviceSize maxBytes) {
+            for (uint32_t i = 0; i < assets.size(); i++) {
+                DeviceAllocation* allocation = assets[i].allocation;
+                if (assets[i].buffer != VK_NULL_HANDLE && allocation->userData == nullptr && isReady(i)) {
+                    allocation->userData = &assets[i];
+                    allocation->movable = true;
+                }
+            }
+            std::vector<DefragmentationMove> moves = memory->beginDefragmentation(maxBytes);
+            if (moves.empty()) {
+                return 0;
+            }
+            // Finished uploads and earlier frames' writes before the copies read the old buffers
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            dispatch->vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+            VkDeviceSize moved = 0;
+            for (DefragmentationMove& move : moves) {
+                LoadedAsset& asset = *static_cast<LoadedAsset*>(move.source->userData);
+                VkBuffer buffer = createMeshBuffer(asset.size);
+                if (dispatch->vkBindBufferMemory(dispatch->device, buffer, move.destination->memory, move.destination->offset) != VK_SUCCESS) {
+                    dispatch->vkDestroyBuffer(dispatch->device, buffer, callbacks);
+                    continue; // The reservation goes back in endDefragmentation
+                }
+                VkBufferCopy region{ 0, 0, asset.size };
+                dispatch->vkCmdCopyBuffer(commandBuffer, asset.buffer, buffer, 1, &region);
+                deletion->retire(asset.buffer, move.source, value);
+                deletion->track(buffer, "asset mesh");
+                asset.buffer = buffer;
+                asset.allocation = move.destination;
+                move.done = true;
+                moved += asset.size;
+            }
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+            dispatch->vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+            memory->endDefragmentation(moves);
+            return moved;
+        }
+
+    private:
+        struct LoadedAsset {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkImage image = VK_NULL_HANDLE;
+            DeviceAllocation* allocation = nullptr;
+            VkDeviceSize indexOffset = 0;
+            VkDeviceSize size = 0;                      // mesh bytes, kept for relocation after the pack closes
+            bool begun = false;                         // image layout transition recorded
+            std::atomic<uint32_t> chunksLeft{ 0 };
+            UploadTicket ticket;                        // written by the job that copies the last chunk
+            std::atomic<bool> finished{ false };        // publishes ticket
+            std::atomic<bool> failed{ false };          // a chunk did not decode
+        };
+
+        void createResource(uint32_t index) {
+            const PackAsset& info = pack.asset(index);
+            LoadedAsset& asset = assets[index];
+            asset.chunksLeft.store(info.chunkCount);
+            if (info.kind == AssetKind::Mesh) {
+                asset.buffer = memory->createBuffer(info.size, MeshBufferUsage, MemoryUsage::GpuOnly, asset.allocation);
+                asset.size = info.size;
+                asset.indexOffset = VkDeviceSize(info.vertexCount) * info.vertexStride;
+                deletion->track(asset.buffer, "asset mesh");
+                return;
+            }
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.format = static_cast<VkFormat>(info.format);
+            imageInfo.extent = { info.width, info.height, 1 };
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            Allocator::ScopedAllocationTag allocationTag("vkCreateImage");
+            if (dispatch->vkCreateImage(dispatch->device, &imageInfo, callbacks, &asset.image) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create image for asset " + std::string(info.name) + "!");
+            }
+            deletion->track(asset.image, "asset texture");
+            asset.allocation = memory->allocateForImage(asset.image, MemoryUsage::GpuOnly);
+        }
+
+        VkBuffer createMeshBuffer(VkDeviceSize size) {
+            VkBufferCreateInfo bufferInfo{};
+            bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.size = size;
+            bufferInfo.usage = MeshBufferUsage;
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            VkBuffer buffer;
+            Allocator::ScopedAllocationTag allocationTag("vkCreateBuffer");
+            if (dispatch->vkCreateBuffer(dispatch->device, &bufferInfo, callbacks, &buffer) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create buffer!");
+            }
+            return buffer;
+        }
+
+        // Starts at least one chunk per call, so a chunk larger than the budget still makes progress.
+        void startFills() {
+            VkDeviceSize budget = budgetPerFrame;
+            while (nextChunk < pack.chunkCount() && budget > 0) {
+                const PackChunk& chunk = pack.chunk(nextChunk);
+                uint32_t assetIndex = owner(nextChunk);
+                const PackAsset& info = pack.asset(assetIndex);
+                VkDeviceSize alignment = info.kind == AssetKind::Texture ? UploadManager::imageAlignment(info.bytesPerTexel) : 16;
+                StagingSpan span = uploads->reserve(chunk.size, alignment, false);
+                if (!span) {
+                    break; // Ring is full until earlier batches retire
+                }
+                LoadedAsset& asset = assets[assetIndex];
+                if (info.kind == AssetKind::Texture && !asset.begun) {
+                    uploads->beginImage(asset.image); // Recorded before any of its copies
+                    asset.begun = true;
+                }
+                uint32_t chunkIndex = nextChunk;
+                jobs->schedule([this, assetIndex, chunkIndex, span]() { fill(assetIndex, chunkIndex, span); }, &fills);
+                budget -= std::min<VkDeviceSize>(budget, chunk.size);
+                nextChunk++;
+            }
+            if (nextChunk < pack.chunkCount()) {
+                // Read ahead what the next pump() will start with
+                uint32_t lastChunk = std::min<uint32_t>(nextChunk + static_cast<uint32_t>(budgetPerFrame / AssetPackChunkSize), pack.chunkCount() - 1);
+                const PackChunk& first = pack.chunk(nextChunk);
+                const PackChunk& last = pack.chunk(lastChunk);
+                pack.mapped().prefetch(first.fileOffset, last.fileOffset + last.storedSize - first.fileOffset);
+            }
+        }
+
+        // Runs on a worker: fills the span, records its copy, and finishes the asset after its last chunk.
+        void fill(uint32_t assetIndex, uint32_t chunkIndex, const StagingSpan& span) {
+            const PackAsset& info = pack.asset(assetIndex);
+            const PackChunk& chunk = pack.chunk(chunkIndex);
+            LoadedAsset& asset = assets[assetIndex];
+            if (!asset.failed.load(std::memory_order_acquire) && decode(chunkIndex, span.mapped)) {
+                if (info.kind == AssetKind::Mesh) {
+                    uploads->copy(span, asset.buffer, chunk.assetOffset);
+                }
+                else {
+                    uint64_t rowBytes = uint64_t(info.width) * info.bytesPerTexel;
+                    uploads->copyRows(span, asset.image, info.width, static_cast<uint32_t>(chunk.assetOffset / rowBytes),
+                        static_cast<uint32_t>(chunk.size / rowBytes));
+                }
+                decodedBytes.fetch_add(chunk.size, std::memory_order_relaxed);
+                storedBytes.fetch_add(chunk.storedSize, std::memory_order_relaxed);
+            }
+            else {
+                // The span goes back unread; the asset still counts down so the load can complete
+                uploads->cancel(span);
+                if (!asset.failed.exchange(true, std::memory_order_acq_rel)) {
+                    std::cout << "Asset pack: chunk " << chunkIndex << " of " << info.name << " is corrupt, skipping the asset." << std::endl;
+                }
+            }
+            pack.mapped().release(chunk.fileOffset, chunk.storedSize);
+            // A failed asset is finished too, so its image still ends in a defined layout and owner
+            if (asset.chunksLeft.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                asset.ticket = info.kind == AssetKind::Mesh ? uploads->finish(asset.buffer, 0, info.size)
+                    : uploads->finishImage(asset.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+                asset.finished.store(true, std::memory_order_release);
+            }
+        }
+
+        bool decode(uint32_t index, void* dst) const {
+            const PackChunk& chunk = pack.chunk(index);
+            if (chunk.codec == ChunkCodec::None || directDecode) {
+                return pack.read(index, dst);
+            }
+            // LZ4 re-reads its own output, which is very slow in write-combined memory: decode into a
+            // cache-sized per-thread scratch and stream the result into the span in one pass
+            thread_local std::vector<uint8_t> scratch;
+            if (scratch.size() < chunk.size) {
+                scratch.resize(AssetPackChunkSize);
+            }
+            if (!pack.read(index, scratch.data())) {
+                return false;
+            }
+            std::memcpy(dst, scratch.data(), chunk.size);
+            return true;
+        }
+
+        uint32_t owner(uint32_t chunk) {
+            while (currentAsset + 1 < pack.assetCount() && chunk >= pack.asset(currentAsset).firstChunk + pack.asset(currentAsset).chunkCount) {
+                currentAsset++;
+            }
+            return currentAsset;
+        }
+
+        bool allReady() const {
+            for (uint32_t i = 0; i < assets.size(); i++) {
+                if (!isReady(i) && !(isFailed(i) && assets[i].finished.load(std::memory_order_acquire))) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Transfer source so defragment() can copy a mesh out of its old buffer
+        static constexpr VkBufferUsageFlags MeshBufferUsage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+        DeviceMemoryAllocator* memory = nullptr;
+        const DeviceDispatch* dispatch = nullptr;
+        const VkAllocationCallbacks* callbacks = nullptr;
+        DeletionQueue* deletion = nullptr;
+        UploadManager* uploads = nullptr;
+        Jobs::JobSystem* jobs = nullptr;
+        VkDeviceSize budgetPerFrame = 0;
+        bool directDecode = false;
+
+        AssetPack pack;
+        std::vector<LoadedAsset> assets;
+        uint32_t nextChunk = 0;
+        uint32_t currentAsset = 0;
+        Jobs::Counter fills;
+        std::atomic<uint64_t> decodedBytes{ 0 };
+        std::atomic<uint64_t> storedBytes{ 0 };
+
+        std::chrono::steady_clock::time_point startTime;
+        uint64_t baselineResident = 0;
+        AssetLoadStats stats;
+    };
+
+} // namespace vulkan
@@ -6,7 +6,27 @@
 #include <iostream>
 #include <vector>
 #include <set>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <memory>
 #include "Alloctor.hpp"
+#include "DeviceMemory.hpp"
+#include "DeviceSelection.hpp"
+#include "PipelineCache.hpp"
+#include "JobSystem.hpp"
+#include "StagingUpload.hpp"
+#include "AssetPack.hpp"
+#include "Profiler.hpp"
+#include "RenderGraph.hpp"
+#include "PresentPolicy.hpp"
+#include "DeferredDeletion.hpp"
+#include "VulkanDispatch.hpp"
+#include "Descriptors.hpp"
+#include "GpuCulling.hpp"
+#include "ShaderSystem.hpp"
+#include "Scene.hpp"
 
 struct SwapChainSupportDetails {
     VkSurfaceCapabilitiesKHR capabilities;
@@ -14,24 +34,204 @@ struct SwapChainSupportDetails {
     std::vector<VkPresentModeKHR> presentModes;
 };
 
+// How frames are recorded. Auto picks dynamic rendering when the device supports it.
+enum class RenderBackend {
+    Auto,
+    DynamicRendering,   // vkCmdBeginRendering + synchronization2, no VkRenderPass/VkFramebuffer
+    RenderPass          // legacy single-subpass render pass with one framebuffer per image
+};
+
+// Startup options for VulkanApp.
+struct AppConfig {
+    uint32_t framesInFlight = 0;   // how many frames the CPU may record ahead of the GPU; 0 = per present policy (2 headless)
+    double targetFps = 0.0;        // 0 = unlimited (present mode paces the loop)
+    vulkan::PresentPolicy presentPolicy = vulkan::PresentPolicy::LowLatency;  // switchable at runtime with F1-F3
+
+    // Headless mode renders into offscreen images without GLFW or a surface, for display-less
+    // render nodes and software drivers such as lavapipe.
+    bool headless = false;
+    uint32_t headlessWidth = 1280;
+    uint32_t headlessHeight = 720;
+    uint32_t headlessFrameCount = 300;
+    // Receives each rendered frame (tightly packed BGRA8) a few frames after it was submitted.
+    std::function<void(const void* pixels, uint32_t width, uint32_t height, uint64_t frameNumber)> readbackCallback;
+
+    // Physical device override: an index or a substring of the device name. Empty = highest score,
+    // falling back to VKL_DEVICE.
+    std::string device;
+
+    // On-disk VkPipelineCache; written on shutdown and every pipelineCacheSaveInterval seconds.
+    std::string pipelineCachePath = "pipeline_cache.bin";
+    size_t pipelineCacheMaxBytes = 64ull << 20;
+    double pipelineCacheSaveInterval = 60.0;
+
+    uint32_t workerThreads = 0;    // 0 = one per hardware thread, minus the main thread
+    uint32_t recordingChunks = 0;  // secondary command buffers per frame; 0 = one per thread
+
+    // Slots in the global bindless descriptor table; clamped to the device's update-after-bind limits.
+    uint32_t bindlessTextureCount = 16384;
+    uint32_t bindlessBufferCount = 16384;
+
+    // Objects laid out on a grid and drawn through GPU frustum culling and a single indirect count
+    // draw; 0 = off. Needs bindless and dynamic rendering.
+    uint32_t gpuCullingObjectCount = 0;
+
+    // CPU scene hierarchy of about this many nodes, animated, transformed and frustum-culled every
+    // frame by the SoA kernels in SceneMath.hpp; 0 = off. The level is clamped to what the CPU supports.
+    uint32_t sceneObjectCount = 0;
+    vulkan::SimdLevel sceneSimdLevel = vulkan::SimdLevel::Avx2;
+
+    // Shader sources are compiled at startup into a content-addressed SPIR-V cache; with hot reload on,
+    // edited sources are recompiled and the pipelines using them rebuilt at the next frame boundary.
+    std::string shaderDirectory = "shaders";
+    std::string shaderCacheDirectory = "shader_cache";
+#if defined(NDEBUG)
+    bool shaderHotReload = false;
+#else
+    bool shaderHotReload = true;
+#endif
+
+    VkDeviceSize stagingRingSize = 64ull << 20;
+    VkDeviceSize streamBudgetPerFrame = 16ull << 20;  // streamed upload bytes copied per frame
+
+    // Non-empty streams this asset pack into device memory while frames render (see AssetLoader).
+    std::string assetPackPath;
+    VkDeviceSize assetBudgetPerFrame = 32ull << 20;   // decoded pack bytes started per frame
+    VkDeviceSize defragmentBudgetPerFrame = 4ull << 20;   // mesh bytes moved per frame to compact device memory, 0 disables
+
+    // Non-empty enables CPU/GPU profiling and writes a Chrome trace here on exit.
+    std::string profileTracePath;
+
+    // Lists Vulkan handles created by the app that were never destroyed, at shutdown.
+    bool trackLeaks = false;
+
+    // Benchmark knobs: stop the windowed loop after maxFrames (0 = run until closed), force a swapchain
+    // recreation every recreateEveryNFrames, and record syntheticDrawCount clear rects per frame as a
+    // stand-in draw workload.
+    uint32_t maxFrames = 0;
+    uint32_t recreateEveryNFrames = 0;
+    uint32_t syntheticDrawCount = 0;
+
+    RenderBackend renderBackend = RenderBackend::Auto;
+};
+
+// Wall time of one startup phase (or one swapchain recreation), in the order they ran.
+struct PhaseTiming {
+    const char* name;
+    double ms;
+};
+
+// Command pool owned by one job-system thread for one frame in flight. Pools are externally
+// synchronized, so each thread records its secondaries from its own pool without locking.
+struct ThreadCommandPool {
+    VkCommandPool pool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> secondaries;
+    uint32_t used = 0;
+};
+
+// Everything one frame in flight owns. The fence guards reuse of the command pool and the
+// acquire semaphore, so the CPU can record frame N+1 while the GPU still executes frame N.
+struct FrameContext {
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkFence inFlightFence = VK_NULL_HANDLE;
+    VkSemaphore imageAvailableSemaphore = VK_NULL_HANDLE;
+    uint64_t submitSerial = 0;     // frame timeline value of the last submission that used this slot
+    std::vector<ThreadCommandPool> threadPools;  // indexed by Jobs::JobSystem::threadIndex()
+
+    // Headless readback target: written by the frame's copy, read once the fence is waited on
+    VkBuffer readbackBuffer = VK_NULL_HANDLE;
+    vulkan::DeviceAllocation* readbackAllocation = nullptr;
+    bool readbackPending = false;
+    uint64_t frameNumber = 0;
+};
+
+// Rolling frame timings, reported once per second.
+struct FrameStats {
+    double cpuFrameMs = 0.0;      // time spent recording and submitting, excluding waits
+    double gpuWaitMs = 0.0;       // time blocked waiting for a frame-in-flight fence
+    double fps = 0.0;
+    uint32_t frameCount = 0;
+    double cpuAccumulatedMs = 0.0;
+    double gpuWaitAccumulatedMs = 0.0;
+    double sceneMs = 0.0;         // CPU scene update and cull, part of cpuFrameMs
+    double sceneAccumulatedMs = 0.0;
+    std::chrono::steady_clock::time_point windowStart = std::chrono::steady_clock::now();
+};
+
 namespace vulkan {
 
     class VulkanApp {
     public:
-        VulkanApp() : instance(VK_NULL_HANDLE), logicalDevice(VK_NULL_HANDLE), window(nullptr), swapchain(VK_NULL_HANDLE) {
+        VulkanApp(const AppConfig& config = AppConfig{}) : instance(VK_NULL_HANDLE), logicalDevice(VK_NULL_HANDLE), window(nullptr), swapchain(VK_NULL_HANDLE), config(config) {
             run();
         }
         GLFWwindow* window;
         void run() {
+            Profiler::Instance().setEnabled(!config.profileTracePath.empty());
+            presentPolicy = requestedPresentPolicy = config.presentPolicy;
             CreateAllocator();
-            createInstance();
-            wininit();
-            enumeratePhysicalDevices();
-            createLogicalDevice();
-            swapChainSupport = querySwapChainSupport(physicalDevices[0], surface);
-            printSwapChainSupportDetails(swapChainSupport);
-            createSwapChain(); // Encapsulated swapchain creation
-            mainLoop();
+            jobSystem = std::make_unique<Jobs::JobSystem>(config.workerThreads);
+            std::cout << "Job system: " << jobSystem->threadCount() << " threads." << std::endl;
+            if (!config.headless) {
+                wininit(); // GLFW must be up before createInstance() asks it for surface extensions
+            }
+            timePhase("createInstance", [this]() { createInstance(); });
+            if (!config.headless) {
+                createSurface();
+            }
+            timePhase("enumeratePhysicalDevices", [this]() {
+                enumeratePhysicalDevices();
+                pickPhysicalDevice();
+            });
+            timePhase("createLogicalDevice", [this]() { createLogicalDevice(); });
+            deviceMemory.init(physicalDevice, deviceDispatch, &Alloctor, memoryBudgetSupported);
+            deviceMemory.printBudget();
+            deletionQueue.init(deviceMemory, deviceDispatch, &Alloctor, config.trackLeaks);
+            createDescriptors();
+            shaders.init(deviceDispatch, &Alloctor, deletionQueue, *jobSystem, config.shaderDirectory,
+                config.shaderCacheDirectory, config.shaderHotReload);
+            pipelineCache.init(physicalDevice, deviceDispatch, &Alloctor, config.pipelineCachePath,
+                config.pipelineCacheMaxBytes, config.pipelineCacheSaveInterval, jobSystem->threadCount());
+            uploads.init(deviceMemory, deviceDispatch, &Alloctor, queues, config.stagingRingSize, config.streamBudgetPerFrame);
+            assets.init(deviceMemory, deviceDispatch, &Alloctor, deletionQueue, uploads, *jobSystem, config.assetBudgetPerFrame);
+            if (!config.assetPackPath.empty()) {
+                timePhase("openAssetPack", [this]() { assets.open(config.assetPackPath); });
+            }
+            renderGraph.init(deviceMemory, deviceDispatch, &Alloctor, queues, frameSlotCount(), &deletionQueue);
+            Profiler::Instance().initGpu(instance, physicalDevice, deviceDispatch, &Alloctor, graphicsFamilyIndex,
+                frameSlotCount(), pipelineStatisticsEnabled, calibratedTimestampsSupported);
+            timePhase("createScene", [this]() { createScene(); });
+            if (config.headless) {
+                timePhase("createOffscreenTargets", [this]() { createOffscreenTargets(); });
+            }
+            else {
+                swapChainSupport = querySwapChainSupport(physicalDevice, surface);
+                printSwapChainSupportDetails(swapChainSupport);
+                timePhase("createSwapChain", [this]() { createSwapChain(); });
+            }
+            timePhase("createImageViews", [this]() { createSwapChainImageViews(logicalDevice, swapChainImages); });
+            if (!useDynamicRendering) {
+                timePhase("createRenderPass", [this]() { createRenderPass(logicalDevice); });
+                timePhase("createFramebuffers", [this]() { createFramebuffers(); });
+            }
+            timePhase("createFrameResources", [this]() { createFrameResources(); });
+            if (useDynamicRendering) {
+                timePhase("createGpuCulling", [this]() { createGpuCulling(); });
+                timePhase("buildRenderGraph", [this]() { buildRenderGraph(); });
+            }
+            if (config.headless) {
+                headlessLoop();
+            }
+            else {
+                mainLoop();
+            }
+            deviceDispatch.vkDeviceWaitIdle(logicalDevice);
+            if (Profiler::Instance().isEnabled()) {
+                Profiler::Instance().printStats();
+                Profiler::Instance().exportChromeTrace(config.profileTracePath);
+            }
+            destroyFrameResources();
             cleanup();
          
             
@@ -41,46 +241,144 @@ namespace vulkan {
 
         
         
+        const std::vector<PhaseTiming>& getPhaseTimings() const {
+            return phaseTimings;
+        }
+
+        // Frames rendered by the main or headless loop, and the loop's wall time.
+        uint64_t getLoopFrameCount() const {
+            return loopFrameCount;
+        }
+
+        double getLoopSeconds() const {
+            return loopSeconds;
+        }
+
+        const AssetLoadStats& getAssetLoadStats() const {
+            return assets.loadStats();
+        }
+
     private:
+        std::vector<PhaseTiming> phaseTimings;
+        uint64_t loopFrameCount = 0;
+        double loopSeconds = 0.0;
+
+        // Frame slots to allocate: enough for the deepest present policy, or what the config pins.
+        uint32_t frameSlotCount() const {
+            if (config.framesInFlight > 0) {
+                return config.framesInFlight;
+            }
+            return config.headless ? 2 : MaxPolicyFramesInFlight;
+        }
+
+        void timePhase(const char* name, const std::function<void()>& phase) {
+            auto start = std::chrono::steady_clock::now();
+            phase();
+            phaseTimings.push_back({ name, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() });
+        }
+
         VkApplicationInfo appInfo{};
         VkInstanceCreateInfo createInfo{};
         VkInstance instance;
         VkAllocationCallbacks Alloctor;
         VkDevice logicalDevice;
+        InstanceDispatch instanceDispatch;     // loaded right after vkCreateInstance
+        DeviceDispatch deviceDispatch;         // loaded right after vkCreateDevice; all recording and submits go through it
         VkQueue graphicsQueue;
         VkQueue presentQueue;
+        PipelineCacheService pipelineCache;
+        std::unique_ptr<Jobs::JobSystem> jobSystem;
+        UploadManager uploads;
+        AssetLoader assets;
+        RenderGraph renderGraph;               // drives the dynamic rendering backend
+        RenderResource backbuffer = InvalidRenderResource;
+        uint64_t uploadWaitValue = 0; // upload timeline value the frame being recorded must wait on
+        PresentPolicy presentPolicy = PresentPolicy::LowLatency;
+        PresentPolicy requestedPresentPolicy = PresentPolicy::LowLatency; // set by the F1-F3 key callback
+        PresentSettings presentSettings;
+        PresentLatencyTracker presentLatency;
+        bool presentWaitSupported = false;
+        uint32_t activeFrameCount = 1;         // frame slots in use; frames.size() is the most any policy needs
+        QueueSet queues; // Every submit and present goes through here so other threads can share queues
         std::vector<VkPhysicalDevice> physicalDevices;
-        VkSurfaceKHR surface;
-        VkRenderPass renderPasss;
+        VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+        VkSurfaceKHR surface = VK_NULL_HANDLE;
+        VkRenderPass renderPasss = VK_NULL_HANDLE;
+        VkFormat swapChainImageFormat = VK_FORMAT_B8G8R8A8_SRGB; // Headless targets keep this for BGRA8 readback
+        bool useDynamicRendering = false;
+        std::vector<DeviceAllocation*> offscreenAllocations; // headless render targets
         std::vector<VkImageView> swapChainImageViews;
         std::vector<VkImage> swapChainImages;
+        DeviceMemoryAllocator deviceMemory;
+        bool memoryBudgetSupported = false;
+        bool calibratedTimestampsSupported = false;
+        bool pipelineStatisticsEnabled = false;
+        AppConfig config;
+        std::vector<FrameContext> frames;
+        std::vector<VkSemaphore> renderFinishedSemaphores; // one per swapchain image, see createFrameResources()
+        uint32_t currentFrame = 0;
+        FrameStats frameStats;
+        bool framebufferResized = false;       // set by the GLFW callback, consumed at the next frame boundary
+        DeletionQueue deletionQueue;           // frame timeline + deferred destruction of everything the GPU may still use
+        bool bindlessSupported = false;
+        BindlessTable bindless;                // global textures/buffers, bound by whoever records into a command buffer
+        VkPipelineLayout bindlessLayout = VK_NULL_HANDLE;
+        FrameDescriptorAllocator frameDescriptors; // transient sets, reset with their frame slot
+        ShaderSystem shaders;                  // owns every shader module; pipelines hold ShaderIds
+        bool gpuDrivenSupported = false;
+        GpuCulling gpuCulling;
+        GpuCulling::Outputs cullOutputs;
+        static constexpr float CullingGridSpacing = 3.0f;
+        float cullingGridExtent = 0.0f;        // side length of the stand-in object grid
+        Scene scene;
+        std::vector<Scene::NodeId> sceneSpinners;  // animated nodes; everything else only inherits motion
+        float sceneExtent = 0.0f;
+        VkExtent2D swapChainExtent{};
         
+        // Children before parents: device objects (through the deletion queue) before the device, the
+        // swapchain before its surface, everything before the instance.
         void cleanup() {
-            if (surface)
-            {
-                vkDestroySurfaceKHR(instance, surface, &Alloctor);
-
-            }
+            presentLatency.stop();
             if (swapchain != VK_NULL_HANDLE) {
                 cleanupSwapChain();
             }
+            if (config.headless) {
+                destroyOffscreenTargets();
+            }
             if (logicalDevice != VK_NULL_HANDLE) {
-                vkDestroyDevice(logicalDevice, &Alloctor);
+                deletionQueue.retire(renderPasss);
+                renderPasss = VK_NULL_HANDLE;
+                pipelineCache.destroy();
+                Profiler::Instance().destroyGpu();
+                assets.destroy();
+                uploads.destroy();
+                renderGraph.destroy();
+                gpuCulling.destroy();
+                shaders.destroy();
+                deletionQueue.retire(bindlessLayout);
+                frameDescriptors.destroy();
+                bindless.destroy();
+                deletionQueue.destroy();
+                deviceMemory.destroy();
+                deviceDispatch.vkDestroyDevice(logicalDevice, &Alloctor);
+            }
+            if (surface != VK_NULL_HANDLE) {
+                instanceDispatch.vkDestroySurfaceKHR(instance, surface, &Alloctor);
             }
-           
+
 
             if (instance != VK_NULL_HANDLE) {
-                vkDestroyInstance(instance, &Alloctor);
+                instanceDispatch.vkDestroyInstance(instance, &Alloctor);
             }
             if (window) {
                 glfwDestroyWindow(window);
+                glfwTerminate();
             }
-            glfwTerminate();
         }
         VkSwapchainKHR swapchain; // Add a member for the swapchain
         SwapChainSupportDetails swapChainSupport; // Store swapchain support details
-        int graphicsFamilyIndex = -1;
-        int presentFamilyIndex = -1;
+        uint32_t graphicsFamilyIndex = UINT32_MAX;
+        uint32_t presentFamilyIndex = UINT32_MAX;
 
         void printSwapChainSupportDetails(const SwapChainSupportDetails& details) {
             // Print Surface Capabilities
@@ -114,85 +412,168 @@ namespace vulkan {
         }
 
         void createLogicalDevice() {
-            uint32_t queueFamilyCount = 0;
-            vkGetPhysicalDeviceQueueFamilyProperties(physicalDevices[0], &queueFamilyCount, nullptr);
-
-            std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-            vkGetPhysicalDeviceQueueFamilyProperties(physicalDevices[0], &queueFamilyCount, queueFamilies.data());
+            queues.plan(physicalDevice, surface);
+            std::vector<VkDeviceQueueCreateInfo> queueCreateInfos = queues.createInfos();
 
-            
-            for (int i = 0; i < queueFamilies.size(); i++) {
-                if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-                    graphicsFamilyIndex = i;
-                }
+            VkPhysicalDeviceFeatures deviceFeatures{}; // Initialize device features if needed
+            std::vector<const char*> deviceExtensions;
+            if (!config.headless) {
+                deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+            }
+            // Present latency is measured with present ids plus a wait for each id to reach the screen
+            VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+            presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+            VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+            presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+            presentIdFeatures.pNext = &presentWaitFeatures;
+            if (!config.headless && isDeviceExtensionSupported(physicalDevice, VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+                isDeviceExtensionSupported(physicalDevice, VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+                VkPhysicalDeviceFeatures2 query{};
+                query.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+                query.pNext = &presentIdFeatures;
+                instanceDispatch.vkGetPhysicalDeviceFeatures2(physicalDevice, &query);
+                presentWaitSupported = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+            }
+            if (presentWaitSupported) {
+                deviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+                deviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+            }
+            // Lets the device-memory allocator read real per-heap budgets instead of guessing
+            memoryBudgetSupported = isDeviceExtensionSupported(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            if (memoryBudgetSupported) {
+                deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            }
 
-                VkBool32 presentSupport = false;
-                vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevices[0], i, surface, &presentSupport);
-                if (presentSupport == VK_TRUE) {
-                    presentFamilyIndex = i;
+            if (Profiler::Instance().isEnabled()) {
+                calibratedTimestampsSupported = isDeviceExtensionSupported(physicalDevice, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+                if (calibratedTimestampsSupported) {
+                    deviceExtensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
                 }
+                // The frame's statistics query stays active across vkCmdExecuteCommands, which needs inheritedQueries
+                VkPhysicalDeviceFeatures supported;
+                instanceDispatch.vkGetPhysicalDeviceFeatures(physicalDevice, &supported);
+                pipelineStatisticsEnabled = supported.pipelineStatisticsQuery && supported.inheritedQueries;
+                deviceFeatures.pipelineStatisticsQuery = pipelineStatisticsEnabled ? VK_TRUE : VK_FALSE;
+                deviceFeatures.inheritedQueries = pipelineStatisticsEnabled ? VK_TRUE : VK_FALSE;
+            }
 
-                if (graphicsFamilyIndex != -1 && presentFamilyIndex != -1) {
-                    break;
-                }
+            // Dynamic rendering and synchronization2 are core in 1.3 but still optional features
+            VkPhysicalDeviceVulkan13Features supported13{};
+            supported13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+            VkPhysicalDeviceVulkan12Features supported12{};
+            supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+            supported12.pNext = &supported13;
+            VkPhysicalDeviceFeatures2 supported{};
+            supported.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            supported.pNext = &supported12;
+            instanceDispatch.vkGetPhysicalDeviceFeatures2(physicalDevice, &supported);
+            bool dynamicRenderingSupported = supported13.dynamicRendering && supported13.synchronization2;
+            useDynamicRendering = config.renderBackend != RenderBackend::RenderPass && dynamicRenderingSupported;
+            if (config.renderBackend == RenderBackend::DynamicRendering && !dynamicRenderingSupported) {
+                std::cout << "Dynamic rendering not supported, falling back to the render pass backend." << std::endl;
             }
-            if (graphicsFamilyIndex == -1 || presentFamilyIndex == -1) {
-                throw std::runtime_error("Failed to find suitable queue families!");
+            std::cout << "Render backend: " << (useDynamicRendering ? "dynamic rendering" : "render pass") << std::endl;
+
+            VkPhysicalDeviceVulkan13Features features13{};
+            features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+            features13.dynamicRendering = useDynamicRendering ? VK_TRUE : VK_FALSE;
+            features13.synchronization2 = useDynamicRendering ? VK_TRUE : VK_FALSE;
+            features13.pNext = presentWaitSupported ? &presentIdFeatures : nullptr; // both bits were left set by the query
+
+            // Timeline semaphores track upload completion
+            VkPhysicalDeviceVulkan12Features features12{};
+            features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+            features12.pNext = &features13;
+            features12.timelineSemaphore = VK_TRUE;
+
+            // Descriptor indexing for the bindless table: unbounded, partially bound arrays written after bind
+            bindlessSupported = supported12.descriptorIndexing && supported12.runtimeDescriptorArray &&
+                supported12.descriptorBindingPartiallyBound && supported12.descriptorBindingSampledImageUpdateAfterBind &&
+                supported12.descriptorBindingStorageBufferUpdateAfterBind && supported12.shaderSampledImageArrayNonUniformIndexing &&
+                supported12.shaderStorageBufferArrayNonUniformIndexing;
+            if (bindlessSupported) {
+                features12.descriptorIndexing = VK_TRUE;
+                features12.runtimeDescriptorArray = VK_TRUE;
+                features12.descriptorBindingPartiallyBound = VK_TRUE;
+                features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+                features12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+                features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+                features12.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
             }
-            float queuePriority = 1.0f;
-            std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-            std::set<int> uniqueQueueFamilies = { graphicsFamilyIndex, presentFamilyIndex };
-
-            for (int queueFamily : uniqueQueueFamilies) {
-                VkDeviceQueueCreateInfo queueCreateInfo{};
-                queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-                queueCreateInfo.queueFamilyIndex = queueFamily;
-                queueCreateInfo.queueCount = 1;
-                queueCreateInfo.pQueuePriorities = &queuePriority;
-                queueCreateInfos.push_back(queueCreateInfo);
+            else {
+                std::cout << "Descriptor indexing not supported, bindless table disabled." << std::endl;
             }
 
-            VkPhysicalDeviceFeatures deviceFeatures{}; // Initialize device features if needed
-            std::vector<const char*> deviceExtensions = {
-                VK_KHR_SWAPCHAIN_EXTENSION_NAME
-            };
+            // GPU culling draws with a GPU-written count and compacted commands whose firstInstance is
+            // the visible slot
+            gpuDrivenSupported = bindlessSupported && supported12.drawIndirectCount && supported.features.multiDrawIndirect &&
+                supported.features.drawIndirectFirstInstance;
+            if (gpuDrivenSupported) {
+                features12.drawIndirectCount = VK_TRUE;
+                deviceFeatures.multiDrawIndirect = VK_TRUE;
+                deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+            }
 
             VkDeviceCreateInfo createInfo{};
             createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+            createInfo.pNext = &features12;
             createInfo.pQueueCreateInfos = queueCreateInfos.data();
             createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
             createInfo.pEnabledFeatures = &deviceFeatures;
             createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
             createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
-            if (vkCreateDevice(physicalDevices[0], &createInfo, &Alloctor, &logicalDevice) != VK_SUCCESS) {
+            Allocator::ScopedAllocationTag allocationTag("vkCreateDevice");
+            if (instanceDispatch.vkCreateDevice(physicalDevice, &createInfo, &Alloctor, &logicalDevice) != VK_SUCCESS) {
                 throw std::runtime_error("Failed to create logical device!");
             }
             else {
                 std::cout << "Created logical device." << std::endl;
-                printPhysicalDeviceProperties(physicalDevices[0], 0);
+                printPhysicalDeviceProperties(physicalDevice, 0);
+            }
+
+            deviceDispatch.load(instanceDispatch, logicalDevice);
+            queues.resolve(deviceDispatch);
+            queues.print();
+            graphicsQueue = queues.graphics.queue;
+            presentQueue = queues.present.queue;
+            graphicsFamilyIndex = queues.graphics.family;
+            presentFamilyIndex = queues.present.family;
+            if (presentWaitSupported) {
+                presentLatency.start(deviceDispatch);
             }
+            std::cout << "Present latency measurement: " << (presentLatency.enabled() ? "on" : "unavailable") << std::endl;
+        }
 
-            vkGetDeviceQueue(logicalDevice, graphicsFamilyIndex, 0, &graphicsQueue);
-            vkGetDeviceQueue(logicalDevice, presentFamilyIndex, 0, &presentQueue);
+        bool isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName) {
+            uint32_t extensionCount = 0;
+            instanceDispatch.vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+            std::vector<VkExtensionProperties> extensions(extensionCount);
+            instanceDispatch.vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+            for (const auto& extension : extensions) {
+                if (strcmp(extension.extensionName, extensionName) == 0) {
+                    return true;
+                }
+            }
+            return false;
         }
 
         SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface) {
             SwapChainSupportDetails details;
-            vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
+            instanceDispatch.vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
 
             uint32_t formatCount;
-            vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, nullptr);
+            instanceDispatch.vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, nullptr);
             if (formatCount != 0) {
                 details.formats.resize(formatCount);
-                vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, details.formats.data());
+                instanceDispatch.vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, details.formats.data());
             }
 
             uint32_t presentModeCount;
-            vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, nullptr);
+            instanceDispatch.vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, nullptr);
             if (presentModeCount != 0) {
                 details.presentModes.resize(presentModeCount);
-                vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, details.presentModes.data());
+                instanceDispatch.vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, details.presentModes.data());
             }
 
             return details;
@@ -200,13 +581,13 @@ namespace vulkan {
 
         void CreateAllocator() {
             Alloctor = {};  // Initialize to zero
-            Alloctor.pUserData = nullptr;
+            Alloctor.pUserData = &Allocator::HostHeap::Instance();
             Alloctor.pfnAllocation = Allocator::CustomAllocation;
             Alloctor.pfnReallocation = Allocator::CustomReallocation;
             Alloctor.pfnFree = Allocator::CustomFree;
-            // Optional callbacks
-            Alloctor.pfnInternalAllocation = nullptr;
-            Alloctor.pfnInternalFree = nullptr;
+            // Driver-internal allocations are only reported, they feed the allocation telemetry
+            Alloctor.pfnInternalAllocation = Allocator::InternalAllocationNotification;
+            Alloctor.pfnInternalFree = Allocator::InternalFreeNotification;
         }
 
         void createInstance() {
@@ -217,19 +598,28 @@ namespace vulkan {
             appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
             appInfo.apiVersion = VK_API_VERSION_1_3;
 
-            const char* extensions[] = {
-                VK_KHR_SURFACE_EXTENSION_NAME,
-                "VK_KHR_win32_surface"  // Add this line for Windows
-            };
+            // GLFW knows which surface extensions this platform needs (win32, xlib, wayland, ...);
+            // headless runs need none at all.
+            std::vector<const char*> extensions;
+            if (!config.headless) {
+                uint32_t glfwExtensionCount = 0;
+                const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+                if (glfwExtensions == nullptr) {
+                    throw std::runtime_error("GLFW found no Vulkan surface support on this platform");
+                }
+                extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+            }
 
             createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
             createInfo.pApplicationInfo = &appInfo;
-            createInfo.enabledExtensionCount = 2; // Number of extensions
-            createInfo.ppEnabledExtensionNames = extensions;
+            createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size()); // Number of extensions
+            createInfo.ppEnabledExtensionNames = extensions.data();
 
-            if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
+            Allocator::ScopedAllocationTag allocationTag("vkCreateInstance");
+            if (vkCreateInstance(&createInfo, &Alloctor, &instance) != VK_SUCCESS) {
                 throw std::runtime_error("Failed to create Vulkan instance");
             }
+            instanceDispatch.load(instance);
         }
 
         void wininit() {
@@ -242,68 +632,933 @@ namespace vulkan {
             if (!window) {
                 throw std::runtime_error("Failed to create GLFW window");
             }
+            glfwSetWindowUserPointer(window, this);
+            glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+            glfwSetKeyCallback(window, keyCallback);
+        }
 
-            // Create the surface
+        void createSurface() {
+            Allocator::ScopedAllocationTag allocationTag("vkCreateSurfaceKHR");
             if (glfwCreateWindowSurface(instance, window, &Alloctor, &surface) != VK_SUCCESS) {
                 throw std::runtime_error("Failed to create window surface");
             }
-            glfwSetWindowUserPointer(window, this);
-            glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+        }
+
+        // Headless stand-in for the swapchain: one offscreen colour target per frame in flight, stored
+        // in the swapchain image list so image views, framebuffers and recording work unchanged.
+        void createOffscreenTargets() {
+            swapChainExtent = { config.headlessWidth, config.headlessHeight };
+            swapChainImages.resize(frameSlotCount());
+            offscreenAllocations.resize(swapChainImages.size());
+            for (size_t i = 0; i < swapChainImages.size(); i++) {
+                VkImageCreateInfo imageInfo{};
+                imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+                imageInfo.imageType = VK_IMAGE_TYPE_2D;
+                imageInfo.format = swapChainImageFormat;
+                imageInfo.extent = { swapChainExtent.width, swapChainExtent.height, 1 };
+                imageInfo.mipLevels = 1;
+                imageInfo.arrayLayers = 1;
+                imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+                imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+                imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+                imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+                imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+                Allocator::ScopedAllocationTag allocationTag("vkCreateImage");
+                if (deviceDispatch.vkCreateImage(logicalDevice, &imageInfo, &Alloctor, &swapChainImages[i]) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create offscreen image!");
+                }
+                deletionQueue.track(swapChainImages[i], "offscreen target");
+                offscreenAllocations[i] = deviceMemory.allocateForImage(swapChainImages[i], MemoryUsage::GpuOnly);
+            }
+            std::cout << "Created " << swapChainImages.size() << " offscreen targets (" << swapChainExtent.width << " x " << swapChainExtent.height << ")." << std::endl;
+        }
+
+        void destroyOffscreenTargets() {
+            uint64_t lastUse = deletionQueue.lastSubmitted();
+            for (auto framebuffer : framebuffers) {
+                deletionQueue.retire(framebuffer, lastUse);
+            }
+            for (auto imageView : swapChainImageViews) {
+                deletionQueue.retire(imageView, lastUse);
+            }
+            for (size_t i = 0; i < swapChainImages.size(); i++) {
+                deletionQueue.retire(swapChainImages[i], offscreenAllocations[i], lastUse);
+            }
+            framebuffers.clear();
+            swapChainImageViews.clear();
+            swapChainImages.clear();
+            offscreenAllocations.clear();
         }
         static void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
+            // A drag-resize fires this many times per frame; just note it and recreate once at the
+            // next frame boundary.
+            auto app = reinterpret_cast<VulkanApp*>(glfwGetWindowUserPointer(window));
+            app->framebufferResized = true;
+        }
+
+        static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+            if (action != GLFW_PRESS) {
+                return;
+            }
             auto app = reinterpret_cast<VulkanApp*>(glfwGetWindowUserPointer(window));
-            app->recreateSwapChain();
+            switch (key) {
+            case GLFW_KEY_F1: app->requestedPresentPolicy = PresentPolicy::LowLatency; break;
+            case GLFW_KEY_F2: app->requestedPresentPolicy = PresentPolicy::MaxThroughput; break;
+            case GLFW_KEY_F3: app->requestedPresentPolicy = PresentPolicy::PowerSaving; break;
+            default: break;
+            }
         }
 
+        // Hands the current swapchain to a new one through oldSwapchain without idling the device.
+        // The old swapchain and everything built on its images go to the deletion queue.
         void recreateSwapChain() {
             int width = 0, height = 0;
             glfwGetFramebufferSize(window, &width, &height);
             if (width == 0 || height == 0) {
-                return; // Do not recreate if the window is minimized
+                return; // Do not recreate if the window is minimized; the flag stays set
             }
+            framebufferResized = false;
+            auto start = std::chrono::steady_clock::now();
 
-            vkDeviceWaitIdle(logicalDevice); // Wait for the device to be idle
-
-            // Cleanup previous swap chain
-            cleanupSwapChain();
-
-            // Recreate swap chain
-            swapChainSupport = querySwapChainSupport(physicalDevices[0], surface);
-            createSwapChain();
+            // Presents of the last frames may still wait on the retired semaphores after the timeline
+            // passes their submissions, so keep the objects for one more round of frames in flight.
+            uint64_t lastUse = deletionQueue.lastSubmitted() + frames.size();
+            for (auto framebuffer : framebuffers) {
+                deletionQueue.retire(framebuffer, lastUse);
+            }
+            for (auto imageView : swapChainImageViews) {
+                deletionQueue.retire(imageView, lastUse);
+            }
+            for (auto semaphore : renderFinishedSemaphores) {
+                deletionQueue.retire(semaphore, lastUse);
+            }
+            swapChainImageViews.clear();
+            framebuffers.clear();
+            renderFinishedSemaphores.clear();
+
+            VkSwapchainKHR oldSwapchain = swapchain;
+            swapChainSupport = querySwapChainSupport(physicalDevice, surface);
+            VkFormat previousFormat = swapChainImageFormat;
+            createSwapChain(oldSwapchain);
+            // Nothing presents to the old swapchain any more; stop measuring it before it is destroyed
+            presentLatency.forget(oldSwapchain);
+            deletionQueue.retire(oldSwapchain, lastUse);
+            if (!useDynamicRendering && swapChainImageFormat != previousFormat) {
+                // The render pass bakes in the attachment format; frames in flight may still use the old one
+                deletionQueue.retire(renderPasss, lastUse);
+                createRenderPass(logicalDevice);
+            }
+            if (useDynamicRendering && swapChainImageFormat != previousFormat) {
+                // Same for the culling draw pipeline and the graph's backbuffer description
+                gpuCulling.setColorFormat(swapChainImageFormat);
+                renderGraph.reset();
+                buildRenderGraph();
+            }
 
-            // Create image views and framebuffers for the new swap chain
+            // Dynamic rendering only needs the new image views; the legacy path also rebuilds framebuffers
             createSwapChainImageViews(logicalDevice, swapChainImages);
-            createFramebuffers();
+            if (!useDynamicRendering) {
+                createFramebuffers();
+            }
+            createRenderFinishedSemaphores();
+            phaseTimings.push_back({ "recreateSwapChain", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() });
         }
+
         void mainLoop() {
-            while (!glfwWindowShouldClose(window)) {
-                glfwPollEvents();  // Handle events
-               
+            using clock = std::chrono::steady_clock;
+            auto nextFrameTime = clock::now();
+            auto loopStart = clock::now();
+            while (!glfwWindowShouldClose(window) && (config.maxFrames == 0 || loopFrameCount < config.maxFrames)) {
+                int width = 0, height = 0;
+                glfwGetFramebufferSize(window, &width, &height);
+                if (width == 0 || height == 0) {
+                    glfwWaitEvents();  // Minimized: sleep until something happens instead of spinning
+                    continue;
+                }
+
+                if (config.targetFps > 0.0) {
+                    // Frame-rate limiter: block in the event queue until the next frame is due
+                    auto now = clock::now();
+                    if (now < nextFrameTime) {
+                        glfwWaitEventsTimeout(std::chrono::duration<double>(nextFrameTime - now).count());
+                    }
+                    else {
+                        glfwPollEvents();
+                    }
+                    nextFrameTime = std::max(nextFrameTime, now) + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / config.targetFps));
+                }
+                else {
+                    glfwPollEvents();  // Handle events; the present mode paces the loop
+                }
+
+                if (config.recreateEveryNFrames > 0 && loopFrameCount > 0 && loopFrameCount % config.recreateEveryNFrames == 0) {
+                    framebufferResized = true;
+                }
+                drawFrame();
+                pipelineCache.tick();
+                loopFrameCount++;
+            }
+            loopSeconds = std::chrono::duration<double>(clock::now() - loopStart).count();
+        }
+
+        // The bindless table is sized from the update-after-bind limits; the whole set is visible to
+        // every stage, so the per-stage limits are the binding ones.
+        void createDescriptors() {
+            frameDescriptors.init(deviceDispatch, &Alloctor, frameSlotCount());
+            if (!bindlessSupported) {
+                return;
+            }
+            VkPhysicalDeviceVulkan12Properties properties12{};
+            properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+            VkPhysicalDeviceProperties2 properties{};
+            properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+            properties.pNext = &properties12;
+            instanceDispatch.vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+            uint32_t textures = std::min({ config.bindlessTextureCount, properties12.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                properties12.maxDescriptorSetUpdateAfterBindSampledImages });
+            uint32_t buffers = std::min({ config.bindlessBufferCount, properties12.maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+                properties12.maxDescriptorSetUpdateAfterBindStorageBuffers });
+            bindless.init(deviceDispatch, &Alloctor, deletionQueue, textures, buffers);
+
+            // Shared by every pipeline: set 0 is the bindless table, per-draw data goes in push constants
+            VkDescriptorSetLayout setLayout = bindless.layout();
+            VkPushConstantRange pushConstants{};
+            pushConstants.stageFlags = VK_SHADER_STAGE_ALL;
+            pushConstants.offset = 0;
+            pushConstants.size = 128; // The minimum every device guarantees
+            VkPipelineLayoutCreateInfo layoutInfo{};
+            layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            layoutInfo.setLayoutCount = 1;
+            layoutInfo.pSetLayouts = &setLayout;
+            layoutInfo.pushConstantRangeCount = 1;
+            layoutInfo.pPushConstantRanges = &pushConstants;
+            Allocator::ScopedAllocationTag allocationTag("vkCreatePipelineLayout");
+            if (deviceDispatch.vkCreatePipelineLayout(logicalDevice, &layoutInfo, &Alloctor, &bindlessLayout) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create bindless pipeline layout!");
+            }
+            deletionQueue.track(bindlessLayout, "bindless pipeline layout");
+        }
+
+        // Stand-in scene for GPU culling: unit-radius objects on a square grid in the xz plane, seen
+        // by a camera orbiting inside it, so part of the grid is always behind or beside the view.
+        void createGpuCulling() {
+            if (config.gpuCullingObjectCount == 0) {
+                return;
+            }
+            if (!gpuDrivenSupported) {
+                std::cout << "GPU culling needs descriptor indexing, drawIndirectCount and multiDrawIndirect; disabled." << std::endl;
+                return;
+            }
+            if (!gpuCulling.init(deviceMemory, deviceDispatch, &Alloctor, deletionQueue, bindless, shaders, *jobSystem, bindlessLayout,
+                pipelineCache, swapChainImageFormat, config.gpuCullingObjectCount, frameSlotCount())) {
+                return;
+            }
+            uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(config.gpuCullingObjectCount))));
+            for (uint32_t i = 0; i < config.gpuCullingObjectCount; i++) {
+                float center[3] = { (static_cast<float>(i % side) - side * 0.5f) * CullingGridSpacing, 0.0f,
+                    (static_cast<float>(i / side) - side * 0.5f) * CullingGridSpacing };
+                gpuCulling.setObject(i, center, 1.0f, gpuCulling.cubeMesh());
+            }
+            gpuCulling.setObjectCount(config.gpuCullingObjectCount);
+            cullingGridExtent = side * CullingGridSpacing;
+        }
+
+        // Advances by frame rather than wall time, so headless runs always see the same views.
+        void updateCullingCamera() {
+            float angle = static_cast<float>(deletionQueue.lastSubmitted() % 3600) * 0.00174533f; // 0.1 degree per frame
+            float orbit = cullingGridExtent * 0.3f;
+            float eye[3] = { orbit * std::cos(angle), cullingGridExtent * 0.1f + 2.0f, orbit * std::sin(angle) };
+            float target[3] = { eye[0] - std::sin(angle) * orbit, 0.0f, eye[2] + std::cos(angle) * orbit };
+            float aspect = static_cast<float>(swapChainExtent.width) / static_cast<float>(std::max(swapChainExtent.height, 1u));
+            float viewProjection[16];
+            makeViewProjection(eye, target, 1.0472f, aspect, 0.1f, cullingGridExtent * 1.5f + 10.0f, viewProjection);
+            gpuCulling.setViewProjection(viewProjection);
+        }
+
+        // Stand-in CPU scene: a grid of clusters, each a spinning root carrying a static ring of children
+        // with a static grandchild each, so most of the hierarchy moves only through its ancestors.
+        void createScene() {
+            if (config.sceneObjectCount == 0) {
+                return;
+            }
+            scene.setSimdLevel(config.sceneSimdLevel);
+            scene.reserve(config.sceneObjectCount);
+            const uint32_t ringSize = 15;
+            const uint32_t clusterSize = 1 + ringSize * 2;
+            uint32_t clusterCount = std::max(1u, config.sceneObjectCount / clusterSize);
+            uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(clusterCount))));
+            const float spacing = 12.0f;
+            const float identity[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+            const float zero[3] = { 0.0f, 0.0f, 0.0f };
+            const float unit[3] = { 0.5f, 0.5f, 0.5f };
+            const float yAxis[3] = { 0.0f, 1.0f, 0.0f };
+            for (uint32_t cluster = 0; cluster < clusterCount; cluster++) {
+                float center[3] = { (static_cast<float>(cluster % side) - side * 0.5f) * spacing, 0.0f,
+                    (static_cast<float>(cluster / side) - side * 0.5f) * spacing };
+                Scene::NodeId root = scene.createNode(Scene::InvalidNode, center, identity, 1.0f, zero, unit);
+                if (cluster % 4 == 0) {
+                    sceneSpinners.push_back(root); // The rest of the grid stays static
+                }
+                for (uint32_t i = 0; i < ringSize; i++) {
+                    float angle = 6.2831853f * static_cast<float>(i) / ringSize;
+                    float offset[3] = { 4.0f * std::cos(angle), 0.0f, 4.0f * std::sin(angle) };
+                    float rotation[4];
+                    quaternionFromAxisAngle(yAxis, -angle, rotation);
+                    Scene::NodeId child = scene.createNode(root, offset, rotation, 0.5f, zero, unit);
+                    float above[3] = { 0.0f, 1.5f, 0.0f };
+                    scene.createNode(child, above, identity, 0.5f, zero, unit);
+                }
+            }
+            sceneExtent = side * spacing;
+            std::cout << "Scene: " << scene.nodeCount() << " nodes, " << simdLevelName(scene.simdLevel()) << " kernels." << std::endl;
+        }
+
+        // Advances by frame rather than wall time, like the culling camera.
+        void updateScene() {
+            if (scene.nodeCount() == 0) {
+                return;
+            }
+            CpuZone zone("UpdateScene");
+            auto start = std::chrono::steady_clock::now();
+            uint64_t frame = deletionQueue.lastSubmitted();
+            const float yAxis[3] = { 0.0f, 1.0f, 0.0f };
+            float rotation[4];
+            quaternionFromAxisAngle(yAxis, static_cast<float>(frame % 3600) * 0.01745329f, rotation);
+            for (Scene::NodeId node : sceneSpinners) {
+                scene.setRotation(node, rotation);
+            }
+            scene.update(*jobSystem);
+
+            float angle = static_cast<float>(frame % 3600) * 0.00174533f;
+            float orbit = sceneExtent * 0.3f;
+            float eye[3] = { orbit * std::cos(angle), sceneExtent * 0.1f + 2.0f, orbit * std::sin(angle) };
+            float target[3] = { eye[0] - std::sin(angle) * orbit, 0.0f, eye[2] + std::cos(angle) * orbit };
+            float aspect = static_cast<float>(swapChainExtent.width) / static_cast<float>(std::max(swapChainExtent.height, 1u));
+            float viewProjection[16];
+            float planes[6][4];
+            makeViewProjection(eye, target, 1.0472f, aspect, 0.1f, sceneExtent * 1.5f + 10.0f, viewProjection);
+            extractFrustumPlanes(viewProjection, planes);
+            scene.cull(planes, *jobSystem);
+            frameStats.sceneAccumulatedMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
 
-              
+        // Runs once the current slot's fence has been waited on.
+        void beginFrameDescriptors() {
+            if (bindlessSupported) {
+                bindless.collect();
             }
+            frameDescriptors.beginFrame(currentFrame);
+        }
+
+        void createFrameResources() {
+            frames.resize(frameSlotCount());
+            if (config.headless) {
+                activeFrameCount = static_cast<uint32_t>(frames.size());
+            }
+            for (FrameContext& frame : frames) {
+                VkCommandPoolCreateInfo poolInfo{};
+                poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+                poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // Reset as a whole every frame
+                poolInfo.queueFamilyIndex = graphicsFamilyIndex;
+                Allocator::ScopedAllocationTag allocationTag("vkCreateCommandPool");
+                if (deviceDispatch.vkCreateCommandPool(logicalDevice, &poolInfo, &Alloctor, &frame.commandPool) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create frame command pool!");
+                }
+                deletionQueue.track(frame.commandPool, "frame command pool");
+
+                VkCommandBufferAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocInfo.commandPool = frame.commandPool;
+                allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                allocInfo.commandBufferCount = 1;
+                if (deviceDispatch.vkAllocateCommandBuffers(logicalDevice, &allocInfo, &frame.commandBuffer) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to allocate frame command buffer!");
+                }
+
+                VkFenceCreateInfo fenceInfo{};
+                fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+                fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; // The first wait on each frame must not block
+                if (deviceDispatch.vkCreateFence(logicalDevice, &fenceInfo, &Alloctor, &frame.inFlightFence) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create frame fence!");
+                }
+                deletionQueue.track(frame.inFlightFence, "frame fence");
+                frame.imageAvailableSemaphore = createSemaphore();
+
+                frame.threadPools.resize(jobSystem->threadCount());
+                for (ThreadCommandPool& threadPool : frame.threadPools) {
+                    Allocator::ScopedAllocationTag allocationTag("vkCreateCommandPool");
+                    if (deviceDispatch.vkCreateCommandPool(logicalDevice, &poolInfo, &Alloctor, &threadPool.pool) != VK_SUCCESS) {
+                        throw std::runtime_error("Failed to create thread command pool!");
+                    }
+                    deletionQueue.track(threadPool.pool, "thread command pool");
+                }
+
+                if (config.headless) {
+                    // One readback buffer per frame in flight: the copy of frame N lands in its own
+                    // buffer while the CPU reads frame N - framesInFlight from another.
+                    VkDeviceSize readbackSize = VkDeviceSize(swapChainExtent.width) * swapChainExtent.height * 4;
+                    frame.readbackBuffer = deviceMemory.createBuffer(readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryUsage::Readback, frame.readbackAllocation);
+                    deletionQueue.track(frame.readbackBuffer, "readback buffer");
+                }
+            }
+            if (!config.headless) {
+                createRenderFinishedSemaphores();
+            }
+            std::cout << "Created " << frames.size() << " frame slots, " << activeFrameCount << " in flight." << std::endl;
+        }
+
+        // A present may still be reading its wait semaphore after the frame's fence has signalled, so
+        // render-finished semaphores are tied to the swapchain image rather than the frame: the image
+        // cannot be re-acquired until its previous present is done.
+        void createRenderFinishedSemaphores() {
+            renderFinishedSemaphores.resize(swapChainImages.size());
+            for (VkSemaphore& semaphore : renderFinishedSemaphores) {
+                semaphore = createSemaphore();
+            }
+        }
+
+        VkSemaphore createSemaphore() {
+            VkSemaphoreCreateInfo semaphoreInfo{};
+            semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            VkSemaphore semaphore;
+            Allocator::ScopedAllocationTag allocationTag("vkCreateSemaphore");
+            if (deviceDispatch.vkCreateSemaphore(logicalDevice, &semaphoreInfo, &Alloctor, &semaphore) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create semaphore!");
+            }
+            deletionQueue.track(semaphore, "binary semaphore");
+            return semaphore;
+        }
+
+        void destroyFrameResources() {
+            for (FrameContext& frame : frames) {
+                deletionQueue.retire(frame.commandPool, frame.submitSerial);
+                for (ThreadCommandPool& threadPool : frame.threadPools) {
+                    deletionQueue.retire(threadPool.pool, frame.submitSerial);
+                }
+                deletionQueue.retire(frame.inFlightFence, frame.submitSerial);
+                deletionQueue.retire(frame.imageAvailableSemaphore, frame.submitSerial);
+                if (frame.readbackBuffer != VK_NULL_HANDLE) {
+                    deletionQueue.retire(frame.readbackBuffer, frame.readbackAllocation, frame.submitSerial);
+                }
+            }
+            frames.clear();
+            for (VkSemaphore semaphore : renderFinishedSemaphores) {
+                deletionQueue.retire(semaphore);
+            }
+            renderFinishedSemaphores.clear();
+        }
+
+        void drawFrame() {
+            CpuZone frameZone("drawFrame");
+            using clock = std::chrono::steady_clock;
+            if (requestedPresentPolicy != presentPolicy) {
+                applyPresentPolicy();
+            }
+            FrameContext& frame = frames[currentFrame];
+
+            // Only wait for the frame that used this slot framesInFlight frames ago
+            auto waitStart = clock::now();
+            {
+                CpuZone waitZone("WaitForFrameFence");
+                deviceDispatch.vkWaitForFences(logicalDevice, 1, &frame.inFlightFence, VK_TRUE, UINT64_MAX);
+            }
+            auto cpuStart = clock::now();
+            Allocator::BeginFrame();
+            assets.pump();
+            uploads.pump();
+
+            deletionQueue.collect();
+            beginFrameDescriptors();
+            if (shaders.poll()) {
+                gpuCulling.reloadPipelines();
+            }
+            updateScene();
+            if (framebufferResized) {
+                recreateSwapChain();
+                if (framebufferResized) {
+                    return; // Still minimized
+                }
+            }
+
+            uint32_t imageIndex;
+            VkResult result = deviceDispatch.vkAcquireNextImageKHR(logicalDevice, swapchain, UINT64_MAX, frame.imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+            if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+                // Nothing was acquired and the fence is still signalled; retry on the next iteration
+                framebufferResized = true;
+                return;
+            }
+            if (result == VK_SUBOPTIMAL_KHR) {
+                framebufferResized = true; // The image is still usable, so render this frame first
+            }
+            else if (result != VK_SUCCESS) {
+                throw std::runtime_error("Failed to acquire swap chain image!");
+            }
+
+            deviceDispatch.vkResetFences(logicalDevice, 1, &frame.inFlightFence);
+            resetFrameCommandPools(frame);
+            recordCommandBuffer(frame.commandBuffer, imageIndex);
+
+            submitFrame(frame, frame.imageAvailableSemaphore, renderFinishedSemaphores[imageIndex]);
+
+            VkPresentInfoKHR presentInfo{};
+            presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+            presentInfo.waitSemaphoreCount = 1;
+            presentInfo.pWaitSemaphores = &renderFinishedSemaphores[imageIndex];
+            presentInfo.swapchainCount = 1;
+            presentInfo.pSwapchains = &swapchain;
+            presentInfo.pImageIndices = &imageIndex;
+            uint64_t presentId = 0;
+            VkPresentIdKHR presentIdInfo{};
+            if (presentLatency.enabled()) {
+                presentId = presentLatency.nextPresentId();
+                presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+                presentIdInfo.swapchainCount = 1;
+                presentIdInfo.pPresentIds = &presentId;
+                presentInfo.pNext = &presentIdInfo;
+            }
+            result = queues.presentImage(&presentInfo);
+            if (presentId != 0 && (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR)) {
+                presentLatency.presented(swapchain, presentId, cpuStart);
+            }
+            if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+                framebufferResized = true;
+            }
+            else if (result != VK_SUCCESS) {
+                throw std::runtime_error("Failed to present swap chain image!");
+            }
+
+            currentFrame = (currentFrame + 1) % activeFrameCount;
+            auto cpuEnd = clock::now();
+            recordFrameTimings(std::chrono::duration<double, std::milli>(cpuStart - waitStart).count(),
+                std::chrono::duration<double, std::milli>(cpuEnd - cpuStart).count());
+        }
+
+        // Frame slots are independent (each has its own fence), so the active count can change
+        // between frames without draining the GPU; only the swapchain has to be rebuilt.
+        void applyPresentPolicy() {
+            presentPolicy = requestedPresentPolicy;
+            framebufferResized = true;
+            presentLatency.clear();
+            std::cout << "Present policy: " << presentPolicyName(presentPolicy) << std::endl;
+        }
+
+        // Headless counterpart of mainLoop(): renders a fixed number of frames as fast as the device
+        // allows and reports throughput.
+        void headlessLoop() {
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t i = 0; i < config.headlessFrameCount; i++) {
+                drawHeadlessFrame();
+                pipelineCache.tick();
+                loopFrameCount++;
+            }
+            deviceDispatch.vkDeviceWaitIdle(logicalDevice);
+            // Drain the readbacks still in flight, oldest first
+            for (size_t i = 0; i < frames.size(); i++) {
+                uint32_t slot = static_cast<uint32_t>((currentFrame + i) % frames.size());
+                deliverReadback(frames[slot]);
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            loopSeconds = seconds;
+            std::cout << "Headless: rendered " << config.headlessFrameCount << " frames in " << seconds << " s ("
+                << (seconds > 0.0 ? config.headlessFrameCount / seconds : 0.0) << " FPS)." << std::endl;
+        }
+
+        // Submits the frame's command buffer, waiting on the acquired image (if any) and on the uploads
+        // whose acquire barriers it recorded.
+        void submitFrame(FrameContext& frame, VkSemaphore imageAvailable, VkSemaphore renderFinished) {
+            std::vector<VkSemaphore> waitSemaphores;
+            std::vector<VkPipelineStageFlags> waitStages;
+            std::vector<uint64_t> waitValues;
+            if (imageAvailable != VK_NULL_HANDLE) {
+                waitSemaphores.push_back(imageAvailable);
+                waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+                waitValues.push_back(0); // Ignored for binary semaphores
+            }
+            if (uploadWaitValue > 0) {
+                waitSemaphores.push_back(uploads.timeline());
+                waitStages.push_back(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+                waitValues.push_back(uploadWaitValue);
+            }
+            if (renderGraph.asyncWaitValue() > 0) {
+                waitSemaphores.push_back(renderGraph.asyncTimelineSemaphore());
+                waitStages.push_back(renderGraph.asyncWaitStages());
+                waitValues.push_back(renderGraph.asyncWaitValue());
+            }
+            // Every frame signals the frame timeline the deletion queue retires against
+            uint64_t timelineValue = deletionQueue.beginSubmit();
+            std::vector<VkSemaphore> signalSemaphores = { deletionQueue.timeline() };
+            std::vector<uint64_t> signalValues = { timelineValue };
+            if (renderFinished != VK_NULL_HANDLE) {
+                signalSemaphores.push_back(renderFinished);
+                signalValues.push_back(0); // Ignored for binary semaphores
+            }
+
+            VkTimelineSemaphoreSubmitInfo timelineInfo{};
+            timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+            timelineInfo.pWaitSemaphoreValues = waitValues.data();
+            timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+            timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+            VkSubmitInfo submitInfo{};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.pNext = &timelineInfo;
+            submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+            submitInfo.pWaitSemaphores = waitSemaphores.data();
+            submitInfo.pWaitDstStageMask = waitStages.data();
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &frame.commandBuffer;
+            submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+            submitInfo.pSignalSemaphores = signalSemaphores.data();
+            if (queues.submit(QueueRole::Graphics, 1, &submitInfo, frame.inFlightFence) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to submit draw command buffer!");
+            }
+            frame.submitSerial = timelineValue;
+        }
+
+        void drawHeadlessFrame() {
+            CpuZone frameZone("drawHeadlessFrame");
+            using clock = std::chrono::steady_clock;
+            FrameContext& frame = frames[currentFrame];
+
+            auto waitStart = clock::now();
+            {
+                CpuZone waitZone("WaitForFrameFence");
+                deviceDispatch.vkWaitForFences(logicalDevice, 1, &frame.inFlightFence, VK_TRUE, UINT64_MAX);
+            }
+            auto cpuStart = clock::now();
+            Allocator::BeginFrame();
+            assets.pump();
+            uploads.pump();
+            deletionQueue.collect();
+            beginFrameDescriptors();
+            if (shaders.poll()) {
+                gpuCulling.reloadPipelines();
+            }
+            updateScene();
+            // The slot's previous frame is complete, so its pixels can be handed out without a stall
+            deliverReadback(frame);
+
+            deviceDispatch.vkResetFences(logicalDevice, 1, &frame.inFlightFence);
+            resetFrameCommandPools(frame);
+            recordCommandBuffer(frame.commandBuffer, currentFrame);
+
+            submitFrame(frame, VK_NULL_HANDLE, VK_NULL_HANDLE);
+            frame.frameNumber = frame.submitSerial;
+            frame.readbackPending = true;
+
+            currentFrame = (currentFrame + 1) % static_cast<uint32_t>(frames.size());
+            auto cpuEnd = clock::now();
+            recordFrameTimings(std::chrono::duration<double, std::milli>(cpuStart - waitStart).count(),
+                std::chrono::duration<double, std::milli>(cpuEnd - cpuStart).count());
+        }
+
+        void deliverReadback(FrameContext& frame) {
+            if (!frame.readbackPending) {
+                return;
+            }
+            frame.readbackPending = false;
+            if (config.readbackCallback) {
+                deviceMemory.invalidate(frame.readbackAllocation);
+                config.readbackCallback(frame.readbackAllocation->mapped, swapChainExtent.width, swapChainExtent.height, frame.frameNumber);
+            }
+        }
+
+        void recordReadbackCopy(VkCommandBuffer commandBuffer, VkImage image, VkBuffer buffer) {
+            // The render pass left the image in TRANSFER_SRC_OPTIMAL; make its colour writes visible to the copy
+            VkImageMemoryBarrier imageBarrier{};
+            imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            imageBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            imageBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            imageBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.image = image;
+            imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+            deviceDispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                0, nullptr, 0, nullptr, 1, &imageBarrier);
+            copyToReadbackBuffer(commandBuffer, image, buffer);
+        }
+
+        // Expects the image in TRANSFER_SRC_OPTIMAL with its writes already visible to transfers.
+        void copyToReadbackBuffer(VkCommandBuffer commandBuffer, VkImage image, VkBuffer buffer) {
+            VkBufferImageCopy region{};
+            region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+            region.imageExtent = { swapChainExtent.width, swapChainExtent.height, 1 };
+            deviceDispatch.vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &region);
+
+            // Host reads after the fence wait need the transfer writes made visible to the host
+            VkBufferMemoryBarrier bufferBarrier{};
+            bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            bufferBarrier.buffer = buffer;
+            bufferBarrier.offset = 0;
+            bufferBarrier.size = VK_WHOLE_SIZE;
+            deviceDispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                0, nullptr, 1, &bufferBarrier, 0, nullptr);
+        }
+
+        void resetFrameCommandPools(FrameContext& frame) {
+            deviceDispatch.vkResetCommandPool(logicalDevice, frame.commandPool, 0);
+            for (ThreadCommandPool& threadPool : frame.threadPools) {
+                if (threadPool.used > 0) {
+                    deviceDispatch.vkResetCommandPool(logicalDevice, threadPool.pool, 0);
+                    threadPool.used = 0;
+                }
+            }
+        }
+
+        // Splits scene recording into chunks recorded as secondaries on the job system, then stitches
+        // them into the primary in chunk order.
+        void recordSceneParallel(VkCommandBuffer primary, VkFramebuffer framebuffer) {
+            uint32_t chunkCount = config.recordingChunks > 0 ? config.recordingChunks : jobSystem->threadCount();
+            std::vector<VkCommandBuffer> secondaries(chunkCount);
+            FrameContext& frame = frames[currentFrame];
+            Jobs::Counter recorded;
+            for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+                jobSystem->schedule([this, &frame, &secondaries, framebuffer, chunk, chunkCount]() {
+                    secondaries[chunk] = recordSceneChunk(frame, framebuffer, chunk, chunkCount);
+                }, &recorded);
+            }
+            jobSystem->wait(recorded);
+            deviceDispatch.vkCmdExecuteCommands(primary, chunkCount, secondaries.data());
+        }
+
+        VkCommandBuffer recordSceneChunk(FrameContext& frame, VkFramebuffer framebuffer, uint32_t chunk, uint32_t chunkCount) {
+            CpuZone zone("RecordSceneChunk");
+            ThreadCommandPool& threadPool = frame.threadPools[Jobs::JobSystem::threadIndex()];
+            if (threadPool.used == threadPool.secondaries.size()) {
+                VkCommandBufferAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocInfo.commandPool = threadPool.pool;
+                allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+                allocInfo.commandBufferCount = 1;
+                VkCommandBuffer commandBuffer;
+                if (deviceDispatch.vkAllocateCommandBuffers(logicalDevice, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to allocate secondary command buffer!");
+                }
+                threadPool.secondaries.push_back(commandBuffer);
+            }
+            VkCommandBuffer commandBuffer = threadPool.secondaries[threadPool.used++];
+
+            // Dynamic rendering secondaries describe the attachments instead of naming a render pass
+            VkCommandBufferInheritanceRenderingInfo renderingInheritance{};
+            renderingInheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+            renderingInheritance.colorAttachmentCount = 1;
+            renderingInheritance.pColorAttachmentFormats = &swapChainImageFormat;
+            renderingInheritance.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+            VkCommandBufferInheritanceInfo inheritanceInfo{};
+            inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+            inheritanceInfo.pNext = useDynamicRendering ? &renderingInheritance : nullptr;
+            inheritanceInfo.renderPass = useDynamicRendering ? VK_NULL_HANDLE : renderPasss;
+            inheritanceInfo.subpass = 0;
+            inheritanceInfo.framebuffer = framebuffer;
+            inheritanceInfo.pipelineStatistics = Profiler::Instance().inheritedStatistics();
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+            beginInfo.pInheritanceInfo = &inheritanceInfo;
+            if (deviceDispatch.vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to begin recording secondary command buffer!");
+            }
+            recordScene(commandBuffer, chunk, chunkCount);
+            if (deviceDispatch.vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to record secondary command buffer!");
+            }
+            return commandBuffer;
+        }
+
+        // Records this chunk's share of the scene's draws. There is no geometry yet, so the only
+        // draws are the GPU-culled stand-in objects (one indirect draw, in the first chunk) and the
+        // benchmark's synthetic ones: small attachment clears on a grid.
+        void recordScene(VkCommandBuffer commandBuffer, uint32_t chunk, uint32_t chunkCount) {
+            if (chunk == 0 && gpuCulling.enabled()) {
+                gpuCulling.recordDraws(commandBuffer, currentFrame, swapChainExtent);
+            }
+            uint32_t begin = static_cast<uint32_t>(uint64_t(config.syntheticDrawCount) * chunk / chunkCount);
+            uint32_t end = static_cast<uint32_t>(uint64_t(config.syntheticDrawCount) * (chunk + 1) / chunkCount);
+            if (begin == end) {
+                return;
+            }
+            const uint32_t columns = std::max(1u, swapChainExtent.width / 8);
+            const uint32_t rows = std::max(1u, swapChainExtent.height / 8);
+            VkClearAttachment attachment{};
+            attachment.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            attachment.colorAttachment = 0;
+            for (uint32_t draw = begin; draw < end; draw++) {
+                float shade = static_cast<float>(draw % 256) / 255.0f;
+                attachment.clearValue.color = { { shade, 0.25f, 1.0f - shade, 1.0f } };
+                VkClearRect rect{};
+                rect.rect.offset = { static_cast<int32_t>(draw % columns * 8), static_cast<int32_t>(draw / columns % rows * 8) };
+                rect.rect.extent = { std::min(8u, swapChainExtent.width), std::min(8u, swapChainExtent.height) };
+                rect.layerCount = 1;
+                deviceDispatch.vkCmdClearAttachments(commandBuffer, 1, &attachment, 1, &rect);
+            }
+        }
+
+        void recordRenderPass(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+            VkClearValue clearColor{};
+            clearColor.color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+            VkRenderPassBeginInfo renderPassInfo{};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = renderPasss;
+            renderPassInfo.framebuffer = framebuffers[imageIndex];
+            renderPassInfo.renderArea.offset = { 0, 0 };
+            renderPassInfo.renderArea.extent = swapChainExtent;
+            renderPassInfo.clearValueCount = 1;
+            renderPassInfo.pClearValues = &clearColor;
+            deviceDispatch.vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            recordSceneParallel(commandBuffer, framebuffers[imageIndex]);
+            deviceDispatch.vkCmdEndRenderPass(commandBuffer);
+        }
+
+        // Dynamic rendering frames go through the render graph, which derives the backbuffer's layout
+        // transitions and the readback barrier from what the passes declare.
+        void buildRenderGraph() {
+            RenderImageDesc backbufferDesc;
+            backbufferDesc.format = swapChainImageFormat;
+            backbufferDesc.extent = swapChainExtent;
+            ImportedState initial;
+            initial.stages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT; // Where the acquire semaphore is waited on
+            ImportedState final;
+            final.layout = config.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            backbuffer = renderGraph.importImage("Backbuffer", backbufferDesc, initial, final);
+
+            if (gpuCulling.enabled()) {
+                cullOutputs = gpuCulling.addPasses(renderGraph);
+            }
+            renderGraph.addPass("MainPass", PassKind::Graphics, [this](RenderPassBuilder& pass) {
+                pass.colorAttachment(backbuffer, VK_ATTACHMENT_LOAD_OP_CLEAR, { { 0.0f, 0.0f, 0.0f, 1.0f } }).secondaryCommandBuffers();
+                if (gpuCulling.enabled()) {
+                    pass.read(cullOutputs.commands, ResourceUsage::IndirectRead)
+                        .read(cullOutputs.count, ResourceUsage::IndirectRead)
+                        .read(cullOutputs.instances, ResourceUsage::StorageRead);
+                }
+            }, [this](RenderPassContext& context) {
+                recordSceneParallel(context.commandBuffer, VK_NULL_HANDLE);
+            });
+            if (config.headless) {
+                renderGraph.addPass("Readback", PassKind::Transfer, [this](RenderPassBuilder& pass) {
+                    pass.read(backbuffer, ResourceUsage::TransferSrc).sideEffect();
+                }, [this](RenderPassContext& context) {
+                    copyToReadbackBuffer(context.commandBuffer, context.image(backbuffer), frames[currentFrame].readbackBuffer);
+                });
+            }
+            renderGraph.compile();
+        }
+
+        void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+            CpuZone zone("RecordCommandBuffer");
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            if (deviceDispatch.vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to begin recording command buffer!");
+            }
+            uploadWaitValue = uploads.recordAcquireBarriers(commandBuffer);
+            if (config.defragmentBudgetPerFrame > 0) {
+                // This submission signals the next frame timeline value
+                assets.defragment(commandBuffer, deletionQueue.lastSubmitted() + 1, config.defragmentBudgetPerFrame);
+            }
+            Profiler& profiler = Profiler::Instance();
+            profiler.beginFrame(commandBuffer, currentFrame);
+            profiler.beginGpuZone(commandBuffer, "Frame");
+            profiler.beginPipelineStatistics(commandBuffer);
+
+            if (useDynamicRendering) {
+                // The graph opens a GPU zone per pass
+                if (gpuCulling.enabled()) {
+                    updateCullingCamera();
+                }
+                renderGraph.setImportedImage(backbuffer, swapChainImages[imageIndex], swapChainImageViews[imageIndex], swapChainExtent);
+                renderGraph.execute(commandBuffer, currentFrame);
+                profiler.endPipelineStatistics(commandBuffer);
+            }
+            else {
+                profiler.beginGpuZone(commandBuffer, "MainPass");
+                recordRenderPass(commandBuffer, imageIndex);
+                profiler.endGpuZone(commandBuffer);
+                profiler.endPipelineStatistics(commandBuffer);
+
+                if (config.headless) {
+                    profiler.beginGpuZone(commandBuffer, "Readback");
+                    recordReadbackCopy(commandBuffer, swapChainImages[imageIndex], frames[currentFrame].readbackBuffer);
+                    profiler.endGpuZone(commandBuffer);
+                }
+            }
+            profiler.endGpuZone(commandBuffer);
+
+            if (deviceDispatch.vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to record command buffer!");
+            }
+        }
+
+        void recordFrameTimings(double gpuWaitMs, double cpuMs) {
+            frameStats.frameCount++;
+            frameStats.gpuWaitAccumulatedMs += gpuWaitMs;
+            frameStats.cpuAccumulatedMs += cpuMs;
+            auto now = std::chrono::steady_clock::now();
+            double elapsed = std::chrono::duration<double>(now - frameStats.windowStart).count();
+            if (elapsed < 1.0) {
+                return;
+            }
+            frameStats.fps = frameStats.frameCount / elapsed;
+            frameStats.cpuFrameMs = frameStats.cpuAccumulatedMs / frameStats.frameCount;
+            frameStats.gpuWaitMs = frameStats.gpuWaitAccumulatedMs / frameStats.frameCount;
+            frameStats.sceneMs = frameStats.sceneAccumulatedMs / frameStats.frameCount;
+            std::cout << "FPS: " << frameStats.fps << ", CPU frame: " << frameStats.cpuFrameMs
+                << " ms, GPU wait: " << frameStats.gpuWaitMs << " ms";
+            double latencyMs = 0.0, latencyP99Ms = 0.0;
+            if (presentLatency.latency(latencyMs, latencyP99Ms)) {
+                std::cout << ", present latency: " << latencyMs << " ms (p99 " << latencyP99Ms << " ms)";
+            }
+            if (scene.nodeCount() > 0) {
+                std::cout << ", scene: " << frameStats.sceneMs << " ms (" << scene.visibleNodes().size() << " visible)";
+            }
+            std::cout << std::endl;
+            frameStats.frameCount = 0;
+            frameStats.cpuAccumulatedMs = 0.0;
+            frameStats.gpuWaitAccumulatedMs = 0.0;
+            frameStats.sceneAccumulatedMs = 0.0;
+            frameStats.windowStart = now;
         }
 
         void enumeratePhysicalDevices() {
             uint32_t deviceCount = 0;
-            if (vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr) != VK_SUCCESS || deviceCount == 0) {
+            if (instanceDispatch.vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr) != VK_SUCCESS || deviceCount == 0) {
                 throw std::runtime_error("Failed to find GPUs with Vulkan support!");
             }
 
             physicalDevices.resize(deviceCount);
-            if (vkEnumeratePhysicalDevices(instance, &deviceCount, physicalDevices.data()) != VK_SUCCESS) {
+            if (instanceDispatch.vkEnumeratePhysicalDevices(instance, &deviceCount, physicalDevices.data()) != VK_SUCCESS) {
                 throw std::runtime_error("Failed to enumerate physical devices!");
             }
 
             std::cout << "Number of physical devices: " << deviceCount << std::endl;
             for (size_t i = 0; i < physicalDevices.size(); ++i) {
-                printPhysicalDeviceProperties(physicalDevices[i], i + 1);
+                printPhysicalDeviceProperties(physicalDevices[i], static_cast<int>(i));
             }
         }
 
+        void pickPhysicalDevice() {
+            DeviceRequirements requirements;
+            requirements.surface = surface;
+            if (!config.headless) {
+                requirements.extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+            }
+            uint32_t index = selectPhysicalDevice(physicalDevices, requirements, config.device);
+            physicalDevice = physicalDevices[index];
+            std::cout << "Selected physical device " << index << "." << std::endl;
+        }
+
         void printPhysicalDeviceProperties(VkPhysicalDevice device, int deviceIndex) {
             VkPhysicalDeviceProperties properties;
-            vkGetPhysicalDeviceProperties(device, &properties);
+            instanceDispatch.vkGetPhysicalDeviceProperties(device, &properties);
 
             std::cout << "Physical Device " << deviceIndex << ": " << properties.deviceName << std::endl;
             std::cout << "API Version: "
@@ -335,17 +1590,18 @@ namespace vulkan {
             std::cout << std::endl << std::endl;
         }
 
-        void createSwapChain() {
+        void createSwapChain(VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE) {
             // Select the best surface format and present mode
             
             VkSurfaceFormatKHR surfaceFormat = selectSurfaceFormat(swapChainSupport.formats);
-            VkPresentModeKHR presentMode = selectPresentMode(swapChainSupport.presentModes);
+            presentSettings = resolvePresentPolicy(presentPolicy, swapChainSupport.capabilities, swapChainSupport.presentModes);
+            VkPresentModeKHR presentMode = presentSettings.presentMode;
+            activeFrameCount = config.framesInFlight > 0 ? config.framesInFlight : std::min(presentSettings.framesInFlight, frameSlotCount());
 
-            VkExtent2D extent = swapChainSupport.capabilities.currentExtent;
-            uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
-            if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
-                imageCount = swapChainSupport.capabilities.maxImageCount;
-            }
+            VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
+            swapChainExtent = extent;
+            swapChainImageFormat = surfaceFormat.format;
+            uint32_t imageCount = presentSettings.imageCount;
 
             VkSwapchainCreateInfoKHR createInfo{};
             createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -374,26 +1630,45 @@ namespace vulkan {
             createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
             createInfo.presentMode = presentMode;
             createInfo.clipped = VK_TRUE;
-            createInfo.oldSwapchain = VK_NULL_HANDLE;
+            createInfo.oldSwapchain = oldSwapchain; // Lets the driver hand over resources instead of starting cold
 
-            if (vkCreateSwapchainKHR(logicalDevice, &createInfo, &Alloctor, &swapchain) != VK_SUCCESS) {
+            Allocator::ScopedAllocationTag allocationTag("vkCreateSwapchainKHR");
+            if (deviceDispatch.vkCreateSwapchainKHR(logicalDevice, &createInfo, &Alloctor, &swapchain) != VK_SUCCESS) {
                 throw std::runtime_error("Failed to create swap chain!");
             }
-            std::cout << "Created swap chain." << std::endl;
+            deletionQueue.track(swapchain, "swapchain");
+            std::cout << "Created swap chain (" << presentPolicyName(presentPolicy) << ": " << presentModeName(presentMode) << ", "
+                << imageCount << " images, " << activeFrameCount << " frames in flight)." << std::endl;
             
-            vkGetSwapchainImagesKHR(logicalDevice, swapchain, &imageCount, nullptr);
+            deviceDispatch.vkGetSwapchainImagesKHR(logicalDevice, swapchain, &imageCount, nullptr);
             swapChainImages.resize(imageCount);
-            vkGetSwapchainImagesKHR(logicalDevice, swapchain, &imageCount, swapChainImages.data());
+            deviceDispatch.vkGetSwapchainImagesKHR(logicalDevice, swapchain, &imageCount, swapChainImages.data());
         }
         void cleanupSwapChain() {
-            vkDestroySwapchainKHR(logicalDevice , swapchain , &Alloctor);
+            for (auto framebuffer : framebuffers) {
+                deletionQueue.retire(framebuffer);
+            }
             for (auto imageView : swapChainImageViews) {
-                vkDestroyImageView(logicalDevice, imageView, &Alloctor);
+                deletionQueue.retire(imageView);
             }
-            for (auto framebuffer : framebuffers) {
-                vkDestroyFramebuffer(logicalDevice, framebuffer, &Alloctor);
+            presentLatency.forget(swapchain);
+            deletionQueue.retire(swapchain);
+            swapchain = VK_NULL_HANDLE;
+            framebuffers.clear();
+            swapChainImageViews.clear();
+        }
+
+        // currentExtent is 0xFFFFFFFF on platforms where the surface size follows the swapchain
+        VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
+            if (capabilities.currentExtent.width != UINT32_MAX) {
+                return capabilities.currentExtent;
             }
-            
+            int width = 0, height = 0;
+            glfwGetFramebufferSize(window, &width, &height);
+            VkExtent2D extent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
+            extent.width = std::max(capabilities.minImageExtent.width, std::min(capabilities.maxImageExtent.width, extent.width));
+            extent.height = std::max(capabilities.minImageExtent.height, std::min(capabilities.maxImageExtent.height, extent.height));
+            return extent;
         }
         VkSurfaceFormatKHR selectSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
             for (const auto& format : availableFormats) {
@@ -405,24 +1680,18 @@ namespace vulkan {
             return availableFormats[0];
         }
 
-        VkPresentModeKHR selectPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
-            for (const auto& mode : availablePresentModes) {
-                if (mode == VK_PRESENT_MODE_MAILBOX_KHR) {
-                    return mode; // Prefer mailbox for lower latency
-                }
-            }
-            return VK_PRESENT_MODE_FIFO_KHR; // Fallback to FIFO
-        }
         VkRenderPass createRenderPass(VkDevice device) {
             VkAttachmentDescription colorAttachment{};
-            colorAttachment.format = VK_FORMAT_B8G8R8A8_SRGB; // Match swap chain format
+            colorAttachment.format = swapChainImageFormat;
             colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
             colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; // Clear the attachment
             colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE; // Store the result
             colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
             colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
             colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; // No initial layout
-            colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // Final layout for presentation
+            colorAttachment.finalLayout = config.headless
+                ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL   // Headless frames are copied out for readback
+                : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // Final layout for presentation
 
             VkAttachmentReference colorAttachmentRef{};
             colorAttachmentRef.attachment = 0; // Attachment index
@@ -439,12 +1708,24 @@ namespace vulkan {
             renderPassInfo.pAttachments = &colorAttachment;
             renderPassInfo.subpassCount = 1;
             renderPassInfo.pSubpasses = &subpass;
-            
 
-            if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPasss) != VK_SUCCESS) {
+            // The layout transition must wait for the acquire semaphore, which is waited on at this stage
+            VkSubpassDependency dependency{};
+            dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+            dependency.dstSubpass = 0;
+            dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            dependency.srcAccessMask = 0;
+            dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            renderPassInfo.dependencyCount = 1;
+            renderPassInfo.pDependencies = &dependency;
+
+            Allocator::ScopedAllocationTag allocationTag("vkCreateRenderPass");
+            if (deviceDispatch.vkCreateRenderPass(device, &renderPassInfo, &Alloctor, &renderPasss) != VK_SUCCESS) {
                 throw std::runtime_error("Failed to create render pass!");
             }
-            std::cout << "Created swap chain." << std::endl;
+            deletionQueue.track(renderPasss, "render pass");
+            std::cout << "Created render pass." << std::endl;
 
             return renderPasss;
         }
@@ -458,7 +1739,7 @@ namespace vulkan {
                 viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
                 viewInfo.image = swapChainImages[i];
                 viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-                viewInfo.format = VK_FORMAT_B8G8R8A8_SRGB; // Match swap chain format
+                viewInfo.format = swapChainImageFormat;
                 viewInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
                 viewInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
                 viewInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
@@ -469,13 +1750,15 @@ namespace vulkan {
                 viewInfo.subresourceRange.baseArrayLayer = 0;
                 viewInfo.subresourceRange.layerCount = 1;
 
-                if (vkCreateImageView(device, &viewInfo, nullptr, &swapChainImageViews[i]) != VK_SUCCESS) {
+                Allocator::ScopedAllocationTag allocationTag("vkCreateImageView");
+                if (deviceDispatch.vkCreateImageView(device, &viewInfo, &Alloctor, &swapChainImageViews[i]) != VK_SUCCESS) {
                     throw std::runtime_error("Failed to create image views!");
                 }
                 else
                 {
                     std::cout << "createSwapChainImageViews is working  \n";
                 }
+                deletionQueue.track(swapChainImageViews[i], "swapchain image view");
             }
         }
         std::vector<VkFramebuffer> framebuffers;
@@ -490,14 +1773,16 @@ namespace vulkan {
                 framebufferInfo.renderPass = renderPasss;;  // Use the render pass created earlier
                 framebufferInfo.attachmentCount = 1;      // Number of attachments (we're only using the color attachment)
                 framebufferInfo.pAttachments = &swapChainImageViews[i];  // Image view for this framebuffer
-                framebufferInfo.width = swapChainSupport.capabilities.currentExtent.width;   // Swap chain image width
-                framebufferInfo.height = swapChainSupport.capabilities.currentExtent.height; // Swap chain image height
+                framebufferInfo.width = swapChainExtent.width;   // Swap chain image width
+                framebufferInfo.height = swapChainExtent.height; // Swap chain image height
                 framebufferInfo.layers = 1;  // Number of layers in the image (1 for 2D images)
 
                 // Create the framebuffer for this image view
-                if (vkCreateFramebuffer(logicalDevice, &framebufferInfo, &Alloctor, &framebuffers[i]) != VK_SUCCESS) {
+                Allocator::ScopedAllocationTag allocationTag("vkCreateFramebuffer");
+                if (deviceDispatch.vkCreateFramebuffer(logicalDevice, &framebufferInfo, &Alloctor, &framebuffers[i]) != VK_SUCCESS) {
                     throw std::runtime_error("Failed to create framebuffer!");
                 }
+                deletionQueue.track(framebuffers[i], "framebuffer");
             }
 
             std::cout << "Framebuffers created successfully." << std::endl;
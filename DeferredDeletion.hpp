@@ -0,0 +1,280 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "DeviceMemory.hpp"
+
+namespace vulkan {
+
+    // Maps a handle type to its VkObjectType. Non-dispatchable handles are distinct pointer types on
+    // 64-bit targets, which is what lets retire()/track() overload on them.
+    template <typename Handle> struct HandleObjectType;
+    template <> struct HandleObjectType<VkImage> { static constexpr VkObjectType value = VK_OBJECT_TYPE_IMAGE; };
+    template <> struct HandleObjectType<VkImageView> { static constexpr VkObjectType value = VK_OBJECT_TYPE_IMAGE_VIEW; };
+    template <> struct HandleObjectType<VkBuffer> { static constexpr VkObjectType value = VK_OBJECT_TYPE_BUFFER; };
+    template <> struct HandleObjectType<VkFramebuffer> { static constexpr VkObjectType value = VK_OBJECT_TYPE_FRAMEBUFFER; };
+    template <> struct HandleObjectType<VkRenderPass> { static constexpr VkObjectType value = VK_OBJECT_TYPE_RENDER_PASS; };
+    template <> struct HandleObjectType<VkSemaphore> { static constexpr VkObjectType value = VK_OBJECT_TYPE_SEMAPHORE; };
+    template <> struct HandleObjectType<VkFence> { static constexpr VkObjectType value = VK_OBJECT_TYPE_FENCE; };
+    template <> struct HandleObjectType<VkCommandPool> { static constexpr VkObjectType value = VK_OBJECT_TYPE_COMMAND_POOL; };
+    template <> struct HandleObjectType<VkSwapchainKHR> { static constexpr VkObjectType value = VK_OBJECT_TYPE_SWAPCHAIN_KHR; };
+    template <> struct HandleObjectType<VkPipeline> { static constexpr VkObjectType value = VK_OBJECT_TYPE_PIPELINE; };
+    template <> struct HandleObjectType<VkPipelineLayout> { static constexpr VkObjectType value = VK_OBJECT_TYPE_PIPELINE_LAYOUT; };
+    template <> struct HandleObjectType<VkDescriptorPool> { static constexpr VkObjectType value = VK_OBJECT_TYPE_DESCRIPTOR_POOL; };
+    template <> struct HandleObjectType<VkDescriptorSetLayout> { static constexpr VkObjectType value = VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT; };
+    template <> struct HandleObjectType<VkSampler> { static constexpr VkObjectType value = VK_OBJECT_TYPE_SAMPLER; };
+    template <> struct HandleObjectType<VkShaderModule> { static constexpr VkObjectType value = VK_OBJECT_TYPE_SHADER_MODULE; };
+
+    inline const char* objectTypeName(VkObjectType type) {
+        switch (type) {
+        case VK_OBJECT_TYPE_IMAGE: return "VkImage";
+        case VK_OBJECT_TYPE_IMAGE_VIEW: return "VkImageView";
+        case VK_OBJECT_TYPE_BUFFER: return "VkBuffer";
+        case VK_OBJECT_TYPE_FRAMEBUFFER: return "VkFramebuffer";
+        case VK_OBJECT_TYPE_RENDER_PASS: return "VkRenderPass";
+        case VK_OBJECT_TYPE_SEMAPHORE: return "VkSemaphore";
+        case VK_OBJECT_TYPE_FENCE: return "VkFence";
+        case VK_OBJECT_TYPE_COMMAND_POOL: return "VkCommandPool";
+        case VK_OBJECT_TYPE_SWAPCHAIN_KHR: return "VkSwapchainKHR";
+        case VK_OBJECT_TYPE_PIPELINE: return "VkPipeline";
+        case VK_OBJECT_TYPE_PIPELINE_LAYOUT: return "VkPipelineLayout";
+        case VK_OBJECT_TYPE_DESCRIPTOR_POOL: return "VkDescriptorPool";
+        case VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT: return "VkDescriptorSetLayout";
+        case VK_OBJECT_TYPE_SAMPLER: return "VkSampler";
+        case VK_OBJECT_TYPE_SHADER_MODULE: return "VkShaderModule";
+        case VK_OBJECT_TYPE_DEVICE_MEMORY: return "device allocation";
+        default: return "handle";
+        }
+    }
+
+    // Deferred destruction keyed by the graphics timeline. Every graphics submission signals
+    // timeline() with the value from beginSubmit(); a retired handle (and its device memory) is
+    // tagged with the value of the last submission that may use it and destroyed by collect() once
+    // the semaphore has reached that value. Nothing on the frame path waits for the device.
+    //
+    // With leak tracking on, handles registered with track() that are still alive when destroy()
+    // runs are listed along with the name they were registered under.
+    //
+    // retire() and track() are thread-safe; destruction runs outside the lock.
+    class DeletionQueue {
+    public:
+        void init(DeviceMemoryAllocator& memory, const DeviceDispatch& dispatch, const VkAllocationCallbacks* callbacks, bool trackLeaks) {
+            this->memory = &memory;
+            this->dispatch = &dispatch;
+            this->device = dispatch.device;
+            this->callbacks = callbacks;
+            this->trackLeaks = trackLeaks;
+
+            VkSemaphoreTypeCreateInfo typeInfo{};
+            typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+            typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+            typeInfo.initialValue = 0;
+            VkSemaphoreCreateInfo semaphoreInfo{};
+            semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            semaphoreInfo.pNext = &typeInfo;
+            Allocator::ScopedAllocationTag semaphoreTag("vkCreateSemaphore");
+            if (dispatch.vkCreateSemaphore(device, &semaphoreInfo, callbacks, &timelineSemaphore) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create frame timeline semaphore!");
+            }
+        }
+
+        // Destroys everything still queued and reports leaks. Expects the device to be idle.
+        void destroy() {
+            if (device == VK_NULL_HANDLE) {
+                return;
+            }
+            flush();
+            if (trackLeaks) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (live.empty()) {
+                    std::cout << "Leak check: no Vulkan handles leaked." << std::endl;
+                }
+                else {
+                    std::cout << "Leak check: " << live.size() << " Vulkan handles were never destroyed:" << std::endl;
+                    for (const auto& entry : live) {
+                        std::cout << " - " << objectTypeName(entry.first.first) << " 0x" << std::hex << entry.first.second << std::dec
+                            << " (" << entry.second << ")" << std::endl;
+                    }
+                }
+                live.clear();
+            }
+            dispatch->vkDestroySemaphore(device, timelineSemaphore, callbacks);
+            timelineSemaphore = VK_NULL_HANDLE;
+            device = VK_NULL_HANDLE;
+        }
+
+        VkSemaphore timeline() const {
+            return timelineSemaphore;
+        }
+
+        // Value the next graphics submission must signal on timeline().
+        uint64_t beginSubmit() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return ++submittedValue;
+        }
+
+        uint64_t lastSubmitted() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return submittedValue;
+        }
+
+        uint64_t completed() {
+            uint64_t value = 0;
+            if (dispatch->vkGetSemaphoreCounterValue(device, timelineSemaphore, &value) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to read frame timeline semaphore!");
+            }
+            return value;
+        }
+
+        // Destroys handle once the timeline reaches afterValue.
+        template <typename Handle>
+        void retire(Handle handle, uint64_t afterValue) {
+            if (handle != VK_NULL_HANDLE) {
+                enqueue({ afterValue, HandleObjectType<Handle>::value, handleBits(handle), nullptr });
+            }
+        }
+
+        // Retires after the last submission recorded so far.
+        template <typename Handle>
+        void retire(Handle handle) {
+            retire(handle, lastSubmitted());
+        }
+
+        // Resources bound to memory from the device allocator; the memory goes back with them.
+        void retire(VkImage image, DeviceAllocation* allocation, uint64_t afterValue) {
+            enqueue({ afterValue, VK_OBJECT_TYPE_IMAGE, handleBits(image), allocation });
+        }
+
+        void retire(VkBuffer buffer, DeviceAllocation* allocation, uint64_t afterValue) {
+            enqueue({ afterValue, VK_OBJECT_TYPE_BUFFER, handleBits(buffer), allocation });
+        }
+
+        void retire(DeviceAllocation* allocation, uint64_t afterValue) {
+            if (allocation != nullptr) {
+                enqueue({ afterValue, VK_OBJECT_TYPE_DEVICE_MEMORY, 0, allocation });
+            }
+        }
+
+        // Destroys every entry the GPU has finished with, in one batch. Returns how many there were.
+        size_t collect() {
+            uint64_t done = completed();
+            std::vector<Entry> batch;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                while (!pending.empty() && pending.front().value <= done) {
+                    batch.push_back(pending.front());
+                    pending.pop_front();
+                }
+            }
+            for (const Entry& entry : batch) {
+                destroyEntry(entry);
+            }
+            return batch.size();
+        }
+
+        // Destroys everything regardless of the timeline. Expects the device to be idle.
+        void flush() {
+            std::deque<Entry> batch;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                batch.swap(pending);
+            }
+            for (const Entry& entry : batch) {
+                destroyEntry(entry);
+            }
+        }
+
+        size_t pendingCount() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return pending.size();
+        }
+
+        // Leak tracking: registers a live handle under name (kept by pointer, use a literal).
+        template <typename Handle>
+        void track(Handle handle, const char* name) {
+            if (trackLeaks && handle != VK_NULL_HANDLE) {
+                std::lock_guard<std::mutex> lock(mutex);
+                live[{ HandleObjectType<Handle>::value, handleBits(handle) }] = name;
+            }
+        }
+
+    private:
+        struct Entry {
+            uint64_t value;
+            VkObjectType type;
+            uint64_t handle;
+            DeviceAllocation* allocation;
+        };
+
+        template <typename Handle>
+        static uint64_t handleBits(Handle handle) {
+            uint64_t bits = 0;
+            std::memcpy(&bits, &handle, sizeof(handle));
+            return bits;
+        }
+
+        template <typename Handle>
+        static Handle fromBits(uint64_t bits) {
+            Handle handle;
+            std::memcpy(&handle, &bits, sizeof(handle));
+            return handle;
+        }
+
+        // Values arrive almost always in order, so the sorted insert is a push_back in practice.
+        void enqueue(const Entry& entry) {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto position = pending.end();
+            while (position != pending.begin() && std::prev(position)->value > entry.value) {
+                --position;
+            }
+            pending.insert(position, entry);
+        }
+
+        void destroyEntry(const Entry& entry) {
+            switch (entry.type) {
+            case VK_OBJECT_TYPE_IMAGE: dispatch->vkDestroyImage(device, fromBits<VkImage>(entry.handle), callbacks); break;
+            case VK_OBJECT_TYPE_IMAGE_VIEW: dispatch->vkDestroyImageView(device, fromBits<VkImageView>(entry.handle), callbacks); break;
+            case VK_OBJECT_TYPE_BUFFER: dispatch->vkDestroyBuffer(device, fromBits<VkBuffer>(entry.handle), callbacks); break;
+            case VK_OBJECT_TYPE_FRAMEBUFFER: dispatch->vkDestroyFramebuffer(device, fromBits<VkFramebuffer>(entry.handle), callbacks); break;
+            case VK_OBJECT_TYPE_RENDER_PASS: dispatch->vkDestroyRenderPass(device, fromBits<VkRenderPass>(entry.handle), callbacks); break;
+            case VK_OBJECT_TYPE_SEMAPHORE: dispatch->vkDestroySemaphore(device, fromBits<VkSemaphore>(entry.handle), callbacks); break;
+            case VK_OBJECT_TYPE_FENCE: dispatch->vkDestroyFence(device, fromBits<VkFence>(entry.handle), callbacks); break;
+            case VK_OBJECT_TYPE_COMMAND_POOL: dispatch->vkDestroyCommandPool(device, fromBits<VkCommandPool>(entry.handle), callbacks); break;
+            case VK_OBJECT_TYPE_SWAPCHAIN_KHR: dispatch->vkDestroySwapchainKHR(device, fromBits<VkSwapchainKHR>(entry.handle), callbacks); break;
+            case VK_OBJECT_TYPE_PIPELINE: dispatch->vkDestroyPipeline(device, fromBits<VkPipeline>(entry.handle), callbacks); break;
+            case VK_OBJECT_TYPE_PIPELINE_LAYOUT: dispatch->vkDestroyPipelineLayout(device, fromBits<VkPipelineLayout>(entry.handle), callbacks); break;
+            case VK_OBJECT_TYPE_DESCRIPTOR_POOL: dispatch->vkDestroyDescriptorPool(device, fromBits<VkDescriptorPool>(entry.handle), callbacks); break;
+            case VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT: dispatch->vkDestroyDescriptorSetLayout(device, fromBits<VkDescriptorSetLayout>(entry.handle), callbacks); break;
+            case VK_OBJECT_TYPE_SAMPLER: dispatch->vkDestroySampler(device, fromBits<VkSampler>(entry.handle), callbacks); break;
+            case VK_OBJECT_TYPE_SHADER_MODULE: dispatch->vkDestroyShaderModule(device, fromBits<VkShaderModule>(entry.handle), callbacks); break;
+            default: break; // VK_OBJECT_TYPE_DEVICE_MEMORY: allocation only
+            }
+            memory->free(entry.allocation);
+            if (trackLeaks && entry.handle != 0) {
+                std::lock_guard<std::mutex> lock(mutex);
+                live.erase({ entry.type, entry.handle });
+            }
+        }
+
+        DeviceMemoryAllocator* memory = nullptr;
+        const DeviceDispatch* dispatch = nullptr;
+        VkDevice device = VK_NULL_HANDLE;
+        const VkAllocationCallbacks* callbacks = nullptr;
+        VkSemaphore timelineSemaphore = VK_NULL_HANDLE;
+        bool trackLeaks = false;
+
+        mutable std::mutex mutex;
+        uint64_t submittedValue = 0;
+        std::deque<Entry> pending;                                      // sorted by value
+        std::map<std::pair<VkObjectType, uint64_t>, const char*> live;  // leak tracking only
+    };
+
+} // namespace vulkan
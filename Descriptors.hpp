@@ -0,0 +1,376 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "DeferredDeletion.hpp"
+#include "VulkanDispatch.hpp"
+
+namespace vulkan {
+
+    constexpr uint32_t InvalidBindlessIndex = UINT32_MAX;
+
+    // Binding numbers of the global bindless set, as seen by shaders:
+    //   layout(set = 0, binding = 0) uniform sampler2D textures[];
+    //   layout(set = 0, binding = 1) buffer Buffers { ... } buffers[];
+    enum class BindlessKind : uint32_t {
+        Texture = 0,        // COMBINED_IMAGE_SAMPLER
+        StorageBuffer = 1   // STORAGE_BUFFER
+    };
+
+    // One global descriptor set holding every texture and storage buffer, indexed from shaders with
+    // descriptor indexing. Slots come from a free list per kind; a released slot returns to the list
+    // only after the frame timeline passes the last submission that could have read it, so shaders of
+    // frames in flight never see it rewritten. The set is update-after-bind and partially bound, so it
+    // is bound once per command buffer and written while frames that use it are executing.
+    //
+    // All members are thread-safe.
+    class BindlessTable {
+    public:
+        void init(const DeviceDispatch& dispatch, const VkAllocationCallbacks* callbacks, DeletionQueue& deletion,
+            uint32_t textureCapacity, uint32_t bufferCapacity) {
+            this->dispatch = &dispatch;
+            this->callbacks = callbacks;
+            this->deletion = &deletion;
+            kinds[0].capacity = textureCapacity;
+            kinds[1].capacity = bufferCapacity;
+
+            VkDescriptorSetLayoutBinding bindings[2]{};
+            bindings[0].binding = static_cast<uint32_t>(BindlessKind::Texture);
+            bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            bindings[0].descriptorCount = textureCapacity;
+            bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+            bindings[1].binding = static_cast<uint32_t>(BindlessKind::StorageBuffer);
+            bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[1].descriptorCount = bufferCapacity;
+            bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+
+            VkDescriptorBindingFlags bindingFlags[2] = {
+                VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,
+                VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,
+            };
+            VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{};
+            flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+            flagsInfo.bindingCount = 2;
+            flagsInfo.pBindingFlags = bindingFlags;
+
+            VkDescriptorSetLayoutCreateInfo layoutInfo{};
+            layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            layoutInfo.pNext = &flagsInfo;
+            layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+            layoutInfo.bindingCount = 2;
+            layoutInfo.pBindings = bindings;
+            Allocator::ScopedAllocationTag layoutTag("vkCreateDescriptorSetLayout");
+            if (dispatch.vkCreateDescriptorSetLayout(dispatch.device, &layoutInfo, callbacks, &setLayout) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create bindless descriptor set layout!");
+            }
+
+            VkDescriptorPoolSize poolSizes[2] = {
+                { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, textureCapacity },
+                { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, bufferCapacity },
+            };
+            VkDescriptorPoolCreateInfo poolInfo{};
+            poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+            poolInfo.maxSets = 1;
+            poolInfo.poolSizeCount = 2;
+            poolInfo.pPoolSizes = poolSizes;
+            Allocator::ScopedAllocationTag poolTag("vkCreateDescriptorPool");
+            if (dispatch.vkCreateDescriptorPool(dispatch.device, &poolInfo, callbacks, &pool) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create bindless descriptor pool!");
+            }
+
+            VkDescriptorSetAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            allocInfo.descriptorPool = pool;
+            allocInfo.descriptorSetCount = 1;
+            allocInfo.pSetLayouts = &setLayout;
+            if (dispatch.vkAllocateDescriptorSets(dispatch.device, &allocInfo, &set) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to allocate bindless descriptor set!");
+            }
+            std::cout << "Bindless table: " << textureCapacity << " textures, " << bufferCapacity << " storage buffers." << std::endl;
+        }
+
+        // Expects the device to be idle.
+        void destroy() {
+            if (pool == VK_NULL_HANDLE) {
+                return;
+            }
+            dispatch->vkDestroyDescriptorPool(dispatch->device, pool, callbacks);
+            dispatch->vkDestroyDescriptorSetLayout(dispatch->device, setLayout, callbacks);
+            pool = VK_NULL_HANDLE;
+            setLayout = VK_NULL_HANDLE;
+            set = VK_NULL_HANDLE;
+        }
+
+        VkDescriptorSetLayout layout() const {
+            return setLayout;
+        }
+
+        VkDescriptorSet descriptorSet() const {
+            return set;
+        }
+
+        // Hands out a slot without writing it, for buffers that only exist once a later update*()
+        // call fills the slot in. Recycled slots first, so the live range stays dense.
+        uint32_t reserve(BindlessKind kind) {
+            std::lock_guard<std::mutex> lock(mutex);
+            Kind& slots = kinds[static_cast<uint32_t>(kind)];
+            if (!slots.freeSlots.empty()) {
+                uint32_t index = slots.freeSlots.back();
+                slots.freeSlots.pop_back();
+                return index;
+            }
+            if (slots.highWater < slots.capacity) {
+                return slots.highWater++;
+            }
+            return InvalidBindlessIndex;
+        }
+
+        // Returns the slot shaders index textures[] with, or InvalidBindlessIndex when the table is full.
+        uint32_t addTexture(VkImageView view, VkSampler sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+            uint32_t index = reserve(BindlessKind::Texture);
+            if (index != InvalidBindlessIndex) {
+                updateTexture(index, view, sampler, layout);
+            }
+            return index;
+        }
+
+        uint32_t addBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE) {
+            uint32_t index = reserve(BindlessKind::StorageBuffer);
+            if (index != InvalidBindlessIndex) {
+                updateBuffer(index, buffer, offset, range);
+            }
+            return index;
+        }
+
+        // Rewrites a slot in place, e.g. when a streamed texture gets its full mip chain. The previous
+        // contents may still be read by frames in flight; update-after-bind makes that legal as long as
+        // those frames do not access this slot.
+        void updateTexture(uint32_t index, VkImageView view, VkSampler sampler, VkImageLayout layout) {
+            VkDescriptorImageInfo imageInfo{};
+            imageInfo.sampler = sampler;
+            imageInfo.imageView = view;
+            imageInfo.imageLayout = layout;
+            VkWriteDescriptorSet write{};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = set;
+            write.dstBinding = static_cast<uint32_t>(BindlessKind::Texture);
+            write.dstArrayElement = index;
+            write.descriptorCount = 1;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            write.pImageInfo = &imageInfo;
+            std::lock_guard<std::mutex> lock(mutex);
+            dispatch->vkUpdateDescriptorSets(dispatch->device, 1, &write, 0, nullptr);
+        }
+
+        void updateBuffer(uint32_t index, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+            VkDescriptorBufferInfo bufferInfo{};
+            bufferInfo.buffer = buffer;
+            bufferInfo.offset = offset;
+            bufferInfo.range = range;
+            VkWriteDescriptorSet write{};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = set;
+            write.dstBinding = static_cast<uint32_t>(BindlessKind::StorageBuffer);
+            write.dstArrayElement = index;
+            write.descriptorCount = 1;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            write.pBufferInfo = &bufferInfo;
+            std::lock_guard<std::mutex> lock(mutex);
+            dispatch->vkUpdateDescriptorSets(dispatch->device, 1, &write, 0, nullptr);
+        }
+
+        // The slot becomes reusable once every frame submitted so far has completed.
+        void release(BindlessKind kind, uint32_t index) {
+            if (index == InvalidBindlessIndex) {
+                return;
+            }
+            uint64_t lastUse = deletion->lastSubmitted();
+            std::lock_guard<std::mutex> lock(mutex);
+            retired.push_back({ lastUse, kind, index });
+        }
+
+        // Returns released slots whose last frame has completed to their free lists. Call once per frame.
+        void collect() {
+            uint64_t done = deletion->completed();
+            std::lock_guard<std::mutex> lock(mutex);
+            while (!retired.empty() && retired.front().value <= done) {
+                kinds[static_cast<uint32_t>(retired.front().kind)].freeSlots.push_back(retired.front().index);
+                retired.pop_front();
+            }
+        }
+
+        void bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t setIndex = 0) const {
+            dispatch->vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout, setIndex, 1, &set, 0, nullptr);
+        }
+
+        uint32_t liveCount(BindlessKind kind) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            const Kind& slots = kinds[static_cast<uint32_t>(kind)];
+            return slots.highWater - static_cast<uint32_t>(slots.freeSlots.size());
+        }
+
+    private:
+        struct Kind {
+            uint32_t capacity = 0;
+            uint32_t highWater = 0;             // slots below this have been handed out at least once
+            std::vector<uint32_t> freeSlots;
+        };
+
+        struct RetiredSlot {
+            uint64_t value;
+            BindlessKind kind;
+            uint32_t index;
+        };
+
+        const DeviceDispatch* dispatch = nullptr;
+        const VkAllocationCallbacks* callbacks = nullptr;
+        DeletionQueue* deletion = nullptr;
+        VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+        VkDescriptorPool pool = VK_NULL_HANDLE;
+        VkDescriptorSet set = VK_NULL_HANDLE;
+
+        mutable std::mutex mutex;
+        Kind kinds[2];
+        std::deque<RetiredSlot> retired;    // in release order, which is timeline order
+    };
+
+    // Descriptors of each type reserved per set when sizing a transient pool.
+    struct DescriptorPoolRatio {
+        VkDescriptorType type;
+        float perSet;
+    };
+
+    // Transient descriptor sets for one frame at a time. Each frame slot owns a chain of pools that is
+    // reset as a whole by beginFrame() (after the slot's fence), so sets are never freed one by one.
+    // When the current pool runs out, allocation moves on to the next pool in the chain, creating one
+    // twice the size of the last when the chain is exhausted; the chain keeps its pools across frames,
+    // so a steady workload stops creating pools after the first few frames.
+    //
+    // allocate() is thread-safe.
+    class FrameDescriptorAllocator {
+    public:
+        void init(const DeviceDispatch& dispatch, const VkAllocationCallbacks* callbacks, uint32_t frameCount,
+            uint32_t initialSetsPerPool = 128, std::vector<DescriptorPoolRatio> ratios = {
+                { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f },
+                { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+                { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f },
+                { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f },
+                { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0.5f },
+            }) {
+            this->dispatch = &dispatch;
+            this->callbacks = callbacks;
+            this->initialSetsPerPool = std::max(initialSetsPerPool, 1u);
+            this->ratios = std::move(ratios);
+            frames.resize(std::max(frameCount, 1u));
+        }
+
+        // Expects the device to be idle.
+        void destroy() {
+            for (FramePools& frame : frames) {
+                for (const Pool& pool : frame.pools) {
+                    dispatch->vkDestroyDescriptorPool(dispatch->device, pool.pool, callbacks);
+                }
+                frame.pools.clear();
+            }
+            frames.clear();
+        }
+
+        // Only call once the GPU has finished the frame that last used this slot.
+        void beginFrame(uint32_t frameIndex) {
+            std::lock_guard<std::mutex> lock(mutex);
+            current = &frames[frameIndex];
+            for (const Pool& pool : current->pools) {
+                dispatch->vkResetDescriptorPool(dispatch->device, pool.pool, 0);
+            }
+            current->active = 0;
+            current->allocated = 0;
+        }
+
+        VkDescriptorSet allocate(VkDescriptorSetLayout layout) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (current == nullptr) {
+                throw std::runtime_error("FrameDescriptorAllocator::allocate() before beginFrame()!");
+            }
+            VkDescriptorSetAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            allocInfo.descriptorSetCount = 1;
+            allocInfo.pSetLayouts = &layout;
+            while (true) {
+                if (current->active == current->pools.size()) {
+                    uint32_t sets = current->pools.empty() ? initialSetsPerPool : std::min(current->pools.back().maxSets * 2, MaxSetsPerPool);
+                    current->pools.push_back({ createPool(sets), sets });
+                }
+                allocInfo.descriptorPool = current->pools[current->active].pool;
+                VkDescriptorSet set = VK_NULL_HANDLE;
+                VkResult result = dispatch->vkAllocateDescriptorSets(dispatch->device, &allocInfo, &set);
+                if (result == VK_SUCCESS) {
+                    current->pools[current->active].fresh = false;
+                    current->allocated++;
+                    return set;
+                }
+                if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) {
+                    throw std::runtime_error("Failed to allocate transient descriptor set!");
+                }
+                // A freshly created pool that still fails means the layout is bigger than any ratio allows
+                if (current->pools[current->active].fresh) {
+                    throw std::runtime_error("Descriptor set layout does not fit a transient pool!");
+                }
+                current->active++;
+            }
+        }
+
+        uint32_t poolCount(uint32_t frameIndex) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return static_cast<uint32_t>(frames[frameIndex].pools.size());
+        }
+
+    private:
+        static constexpr uint32_t MaxSetsPerPool = 4096;
+
+        struct Pool {
+            VkDescriptorPool pool;
+            uint32_t maxSets;
+            bool fresh = true;      // nothing has been allocated from it yet
+        };
+
+        struct FramePools {
+            std::vector<Pool> pools;
+            size_t active = 0;
+            uint32_t allocated = 0;
+        };
+
+        VkDescriptorPool createPool(uint32_t sets) {
+            std::vector<VkDescriptorPoolSize> sizes;
+            for (const DescriptorPoolRatio& ratio : ratios) {
+                sizes.push_back({ ratio.type, std::max(1u, static_cast<uint32_t>(ratio.perSet * sets)) });
+            }
+            VkDescriptorPoolCreateInfo poolInfo{};
+            poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            poolInfo.maxSets = sets;
+            poolInfo.poolSizeCount = static_cast<uint32_t>(sizes.size());
+            poolInfo.pPoolSizes = sizes.data();
+            VkDescriptorPool pool;
+            Allocator::ScopedAllocationTag poolTag("vkCreateDescriptorPool");
+            if (dispatch->vkCreateDescriptorPool(dispatch->device, &poolInfo, callbacks, &pool) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create transient descriptor pool!");
+            }
+            return pool;
+        }
+
+        const DeviceDispatch* dispatch = nullptr;
+        const VkAllocationCallbacks* callbacks = nullptr;
+        uint32_t initialSetsPerPool = 128;
+        std::vector<DescriptorPoolRatio> ratios;
+
+        mutable std::mutex mutex;
+        std::vector<FramePools> frames;
+        FramePools* current = nullptr;
+    };
+
+} // namespace vulkan
@@ -0,0 +1,977 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "AllocationTelemetry.hpp"
+#include "VulkanDispatch.hpp"
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace vulkan {
+
+    // What the CPU does with the memory; decides which memory type an allocation lands in.
+    enum class MemoryUsage {
+        GpuOnly,     // device-local, never mapped
+        Upload,      // host-visible, written by the CPU and read by the GPU (staging, per-frame uniforms)
+        Readback     // host-visible and preferably cached, written by the GPU and read by the CPU
+    };
+
+    // Buffers and linear images must not share a block with optimal-tiling images unless
+    // bufferImageGranularity is respected; keeping them in separate pools sidesteps that entirely.
+    enum class ResourceKind {
+        Linear = 0,
+        Optimal = 1
+    };
+
+    inline uint32_t bitScanReverse(uint64_t value) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return static_cast<uint32_t>(index);
+#else
+        return 63u - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+    }
+
+    inline uint32_t bitScanForward(uint64_t value) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return static_cast<uint32_t>(index);
+#else
+        return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+    }
+
+    inline VkDeviceSize alignDeviceSize(VkDeviceSize value, VkDeviceSize alignment) {
+        return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+    }
+
+    // Two-level segregated fit bookkeeping for one VkDeviceMemory block. Allocation and free are O(1):
+    // the first level splits sizes by power of two, the second level into 16 linear ranges, and two
+    // bitmaps locate the smallest non-empty class that is large enough.
+    class TlsfMetadata {
+    public:
+        static constexpr uint32_t kNull = UINT32_MAX;
+
+        void init(VkDeviceSize size) {
+            nodes.clear();
+            spareNodes.clear();
+            firstLevelBitmap = 0;
+            std::fill(std::begin(secondLevelBitmap), std::end(secondLevelBitmap), 0u);
+            for (auto& level : freeHeads) {
+                std::fill(std::begin(level), std::end(level), kNull);
+            }
+            blockSize = size;
+            usedBytes = 0;
+            allocationCount = 0;
+            uint32_t node = newNode();
+            nodes[node].offset = 0;
+            nodes[node].size = size;
+            insertFree(node);
+        }
+
+        bool allocate(VkDeviceSize size, VkDeviceSize alignment, void* owner, uint32_t& outNode, VkDeviceSize& outOffset) {
+            // Searching for size + alignment - 1 guarantees the aligned range still fits.
+            VkDeviceSize request = size + (alignment > 1 ? alignment - 1 : 0);
+            uint32_t node = findFree(request);
+            if (node == kNull) {
+                return false;
+            }
+            removeFree(node);
+
+            VkDeviceSize padding = alignDeviceSize(nodes[node].offset, alignment) - nodes[node].offset;
+            if (padding > 0) {
+                uint32_t front = newNode();
+                nodes[front].offset = nodes[node].offset;
+                nodes[front].size = padding;
+                linkBefore(front, node);
+                nodes[node].offset += padding;
+                nodes[node].size -= padding;
+                insertFree(front);
+            }
+            if (nodes[node].size > size) {
+                uint32_t tail = newNode();
+                nodes[tail].offset = nodes[node].offset + size;
+                nodes[tail].size = nodes[node].size - size;
+                linkAfter(tail, node);
+                nodes[node].size = size;
+                insertFree(tail);
+            }
+            nodes[node].free = false;
+            nodes[node].owner = owner;
+            usedBytes += size;
+            ++allocationCount;
+            outNode = node;
+            outOffset = nodes[node].offset;
+            return true;
+        }
+
+        void release(uint32_t node) {
+            nodes[node].free = true;
+            nodes[node].owner = nullptr;
+            usedBytes -= nodes[node].size;
+            --allocationCount;
+
+            uint32_t next = nodes[node].nextPhysical;
+            if (next != kNull && nodes[next].free) {
+                removeFree(next);
+                nodes[node].size += nodes[next].size;
+                unlink(next);
+            }
+            uint32_t prev = nodes[node].prevPhysical;
+            if (prev != kNull && nodes[prev].free) {
+                removeFree(prev);
+                nodes[prev].size += nodes[node].size;
+                unlink(node);
+                node = prev;
+            }
+            insertFree(node);
+        }
+
+        // Visits every live allocation's owner pointer in address order.
+        template <typename Fn>
+        void forEachAllocation(Fn&& fn) const {
+            for (uint32_t node = 0; node < nodes.size(); ++node) {
+                if (!nodes[node].free && nodes[node].owner) {
+                    fn(nodes[node].owner, node);
+                }
+            }
+        }
+
+        VkDeviceSize size() const { return blockSize; }
+        VkDeviceSize used() const { return usedBytes; }
+        uint32_t count() const { return allocationCount; }
+        bool empty() const { return allocationCount == 0; }
+
+    private:
+        static constexpr uint32_t kSecondLevelLog2 = 4;
+        static constexpr uint32_t kSecondLevelCount = 1u << kSecondLevelLog2;
+        static constexpr uint32_t kFirstLevelCount = 64 - kSecondLevelLog2 + 1;
+
+        struct Node {
+            VkDeviceSize offset = 0;
+            VkDeviceSize size = 0;
+            uint32_t prevPhysical = kNull;
+            uint32_t nextPhysical = kNull;
+            uint32_t prevFree = kNull;
+            uint32_t nextFree = kNull;
+            bool free = true;
+            void* owner = nullptr;
+        };
+
+        static void mapping(VkDeviceSize size, uint32_t& firstLevel, uint32_t& secondLevel) {
+            if (size < kSecondLevelCount) {
+                firstLevel = 0;
+                secondLevel = static_cast<uint32_t>(size);
+                return;
+            }
+            uint32_t msb = bitScanReverse(size);
+            firstLevel = msb - kSecondLevelLog2 + 1;
+            secondLevel = static_cast<uint32_t>(size >> (msb - kSecondLevelLog2)) ^ kSecondLevelCount;
+        }
+
+        uint32_t findFree(VkDeviceSize size) const {
+            if (size >= kSecondLevelCount) {
+                // Round up to the next class boundary so every block in the found class is big enough.
+                size += (VkDeviceSize(1) << (bitScanReverse(size) - kSecondLevelLog2)) - 1;
+            }
+            uint32_t firstLevel, secondLevel;
+            mapping(size, firstLevel, secondLevel);
+            if (firstLevel >= kFirstLevelCount) {
+                return kNull;
+            }
+            uint32_t secondMap = secondLevelBitmap[firstLevel] & (~0u << secondLevel);
+            if (secondMap == 0) {
+                uint64_t firstMap = firstLevel + 1 < 64 ? firstLevelBitmap & (~0ull << (firstLevel + 1)) : 0;
+                if (firstMap == 0) {
+                    return kNull;
+                }
+                firstLevel = bitScanForward(firstMap);
+                secondMap = secondLevelBitmap[firstLevel];
+            }
+            return freeHeads[firstLevel][bitScanForward(secondMap)];
+        }
+
+        void insertFree(uint32_t node) {
+            uint32_t firstLevel, secondLevel;
+            mapping(nodes[node].size, firstLevel, secondLevel);
+            uint32_t head = freeHeads[firstLevel][secondLevel];
+            nodes[node].free = true;
+            nodes[node].prevFree = kNull;
+            nodes[node].nextFree = head;
+            if (head != kNull) {
+                nodes[head].prevFree = node;
+            }
+            freeHeads[firstLevel][secondLevel] = node;
+            firstLevelBitmap |= 1ull << firstLevel;
+            secondLevelBitmap[firstLevel] |= 1u << secondLevel;
+        }
+
+        void removeFree(uint32_t node) {
+            uint32_t firstLevel, secondLevel;
+            mapping(nodes[node].size, firstLevel, secondLevel);
+            uint32_t prev = nodes[node].prevFree;
+            uint32_t next = nodes[node].nextFree;
+            if (prev != kNull) {
+                nodes[prev].nextFree = next;
+            }
+            else {
+                freeHeads[firstLevel][secondLevel] = next;
+                if (next == kNull) {
+                    secondLevelBitmap[firstLevel] &= ~(1u << secondLevel);
+                    if (secondLevelBitmap[firstLevel] == 0) {
+                        firstLevelBitmap &= ~(1ull << firstLevel);
+                    }
+                }
+            }
+            if (next != kNull) {
+                nodes[next].prevFree = prev;
+            }
+        }
+
+        uint32_t newNode() {
+            if (!spareNodes.empty()) {
+                uint32_t node = spareNodes.back();
+                spareNodes.pop_back();
+                nodes[node] = Node{};
+                return node;
+            }
+            nodes.emplace_back();
+            return static_cast<uint32_t>(nodes.size() - 1);
+        }
+
+        void linkBefore(uint32_t node, uint32_t before) {
+            nodes[node].prevPhysical = nodes[before].prevPhysical;
+            nodes[node].nextPhysical = before;
+            if (nodes[before].prevPhysical != kNull) {
+                nodes[nodes[before].prevPhysical].nextPhysical = node;
+            }
+            nodes[before].prevPhysical = node;
+        }
+
+        void linkAfter(uint32_t node, uint32_t after) {
+            nodes[node].nextPhysical = nodes[after].nextPhysical;
+            nodes[node].prevPhysical = after;
+            if (nodes[after].nextPhysical != kNull) {
+                nodes[nodes[after].nextPhysical].prevPhysical = node;
+            }
+            nodes[after].nextPhysical = node;
+        }
+
+        void unlink(uint32_t node) {
+            uint32_t prev = nodes[node].prevPhysical;
+            uint32_t next = nodes[node].nextPhysical;
+            if (prev != kNull) {
+                nodes[prev].nextPhysical = next;
+            }
+            if (next != kNull) {
+                nodes[next].prevPhysical = prev;
+            }
+            nodes[node].free = false;
+            nodes[node].owner = nullptr;
+            spareNodes.push_back(node);
+        }
+
+        std::vector<Node> nodes;
+        std::vector<uint32_t> spareNodes;
+        uint64_t firstLevelBitmap = 0;
+        uint32_t secondLevelBitmap[kFirstLevelCount] = {};
+        uint32_t freeHeads[kFirstLevelCount][kSecondLevelCount];
+        VkDeviceSize blockSize = 0;
+        VkDeviceSize usedBytes = 0;
+        uint32_t allocationCount = 0;
+    };
+
+    struct MemoryBlock {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* mapped = nullptr;
+        TlsfMetadata metadata;
+    };
+
+    // A sub-allocation handed out by DeviceMemoryAllocator. The allocator owns the object; hold on to
+    // the pointer and give it back through free().
+    struct DeviceAllocation {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        void* mapped = nullptr;          // persistently mapped pointer for host-visible memory
+        uint32_t memoryTypeIndex = 0;
+        VkDeviceSize alignment = 1;
+        bool movable = false;            // opt in to defragmentation; the owner must be able to relocate its resource
+        void* userData = nullptr;        // carried over to the destination of a move
+
+        MemoryBlock* block = nullptr;    // null for dedicated allocations
+        uint32_t node = TlsfMetadata::kNull;
+        ResourceKind kind = ResourceKind::Linear;
+    };
+
+    // A relocation planned by beginDefragmentation(). destination is a new allocation reserved in a
+    // fuller block. The owner creates a new resource bound to destination, records the copy from the
+    // old one, hands the old resource and source to the deletion queue, and sets done. Moves left
+    // undone give their reservation back in endDefragmentation().
+    struct DefragmentationMove {
+        DeviceAllocation* source = nullptr;
+        DeviceAllocation* destination = nullptr;
+        bool done = false;
+    };
+
+    struct HeapBudget {
+        uint32_t heapIndex = 0;
+        VkDeviceSize heapSize = 0;
+        VkDeviceSize budget = 0;          // what the driver says we may use (VK_EXT_memory_budget), or an estimate
+        VkDeviceSize usage = 0;           // process-wide usage reported by the driver, or our own block bytes
+        VkDeviceSize blockBytes = 0;      // VkDeviceMemory owned by this allocator
+        VkDeviceSize allocatedBytes = 0;  // bytes actually handed out from those blocks
+    };
+
+    class DeviceMemoryAllocator {
+    public:
+        static constexpr VkDeviceSize kDefaultBlockSize = 64ull * 1024 * 1024;
+
+        void init(VkPhysicalDevice physicalDevice, const DeviceDispatch& dispatch, const VkAllocationCallbacks* allocationCallbacks, bool memoryBudgetSupported) {
+            VkPhysicalDeviceMemoryProperties deviceMemoryProperties;
+            vkGetPhysicalDeviceMemoryProperties(physicalDevice, &deviceMemoryProperties);
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+            this->physicalDevice = physicalDevice;
+            init(deviceMemoryProperties, properties.limits, dispatch, allocationCallbacks, memoryBudgetSupported);
+        }
+
+        // Takes the device description directly; without a physical device the driver budget can't be
+        // read, so memoryBudgetSupported must be false. The tests drive the allocator this way.
+        void init(const VkPhysicalDeviceMemoryProperties& memoryProperties, const VkPhysicalDeviceLimits& limits, const DeviceDispatch& dispatch,
+            const VkAllocationCallbacks* allocationCallbacks, bool memoryBudgetSupported) {
+            this->dispatch = &dispatch;
+            this->device = dispatch.device;
+            this->allocationCallbacks = allocationCallbacks;
+            this->memoryBudgetSupported = memoryBudgetSupported;
+            this->memoryProperties = memoryProperties;
+            maxAllocationCount = limits.maxMemoryAllocationCount;
+            nonCoherentAtomSize = limits.nonCoherentAtomSize;
+            storageBufferAlignment = limits.minStorageBufferOffsetAlignment;
+
+            pools.resize(memoryProperties.memoryTypeCount);
+            for (uint32_t type = 0; type < memoryProperties.memoryTypeCount; ++type) {
+                // Small heaps (e.g. 256 MiB BAR windows) get proportionally smaller blocks.
+                VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[type].heapIndex].size;
+                for (auto& pool : pools[type]) {
+                    pool.memoryTypeIndex = type;
+                    pool.blockSize = std::min(kDefaultBlockSize, std::max<VkDeviceSize>(heapSize / 8, 1024 * 1024));
+                }
+            }
+            heapBlockBytes.assign(memoryProperties.memoryHeapCount, 0);
+            heapAllocatedBytes.assign(memoryProperties.memoryHeapCount, 0);
+        }
+
+        void destroy() {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto& typePools : pools) {
+                for (auto& pool : typePools) {
+                    for (auto& block : pool.blocks) {
+                        block->metadata.forEachAllocation([](void* owner, uint32_t) {
+                            delete static_cast<DeviceAllocation*>(owner);
+                        });
+                        freeMemory(block->memory);
+                    }
+                    pool.blocks.clear();
+                }
+            }
+            for (DeviceAllocation* allocation : dedicated) {
+                freeMemory(allocation->memory);
+                delete allocation;
+            }
+            dedicated.clear();
+            moves.clear();
+        }
+
+        // Picks the memory type that has all required flags and the most preferred ones. Returns
+        // UINT32_MAX when nothing in typeBits qualifies.
+        uint32_t findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred, VkMemoryPropertyFlags avoided = 0) const {
+            uint32_t best = UINT32_MAX;
+            int bestScore = -1;
+            for (uint32_t type = 0; type < memoryProperties.memoryTypeCount; ++type) {
+                VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[type].propertyFlags;
+                if (!(typeBits & (1u << type)) || (flags & required) != required) {
+                    continue;
+                }
+                int score = 2 * countBits(flags & preferred) - countBits(flags & avoided);
+                if (score > bestScore) {
+                    best = type;
+                    bestScore = score;
+                }
+            }
+            return best;
+        }
+
+        DeviceAllocation* allocateForBuffer(VkBuffer buffer, MemoryUsage usage, bool bind = true) {
+            VkBufferMemoryRequirementsInfo2 info{};
+            info.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+            info.buffer = buffer;
+            VkMemoryDedicatedRequirements dedicatedRequirements{};
+            dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+            VkMemoryRequirements2 requirements{};
+            requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+            requirements.pNext = &dedicatedRequirements;
+            dispatch->vkGetBufferMemoryRequirements2(device, &info, &requirements);
+
+            DeviceAllocation* allocation = allocate(requirements.memoryRequirements, usage, ResourceKind::Linear,
+                dedicatedRequirements.prefersDedicatedAllocation, dedicatedRequirements.requiresDedicatedAllocation, buffer, VK_NULL_HANDLE);
+            if (bind && dispatch->vkBindBufferMemory(device, buffer, allocation->memory, allocation->offset) != VK_SUCCESS) {
+                free(allocation);
+                throw std::runtime_error("Failed to bind buffer memory!");
+            }
+            return allocation;
+        }
+
+        DeviceAllocation* allocateForImage(VkImage image, MemoryUsage usage, ResourceKind kind = ResourceKind::Optimal, bool bind = true) {
+            VkImageMemoryRequirementsInfo2 info{};
+            info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+            info.image = image;
+            VkMemoryDedicatedRequirements dedicatedRequirements{};
+            dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+            VkMemoryRequirements2 requirements{};
+            requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+            requirements.pNext = &dedicatedRequirements;
+            dispatch->vkGetImageMemoryRequirements2(device, &info, &requirements);
+
+            DeviceAllocation* allocation = allocate(requirements.memoryRequirements, usage, kind,
+                dedicatedRequirements.prefersDedicatedAllocation, dedicatedRequirements.requiresDedicatedAllocation, VK_NULL_HANDLE, image);
+            if (bind && dispatch->vkBindImageMemory(device, image, allocation->memory, allocation->offset) != VK_SUCCESS) {
+                free(allocation);
+                throw std::runtime_error("Failed to bind image memory!");
+            }
+            return allocation;
+        }
+
+        // Dedicated allocations are only made when the driver asks for one, or when the resource is too
+        // large to share a block sensibly.
+        DeviceAllocation* allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, ResourceKind kind,
+            bool prefersDedicated = false, bool requiresDedicated = false, VkBuffer dedicatedBuffer = VK_NULL_HANDLE, VkImage dedicatedImage = VK_NULL_HANDLE) {
+            std::lock_guard<std::mutex> lock(mutex);
+            uint32_t typeBits = requirements.memoryTypeBits;
+            while (typeBits != 0) {
+                uint32_t type = selectMemoryType(typeBits, usage);
+                if (type == UINT32_MAX) {
+                    break;
+                }
+                Pool& pool = pools[type][static_cast<uint32_t>(kind)];
+                VkDeviceSize alignment = requirements.alignment;
+                if (isHostVisible(type) && !isHostCoherent(type)) {
+                    // Keep flush/invalidate ranges of neighbouring allocations from overlapping.
+                    alignment = std::max(alignment, nonCoherentAtomSize);
+                }
+
+                DeviceAllocation* allocation = nullptr;
+                if (requiresDedicated || prefersDedicated || requirements.size > pool.blockSize / 2) {
+                    allocation = allocateDedicated(type, requirements.size, dedicatedBuffer, dedicatedImage);
+                }
+                else {
+                    allocation = allocateFromPool(pool, type, requirements.size, alignment);
+                }
+                if (allocation) {
+                    allocation->kind = kind;
+                    return allocation;
+                }
+                // Heap exhausted or over budget: fall back to the next best compatible type.
+                typeBits &= ~(1u << type);
+            }
+            throw std::runtime_error("Failed to allocate device memory!");
+        }
+
+        void free(DeviceAllocation* allocation) {
+            if (allocation == nullptr) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            freeLocked(allocation);
+        }
+
+        // Plans moves that empty the sparsest blocks of each pool into fuller ones, up to maxBytesToMove.
+        // Only allocations flagged movable are considered. Destinations are reserved right away and are
+        // not movable themselves, so a block that receives moves is never emptied back out in the same
+        // pass. Freeing a source before endDefragmentation() drops its reservation.
+        std::vector<DefragmentationMove> beginDefragmentation(VkDeviceSize maxBytesToMove) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!moves.empty()) {
+                throw std::runtime_error("Defragmentation pass already running!");
+            }
+            VkDeviceSize moved = 0;
+            for (auto& typePools : pools) {
+                for (Pool& pool : typePools) {
+                    if (pool.blocks.size() < 2) {
+                        continue;
+                    }
+                    std::vector<MemoryBlock*> order;
+                    for (auto& block : pool.blocks) {
+                        order.push_back(block.get());
+                    }
+                    std::sort(order.begin(), order.end(), [](const MemoryBlock* a, const MemoryBlock* b) {
+                        return a->metadata.used() > b->metadata.used();
+                    });
+                    // Sources from the sparsest block up, destinations only in blocks fuller than the source
+                    for (size_t source = order.size() - 1; source > 0; --source) {
+                        std::vector<DeviceAllocation*> candidates;
+                        order[source]->metadata.forEachAllocation([&](void* owner, uint32_t) {
+                            auto* allocation = static_cast<DeviceAllocation*>(owner);
+                            if (allocation->movable) {
+                                candidates.push_back(allocation);
+                            }
+                        });
+                        for (DeviceAllocation* allocation : candidates) {
+                            if (moved + allocation->size > maxBytesToMove) {
+                                return moves;
+                            }
+                            for (size_t target = 0; target < source; ++target) {
+                                DeviceAllocation* destination = reserve(*order[target], *allocation);
+                                if (destination) {
+                                    moves.push_back({ allocation, destination, false });
+                                    moved += allocation->size;
+                                    break;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+            return moves;
+        }
+
+        // Takes the moves back with done set on the ones that were carried out. Their destinations become
+        // movable in turn; the rest are released. Blocks emptied by the pass go once the deletion queue
+        // frees the sources.
+        void endDefragmentation(const std::vector<DefragmentationMove>& completed) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (completed.size() != moves.size()) {
+                throw std::runtime_error("Defragmentation moves do not match the running pass!");
+            }
+            std::vector<DefragmentationMove> pass;
+            pass.swap(moves);
+            for (size_t i = 0; i < pass.size(); ++i) {
+                if (pass[i].destination == nullptr) {
+                    continue; // Dropped by free() during the pass
+                }
+                if (completed[i].done) {
+                    pass[i].source->movable = false; // Retired; must not be planned again
+                    pass[i].destination->movable = true;
+                }
+                else {
+                    freeLocked(pass[i].destination);
+                }
+            }
+        }
+
+        // Uncached host-visible memory is usually write-combined: fine to stream into, slow to read back.
+        bool isHostCached(const DeviceAllocation* allocation) const {
+            return (memoryProperties.memoryTypes[allocation->memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != 0;
+        }
+
+        // Host writes to non-coherent memory must be flushed before the GPU reads them.
+        void flush(const DeviceAllocation* allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) {
+            if (isHostCoherent(allocation->memoryTypeIndex)) {
+                return;
+            }
+            VkMappedMemoryRange range = mappedRange(allocation, offset, size);
+            dispatch->vkFlushMappedMemoryRanges(device, 1, &range);
+        }
+
+        void invalidate(const DeviceAllocation* allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) {
+            if (isHostCoherent(allocation->memoryTypeIndex)) {
+                return;
+            }
+            VkMappedMemoryRange range = mappedRange(allocation, offset, size);
+            dispatch->vkInvalidateMappedMemoryRanges(device, 1, &range);
+        }
+
+        // Convenience for the common case of a buffer that owns its own sub-allocation.
+        VkBuffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memoryUsage, DeviceAllocation*& allocation) {
+            VkBufferCreateInfo bufferInfo{};
+            bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.size = size;
+            bufferInfo.usage = usage;
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            VkBuffer buffer;
+            Allocator::ScopedAllocationTag allocationTag("vkCreateBuffer");
+            if (dispatch->vkCreateBuffer(device, &bufferInfo, allocationCallbacks, &buffer) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create buffer!");
+            }
+            allocation = allocateForBuffer(buffer, memoryUsage);
+            return buffer;
+        }
+
+        void destroyBuffer(VkBuffer buffer, DeviceAllocation* allocation) {
+            dispatch->vkDestroyBuffer(device, buffer, allocationCallbacks);
+            free(allocation);
+        }
+
+        // Per-heap budget. With VK_EXT_memory_budget the driver's numbers include other processes and
+        // other allocators in this one; without it we fall back to 80% of the heap and our own usage.
+        std::vector<HeapBudget> queryBudget() {
+            VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+            if (memoryBudgetSupported) {
+                readDriverBudget(budgetProperties);
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            std::vector<HeapBudget> budgets(memoryProperties.memoryHeapCount);
+            for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; ++heap) {
+                HeapBudget& budget = budgets[heap];
+                budget.heapIndex = heap;
+                budget.heapSize = memoryProperties.memoryHeaps[heap].size;
+                budget.blockBytes = heapBlockBytes[heap];
+                budget.allocatedBytes = heapAllocatedBytes[heap];
+                if (memoryBudgetSupported) {
+                    budget.budget = budgetProperties.heapBudget[heap];
+                    budget.usage = budgetProperties.heapUsage[heap];
+                }
+                else {
+                    budget.budget = budget.heapSize * 8 / 10;
+                    budget.usage = budget.blockBytes;
+                }
+            }
+            return budgets;
+        }
+
+        void printBudget() {
+            std::cout << "Device memory budget:" << std::endl;
+            for (const HeapBudget& budget : queryBudget()) {
+                std::cout << " - Heap " << budget.heapIndex << ": usage " << (budget.usage >> 20) << " / " << (budget.budget >> 20)
+                    << " MiB budget (heap " << (budget.heapSize >> 20) << " MiB), blocks " << (budget.blockBytes >> 20)
+                    << " MiB, allocated " << (budget.allocatedBytes >> 20) << " MiB" << std::endl;
+            }
+        }
+
+        const VkPhysicalDeviceMemoryProperties& properties() const { return memoryProperties; }
+        VkDevice getDevice() const { return device; }
+        VkDeviceSize minStorageBufferOffsetAlignment() const { return storageBufferAlignment; }
+
+    private:
+        struct Pool {
+            uint32_t memoryTypeIndex = 0;
+            VkDeviceSize blockSize = kDefaultBlockSize;
+            std::vector<std::unique_ptr<MemoryBlock>> blocks;
+        };
+
+        static int countBits(uint32_t value) {
+            int count = 0;
+            for (; value; value &= value - 1) {
+                ++count;
+            }
+            return count;
+        }
+
+        bool isHostVisible(uint32_t type) const {
+            return (memoryProperties.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+        }
+
+        bool isHostCoherent(uint32_t type) const {
+            return (memoryProperties.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+        }
+
+        uint32_t selectMemoryType(uint32_t typeBits, MemoryUsage usage) const {
+            switch (usage) {
+            case MemoryUsage::Upload:
+                return findMemoryType(typeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            case MemoryUsage::Readback:
+                return findMemoryType(typeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                    VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            default:
+                return findMemoryType(typeBits, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+            }
+        }
+
+        void readDriverBudget(VkPhysicalDeviceMemoryBudgetPropertiesEXT& budgetProperties) const {
+            budgetProperties = {};
+            budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+            VkPhysicalDeviceMemoryProperties2 properties2{};
+            properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+            properties2.pNext = &budgetProperties;
+            vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties2);
+        }
+
+        // New VkDeviceMemory is refused once it would push the heap past its budget, so the caller falls
+        // back to another memory type instead of the driver paging or failing later.
+        bool withinBudget(uint32_t type, VkDeviceSize size) const {
+            uint32_t heap = memoryProperties.memoryTypes[type].heapIndex;
+            if (memoryBudgetSupported) {
+                VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties;
+                readDriverBudget(budgetProperties);
+                return budgetProperties.heapUsage[heap] + size <= budgetProperties.heapBudget[heap];
+            }
+            return heapBlockBytes[heap] + size <= memoryProperties.memoryHeaps[heap].size * 8 / 10;
+        }
+
+        VkDeviceMemory allocateMemory(uint32_t type, VkDeviceSize size, const void* pNext) {
+            if (allocationCount >= maxAllocationCount || !withinBudget(type, size)) {
+                return VK_NULL_HANDLE;
+            }
+            VkMemoryAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocInfo.pNext = pNext;
+            allocInfo.allocationSize = size;
+            allocInfo.memoryTypeIndex = type;
+
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            Allocator::ScopedAllocationTag allocationTag("vkAllocateMemory");
+            if (dispatch->vkAllocateMemory(device, &allocInfo, allocationCallbacks, &memory) != VK_SUCCESS) {
+                return VK_NULL_HANDLE;
+            }
+            ++allocationCount;
+            heapBlockBytes[memoryProperties.memoryTypes[type].heapIndex] += size;
+            return memory;
+        }
+
+        void freeMemory(VkDeviceMemory memory) {
+            dispatch->vkFreeMemory(device, memory, allocationCallbacks);
+            --allocationCount;
+        }
+
+        void* mapIfHostVisible(uint32_t type, VkDeviceMemory memory) {
+            void* mapped = nullptr;
+            if (isHostVisible(type) && dispatch->vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+                mapped = nullptr;
+            }
+            return mapped;
+        }
+
+        DeviceAllocation* allocateDedicated(uint32_t type, VkDeviceSize size, VkBuffer buffer, VkImage image) {
+            VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+            dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+            dedicatedInfo.buffer = buffer;
+            dedicatedInfo.image = image;
+            bool useDedicatedInfo = buffer != VK_NULL_HANDLE || image != VK_NULL_HANDLE;
+
+            VkDeviceMemory memory = allocateMemory(type, size, useDedicatedInfo ? &dedicatedInfo : nullptr);
+            if (memory == VK_NULL_HANDLE) {
+                return nullptr;
+            }
+            auto* allocation = new DeviceAllocation();
+            allocation->memory = memory;
+            allocation->size = size;
+            allocation->memoryTypeIndex = type;
+            allocation->mapped = mapIfHostVisible(type, memory);
+            dedicated.push_back(allocation);
+            heapAllocatedBytes[memoryProperties.memoryTypes[type].heapIndex] += size;
+            return allocation;
+        }
+
+        DeviceAllocation* allocateFromPool(Pool& pool, uint32_t type, VkDeviceSize size, VkDeviceSize alignment) {
+            auto* allocation = new DeviceAllocation();
+            MemoryBlock* block = nullptr;
+            VkDeviceSize offset = 0;
+            uint32_t node = TlsfMetadata::kNull;
+            for (auto& candidate : pool.blocks) {
+                if (candidate->metadata.size() - candidate->metadata.used() >= size &&
+                    candidate->metadata.allocate(size, alignment, allocation, node, offset)) {
+                    block = candidate.get();
+                    break;
+                }
+            }
+            if (block == nullptr) {
+                VkDeviceMemory memory = allocateMemory(type, pool.blockSize, nullptr);
+                if (memory == VK_NULL_HANDLE) {
+                    delete allocation;
+                    return nullptr;
+                }
+                pool.blocks.push_back(std::make_unique<MemoryBlock>());
+                block = pool.blocks.back().get();
+                block->memory = memory;
+                block->mapped = mapIfHostVisible(type, memory);
+                block->metadata.init(pool.blockSize);
+                block->metadata.allocate(size, alignment, allocation, node, offset);
+            }
+            allocation->memory = block->memory;
+            allocation->offset = offset;
+            allocation->size = size;
+            allocation->memoryTypeIndex = type;
+            allocation->mapped = block->mapped ? static_cast<char*>(block->mapped) + offset : nullptr;
+            allocation->block = block;
+            allocation->node = node;
+            allocation->alignment = alignment;
+            heapAllocatedBytes[memoryProperties.memoryTypes[type].heapIndex] += size;
+            return allocation;
+        }
+
+        void freeLocked(DeviceAllocation* allocation) {
+            for (DefragmentationMove& move : moves) {
+                if (move.destination == allocation) {
+                    move.source = nullptr;
+                    move.destination = nullptr;
+                }
+                else if (move.source == allocation) {
+                    // The reserved range has no owner left to move into it
+                    DeviceAllocation* destination = move.destination;
+                    move.source = nullptr;
+                    move.destination = nullptr;
+                    if (destination) {
+                        freeLocked(destination);
+                    }
+                }
+            }
+            uint32_t heap = memoryProperties.memoryTypes[allocation->memoryTypeIndex].heapIndex;
+            heapAllocatedBytes[heap] -= allocation->size;
+            if (allocation->block == nullptr) {
+                heapBlockBytes[heap] -= allocation->size;
+                freeMemory(allocation->memory);
+                dedicated.erase(std::find(dedicated.begin(), dedicated.end(), allocation));
+                delete allocation;
+                return;
+            }
+            MemoryBlock* block = allocation->block;
+            block->metadata.release(allocation->node);
+            Pool& pool = pools[allocation->memoryTypeIndex][static_cast<uint32_t>(allocation->kind)];
+            delete allocation;
+            releaseEmptyBlocks(pool);
+        }
+
+        // Reserves a range for source's contents in block; null when it does not fit.
+        DeviceAllocation* reserve(MemoryBlock& block, const DeviceAllocation& source) {
+            if (block.metadata.size() - block.metadata.used() < source.size) {
+                return nullptr;
+            }
+            auto* destination = new DeviceAllocation();
+            VkDeviceSize offset = 0;
+            uint32_t node = TlsfMetadata::kNull;
+            if (!block.metadata.allocate(source.size, source.alignment, destination, node, offset)) {
+                delete destination;
+                return nullptr;
+            }
+            destination->memory = block.memory;
+            destination->offset = offset;
+            destination->size = source.size;
+            destination->mapped = block.mapped ? static_cast<char*>(block.mapped) + offset : nullptr;
+            destination->memoryTypeIndex = source.memoryTypeIndex;
+            destination->alignment = source.alignment;
+            destination->userData = source.userData;
+            destination->block = &block;
+            destination->node = node;
+            destination->kind = source.kind;
+            heapAllocatedBytes[memoryProperties.memoryTypes[source.memoryTypeIndex].heapIndex] += source.size;
+            return destination;
+        }
+
+        // Keeps one empty block per pool around so a free/alloc pair at a block boundary doesn't thrash
+        // vkAllocateMemory.
+        void releaseEmptyBlocks(Pool& pool) {
+            bool keptOne = false;
+            for (auto it = pool.blocks.begin(); it != pool.blocks.end();) {
+                if (!(*it)->metadata.empty()) {
+                    ++it;
+                    continue;
+                }
+                if (!keptOne) {
+                    keptOne = true;
+                    ++it;
+                    continue;
+                }
+                heapBlockBytes[memoryProperties.memoryTypes[pool.memoryTypeIndex].heapIndex] -= (*it)->metadata.size();
+                freeMemory((*it)->memory);
+                it = pool.blocks.erase(it);
+            }
+        }
+
+        VkMappedMemoryRange mappedRange(const DeviceAllocation* allocation, VkDeviceSize offset, VkDeviceSize size) const {
+            VkMappedMemoryRange range{};
+            range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+            range.memory = allocation->memory;
+            VkDeviceSize begin = allocation->offset + offset;
+            VkDeviceSize end = size == VK_WHOLE_SIZE ? allocation->offset + allocation->size : begin + size;
+            range.offset = begin / nonCoherentAtomSize * nonCoherentAtomSize;
+            range.size = alignDeviceSize(end - range.offset, nonCoherentAtomSize);
+            if (allocation->block && range.offset + range.size > allocation->block->metadata.size()) {
+                range.size = VK_WHOLE_SIZE;
+            }
+            return range;
+        }
+
+        VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+        const DeviceDispatch* dispatch = nullptr;
+        VkDevice device = VK_NULL_HANDLE;
+        const VkAllocationCallbacks* allocationCallbacks = nullptr;
+        bool memoryBudgetSupported = false;
+        VkPhysicalDeviceMemoryProperties memoryProperties{};
+        uint32_t maxAllocationCount = 4096;
+        uint32_t allocationCount = 0;
+        VkDeviceSize nonCoherentAtomSize = 1;
+        VkDeviceSize storageBufferAlignment = 16;
+
+        std::mutex mutex;
+        std::vector<std::array<Pool, 2>> pools;   // [memoryType][ResourceKind]
+        std::vector<DeviceAllocation*> dedicated;
+        std::vector<DefragmentationMove> moves;   // the running defragmentation pass
+        std::vector<VkDeviceSize> heapBlockBytes;
+        std::vector<VkDeviceSize> heapAllocatedBytes;
+    };
+
+    // Per-frame bump allocator for uniform/dynamic data: one persistently mapped buffer split into
+    // frameCount regions. beginFrame() rewinds the region of a frame whose GPU work has completed.
+    class LinearFrameAllocator {
+    public:
+        struct Slice {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkDeviceSize offset = 0;
+            void* mapped = nullptr;
+        };
+
+        void init(DeviceMemoryAllocator& memory, VkDeviceSize bytesPerFrame, uint32_t frameCount, VkBufferUsageFlags usage, VkDeviceSize alignment) {
+            this->memory = &memory;
+            this->bytesPerFrame = alignDeviceSize(bytesPerFrame, alignment);
+            this->alignment = alignment;
+            buffer = memory.createBuffer(this->bytesPerFrame * frameCount, usage, MemoryUsage::Upload, allocation);
+            if (allocation->mapped == nullptr) {
+                throw std::runtime_error("Per-frame linear allocator needs host-visible memory!");
+            }
+        }
+
+        void destroy() {
+            if (buffer != VK_NULL_HANDLE) {
+                memory->destroyBuffer(buffer, allocation);
+                buffer = VK_NULL_HANDLE;
+                allocation = nullptr;
+            }
+        }
+
+        void beginFrame(uint32_t frameIndex) {
+            frameBase = bytesPerFrame * frameIndex;
+            cursor = 0;
+        }
+
+        // Returns false once the frame's region is exhausted; callers should size bytesPerFrame for the
+        // worst frame rather than silently spill into the next frame's data.
+        bool allocate(VkDeviceSize size, Slice& out) {
+            VkDeviceSize offset = alignDeviceSize(cursor, alignment);
+            if (offset + size > bytesPerFrame) {
+                return false;
+            }
+            cursor = offset + size;
+            out.buffer = buffer;
+            out.offset = frameBase + offset;
+            out.mapped = static_cast<char*>(allocation->mapped) + out.offset;
+            return true;
+        }
+
+        void flush() {
+            if (cursor > 0) {
+                memory->flush(allocation, frameBase, cursor);
+            }
+        }
+
+    private:
+        DeviceMemoryAllocator* memory = nullptr;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        DeviceAllocation* allocation = nullptr;
+        VkDeviceSize bytesPerFrame = 0;
+        VkDeviceSize alignment = 256;
+        VkDeviceSize frameBase = 0;
+        VkDeviceSize cursor = 0;
+    };
+
+} // namespace vulkan
@@ -0,0 +1,317 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "VulkanDispatch.hpp"
+
+namespace vulkan {
+
+    // What a physical device must offer to be usable at all.
+    struct DeviceRequirements {
+        uint32_t minApiVersion = VK_API_VERSION_1_3;
+        std::vector<const char*> extensions;
+        VkSurfaceKHR surface = VK_NULL_HANDLE;   // null for headless runs
+    };
+
+    inline bool supportsDeviceExtension(const std::vector<VkExtensionProperties>& available, const char* name) {
+        for (const auto& extension : available) {
+            if (std::strcmp(extension.extensionName, name) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline std::vector<VkExtensionProperties> enumerateDeviceExtensions(VkPhysicalDevice device) {
+        uint32_t count = 0;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &count, nullptr);
+        std::vector<VkExtensionProperties> extensions(count);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &count, extensions.data());
+        return extensions;
+    }
+
+    inline std::vector<VkQueueFamilyProperties> queryQueueFamilies(VkPhysicalDevice device) {
+        uint32_t count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &count, nullptr);
+        std::vector<VkQueueFamilyProperties> families(count);
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &count, families.data());
+        return families;
+    }
+
+    // Higher is better; negative means the device cannot run the app. Device type dominates, then
+    // device-local memory, then limits, with a bonus for dedicated compute/transfer families.
+    inline int64_t scorePhysicalDevice(VkPhysicalDevice device, const DeviceRequirements& requirements) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(device, &properties);
+        if (properties.apiVersion < requirements.minApiVersion) {
+            return -1;
+        }
+
+        std::vector<VkExtensionProperties> extensions = enumerateDeviceExtensions(device);
+        for (const char* extension : requirements.extensions) {
+            if (!supportsDeviceExtension(extensions, extension)) {
+                return -1;
+            }
+        }
+
+        bool hasGraphics = false;
+        bool hasPresent = requirements.surface == VK_NULL_HANDLE;
+        bool hasAsyncCompute = false;
+        bool hasTransferOnly = false;
+        std::vector<VkQueueFamilyProperties> families = queryQueueFamilies(device);
+        for (uint32_t i = 0; i < families.size(); i++) {
+            VkQueueFlags flags = families[i].queueFlags;
+            hasGraphics |= (flags & VK_QUEUE_GRAPHICS_BIT) != 0;
+            hasAsyncCompute |= (flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT);
+            hasTransferOnly |= (flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+            if (requirements.surface != VK_NULL_HANDLE && !hasPresent) {
+                VkBool32 presentSupport = VK_FALSE;
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, requirements.surface, &presentSupport);
+                hasPresent = presentSupport == VK_TRUE;
+            }
+        }
+        if (!hasGraphics || !hasPresent) {
+            return -1;
+        }
+
+        int64_t score = 0;
+        switch (properties.deviceType) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: score += 1000000; break;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: score += 500000; break;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: score += 250000; break;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU: score += 1000; break;
+        default: break;
+        }
+
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
+        VkDeviceSize deviceLocalBytes = 0;
+        for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; heap++) {
+            if (memoryProperties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+                deviceLocalBytes += memoryProperties.memoryHeaps[heap].size;
+            }
+        }
+        score += static_cast<int64_t>(deviceLocalBytes >> 26) * 100;          // 100 per 64 MiB
+        score += properties.limits.maxImageDimension2D / 16;
+        score += hasAsyncCompute ? 20000 : 0;
+        score += hasTransferOnly ? 10000 : 0;
+        return score;
+    }
+
+    // Picks the best-scoring device. The override (a 0-based index, or a substring of the device name)
+    // comes from AppConfig::device or VKL_DEVICE and wins as long as the device is usable.
+    inline uint32_t selectPhysicalDevice(const std::vector<VkPhysicalDevice>& devices, const DeviceRequirements& requirements, const std::string& overrideSelector) {
+        std::string selector = overrideSelector;
+        if (selector.empty()) {
+            if (const char* env = std::getenv("VKL_DEVICE")) {
+                selector = env;
+            }
+        }
+        bool isIndex = !selector.empty() && selector.find_first_not_of("0123456789") == std::string::npos;
+        uint32_t selectedIndex = UINT32_MAX;
+        if (isIndex) {
+            // Out-of-range digits simply match no device
+            selectedIndex = selector.size() <= 9 ? static_cast<uint32_t>(std::strtoul(selector.c_str(), nullptr, 10)) : UINT32_MAX;
+        }
+
+        uint32_t best = UINT32_MAX;
+        int64_t bestScore = -1;
+        bool matchedUnusable = false;
+        for (uint32_t i = 0; i < devices.size(); i++) {
+            int64_t score = scorePhysicalDevice(devices[i], requirements);
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(devices[i], &properties);
+            std::cout << "Device " << i << " (" << properties.deviceName << ") score: " << score << std::endl;
+            bool matches = !selector.empty() && (isIndex ? selectedIndex == i : std::strstr(properties.deviceName, selector.c_str()) != nullptr);
+            if (score < 0) {
+                matchedUnusable |= matches;
+                continue;
+            }
+            if (matches) {
+                return i;
+            }
+            if (score > bestScore) {
+                best = i;
+                bestScore = score;
+            }
+        }
+        if (best == UINT32_MAX) {
+            throw std::runtime_error("Failed to find a suitable GPU!");
+        }
+        if (!selector.empty()) {
+            std::cout << "Warning: device override \"" << selector << "\" "
+                << (matchedUnusable ? "only matched devices that lack required features" : "matched no device")
+                << ", using the best score." << std::endl;
+        }
+        return best;
+    }
+
+    enum class QueueRole {
+        Graphics,
+        Present,
+        Compute,    // async compute: a family without graphics when the device has one
+        Transfer    // copy-only family when the device has one
+    };
+
+    // One VkQueue the engine can submit to. Several roles can share a queue (e.g. present and graphics
+    // on most desktop drivers); the mutex is shared with it, since vkQueueSubmit on one VkQueue must be
+    // externally synchronized.
+    struct QueueHandle {
+        VkQueue queue = VK_NULL_HANDLE;
+        uint32_t family = UINT32_MAX;
+        uint32_t index = 0;
+        float priority = 1.0f;
+        std::mutex* mutex = nullptr;
+
+        bool dedicatedFrom(const QueueHandle& other) const {
+            return queue != other.queue;
+        }
+    };
+
+    // The queues created on the logical device, plus what vkCreateDevice needs to create them.
+    class QueueSet {
+    public:
+        QueueHandle graphics;
+        QueueHandle present;
+        QueueHandle compute;
+        QueueHandle transfer;
+
+        // Chooses families and queue indices for every role. Dedicated compute/transfer families are
+        // preferred; otherwise a second queue of the graphics family is used when it has one.
+        void plan(VkPhysicalDevice device, VkSurfaceKHR surface) {
+            families = queryQueueFamilies(device);
+            uint32_t graphicsFamily = UINT32_MAX;
+            uint32_t presentFamily = UINT32_MAX;
+            uint32_t computeFamily = UINT32_MAX;
+            uint32_t transferFamily = UINT32_MAX;
+
+            for (uint32_t i = 0; i < families.size(); i++) {
+                VkQueueFlags flags = families[i].queueFlags;
+                VkBool32 presentSupport = VK_FALSE;
+                if (surface != VK_NULL_HANDLE) {
+                    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+                }
+                if ((flags & VK_QUEUE_GRAPHICS_BIT) && (graphicsFamily == UINT32_MAX || (presentSupport && presentFamily != graphicsFamily))) {
+                    graphicsFamily = i;
+                    if (presentSupport) {
+                        presentFamily = i; // Prefer one family for both to avoid concurrent sharing
+                    }
+                }
+                if (presentSupport && presentFamily == UINT32_MAX) {
+                    presentFamily = i;
+                }
+                if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && computeFamily == UINT32_MAX) {
+                    computeFamily = i;
+                }
+                if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) && transferFamily == UINT32_MAX) {
+                    transferFamily = i;
+                }
+            }
+            if (graphicsFamily == UINT32_MAX || (surface != VK_NULL_HANDLE && presentFamily == UINT32_MAX)) {
+                throw std::runtime_error("Failed to find suitable queue families!");
+            }
+            if (surface == VK_NULL_HANDLE) {
+                presentFamily = graphicsFamily; // Headless: nothing is presented
+            }
+
+            priorities.clear();
+            graphics = reserve(graphicsFamily, 1.0f, true);
+            present = presentFamily == graphicsFamily ? graphics : reserve(presentFamily, 1.0f, true);
+            compute = reserve(computeFamily != UINT32_MAX ? computeFamily : graphicsFamily, 0.75f, false);
+            transfer = reserve(transferFamily != UINT32_MAX ? transferFamily : (computeFamily != UINT32_MAX ? computeFamily : graphicsFamily), 0.5f, false);
+        }
+
+        // Must outlive the vkCreateDevice call: pQueuePriorities points into this object.
+        std::vector<VkDeviceQueueCreateInfo> createInfos() const {
+            std::vector<VkDeviceQueueCreateInfo> infos;
+            for (const auto& entry : priorities) {
+                VkDeviceQueueCreateInfo queueCreateInfo{};
+                queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+                queueCreateInfo.queueFamilyIndex = entry.first;
+                queueCreateInfo.queueCount = static_cast<uint32_t>(entry.second.size());
+                queueCreateInfo.pQueuePriorities = entry.second.data();
+                infos.push_back(queueCreateInfo);
+            }
+            return infos;
+        }
+
+        // Submits and presents go through the device's dispatch table from here on.
+        void resolve(const DeviceDispatch& dispatch) {
+            this->dispatch = &dispatch;
+            mutexes.clear();
+            std::map<std::pair<uint32_t, uint32_t>, std::mutex*> shared;
+            for (QueueHandle* handle : { &graphics, &present, &compute, &transfer }) {
+                dispatch.vkGetDeviceQueue(dispatch.device, handle->family, handle->index, &handle->queue);
+                auto key = std::make_pair(handle->family, handle->index);
+                if (shared.find(key) == shared.end()) {
+                    mutexes.emplace_back();
+                    shared[key] = &mutexes.back();
+                }
+                handle->mutex = shared[key];
+            }
+        }
+
+        QueueHandle& get(QueueRole role) {
+            switch (role) {
+            case QueueRole::Present: return present;
+            case QueueRole::Compute: return compute;
+            case QueueRole::Transfer: return transfer;
+            default: return graphics;
+            }
+        }
+
+        VkResult submit(QueueRole role, uint32_t submitCount, const VkSubmitInfo* submits, VkFence fence) {
+            QueueHandle& handle = get(role);
+            std::lock_guard<std::mutex> lock(*handle.mutex);
+            return dispatch->vkQueueSubmit(handle.queue, submitCount, submits, fence);
+        }
+
+        VkResult presentImage(const VkPresentInfoKHR* presentInfo) {
+            std::lock_guard<std::mutex> lock(*present.mutex);
+            return dispatch->vkQueuePresentKHR(present.queue, presentInfo);
+        }
+
+        void print() const {
+            auto describe = [](const char* name, const QueueHandle& handle) {
+                std::cout << " - " << name << ": family " << handle.family << ", queue " << handle.index
+                    << ", priority " << handle.priority << std::endl;
+            };
+            std::cout << "Queues:" << std::endl;
+            describe("Graphics", graphics);
+            describe("Present", present);
+            describe("Compute", compute);
+            describe("Transfer", transfer);
+        }
+
+    private:
+        // Hands out the next unused queue of a family, or shares the last one once it runs out.
+        QueueHandle reserve(uint32_t family, float priority, bool shareFirst) {
+            std::vector<float>& familyPriorities = priorities[family];
+            QueueHandle handle;
+            handle.family = family;
+            if (!familyPriorities.empty() && (shareFirst || familyPriorities.size() >= families[family].queueCount)) {
+                handle.index = shareFirst ? 0 : static_cast<uint32_t>(familyPriorities.size() - 1);
+                handle.priority = familyPriorities[handle.index];
+                return handle;
+            }
+            handle.index = static_cast<uint32_t>(familyPriorities.size());
+            handle.priority = priority;
+            familyPriorities.push_back(priority);
+            return handle;
+        }
+
+        const DeviceDispatch* dispatch = nullptr;
+        std::vector<VkQueueFamilyProperties> families;
+        std::map<uint32_t, std::vector<float>> priorities;
+        std::deque<std::mutex> mutexes;
+    };
+
+} // namespace vulkan
@@ -0,0 +1,487 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "DeferredDeletion.hpp"
+#include "Descriptors.hpp"
+#include "DeviceMemory.hpp"
+#include "JobSystem.hpp"
+#include "PipelineCache.hpp"
+#include "RenderGraph.hpp"
+#include "SceneMath.hpp"
+#include "ShaderSystem.hpp"
+#include "VulkanDispatch.hpp"
+
+namespace vulkan {
+
+    // Mirrors the push constant block of shaders/cull.comp; fills the whole 128-byte range.
+    struct CullPushConstants {
+        float planes[6][4];
+        uint32_t objectCount;
+        uint32_t capacity;
+        uint32_t boundsBuffer;
+        uint32_t commandBuffer;
+        uint32_t countBuffer;
+        uint32_t instanceBuffer;
+        uint32_t clearCount;
+        uint32_t pad;
+    };
+    static_assert(sizeof(CullPushConstants) == 128, "CullPushConstants must match cull.comp");
+
+    // Mirrors the push constant block of shaders/cull_draw.vert.
+    struct CullDrawPushConstants {
+        float viewProjection[16];
+        uint32_t instanceBuffer;
+    };
+
+    // Range of the shared index buffer one object draws.
+    struct CullMesh {
+        uint32_t indexCount = 0;
+        uint32_t firstIndex = 0;
+        int32_t vertexOffset = 0;
+    };
+
+    // GPU-driven drawing: object bounds live in SoA storage buffers, a compute pass frustum-culls
+    // them and compacts the survivors into an indirect command buffer plus a count, and the graphics
+    // pass draws everything with one vkCmdDrawIndexedIndirectCount. The CPU cost of a frame no longer
+    // depends on how many objects there are.
+    //
+    // Culling runs as AsyncCompute render graph passes, so it overlaps the previous frame's graphics
+    // work on devices with a dedicated compute queue. Everything is addressed through the bindless
+    // table and the shared pipeline layout. There is no scene geometry yet, so every object draws the
+    // built-in cube (cubeMesh()).
+    class GpuCulling {
+    public:
+        static constexpr uint32_t WorkgroupSize = 64;   // local_size_x of cull.comp
+
+        struct Outputs {
+            RenderResource commands = InvalidRenderResource;
+            RenderResource count = InvalidRenderResource;
+            RenderResource instances = InvalidRenderResource;
+        };
+
+        // Returns false (and stays disabled) when one of its shaders fails to build.
+        bool init(DeviceMemoryAllocator& memory, const DeviceDispatch& dispatch, const VkAllocationCallbacks* callbacks,
+            DeletionQueue& deletion, BindlessTable& bindless, ShaderSystem& shaders, Jobs::JobSystem& jobs, VkPipelineLayout pipelineLayout,
+            PipelineCacheService& pipelineCache, VkFormat colorFormat, uint32_t capacity, uint32_t frameCount) {
+            this->memory = &memory;
+            this->dispatch = &dispatch;
+            this->callbacks = callbacks;
+            this->deletion = &deletion;
+            this->bindless = &bindless;
+            this->shaders = &shaders;
+            this->jobs = &jobs;
+            this->pipelineLayout = pipelineLayout;
+            this->pipelineCache = &pipelineCache;
+            this->colorFormat = colorFormat;
+            this->capacity = std::max(capacity, 1u);
+
+            // All three compile in parallel; buildPipelines() waits for them
+            cullShader = shaders.request({ "cull.comp" });
+            vertexShader = shaders.request({ "cull_draw.vert" });
+            fragmentShader = shaders.request({ "cull_draw.frag" });
+            if (!buildPipelines()) {
+                std::cout << "GPU culling disabled: its shaders failed to build." << std::endl;
+                return false;
+            }
+
+            createIndexBuffer();
+            objects.resize(this->capacity * BoundsArrays);
+            frames.resize(std::max(frameCount, 1u));
+            boundsRing.init(memory, boundsBytes(), static_cast<uint32_t>(frames.size()), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                std::max<VkDeviceSize>(memory.minStorageBufferOffsetAlignment(), 16));
+            for (uint32_t i = 0; i < frames.size(); i++) {
+                Frame& frame = frames[i];
+                // Each slot's bounds are the first (and only) slice of its frame region, so the
+                // descriptor written here stays valid for every frame that slot records
+                LinearFrameAllocator::Slice bounds = allocateBounds(i);
+                frame.boundsSlot = bindless.addBuffer(bounds.buffer, bounds.offset, boundsBytes());
+                frame.commandSlot = bindless.reserve(BindlessKind::StorageBuffer);
+                frame.countSlot = bindless.reserve(BindlessKind::StorageBuffer);
+                frame.instanceSlot = bindless.reserve(BindlessKind::StorageBuffer);
+                if (frame.boundsSlot == InvalidBindlessIndex || frame.instanceSlot == InvalidBindlessIndex) {
+                    throw std::runtime_error("Bindless table has no room for GPU culling buffers!");
+                }
+            }
+            std::cout << "GPU culling: up to " << this->capacity << " objects, " << frames.size() << " frame slots." << std::endl;
+            return true;
+        }
+
+        // Expects the device to be idle.
+        void destroy() {
+            if (!enabled()) {
+                return;
+            }
+            uint64_t lastUse = deletion->lastSubmitted();
+            boundsRing.destroy();
+            for (Frame& frame : frames) {
+                for (uint32_t slot : { frame.boundsSlot, frame.commandSlot, frame.countSlot, frame.instanceSlot }) {
+                    bindless->release(BindlessKind::StorageBuffer, slot);
+                }
+            }
+            frames.clear();
+            deletion->retire(indexBuffer, indexAllocation, lastUse);
+            deletion->retire(cullPipeline, lastUse);
+            deletion->retire(drawPipeline, lastUse);
+            indexBuffer = VK_NULL_HANDLE;
+            cullPipeline = VK_NULL_HANDLE;
+            drawPipeline = VK_NULL_HANDLE;
+        }
+
+        bool enabled() const {
+            return cullPipeline != VK_NULL_HANDLE;
+        }
+
+        // Call when ShaderSystem::poll() reports a reload; rebuilds the pipelines if one of ours changed.
+        void reloadPipelines() {
+            if (enabled() && shaderVersions() != builtVersions && buildPipelines()) {
+                std::cout << "GPU culling: pipelines rebuilt from reloaded shaders." << std::endl;
+            }
+        }
+
+        // The draw pipeline bakes in the attachment format, so a swapchain format change rebuilds it.
+        void setColorFormat(VkFormat format) {
+            if (!enabled() || format == colorFormat) {
+                return;
+            }
+            colorFormat = format;
+            if (!buildPipelines()) {
+                // Shaders not ready; reloadPipelines() retries once they are
+                builtVersions = ~0ull;
+            }
+        }
+
+        // 36 indices whose values are cube corners (bit 0 = +x, bit 1 = +y, bit 2 = +z).
+        CullMesh cubeMesh() const {
+            return { 36, 0, 0 };
+        }
+
+        void setObjectCount(uint32_t count) {
+            objectCount = std::min(count, capacity);
+            version++;
+        }
+
+        void setObject(uint32_t index, const float center[3], float radius, const CullMesh& mesh) {
+            if (index >= capacity) {
+                throw std::runtime_error("GPU culling object index out of range!");
+            }
+            std::memcpy(&objects[index], &center[0], sizeof(float));
+            std::memcpy(&objects[capacity + index], &center[1], sizeof(float));
+            std::memcpy(&objects[2 * capacity + index], &center[2], sizeof(float));
+            std::memcpy(&objects[3 * capacity + index], &radius, sizeof(float));
+            objects[4 * capacity + index] = mesh.indexCount;
+            objects[5 * capacity + index] = mesh.firstIndex;
+            objects[6 * capacity + index] = static_cast<uint32_t>(mesh.vertexOffset);
+            version++;
+        }
+
+        void setViewProjection(const float matrix[16]) {
+            std::memcpy(viewProjection, matrix, sizeof(viewProjection));
+            extractFrustumPlanes(viewProjection, planes);
+        }
+
+        // Adds the count reset and the cull pass. The returned buffers are what the drawing pass must
+        // read: commands and count as IndirectRead, instances as StorageRead.
+        Outputs addPasses(RenderGraph& graph) {
+            graph.addPass("ResetDrawCount", PassKind::AsyncCompute, [this](RenderPassBuilder& pass) {
+                outputs.count = pass.createBuffer("DrawCount", { sizeof(uint32_t) });
+                pass.write(outputs.count, ResourceUsage::StorageWrite);
+            }, [this](RenderPassContext& context) {
+                bindFrame(context, outputs.count);
+                recordDispatch(context.commandBuffer, context.frameIndex, true);
+            });
+            graph.addPass("Cull", PassKind::AsyncCompute, [this](RenderPassBuilder& pass) {
+                outputs.commands = pass.createBuffer("DrawCommands", { capacity * sizeof(VkDrawIndexedIndirectCommand) });
+                outputs.instances = pass.createBuffer("VisibleInstances", { capacity * VisibleInstanceBytes });
+                pass.write(outputs.count, ResourceUsage::StorageWrite);
+                pass.write(outputs.commands, ResourceUsage::StorageWrite);
+                pass.write(outputs.instances, ResourceUsage::StorageWrite);
+            }, [this](RenderPassContext& context) {
+                bindFrame(context, outputs.count, outputs.commands, outputs.instances);
+                uploadBounds(context.frameIndex);
+                recordDispatch(context.commandBuffer, context.frameIndex, false);
+            });
+            return outputs;
+        }
+
+        // Records into a command buffer inside the drawing pass (a secondary is fine: it binds
+        // everything it uses). Uses the buffers the cull pass resolved for frameIndex.
+        void recordDraws(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkExtent2D extent) const {
+            const Frame& frame = frames[frameIndex % frames.size()];
+            if (frame.commands == VK_NULL_HANDLE) {
+                return;
+            }
+            bindless->bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout);
+            dispatch->vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, drawPipeline);
+            VkViewport viewport{ 0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f };
+            VkRect2D scissor{ { 0, 0 }, extent };
+            dispatch->vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+            dispatch->vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+            CullDrawPushConstants constants{};
+            std::memcpy(constants.viewProjection, viewProjection, sizeof(viewProjection));
+            constants.instanceBuffer = frame.instanceSlot;
+            dispatch->vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(constants), &constants);
+            dispatch->vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+            dispatch->vkCmdDrawIndexedIndirectCount(commandBuffer, frame.commands, 0, frame.count, 0, objectCount,
+                sizeof(VkDrawIndexedIndirectCommand));
+        }
+
+    private:
+        // Bounds buffer: centerX, centerY, centerZ, radius, indexCount, firstIndex, vertexOffset
+        static constexpr uint32_t BoundsArrays = 7;
+        static constexpr VkDeviceSize VisibleInstanceBytes = 32;   // VisibleInstance in the shaders
+
+        struct Frame {
+            uint64_t boundsVersion = 0;
+            uint32_t boundsSlot = InvalidBindlessIndex;
+            uint32_t commandSlot = InvalidBindlessIndex;
+            uint32_t countSlot = InvalidBindlessIndex;
+            uint32_t instanceSlot = InvalidBindlessIndex;
+            // Graph buffers last written to the slots above; they change when the graph recompiles
+            VkBuffer commands = VK_NULL_HANDLE;
+            VkBuffer count = VK_NULL_HANDLE;
+            VkBuffer instances = VK_NULL_HANDLE;
+        };
+
+        VkDeviceSize boundsBytes() const {
+            return VkDeviceSize(capacity) * BoundsArrays * sizeof(uint32_t);
+        }
+
+        uint64_t shaderVersions() const {
+            return shaders->version(cullShader) + shaders->version(vertexShader) + shaders->version(fragmentShader);
+        }
+
+        // Replaced pipelines go through the deletion queue, since frames in flight may still use them.
+        bool buildPipelines() {
+            VkShaderModule cullModule = shaders->module(cullShader);
+            VkShaderModule vertexModule = shaders->module(vertexShader);
+            VkShaderModule fragmentModule = shaders->module(fragmentShader);
+            if (cullModule == VK_NULL_HANDLE || vertexModule == VK_NULL_HANDLE || fragmentModule == VK_NULL_HANDLE) {
+                return false;
+            }
+            // Both pipelines compile in parallel on the job system, each thread through its own cache
+            VkPipeline newCullPipeline = VK_NULL_HANDLE;
+            VkPipeline newDrawPipeline = VK_NULL_HANDLE;
+            Jobs::Counter counter;
+            jobs->schedule([this, cullModule, &newCullPipeline]() { newCullPipeline = createCullPipeline(cullModule); }, &counter);
+            jobs->schedule([this, vertexModule, fragmentModule, &newDrawPipeline]() {
+                newDrawPipeline = createDrawPipeline(vertexModule, fragmentModule);
+            }, &counter);
+            try {
+                jobs->wait(counter);
+            }
+            catch (...) {
+                deletion->retire(newCullPipeline);
+                deletion->retire(newDrawPipeline);
+                throw;
+            }
+            deletion->retire(cullPipeline);
+            deletion->retire(drawPipeline);
+            cullPipeline = newCullPipeline;
+            drawPipeline = newDrawPipeline;
+            builtVersions = shaderVersions();
+            return true;
+        }
+
+        VkPipelineCache threadPipelineCache() const {
+            return pipelineCache->threadCache(Jobs::JobSystem::threadIndex());
+        }
+
+        VkPipeline createCullPipeline(VkShaderModule shader) {
+            VkComputePipelineCreateInfo pipelineInfo{};
+            pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            pipelineInfo.stage.module = shader;
+            pipelineInfo.stage.pName = "main";
+            pipelineInfo.layout = pipelineLayout;
+            Allocator::ScopedAllocationTag allocationTag("vkCreateComputePipelines");
+            VkPipeline pipeline;
+            if (dispatch->vkCreateComputePipelines(dispatch->device, threadPipelineCache(), 1, &pipelineInfo, callbacks, &pipeline) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create cull pipeline!");
+            }
+            return pipeline;
+        }
+
+        // Dynamic rendering pipeline for the color target only; viewport and scissor are dynamic so
+        // swapchain resizes do not rebuild it.
+        VkPipeline createDrawPipeline(VkShaderModule vertexModule, VkShaderModule fragmentModule) {
+            VkPipelineShaderStageCreateInfo stages[2]{};
+            stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+            stages[0].module = vertexModule;
+            stages[0].pName = "main";
+            stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+            stages[1].module = fragmentModule;
+            stages[1].pName = "main";
+
+            VkPipelineVertexInputStateCreateInfo vertexInput{};
+            vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+            VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+            inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+            inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+            VkPipelineViewportStateCreateInfo viewportState{};
+            viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+            viewportState.viewportCount = 1;
+            viewportState.scissorCount = 1;
+            VkPipelineRasterizationStateCreateInfo rasterizer{};
+            rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+            rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+            rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+            rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+            rasterizer.lineWidth = 1.0f;
+            VkPipelineMultisampleStateCreateInfo multisampling{};
+            multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+            multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+            VkPipelineColorBlendAttachmentState blendAttachment{};
+            blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+            VkPipelineColorBlendStateCreateInfo colorBlend{};
+            colorBlend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+            colorBlend.attachmentCount = 1;
+            colorBlend.pAttachments = &blendAttachment;
+            VkDynamicState dynamicStates[2] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+            VkPipelineDynamicStateCreateInfo dynamicState{};
+            dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+            dynamicState.dynamicStateCount = 2;
+            dynamicState.pDynamicStates = dynamicStates;
+            VkPipelineRenderingCreateInfo renderingInfo{};
+            renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+            renderingInfo.colorAttachmentCount = 1;
+            renderingInfo.pColorAttachmentFormats = &colorFormat;
+
+            VkGraphicsPipelineCreateInfo pipelineInfo{};
+            pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+            pipelineInfo.pNext = &renderingInfo;
+            pipelineInfo.stageCount = 2;
+            pipelineInfo.pStages = stages;
+            pipelineInfo.pVertexInputState = &vertexInput;
+            pipelineInfo.pInputAssemblyState = &inputAssembly;
+            pipelineInfo.pViewportState = &viewportState;
+            pipelineInfo.pRasterizationState = &rasterizer;
+            pipelineInfo.pMultisampleState = &multisampling;
+            pipelineInfo.pColorBlendState = &colorBlend;
+            pipelineInfo.pDynamicState = &dynamicState;
+            pipelineInfo.layout = pipelineLayout;
+            Allocator::ScopedAllocationTag allocationTag("vkCreateGraphicsPipelines");
+            VkPipeline pipeline;
+            if (dispatch->vkCreateGraphicsPipelines(dispatch->device, threadPipelineCache(), 1, &pipelineInfo, callbacks, &pipeline) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create culled draw pipeline!");
+            }
+            return pipeline;
+        }
+
+        // Tiny and written once, so it stays in host-visible memory instead of going through staging.
+        void createIndexBuffer() {
+            // Counter-clockwise seen from outside; the projection's y flip keeps that the front face
+            static const uint16_t indices[36] = {
+                0, 4, 6, 0, 6, 2,   // -x
+                1, 3, 7, 1, 7, 5,   // +x
+                0, 1, 5, 0, 5, 4,   // -y
+                2, 6, 7, 2, 7, 3,   // +y
+                0, 2, 3, 0, 3, 1,   // -z
+                4, 5, 7, 4, 7, 6    // +z
+            };
+            indexBuffer = memory->createBuffer(sizeof(indices), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, MemoryUsage::Upload, indexAllocation);
+            std::memcpy(indexAllocation->mapped, indices, sizeof(indices));
+            memory->flush(indexAllocation);
+        }
+
+        // Points this frame slot's bindless entries at the graph's buffers for the frame. The slot's
+        // previous frame has completed (its fence was waited on), so rewriting them is safe.
+        void bindFrame(const RenderPassContext& context, RenderResource count,
+            RenderResource commands = InvalidRenderResource, RenderResource instances = InvalidRenderResource) {
+            Frame& frame = frames[context.frameIndex % frames.size()];
+            auto rebind = [this, &context](RenderResource resource, VkBuffer& bound, uint32_t slot) {
+                VkBuffer buffer = context.buffer(resource);
+                if (buffer != bound) {
+                    bindless->updateBuffer(slot, buffer, 0, VK_WHOLE_SIZE);
+                    bound = buffer;
+                }
+            };
+            rebind(count, frame.count, frame.countSlot);
+            if (commands != InvalidRenderResource) {
+                rebind(commands, frame.commands, frame.commandSlot);
+                rebind(instances, frame.instances, frame.instanceSlot);
+            }
+        }
+
+        // Host writes are visible to the queue at submit, so the bounds need no barrier.
+        void uploadBounds(uint32_t frameIndex) {
+            Frame& frame = frames[frameIndex % frames.size()];
+            if (frame.boundsVersion == version) {
+                return;
+            }
+            LinearFrameAllocator::Slice bounds = allocateBounds(frameIndex % frames.size());
+            std::memcpy(bounds.mapped, objects.data(), boundsBytes());
+            boundsRing.flush();
+            frame.boundsVersion = version;
+        }
+
+        LinearFrameAllocator::Slice allocateBounds(uint32_t slot) {
+            boundsRing.beginFrame(slot);
+            LinearFrameAllocator::Slice bounds;
+            if (!boundsRing.allocate(boundsBytes(), bounds)) {
+                throw std::runtime_error("GPU culling bounds do not fit their frame region!");
+            }
+            return bounds;
+        }
+
+        void recordDispatch(VkCommandBuffer commandBuffer, uint32_t frameIndex, bool clearCount) {
+            const Frame& frame = frames[frameIndex % frames.size()];
+            // Async passes get their own command buffer, which inherits no bindings
+            bindless->bind(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout);
+            dispatch->vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+            CullPushConstants constants{};
+            std::memcpy(constants.planes, planes, sizeof(planes));
+            constants.objectCount = objectCount;
+            constants.capacity = capacity;
+            constants.boundsBuffer = frame.boundsSlot;
+            constants.commandBuffer = frame.commandSlot;
+            constants.countBuffer = frame.countSlot;
+            constants.instanceBuffer = frame.instanceSlot;
+            constants.clearCount = clearCount ? 1 : 0;
+            dispatch->vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_ALL, 0, sizeof(constants), &constants);
+            uint32_t groups = clearCount ? 1 : (objectCount + WorkgroupSize - 1) / WorkgroupSize;
+            if (groups > 0) {
+                dispatch->vkCmdDispatch(commandBuffer, groups, 1, 1);
+            }
+        }
+
+        DeviceMemoryAllocator* memory = nullptr;
+        const DeviceDispatch* dispatch = nullptr;
+        const VkAllocationCallbacks* callbacks = nullptr;
+        DeletionQueue* deletion = nullptr;
+        BindlessTable* bindless = nullptr;
+        ShaderSystem* shaders = nullptr;
+        ShaderId cullShader = InvalidShader;
+        ShaderId vertexShader = InvalidShader;
+        ShaderId fragmentShader = InvalidShader;
+        uint64_t builtVersions = 0;
+        VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+        PipelineCacheService* pipelineCache = nullptr;
+        Jobs::JobSystem* jobs = nullptr;
+        VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+        VkPipeline cullPipeline = VK_NULL_HANDLE;
+        VkPipeline drawPipeline = VK_NULL_HANDLE;
+        VkBuffer indexBuffer = VK_NULL_HANDLE;
+        DeviceAllocation* indexAllocation = nullptr;
+
+        uint32_t capacity = 0;
+        uint32_t objectCount = 0;
+        std::vector<uint32_t> objects;      // CPU copy of the bounds buffer; floats stored bitwise
+        uint64_t version = 1;               // bumped on every change, compared per frame slot
+        float viewProjection[16]{};
+        float planes[6][4]{};
+        std::vector<Frame> frames;
+        LinearFrameAllocator boundsRing;    // one region of bounds per frame slot
+        Outputs outputs;                    // resources of the passes added by addPasses()
+    };
+
+} // namespace vulkan
@@ -0,0 +1,271 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Jobs {
+
+    // Counts outstanding jobs. Used for frame-scoped waits: schedule a frame's jobs against one
+    // counter, then JobSystem::wait() on it. The first exception thrown by a job is rethrown there.
+    class Counter {
+    public:
+        bool finished() const {
+            return pending.load(std::memory_order_acquire) == 0;
+        }
+
+    private:
+        friend class JobSystem;
+        std::atomic<int32_t> pending{ 0 };
+        std::atomic<bool> failed{ false };
+        std::exception_ptr error;
+    };
+
+    struct Job {
+        std::function<void()> work;
+        Counter* counter = nullptr;
+        std::atomic<int32_t> blockers{ 1 };   // unfinished dependencies, plus one held while scheduling
+        std::mutex mutex;                     // guards finished and continuations
+        bool finished = false;
+        std::vector<std::shared_ptr<Job>> continuations;
+    };
+
+    using JobHandle = std::shared_ptr<Job>;
+
+    // Work-stealing scheduler. Every worker owns a deque: it pushes and pops at the back (LIFO, hot
+    // in cache) while idle workers steal from the front of others. Threads that are not workers
+    // share deque 0. Waiting threads run jobs instead of blocking, so waits inside jobs and on the
+    // main thread cannot deadlock the pool.
+    class JobSystem {
+    public:
+        // workerCount 0 = one worker per hardware thread, minus the calling thread.
+        explicit JobSystem(uint32_t workerCount = 0) {
+            if (workerCount == 0) {
+                workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+            }
+            queues = std::vector<Queue>(workerCount + 1);
+            for (uint32_t i = 1; i <= workerCount; i++) {
+                workers.emplace_back([this, i]() { workerMain(i); });
+            }
+        }
+
+        ~JobSystem() {
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                stopping = true;
+            }
+            wakeCondition.notify_all();
+            for (std::thread& worker : workers) {
+                worker.join();
+            }
+        }
+
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+
+        // Workers plus the threads that share deque 0; valid bound for threadIndex().
+        uint32_t threadCount() const {
+            return static_cast<uint32_t>(queues.size());
+        }
+
+        // 1..N on workers, 0 everywhere else. Lets callers keep per-thread state (e.g. command pools)
+        // without locking.
+        static uint32_t threadIndex() {
+            return currentIndex();
+        }
+
+        // Runs work once every job in dependencies has finished.
+        JobHandle schedule(std::function<void()> work, Counter* counter = nullptr, std::initializer_list<JobHandle> dependencies = {}) {
+            return schedule(std::move(work), counter, dependencies.begin(), dependencies.end());
+        }
+
+        JobHandle schedule(std::function<void()> work, Counter* counter, const std::vector<JobHandle>& dependencies) {
+            return schedule(std::move(work), counter, dependencies.data(), dependencies.data() + dependencies.size());
+        }
+
+        // Splits [0, count) into ranges of at most granularity and runs them in parallel. The jobs
+        // reference body, so it has to outlive wait(counter); a lambda converted in the call does not.
+        void parallelFor(uint32_t count, uint32_t granularity, const std::function<void(uint32_t begin, uint32_t end)>& body, Counter& counter) {
+            granularity = std::max(1u, granularity);
+            for (uint32_t begin = 0; begin < count; begin += granularity) {
+                uint32_t end = std::min(count, begin + granularity);
+                schedule([&body, begin, end]() { body(begin, end); }, &counter);
+            }
+        }
+
+        // Helps execute jobs until the counter drains.
+        void wait(Counter& counter) {
+            while (!counter.finished()) {
+                if (!runOne(currentIndex())) {
+                    std::this_thread::yield();
+                }
+            }
+            if (counter.failed.exchange(false, std::memory_order_acquire)) {
+                std::exception_ptr error = counter.error;
+                counter.error = nullptr;
+                std::rethrow_exception(error);
+            }
+        }
+
+        void wait(const JobHandle& job) {
+            while (!isFinished(job)) {
+                if (!runOne(currentIndex())) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        // Non-blocking poll, for callers that check back once per frame.
+        static bool isFinished(const JobHandle& job) {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            return job->finished;
+        }
+
+    private:
+        struct Queue {
+            std::mutex mutex;
+            std::deque<JobHandle> jobs;
+        };
+
+        static uint32_t& currentIndex() {
+            thread_local uint32_t index = 0;
+            return index;
+        }
+
+        template <typename Iterator>
+        JobHandle schedule(std::function<void()> work, Counter* counter, Iterator first, Iterator last) {
+            JobHandle job = std::make_shared<Job>();
+            job->work = std::move(work);
+            job->counter = counter;
+            if (counter) {
+                counter->pending.fetch_add(1, std::memory_order_relaxed);
+            }
+            for (Iterator it = first; it != last; ++it) {
+                const JobHandle& dependency = *it;
+                if (!dependency) {
+                    continue;
+                }
+                std::lock_guard<std::mutex> lock(dependency->mutex);
+                if (!dependency->finished) {
+                    job->blockers.fetch_add(1, std::memory_order_relaxed);
+                    dependency->continuations.push_back(job);
+                }
+            }
+            release(job);
+            return job;
+        }
+
+        // Drops one blocker; the job becomes runnable when none are left.
+        void release(const JobHandle& job) {
+            if (job->blockers.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                push(job);
+            }
+        }
+
+        void push(const JobHandle& job) {
+            Queue& queue = queues[currentIndex()];
+            {
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                queue.jobs.push_back(job);
+            }
+            queued.fetch_add(1, std::memory_order_release);
+            {
+                // Pairs with the predicate check in workerMain so a wakeup is never lost
+                std::lock_guard<std::mutex> lock(sleepMutex);
+            }
+            wakeCondition.notify_one();
+        }
+
+        JobHandle pop(uint32_t self) {
+            {
+                Queue& own = queues[self];
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (!own.jobs.empty()) {
+                    JobHandle job = std::move(own.jobs.back());
+                    own.jobs.pop_back();
+                    return job;
+                }
+            }
+            for (uint32_t i = 1; i < queues.size(); i++) {
+                Queue& victim = queues[(self + i) % queues.size()];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.jobs.empty()) {
+                    JobHandle job = std::move(victim.jobs.front());
+                    victim.jobs.pop_front();
+                    return job;
+                }
+            }
+            return nullptr;
+        }
+
+        bool runOne(uint32_t self) {
+            JobHandle job = pop(self);
+            if (!job) {
+                return false;
+            }
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            execute(job);
+            return true;
+        }
+
+        void execute(const JobHandle& job) {
+            try {
+                job->work();
+            }
+            catch (...) {
+                if (job->counter && !job->counter->failed.load(std::memory_order_relaxed)) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!job->counter->failed.load(std::memory_order_relaxed)) {
+                        job->counter->error = std::current_exception();
+                        job->counter->failed.store(true, std::memory_order_release);
+                    }
+                }
+            }
+            job->work = nullptr; // Release captures before waking anyone
+
+            std::vector<JobHandle> continuations;
+            {
+                std::lock_guard<std::mutex> lock(job->mutex);
+                job->finished = true;
+                continuations.swap(job->continuations);
+            }
+            for (const JobHandle& continuation : continuations) {
+                release(continuation);
+            }
+            if (job->counter) {
+                job->counter->pending.fetch_sub(1, std::memory_order_acq_rel);
+            }
+        }
+
+        void workerMain(uint32_t index) {
+            currentIndex() = index;
+            for (;;) {
+                if (runOne(index)) {
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                wakeCondition.wait(lock, [this]() { return stopping || queued.load(std::memory_order_acquire) > 0; });
+                if (stopping) {
+                    return;
+                }
+            }
+        }
+
+        std::vector<Queue> queues;
+        std::vector<std::thread> workers;
+        std::atomic<int64_t> queued{ 0 };
+        std::mutex sleepMutex;
+        std::condition_variable wakeCondition;
+        bool stopping = false;
+        std::mutex errorMutex;
+    };
+
+} // namespace Jobs
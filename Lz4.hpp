@@ -0,0 +1,185 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// LZ4 block format (no frame header), compatible with the reference lz4 library's block API.
+//
+// A block is a run of sequences: a token (literal length in the high nibble, match length - 4 in the
+// low nibble, 15 meaning "more bytes follow"), the literals, and a 16-bit little-endian back offset.
+// The last sequence has literals only. The encoder keeps the spec's end-of-block rules: the last 5
+// bytes are literals and no match starts within the last 12, so any conforming decoder accepts it.
+namespace lz4 {
+
+    constexpr size_t MinMatch = 4;
+    constexpr size_t LastLiterals = 5;
+    constexpr size_t MatchStartLimit = 12;
+    constexpr size_t MaxOffset = 65535;
+    constexpr uint32_t HashBits = 14;
+    constexpr size_t WildCopy = 16;
+
+    inline size_t compressBound(size_t size) {
+        return size + size / 255 + 16;
+    }
+
+    inline uint32_t read32(const uint8_t* p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    inline uint32_t hash(uint32_t sequence) {
+        return (sequence * 2654435761u) >> (32 - HashBits);
+    }
+
+    // Length continuation bytes: 255 each, then the remainder.
+    inline uint8_t* writeLength(uint8_t* out, size_t length) {
+        for (; length >= 255; length -= 255) {
+            *out++ = 255;
+        }
+        *out++ = static_cast<uint8_t>(length);
+        return out;
+    }
+
+    // Greedy single-probe match finder. Returns the compressed size, or 0 when the result would not
+    // fit in capacity (the caller then stores the data uncompressed).
+    inline size_t compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity) {
+        std::vector<uint32_t> table(size_t(1) << HashBits, 0); // position + 1; 0 = empty
+        uint8_t* out = dst;
+        uint8_t* outEnd = dst + capacity;
+        size_t anchor = 0;
+
+        auto emit = [&](size_t literalLength, size_t offset, size_t matchLength) {
+            size_t worst = 1 + literalLength / 255 + 1 + literalLength + 2 + matchLength / 255 + 1;
+            if (worst > static_cast<size_t>(outEnd - out)) {
+                return false;
+            }
+            uint8_t* token = out++;
+            *token = static_cast<uint8_t>(std::min<size_t>(literalLength, 15) << 4);
+            if (literalLength >= 15) {
+                out = writeLength(out, literalLength - 15);
+            }
+            std::memcpy(out, src + anchor, literalLength);
+            out += literalLength;
+            if (matchLength == 0) {
+                return true; // Last sequence: literals only
+            }
+            *out++ = static_cast<uint8_t>(offset);
+            *out++ = static_cast<uint8_t>(offset >> 8);
+            size_t code = matchLength - MinMatch;
+            *token |= static_cast<uint8_t>(std::min<size_t>(code, 15));
+            if (code >= 15) {
+                out = writeLength(out, code - 15);
+            }
+            return true;
+        };
+
+        size_t pos = 0;
+        while (size >= MatchStartLimit + 1 && pos + MatchStartLimit <= size) {
+            uint32_t sequence = read32(src + pos);
+            uint32_t& slot = table[hash(sequence)];
+            size_t candidate = slot;
+            slot = static_cast<uint32_t>(pos + 1);
+            if (candidate == 0 || pos - (candidate - 1) > MaxOffset || read32(src + candidate - 1) != sequence) {
+                pos++;
+                continue;
+            }
+            candidate--;
+            while (pos > anchor && candidate > 0 && src[pos - 1] == src[candidate - 1]) {
+                pos--;
+                candidate--;
+            }
+            size_t length = MinMatch;
+            size_t maxLength = size - LastLiterals - pos;
+            while (length < maxLength && src[pos + length] == src[candidate + length]) {
+                length++;
+            }
+            if (!emit(pos - anchor, pos - candidate, length)) {
+                return 0;
+            }
+            pos += length;
+            anchor = pos;
+        }
+        if (!emit(size - anchor, 0, 0)) {
+            return 0;
+        }
+        return static_cast<size_t>(out - dst);
+    }
+
+    // Decodes exactly dstSize bytes. Every length and offset is bounds-checked, so a corrupt or
+    // truncated block returns false instead of reading or writing out of range.
+    inline bool decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) {
+        size_t in = 0;
+        size_t out = 0;
+        auto readLength = [&](size_t& length) {
+            uint8_t byte;
+            do {
+                if (in >= srcSize) {
+                    return false;
+                }
+                byte = src[in++];
+                length += byte;
+            } while (byte == 255);
+            return true;
+        };
+
+        while (in < srcSize) {
+            uint8_t token = src[in++];
+            size_t literalLength = token >> 4;
+            if (literalLength == 15 && !readLength(literalLength)) {
+                return false;
+            }
+            if (literalLength > srcSize - in || literalLength > dstSize - out) {
+                return false;
+            }
+            if (literalLength <= WildCopy && srcSize - in >= WildCopy && dstSize - out >= WildCopy) {
+                std::memcpy(dst + out, src + in, WildCopy); // Fixed-size copy; the excess is overwritten next
+            }
+            else {
+                std::memcpy(dst + out, src + in, literalLength);
+            }
+            in += literalLength;
+            out += literalLength;
+            if (in == srcSize) {
+                break; // Last sequence
+            }
+
+            if (srcSize - in < 2) {
+                return false;
+            }
+            size_t offset = size_t(src[in]) | (size_t(src[in + 1]) << 8);
+            in += 2;
+            size_t matchLength = token & 15;
+            if (matchLength == 15 && !readLength(matchLength)) {
+                return false;
+            }
+            matchLength += MinMatch;
+            if (offset == 0 || offset > out || matchLength > dstSize - out) {
+                return false;
+            }
+            uint8_t* target = dst + out;
+            const uint8_t* match = target - offset;
+            if (offset >= WildCopy && dstSize - out >= matchLength + WildCopy) {
+                for (size_t done = 0; done < matchLength; done += WildCopy) {
+                    std::memcpy(target + done, match + done, WildCopy);
+                }
+            }
+            else if (offset >= matchLength) {
+                std::memcpy(target, match, matchLength);
+            }
+            else {
+                // Overlapping match repeats the last offset bytes: copy one period, then keep doubling
+                // the copied run, which stays a whole number of periods long
+                std::memcpy(target, match, offset);
+                for (size_t done = offset; done < matchLength; done *= 2) {
+                    std::memcpy(target + done, target, std::min(done, matchLength - done));
+                }
+            }
+            out += matchLength;
+        }
+        return out == dstSize;
+    }
+
+} // namespace lz4
@@ -0,0 +1,277 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "VulkanDispatch.hpp"
+
+namespace vulkan {
+
+    // Our wrapper in front of the driver's blob. The driver header is checked too, but it has no
+    // checksum, and a truncated or bit-flipped blob can crash some drivers in vkCreatePipelineCache.
+    struct PipelineCacheFileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t dataSize;
+        uint64_t checksum;          // FNV-1a over the driver blob
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint32_t reserved;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    };
+
+    // Layout of VK_PIPELINE_CACHE_HEADER_VERSION_ONE at the start of every driver blob.
+    struct PipelineCacheDriverHeader {
+        uint32_t headerSize;
+        uint32_t headerVersion;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    };
+
+    inline uint64_t fnv1a64(const uint8_t* data, size_t size) {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (size_t i = 0; i < size; i++) {
+            hash ^= data[i];
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    // Owns the process-wide VkPipelineCache. Job-system threads that build pipelines use their own
+    // cache from threadCache() so they never contend on the driver's lock; those are merged into the
+    // main cache before every save. Saves go to "<path>.tmp" and are renamed over the old file, so a
+    // crash mid-write leaves the previous cache intact.
+    class PipelineCacheService {
+    public:
+        static constexpr uint32_t FileMagic = 0x43505656; // "VVPC"
+        static constexpr uint32_t FileVersion = 1;
+
+        void init(VkPhysicalDevice physicalDevice, const DeviceDispatch& dispatch, const VkAllocationCallbacks* callbacks,
+            const std::string& path, size_t maxBytes, double saveIntervalSeconds, uint32_t threadCount) {
+            this->dispatch = &dispatch;
+            this->device = dispatch.device;
+            this->callbacks = callbacks;
+            this->path = path;
+            this->maxBytes = maxBytes;
+            this->saveInterval = std::chrono::duration<double>(saveIntervalSeconds);
+            vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+            std::vector<uint8_t> initialData = load();
+            VkPipelineCacheCreateInfo createInfo{};
+            createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+            createInfo.initialDataSize = initialData.size();
+            createInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+            if (dispatch.vkCreatePipelineCache(device, &createInfo, callbacks, &mainCache) != VK_SUCCESS) {
+                // A driver may still reject a blob that passed our checks; start cold rather than fail
+                createInfo.initialDataSize = 0;
+                createInfo.pInitialData = nullptr;
+                if (dispatch.vkCreatePipelineCache(device, &createInfo, callbacks, &mainCache) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create pipeline cache!");
+                }
+            }
+            // Thread caches start empty; whatever they learn reaches mainCache at the next save
+            createInfo.initialDataSize = 0;
+            createInfo.pInitialData = nullptr;
+            threadCaches.resize(threadCount);
+            for (VkPipelineCache& cache : threadCaches) {
+                if (dispatch.vkCreatePipelineCache(device, &createInfo, callbacks, &cache) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create thread pipeline cache!");
+                }
+            }
+            savedChecksum = fnv1a64(initialData.data(), initialData.size());
+            lastSave = std::chrono::steady_clock::now();
+            std::cout << "Pipeline cache: " << (initialData.empty() ? "cold start" : "loaded " + std::to_string(initialData.size()) + " bytes")
+                << " (" << path << ")" << std::endl;
+        }
+
+        // Cache for pipelines created on the main thread.
+        VkPipelineCache get() const {
+            return mainCache;
+        }
+
+        // Cache of the job-system thread with this index (Jobs::JobSystem::threadIndex()). Index 0 is
+        // shared by every thread outside the pool, which is safe since caches are internally synchronized.
+        VkPipelineCache threadCache(uint32_t index) const {
+            return threadCaches[index];
+        }
+
+        // Called once per frame from the main thread; saves when the interval has passed and the
+        // cache contents changed since the last write. The file write happens off the frame thread.
+        void tick() {
+            if (mainCache == VK_NULL_HANDLE || saveInterval.count() <= 0.0) {
+                return;
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (now - lastSave < saveInterval) {
+                return;
+            }
+            lastSave = now;
+            save(false);
+        }
+
+        void destroy() {
+            if (mainCache == VK_NULL_HANDLE) {
+                return;
+            }
+            save(true);
+            for (VkPipelineCache cache : threadCaches) {
+                dispatch->vkDestroyPipelineCache(device, cache, callbacks);
+            }
+            threadCaches.clear();
+            dispatch->vkDestroyPipelineCache(device, mainCache, callbacks);
+            mainCache = VK_NULL_HANDLE;
+        }
+
+    private:
+        // A blocking save returns with no write in flight, whichever way it ends, so the writer thread
+        // can be destroyed afterwards.
+        void save(bool blocking) {
+            startWrite();
+            if (blocking && writer.joinable()) {
+                writer.join();
+            }
+        }
+
+        void startWrite() {
+            if (!threadCaches.empty() &&
+                dispatch->vkMergePipelineCaches(device, mainCache, static_cast<uint32_t>(threadCaches.size()), threadCaches.data()) != VK_SUCCESS) {
+                std::cout << "Pipeline cache: merging thread caches failed, saving the main cache only." << std::endl;
+            }
+            size_t size = 0;
+            if (dispatch->vkGetPipelineCacheData(device, mainCache, &size, nullptr) != VK_SUCCESS || size == 0) {
+                return;
+            }
+            std::vector<uint8_t> data(size);
+            if (dispatch->vkGetPipelineCacheData(device, mainCache, &size, data.data()) != VK_SUCCESS) {
+                return;
+            }
+            data.resize(size);
+            // A blob can change without changing size, so compare contents
+            uint64_t checksum = fnv1a64(data.data(), data.size());
+            if (checksum == savedChecksum) {
+                return;
+            }
+            savedChecksum = checksum;
+            if (size > maxBytes) {
+                // Keep the last good file rather than persisting something unbounded
+                std::cout << "Pipeline cache: " << size << " bytes exceeds the " << maxBytes << " byte limit, not saved." << std::endl;
+                return;
+            }
+
+            if (writer.joinable()) {
+                writer.join();
+            }
+            PipelineCacheFileHeader header = makeHeader(data);
+            std::string target = path;
+            writer = std::thread([header, target, data = std::move(data)]() {
+                writeFile(target, header, data);
+            });
+        }
+
+        PipelineCacheFileHeader makeHeader(const std::vector<uint8_t>& data) const {
+            PipelineCacheFileHeader header{};
+            header.magic = FileMagic;
+            header.version = FileVersion;
+            header.dataSize = data.size();
+            header.checksum = fnv1a64(data.data(), data.size());
+            header.vendorID = properties.vendorID;
+            header.deviceID = properties.deviceID;
+            header.driverVersion = properties.driverVersion;
+            std::memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+            return header;
+        }
+
+        static void writeFile(const std::string& target, const PipelineCacheFileHeader& header, const std::vector<uint8_t>& data) {
+            std::string temp = target + ".tmp";
+            {
+                std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+                file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+                file.flush();
+                if (!file) {
+                    std::cout << "Pipeline cache: failed to write " << temp << std::endl;
+                    return;
+                }
+            }
+            std::error_code error;
+            std::filesystem::rename(temp, target, error); // Replaces the old file in one step
+            if (error) {
+                std::cout << "Pipeline cache: failed to replace " << target << ": " << error.message() << std::endl;
+                std::filesystem::remove(temp, error);
+            }
+        }
+
+        // Returns the driver blob, or nothing if the file is missing, corrupt, too big, or was
+        // written by a different device or driver.
+        std::vector<uint8_t> load() const {
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file) {
+                return {};
+            }
+            std::streamoff fileSize = file.tellg();
+            if (fileSize < static_cast<std::streamoff>(sizeof(PipelineCacheFileHeader))
+                || static_cast<uint64_t>(fileSize) > maxBytes + sizeof(PipelineCacheFileHeader)) {
+                return reject("bad file size");
+            }
+            file.seekg(0);
+            PipelineCacheFileHeader header{};
+            file.read(reinterpret_cast<char*>(&header), sizeof(header));
+            if (!file || header.magic != FileMagic || header.version != FileVersion
+                || header.dataSize != static_cast<uint64_t>(fileSize) - sizeof(header)) {
+                return reject("bad header");
+            }
+            if (header.vendorID != properties.vendorID || header.deviceID != properties.deviceID
+                || header.driverVersion != properties.driverVersion
+                || std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+                return reject("different device or driver");
+            }
+
+            std::vector<uint8_t> data(static_cast<size_t>(header.dataSize));
+            file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+            if (!file || fnv1a64(data.data(), data.size()) != header.checksum) {
+                return reject("checksum mismatch");
+            }
+
+            PipelineCacheDriverHeader driverHeader{};
+            if (data.size() < sizeof(driverHeader)) {
+                return reject("truncated driver header");
+            }
+            std::memcpy(&driverHeader, data.data(), sizeof(driverHeader));
+            if (driverHeader.headerSize < sizeof(driverHeader) || driverHeader.headerSize > data.size()
+                || driverHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+                || driverHeader.vendorID != properties.vendorID || driverHeader.deviceID != properties.deviceID
+                || std::memcmp(driverHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+                return reject("driver header mismatch");
+            }
+            return data;
+        }
+
+        std::vector<uint8_t> reject(const char* reason) const {
+            std::cout << "Pipeline cache: ignoring " << path << " (" << reason << ")" << std::endl;
+            return {};
+        }
+
+        const DeviceDispatch* dispatch = nullptr;
+        VkDevice device = VK_NULL_HANDLE;
+        const VkAllocationCallbacks* callbacks = nullptr;
+        VkPhysicalDeviceProperties properties{};
+        VkPipelineCache mainCache = VK_NULL_HANDLE;
+        std::vector<VkPipelineCache> threadCaches;
+        std::thread writer;
+        std::string path;
+        size_t maxBytes = 0;
+        uint64_t savedChecksum = 0;     // of the blob last written (or loaded)
+        std::chrono::duration<double> saveInterval{ 0.0 };
+        std::chrono::steady_clock::time_point lastSave;
+    };
+
+} // namespace vulkan
@@ -0,0 +1,241 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "VulkanDispatch.hpp"
+
+namespace vulkan {
+
+    // Presentation trade-offs, switchable at runtime (F1-F3 in the windowed app).
+    enum class PresentPolicy {
+        LowLatency,     // newest frame wins: mailbox, one frame in flight
+        MaxThroughput,  // never block on vsync: immediate (or mailbox), deep queue
+        PowerSaving     // vsync-paced FIFO with the fewest images; the CPU sleeps on the fence
+    };
+
+    constexpr uint32_t MaxPolicyFramesInFlight = 3;
+
+    // What a policy resolves to on a particular surface.
+    struct PresentSettings {
+        VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+        uint32_t imageCount = 2;
+        uint32_t framesInFlight = 1;
+    };
+
+    inline const char* presentPolicyName(PresentPolicy policy) {
+        switch (policy) {
+        case PresentPolicy::LowLatency: return "low-latency";
+        case PresentPolicy::MaxThroughput: return "max-throughput";
+        default: return "power-saving";
+        }
+    }
+
+    inline bool parsePresentPolicy(const char* name, PresentPolicy& policy) {
+        for (PresentPolicy candidate : { PresentPolicy::LowLatency, PresentPolicy::MaxThroughput, PresentPolicy::PowerSaving }) {
+            if (std::strcmp(name, presentPolicyName(candidate)) == 0) {
+                policy = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline const char* presentModeName(VkPresentModeKHR mode) {
+        switch (mode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR: return "IMMEDIATE";
+        case VK_PRESENT_MODE_MAILBOX_KHR: return "MAILBOX";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO_RELAXED";
+        default: return "FIFO";
+        }
+    }
+
+    // FIFO is the only mode every surface supports, so it ends each preference list.
+    inline PresentSettings resolvePresentPolicy(PresentPolicy policy, const VkSurfaceCapabilitiesKHR& capabilities,
+        const std::vector<VkPresentModeKHR>& availableModes) {
+        auto supported = [&availableModes](VkPresentModeKHR mode) {
+            return std::find(availableModes.begin(), availableModes.end(), mode) != availableModes.end();
+        };
+        auto firstSupported = [&supported](std::initializer_list<VkPresentModeKHR> preferred) {
+            for (VkPresentModeKHR mode : preferred) {
+                if (supported(mode)) {
+                    return mode;
+                }
+            }
+            return VK_PRESENT_MODE_FIFO_KHR;
+        };
+
+        PresentSettings settings;
+        uint32_t extraImages = 0;
+        switch (policy) {
+        case PresentPolicy::LowLatency:
+            // Mailbox needs a spare image to replace; immediate tears but never queues
+            settings.presentMode = firstSupported({ VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR });
+            extraImages = settings.presentMode == VK_PRESENT_MODE_MAILBOX_KHR ? 1 : 0;
+            settings.framesInFlight = 1;
+            break;
+        case PresentPolicy::MaxThroughput:
+            settings.presentMode = firstSupported({ VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR });
+            extraImages = 2;
+            settings.framesInFlight = MaxPolicyFramesInFlight;
+            break;
+        case PresentPolicy::PowerSaving:
+            settings.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+            extraImages = 0;
+            settings.framesInFlight = 1;
+            break;
+        }
+        settings.imageCount = std::max(capabilities.minImageCount + extraImages, 2u);
+        if (capabilities.maxImageCount > 0) {
+            settings.imageCount = std::min(settings.imageCount, capabilities.maxImageCount);
+        }
+        return settings;
+    }
+
+    // Rolling present latency: CPU frame start to the moment vkWaitForPresentKHR reports the image
+    // on screen. Needs VK_KHR_present_id and VK_KHR_present_wait; the wait runs on a helper thread so
+    // the render loop never blocks on it.
+    class PresentLatencyTracker {
+    public:
+        static constexpr size_t History = 240;
+
+        PresentLatencyTracker() = default;
+        PresentLatencyTracker(const PresentLatencyTracker&) = delete;
+        PresentLatencyTracker& operator=(const PresentLatencyTracker&) = delete;
+
+        ~PresentLatencyTracker() {
+            stop();
+        }
+
+        void start(const DeviceDispatch& dispatch) {
+            waitForPresent = dispatch.vkWaitForPresentKHR;
+            if (waitForPresent == nullptr) {
+                return;
+            }
+            this->device = dispatch.device;
+            running = true;
+            waiter = std::thread([this]() { waiterMain(); });
+        }
+
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                running = false;
+            }
+            wake.notify_all();
+            if (waiter.joinable()) {
+                waiter.join();
+            }
+        }
+
+        bool enabled() const {
+            return waitForPresent != nullptr;
+        }
+
+        // Returns the id to chain into VkPresentIdKHR for this present.
+        uint64_t nextPresentId() {
+            return ++lastPresentId;
+        }
+
+        void presented(VkSwapchainKHR swapchain, uint64_t presentId, std::chrono::steady_clock::time_point frameStart) {
+            if (!enabled()) {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending.push_back({ swapchain, presentId, frameStart });
+            }
+            wake.notify_one();
+        }
+
+        // Must be called before swapchain is destroyed: drops its pending ids and waits until the
+        // helper thread is no longer inside vkWaitForPresentKHR on it.
+        void forget(VkSwapchainKHR swapchain) {
+            std::unique_lock<std::mutex> lock(mutex);
+            pending.erase(std::remove_if(pending.begin(), pending.end(),
+                [swapchain](const PendingPresent& present) { return present.swapchain == swapchain; }), pending.end());
+            idle.wait(lock, [this, swapchain]() { return waitingOn != swapchain; });
+        }
+
+        // Average and 99th percentile over the last History presents; false when there are none yet.
+        bool latency(double& averageMs, double& p99Ms) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (samples.empty()) {
+                return false;
+            }
+            std::vector<double> sorted(samples.begin(), samples.end());
+            std::sort(sorted.begin(), sorted.end());
+            double sum = 0.0;
+            for (double sample : sorted) {
+                sum += sample;
+            }
+            averageMs = sum / sorted.size();
+            p99Ms = sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)];
+            return true;
+        }
+
+        void clear() {
+            std::lock_guard<std::mutex> lock(mutex);
+            samples.clear();
+        }
+
+    private:
+        struct PendingPresent {
+            VkSwapchainKHR swapchain;
+            uint64_t presentId;
+            std::chrono::steady_clock::time_point frameStart;
+        };
+
+        void waiterMain() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (running) {
+                if (pending.empty()) {
+                    wake.wait(lock, [this]() { return !running || !pending.empty(); });
+                    continue;
+                }
+                PendingPresent present = pending.front();
+                waitingOn = present.swapchain;
+                lock.unlock();
+                // Short timeout so forget() and stop() never wait long
+                VkResult result = waitForPresent(device, present.swapchain, present.presentId, 5000000);
+                auto now = std::chrono::steady_clock::now();
+                lock.lock();
+                waitingOn = VK_NULL_HANDLE;
+                idle.notify_all();
+                if (result == VK_TIMEOUT) {
+                    continue; // Try again, unless forget() dropped it meanwhile
+                }
+                if (!pending.empty() && pending.front().presentId == present.presentId) {
+                    pending.pop_front();
+                }
+                if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+                    samples.push_back(std::chrono::duration<double, std::milli>(now - present.frameStart).count());
+                    if (samples.size() > History) {
+                        samples.pop_front();
+                    }
+                }
+            }
+        }
+
+        VkDevice device = VK_NULL_HANDLE;
+        PFN_vkWaitForPresentKHR waitForPresent = nullptr;
+        uint64_t lastPresentId = 0;
+
+        mutable std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable idle;
+        std::deque<PendingPresent> pending;
+        std::deque<double> samples;
+        VkSwapchainKHR waitingOn = VK_NULL_HANDLE;
+        bool running = false;
+        std::thread waiter;
+    };
+
+} // namespace vulkan
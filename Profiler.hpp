@@ -0,0 +1,529 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#include "VulkanDispatch.hpp"
+
+namespace vulkan {
+
+    // Rolling statistics for one zone over its last ZoneHistory samples.
+    struct ZoneStats {
+        std::string name;
+        uint64_t count = 0;          // samples since start, not just the window
+        double minMs = 0.0;
+        double avgMs = 0.0;
+        double p99Ms = 0.0;
+        double maxMs = 0.0;
+    };
+
+    // One VK_QUERY_TYPE_PIPELINE_STATISTICS result, in the order of the enabled bits.
+    struct PipelineStatistics {
+        uint64_t inputAssemblyVertices = 0;
+        uint64_t vertexShaderInvocations = 0;
+        uint64_t clippingPrimitives = 0;
+        uint64_t fragmentShaderInvocations = 0;
+        uint64_t computeShaderInvocations = 0;
+    };
+
+    // CPU zones (any thread) and GPU zones (timestamp queries on the frame's primary command buffer).
+    //
+    // Every frame in flight has its own query pool. A slot's results are read when the slot comes
+    // round again, after its fence has been waited on, so readback never stalls. GPU times are placed
+    // on the CPU timeline with VK_EXT_calibrated_timestamps when available, otherwise they are
+    // anchored to the time the frame began recording.
+    class Profiler {
+    public:
+        static constexpr uint32_t MaxGpuZonesPerFrame = 64;
+        static constexpr size_t ZoneHistory = 512;
+        static constexpr size_t MaxTraceEvents = 200000;
+
+        static Profiler& Instance() {
+            static Profiler profiler;
+            return profiler;
+        }
+
+        void setEnabled(bool value) {
+            enabled.store(value, std::memory_order_relaxed);
+        }
+
+        bool isEnabled() const {
+            return enabled.load(std::memory_order_relaxed);
+        }
+
+        // Call after device creation. pipelineStatistics is true when the pipelineStatisticsQuery
+        // feature was enabled; calibrated when VK_EXT_calibrated_timestamps was.
+        void initGpu(VkInstance instance, VkPhysicalDevice physicalDevice, const DeviceDispatch& dispatch, const VkAllocationCallbacks* callbacks,
+            uint32_t queueFamily, uint32_t frameCount, bool pipelineStatistics, bool calibrated) {
+            if (!isEnabled()) {
+                return;
+            }
+            this->dispatch = &dispatch;
+            this->device = dispatch.device;
+            this->callbacks = callbacks;
+
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+            timestampPeriodNs = properties.limits.timestampPeriod;
+            uint32_t familyCount = 0;
+            vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+            std::vector<VkQueueFamilyProperties> families(familyCount);
+            vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+            uint32_t validBits = queueFamily < familyCount ? families[queueFamily].timestampValidBits : 0;
+            if (validBits == 0) {
+                std::cout << "Profiler: queue family " << queueFamily << " has no timestamps, GPU zones disabled." << std::endl;
+                return;
+            }
+            timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+
+            if (calibrated) {
+                getCalibratedTimestamps = dispatch.vkGetCalibratedTimestampsEXT;
+                auto getDomains = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(
+                    vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+                bool hasDeviceDomain = false;
+                bool hasHostDomain = false;
+                if (getDomains) {
+                    uint32_t domainCount = 0;
+                    getDomains(physicalDevice, &domainCount, nullptr);
+                    std::vector<VkTimeDomainEXT> domains(domainCount);
+                    getDomains(physicalDevice, &domainCount, domains.data());
+                    hasDeviceDomain = std::find(domains.begin(), domains.end(), VK_TIME_DOMAIN_DEVICE_EXT) != domains.end();
+                    hasHostDomain = std::find(domains.begin(), domains.end(), HostTimeDomain) != domains.end();
+                }
+                if (!hasDeviceDomain || !hasHostDomain) {
+                    getCalibratedTimestamps = nullptr;
+                }
+            }
+
+            frames.resize(frameCount);
+            for (GpuFrame& frame : frames) {
+                VkQueryPoolCreateInfo poolInfo{};
+                poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+                poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+                poolInfo.queryCount = MaxGpuZonesPerFrame * 2;
+                if (dispatch.vkCreateQueryPool(device, &poolInfo, callbacks, &frame.timestamps) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create timestamp query pool!");
+                }
+                if (pipelineStatistics) {
+                    poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+                    poolInfo.queryCount = 1;
+                    poolInfo.pipelineStatistics = statisticsFlags;
+                    if (dispatch.vkCreateQueryPool(device, &poolInfo, callbacks, &frame.statistics) != VK_SUCCESS) {
+                        throw std::runtime_error("Failed to create pipeline statistics query pool!");
+                    }
+                }
+            }
+            gpuEnabled = true;
+            calibrate();
+            std::cout << "Profiler: GPU zones on, " << (getCalibratedTimestamps ? "calibrated" : "uncalibrated")
+                << " timestamps" << (pipelineStatistics ? ", pipeline statistics" : "") << "." << std::endl;
+        }
+
+        void destroyGpu() {
+            for (GpuFrame& frame : frames) {
+                dispatch->vkDestroyQueryPool(device, frame.timestamps, callbacks);
+                if (frame.statistics != VK_NULL_HANDLE) {
+                    dispatch->vkDestroyQueryPool(device, frame.statistics, callbacks);
+                }
+            }
+            frames.clear();
+            gpuEnabled = false;
+        }
+
+        // Flags secondaries must inherit while the frame's statistics query is active (0 = none).
+        VkQueryPipelineStatisticFlags inheritedStatistics() const {
+            return gpuEnabled && !frames.empty() && frames[0].statistics != VK_NULL_HANDLE ? statisticsFlags : 0;
+        }
+
+        // Start of a frame slot's command buffer, outside any render pass. The slot's fence must have
+        // been waited on: its previous results are collected here, then its queries are reset.
+        void beginFrame(VkCommandBuffer commandBuffer, uint32_t slot) {
+            if (!gpuEnabled) {
+                return;
+            }
+            GpuFrame& frame = frames[slot];
+            collect(frame);
+            dispatch->vkCmdResetQueryPool(commandBuffer, frame.timestamps, 0, MaxGpuZonesPerFrame * 2);
+            if (frame.statistics != VK_NULL_HANDLE) {
+                dispatch->vkCmdResetQueryPool(commandBuffer, frame.statistics, 0, 1);
+            }
+            frame.zoneNames.clear();
+            frame.openZones.clear();
+            frame.statisticsRecorded = false;
+            frame.recordStartUs = nowUs();
+            current = &frame;
+        }
+
+        void beginGpuZone(VkCommandBuffer commandBuffer, const char* name) {
+            if (!gpuEnabled || current == nullptr || current->zoneNames.size() >= MaxGpuZonesPerFrame) {
+                return;
+            }
+            uint32_t zone = static_cast<uint32_t>(current->zoneNames.size());
+            current->zoneNames.push_back(name);
+            current->openZones.push_back(zone);
+            dispatch->vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, current->timestamps, zone * 2);
+        }
+
+        void endGpuZone(VkCommandBuffer commandBuffer) {
+            if (!gpuEnabled || current == nullptr || current->openZones.empty()) {
+                return;
+            }
+            uint32_t zone = current->openZones.back();
+            current->openZones.pop_back();
+            dispatch->vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, current->timestamps, zone * 2 + 1);
+        }
+
+        // Must bracket commands outside a render pass, or inside a single subpass.
+        void beginPipelineStatistics(VkCommandBuffer commandBuffer) {
+            if (gpuEnabled && current != nullptr && current->statistics != VK_NULL_HANDLE) {
+                dispatch->vkCmdBeginQuery(commandBuffer, current->statistics, 0, 0);
+            }
+        }
+
+        void endPipelineStatistics(VkCommandBuffer commandBuffer) {
+            if (gpuEnabled && current != nullptr && current->statistics != VK_NULL_HANDLE) {
+                dispatch->vkCmdEndQuery(commandBuffer, current->statistics, 0);
+                current->statisticsRecorded = true;
+            }
+        }
+
+        void recordCpuZone(const char* name, int64_t beginUs, int64_t endUs) {
+            std::lock_guard<std::mutex> lock(mutex);
+            addSample(name, (endUs - beginUs) / 1000.0);
+            addEvent({ name, "cpu", threadId(), beginUs, endUs - beginUs });
+        }
+
+        int64_t nowUs() const {
+            return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        std::vector<ZoneStats> stats() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::vector<ZoneStats> result;
+            for (const auto& entry : zones) {
+                const ZoneSamples& samples = entry.second;
+                if (samples.window.empty()) {
+                    continue;
+                }
+                std::vector<double> sorted(samples.window.begin(), samples.window.end());
+                std::sort(sorted.begin(), sorted.end());
+                ZoneStats zone;
+                zone.name = entry.first;
+                zone.count = samples.count;
+                zone.minMs = sorted.front();
+                zone.maxMs = sorted.back();
+                double sum = 0.0;
+                for (double value : sorted) {
+                    sum += value;
+                }
+                zone.avgMs = sum / sorted.size();
+                zone.p99Ms = sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)];
+                result.push_back(zone);
+            }
+            return result;
+        }
+
+        PipelineStatistics lastPipelineStatistics() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return lastStatistics;
+        }
+
+        void printStats() const {
+            std::cout << "Profiler zones (ms, last " << ZoneHistory << " samples):" << std::endl;
+            for (const ZoneStats& zone : stats()) {
+                std::cout << " - " << zone.name << ": min " << zone.minMs << ", avg " << zone.avgMs << ", p99 " << zone.p99Ms
+                    << ", max " << zone.maxMs << " (" << zone.count << " samples)" << std::endl;
+            }
+        }
+
+        // Chrome trace event format; open in chrome://tracing or Perfetto.
+        bool exportChromeTrace(const std::string& path) const {
+            std::ofstream file(path, std::ios::trunc);
+            if (!file) {
+                std::cout << "Profiler: cannot write " << path << std::endl;
+                return false;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+            file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GPU\"}}";
+            for (const TraceEvent& event : events) {
+                file << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category << "\",\"pid\":1,\"tid\":" << event.thread;
+                if (event.counter) {
+                    file << ",\"ph\":\"C\",\"ts\":" << event.beginUs << ",\"args\":{\"value\":" << event.durationUs << "}}";
+                }
+                else {
+                    file << ",\"ph\":\"X\",\"ts\":" << event.beginUs << ",\"dur\":" << event.durationUs << "}";
+                }
+            }
+            file << "\n]}\n";
+            std::cout << "Profiler: wrote " << events.size() << " events to " << path << std::endl;
+            return true;
+        }
+
+    private:
+        struct GpuFrame {
+            VkQueryPool timestamps = VK_NULL_HANDLE;
+            VkQueryPool statistics = VK_NULL_HANDLE;
+            std::vector<const char*> zoneNames;
+            std::vector<uint32_t> openZones;
+            bool statisticsRecorded = false;
+            int64_t recordStartUs = 0;
+        };
+
+        struct ZoneSamples {
+            std::deque<double> window;
+            uint64_t count = 0;
+        };
+
+        struct TraceEvent {
+            const char* name;
+            const char* category;
+            uint32_t thread;       // 0 = GPU
+            int64_t beginUs;
+            int64_t durationUs;    // value for counters
+            bool counter = false;
+        };
+
+        static constexpr VkQueryPipelineStatisticFlags statisticsFlags =
+            VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+        Profiler() : start(std::chrono::steady_clock::now()) {}
+
+        static uint32_t threadId() {
+            static std::atomic<uint32_t> next{ 1 };
+            thread_local uint32_t id = next.fetch_add(1, std::memory_order_relaxed);
+            return id;
+        }
+
+        // The host clock that steady_clock is built on, in the form vkGetCalibratedTimestampsEXT reports it.
+#if defined(_WIN32)
+        static constexpr VkTimeDomainEXT HostTimeDomain = VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+#else
+        static constexpr VkTimeDomainEXT HostTimeDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+#endif
+        // Samples whose device and host reads are further apart than this are retried.
+        static constexpr uint64_t MaxCalibrationDeviationNs = 20000;
+        static constexpr uint32_t CalibrationAttempts = 4;
+
+        static int64_t hostDomainNs(uint64_t value) {
+#if defined(_WIN32)
+            LARGE_INTEGER frequency;
+            QueryPerformanceFrequency(&frequency);
+            uint64_t ticksPerSecond = static_cast<uint64_t>(frequency.QuadPart);
+            return static_cast<int64_t>(value / ticksPerSecond * 1000000000ull + value % ticksPerSecond * 1000000000ull / ticksPerSecond);
+#else
+            return static_cast<int64_t>(value);
+#endif
+        }
+
+        static int64_t hostDomainNowNs() {
+#if defined(_WIN32)
+            LARGE_INTEGER counter;
+            QueryPerformanceCounter(&counter);
+            return hostDomainNs(static_cast<uint64_t>(counter.QuadPart));
+#else
+            timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            return static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+#endif
+        }
+
+        // Pairs a device timestamp with a host timestamp taken by the driver in the same call, then maps
+        // the host value onto our steady_clock timeline. Samples with a large deviation are retried; if
+        // none is good enough the previous calibration stays, and without one GPU zones stay uncalibrated.
+        void calibrate() {
+            if (getCalibratedTimestamps == nullptr) {
+                return;
+            }
+            VkCalibratedTimestampInfoEXT infos[2]{};
+            infos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+            infos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+            infos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+            infos[1].timeDomain = HostTimeDomain;
+            uint64_t best[2] = {};
+            uint64_t bestDeviation = UINT64_MAX;
+            for (uint32_t attempt = 0; attempt < CalibrationAttempts && bestDeviation > MaxCalibrationDeviationNs; ++attempt) {
+                uint64_t timestamps[2] = {};
+                uint64_t deviation = 0;
+                if (getCalibratedTimestamps(device, 2, infos, timestamps, &deviation) == VK_SUCCESS && deviation < bestDeviation) {
+                    best[0] = timestamps[0];
+                    best[1] = timestamps[1];
+                    bestDeviation = deviation;
+                }
+            }
+            calibratedAt = nowUs();
+            if (bestDeviation > MaxCalibrationDeviationNs) {
+                if (!calibrationValid) {
+                    getCalibratedTimestamps = nullptr;
+                    std::cout << "Profiler: timestamp calibration deviation too large, GPU zones stay uncalibrated." << std::endl;
+                }
+                return;
+            }
+            // steady_clock and the host domain read back to back give the offset between their epochs
+            int64_t steadyNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            int64_t offsetNs = steadyNs - hostDomainNowNs();
+            int64_t startNs = std::chrono::duration_cast<std::chrono::nanoseconds>(start.time_since_epoch()).count();
+            calibrationGpu = best[0] & timestampMask;
+            calibrationCpuUs = (hostDomainNs(best[1]) + offsetNs - startNs) / 1000;
+            calibrationValid = true;
+        }
+
+        int64_t gpuToCpuUs(uint64_t timestamp, uint64_t frameBase, const GpuFrame& frame) const {
+            if (getCalibratedTimestamps != nullptr) {
+                int64_t ticks = static_cast<int64_t>((timestamp - calibrationGpu) & timestampMask);
+                if (ticks > static_cast<int64_t>(timestampMask >> 1)) {
+                    ticks -= static_cast<int64_t>(timestampMask) + 1; // Timestamp from before the calibration
+                }
+                return calibrationCpuUs + static_cast<int64_t>(ticks * timestampPeriodNs / 1000.0);
+            }
+            uint64_t ticks = (timestamp - frameBase) & timestampMask;
+            return frame.recordStartUs + static_cast<int64_t>(ticks * timestampPeriodNs / 1000.0);
+        }
+
+        void collect(GpuFrame& frame) {
+            if (frame.zoneNames.empty()) {
+                return;
+            }
+            // Clocks drift apart; recalibrate every few seconds.
+            if (getCalibratedTimestamps != nullptr && nowUs() - calibratedAt > 5000000) {
+                calibrate();
+            }
+            uint32_t queryCount = static_cast<uint32_t>(frame.zoneNames.size()) * 2;
+            std::vector<uint64_t> results(queryCount * 2);
+            dispatch->vkGetQueryPoolResults(device, frame.timestamps, 0, queryCount, results.size() * sizeof(uint64_t), results.data(),
+                sizeof(uint64_t) * 2, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            uint64_t frameBase = results[0] & timestampMask;
+            for (size_t zone = 0; zone < frame.zoneNames.size(); zone++) {
+                const uint64_t* begin = &results[zone * 4];
+                const uint64_t* end = &results[zone * 4 + 2];
+                if (begin[1] == 0 || end[1] == 0) {
+                    continue; // Not written (e.g. zone left open) or not yet available
+                }
+                uint64_t ticks = ((end[0] & timestampMask) - (begin[0] & timestampMask)) & timestampMask;
+                double ms = ticks * timestampPeriodNs / 1e6;
+                std::string name = std::string("GPU ") + frame.zoneNames[zone];
+                addSample(name, ms);
+                int64_t beginUs = gpuToCpuUs(begin[0] & timestampMask, frameBase, frame);
+                addEvent({ frame.zoneNames[zone], "gpu", 0, beginUs, static_cast<int64_t>(ms * 1000.0) });
+            }
+
+            if (frame.statisticsRecorded) {
+                uint64_t values[6] = {};
+                if (dispatch->vkGetQueryPoolResults(device, frame.statistics, 0, 1, sizeof(values), values, sizeof(values),
+                    VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT) == VK_SUCCESS && values[5] != 0) {
+                    lastStatistics.inputAssemblyVertices = values[0];
+                    lastStatistics.vertexShaderInvocations = values[1];
+                    lastStatistics.clippingPrimitives = values[2];
+                    lastStatistics.fragmentShaderInvocations = values[3];
+                    lastStatistics.computeShaderInvocations = values[4];
+                    int64_t at = frame.recordStartUs;
+                    addEvent({ "vertices", "stats", 0, at, static_cast<int64_t>(values[0]), true });
+                    addEvent({ "fragment invocations", "stats", 0, at, static_cast<int64_t>(values[3]), true });
+                }
+            }
+        }
+
+        void addSample(const std::string& name, double ms) {
+            ZoneSamples& samples = zones[name];
+            samples.window.push_back(ms);
+            if (samples.window.size() > ZoneHistory) {
+                samples.window.pop_front();
+            }
+            samples.count++;
+        }
+
+        void addEvent(const TraceEvent& event) {
+            events.push_back(event);
+            if (events.size() > MaxTraceEvents) {
+                events.pop_front(); // Keep the most recent window
+            }
+        }
+
+        std::atomic<bool> enabled{ false };
+        std::chrono::steady_clock::time_point start;
+        mutable std::mutex mutex;
+        std::map<std::string, ZoneSamples> zones;
+        std::deque<TraceEvent> events;
+        PipelineStatistics lastStatistics;
+
+        const DeviceDispatch* dispatch = nullptr;
+        VkDevice device = VK_NULL_HANDLE;
+        const VkAllocationCallbacks* callbacks = nullptr;
+        bool gpuEnabled = false;
+        std::vector<GpuFrame> frames;
+        GpuFrame* current = nullptr;
+        float timestampPeriodNs = 1.0f;
+        uint64_t timestampMask = ~0ull;
+        PFN_vkGetCalibratedTimestampsEXT getCalibratedTimestamps = nullptr;
+        uint64_t calibrationGpu = 0;
+        int64_t calibrationCpuUs = 0;
+        int64_t calibratedAt = 0;
+        bool calibrationValid = false;
+    };
+
+    // Times the enclosing scope on the calling thread. Names must be string literals (or otherwise
+    // outlive the profiler): trace events keep the pointer.
+    class CpuZone {
+    public:
+        explicit CpuZone(const char* name) : name(name) {
+            if (Profiler::Instance().isEnabled()) {
+                beginUs = Profiler::Instance().nowUs();
+            }
+        }
+
+        ~CpuZone() {
+            if (beginUs >= 0) {
+                Profiler::Instance().recordCpuZone(name, beginUs, Profiler::Instance().nowUs());
+            }
+        }
+
+        CpuZone(const CpuZone&) = delete;
+        CpuZone& operator=(const CpuZone&) = delete;
+
+    private:
+        const char* name;
+        int64_t beginUs = -1;
+    };
+
+    class GpuZone {
+    public:
+        GpuZone(VkCommandBuffer commandBuffer, const char* name) : commandBuffer(commandBuffer) {
+            Profiler::Instance().beginGpuZone(commandBuffer, name);
+        }
+
+        ~GpuZone() {
+            Profiler::Instance().endGpuZone(commandBuffer);
+        }
+
+        GpuZone(const GpuZone&) = delete;
+        GpuZone& operator=(const GpuZone&) = delete;
+
+    private:
+        VkCommandBuffer commandBuffer;
+    };
+
+} // namespace vulkan
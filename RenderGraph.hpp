@@ -0,0 +1,1187 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "DeferredDeletion.hpp"
+#include "DeviceMemory.hpp"
+#include "DeviceSelection.hpp"
+#include "Profiler.hpp"
+#include "VulkanDispatch.hpp"
+
+namespace vulkan {
+
+    using RenderResource = uint32_t;
+    constexpr RenderResource InvalidRenderResource = UINT32_MAX;
+
+    // Where a pass runs. AsyncCompute passes move to the dedicated compute queue when the device has
+    // one and nothing they touch was used by a graphics pass earlier in the frame; otherwise they run
+    // on the graphics queue like Compute passes.
+    enum class PassKind {
+        Graphics,
+        Compute,
+        AsyncCompute,
+        Transfer
+    };
+
+    // How a pass touches a resource. Decides pipeline stages, access masks, image layout and the
+    // usage flags transient resources are created with.
+    enum class ResourceUsage {
+        ColorAttachment,
+        DepthAttachment,
+        DepthRead,
+        Sampled,
+        StorageRead,
+        StorageWrite,
+        TransferSrc,
+        TransferDst,
+        IndirectRead,
+        VertexRead,
+        UniformRead
+    };
+
+    struct RenderImageDesc {
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent{};
+        VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    };
+
+    struct RenderBufferDesc {
+        VkDeviceSize size = 0;
+    };
+
+    // Synchronization state of an imported resource at the start (or required at the end) of the graph.
+    struct ImportedState {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 access = VK_ACCESS_2_NONE;
+    };
+
+    class RenderGraph;
+
+    // Handed to a pass's setup callback to declare what the pass reads and writes.
+    class RenderPassBuilder {
+    public:
+        RenderResource createImage(const char* name, const RenderImageDesc& desc);
+        RenderResource createBuffer(const char* name, const RenderBufferDesc& desc);
+
+        RenderPassBuilder& read(RenderResource resource, ResourceUsage usage);
+        RenderPassBuilder& write(RenderResource resource, ResourceUsage usage);
+
+        // Attachments are bound with dynamic rendering around the pass's execute callback.
+        RenderPassBuilder& colorAttachment(RenderResource resource, VkAttachmentLoadOp loadOp, VkClearColorValue clear = {});
+        RenderPassBuilder& depthAttachment(RenderResource resource, VkAttachmentLoadOp loadOp, VkClearDepthStencilValue clear = { 1.0f, 0 });
+
+        // The pass records its draws into secondary command buffers.
+        RenderPassBuilder& secondaryCommandBuffers();
+
+        // Keeps the pass even if nothing in the graph reads its output (e.g. it writes a host buffer).
+        RenderPassBuilder& sideEffect();
+
+    private:
+        friend class RenderGraph;
+        RenderPassBuilder(RenderGraph& graph, uint32_t pass) : graph(graph), pass(pass) {}
+
+        RenderGraph& graph;
+        uint32_t pass;
+    };
+
+    // Handed to a pass's execute callback; resolves resources to this frame's Vulkan handles.
+    class RenderPassContext {
+    public:
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        uint32_t frameIndex = 0;
+
+        VkImage image(RenderResource resource) const;
+        VkImageView imageView(RenderResource resource) const;
+        VkBuffer buffer(RenderResource resource) const;
+        VkExtent2D extent(RenderResource resource) const;
+
+    private:
+        friend class RenderGraph;
+        const RenderGraph* graph = nullptr;
+    };
+
+    // Frame graph. Passes declare the resources they use; compile() culls passes whose results are
+    // never consumed, derives the minimal set of synchronization2 barriers and layout transitions
+    // (batched into one vkCmdPipelineBarrier2 per pass), places transient images whose lifetimes do not
+    // overlap in the same memory, and moves eligible compute passes to the dedicated compute queue.
+    //
+    // The graph is built and compiled once and executed every frame; imported resources (e.g. the
+    // swapchain image) are re-pointed with setImportedImage() before execute(). Requires
+    // synchronization2 and dynamic rendering.
+    class RenderGraph {
+    public:
+        // With a deletion queue, transients replaced by reset()/compile() are retired after the last
+        // submitted frame instead of being destroyed on the spot.
+        void init(DeviceMemoryAllocator& memory, const DeviceDispatch& dispatch, const VkAllocationCallbacks* callbacks, QueueSet& queues,
+            uint32_t frameCount, DeletionQueue* deletion = nullptr) {
+            this->memory = &memory;
+            this->deletion = deletion;
+            this->dispatch = &dispatch;
+            this->device = dispatch.device;
+            this->callbacks = callbacks;
+            this->queues = &queues;
+            this->frameCount = std::max(frameCount, 1u);
+            asyncQueueAvailable = queues.compute.dedicatedFrom(queues.graphics);
+        }
+
+        // Expects the device to be idle.
+        void destroy() {
+            if (device == VK_NULL_HANDLE) {
+                return;
+            }
+            reset();
+            for (AsyncFrame& frame : asyncFrames) {
+                dispatch->vkDestroyCommandPool(device, frame.commandPool, callbacks);
+            }
+            asyncFrames.clear();
+            if (asyncTimeline != VK_NULL_HANDLE) {
+                dispatch->vkDestroySemaphore(device, asyncTimeline, callbacks);
+                asyncTimeline = VK_NULL_HANDLE;
+            }
+            device = VK_NULL_HANDLE;
+        }
+
+        // Drops every pass and resource so the graph can be declared again. Without a deletion queue
+        // this expects the device to be idle, since transient resources are destroyed immediately.
+        void reset() {
+            destroyPhysicalResources();
+            passes.clear();
+            resources.clear();
+            finalBarriers.clear();
+            compiled = false;
+        }
+
+        RenderResource importImage(const char* name, const RenderImageDesc& desc, const ImportedState& initial, const ImportedState& final) {
+            Resource resource;
+            resource.name = name;
+            resource.isImage = true;
+            resource.imported = true;
+            resource.image = desc;
+            resource.initial = initial;
+            resource.final = final;
+            resource.physical.resize(1);
+            resources.push_back(resource);
+            compiled = false;
+            return static_cast<RenderResource>(resources.size() - 1);
+        }
+
+        // sharedWithCompute: the buffer is not written while the graph runs and can be read on the
+        // compute queue without an ownership transfer (concurrent sharing, or the same queue family).
+        RenderResource importBuffer(const char* name, const RenderBufferDesc& desc, const ImportedState& initial, bool sharedWithCompute = false) {
+            Resource resource;
+            resource.name = name;
+            resource.isImage = false;
+            resource.imported = true;
+            resource.buffer = desc;
+            resource.initial = initial;
+            resource.sharedWithCompute = sharedWithCompute;
+            resource.physical.resize(1);
+            resources.push_back(resource);
+            compiled = false;
+            return static_cast<RenderResource>(resources.size() - 1);
+        }
+
+        void setImportedImage(RenderResource id, VkImage image, VkImageView view, VkExtent2D extent) {
+            Resource& resource = resources.at(id);
+            resource.physical[0].image = image;
+            resource.physical[0].view = view;
+            resource.image.extent = extent;
+        }
+
+        void setImportedBuffer(RenderResource id, VkBuffer buffer) {
+            resources.at(id).physical[0].buffer = buffer;
+        }
+
+        // name must outlive the graph; it also labels the pass's GPU profiler zone.
+        void addPass(const char* name, PassKind kind, const std::function<void(RenderPassBuilder&)>& setup,
+            std::function<void(RenderPassContext&)> execute) {
+            Pass pass;
+            pass.name = name;
+            pass.kind = kind;
+            pass.execute = std::move(execute);
+            passes.push_back(std::move(pass));
+            RenderPassBuilder builder(*this, static_cast<uint32_t>(passes.size() - 1));
+            setup(builder);
+            compiled = false;
+        }
+
+        void compile() {
+            destroyPhysicalResources();
+            cullPasses();
+            assignQueues();
+            computeLifetimes();
+            createPhysicalResources();
+
+            // The first run finds each resource's state at the end of a frame; that state is what the
+            // next frame's first use (and any resource aliasing the same memory) has to wait for.
+            std::vector<ResourceState> initial(resources.size());
+            for (uint32_t i = 0; i < resources.size(); i++) {
+                initial[i] = initialState(i, nullptr);
+            }
+            std::vector<ResourceState> endOfFrame = simulate(initial);
+            for (uint32_t i = 0; i < resources.size(); i++) {
+                initial[i] = initialState(i, &endOfFrame);
+            }
+            simulate(initial);
+            compiled = true;
+            printSummary();
+        }
+
+        // Records the graphics passes into commandBuffer and submits the async compute passes, if any,
+        // on the compute queue. The graphics submission must then wait on asyncTimeline() at
+        // asyncWaitValue() for asyncWaitStages().
+        void execute(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+            if (!compiled) {
+                throw std::runtime_error("Render graph executed before compile()!");
+            }
+            frameIndex %= frameCount;
+            lastAsyncValue = 0;
+            if (asyncPassCount > 0) {
+                submitAsyncPasses(frameIndex);
+            }
+            for (Pass& pass : passes) {
+                if (pass.live && !pass.async) {
+                    GpuZone zone(commandBuffer, pass.name);
+                    recordPass(commandBuffer, pass, frameIndex);
+                }
+            }
+            recordBarriers(commandBuffer, finalBarriers, frameIndex);
+        }
+
+        VkSemaphore asyncTimelineSemaphore() const {
+            return asyncTimeline;
+        }
+
+        // 0 when no async compute was submitted this frame.
+        uint64_t asyncWaitValue() const {
+            return lastAsyncValue;
+        }
+
+        VkPipelineStageFlags asyncWaitStages() const {
+            return static_cast<VkPipelineStageFlags>(asyncConsumerStages != 0 ? asyncConsumerStages : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+        }
+
+        void printSummary() const {
+            uint32_t live = 0, transientImages = 0;
+            VkDeviceSize requested = 0, allocated = 0;
+            for (const Pass& pass : passes) {
+                live += pass.live ? 1 : 0;
+            }
+            for (const Resource& resource : resources) {
+                if (!resource.imported && resource.isImage && resource.used) {
+                    transientImages++;
+                    requested += resource.memorySize * resource.physical.size();
+                }
+            }
+            for (const AliasBlock& block : aliasBlocks) {
+                allocated += block.size;
+            }
+            for (const Resource& resource : resources) {
+                if (!resource.imported && resource.isImage && resource.used && resource.aliasBlock == UINT32_MAX) {
+                    allocated += resource.memorySize * resource.physical.size();
+                }
+            }
+            std::cout << "Render graph: " << live << "/" << passes.size() << " passes live, " << asyncPassCount
+                << " on async compute, " << transientImages << " transient images in " << (allocated >> 10) << " KiB ("
+                << ((requested > allocated ? requested - allocated : 0) >> 10) << " KiB saved by aliasing)." << std::endl;
+        }
+
+    private:
+        friend class RenderPassBuilder;
+        friend class RenderPassContext;
+
+        struct Physical {
+            VkImage image = VK_NULL_HANDLE;
+            VkImageView view = VK_NULL_HANDLE;
+            VkBuffer buffer = VK_NULL_HANDLE;
+            DeviceAllocation* allocation = nullptr; // null when the memory belongs to an alias block
+        };
+
+        struct Resource {
+            const char* name = "";
+            bool isImage = true;
+            bool imported = false;
+            bool sharedWithCompute = false;
+            RenderImageDesc image;
+            RenderBufferDesc buffer;
+            ImportedState initial;
+            ImportedState final;
+            VkImageUsageFlags imageUsage = 0;
+            VkBufferUsageFlags bufferUsage = 0;
+
+            // Filled by compile()
+            bool used = false;
+            bool asyncTouched = false;  // one instance per frame in flight, never aliased
+            uint32_t firstPass = UINT32_MAX;
+            uint32_t lastPass = 0;
+            VkMemoryRequirements requirements{};
+            VkDeviceSize memorySize = 0;
+            uint32_t aliasBlock = UINT32_MAX;
+            VkDeviceSize aliasOffset = 0;
+            std::vector<Physical> physical;
+        };
+
+        struct Access {
+            RenderResource resource = InvalidRenderResource;
+            ResourceUsage usage = ResourceUsage::Sampled;
+            bool write = false;
+            bool discards = false;      // attachment cleared or not loaded: earlier contents are not needed
+        };
+
+        struct Attachment {
+            RenderResource resource = InvalidRenderResource;
+            VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            VkClearValue clear{};
+        };
+
+        struct BarrierTemplate {
+            RenderResource resource = InvalidRenderResource;
+            VkPipelineStageFlags2 srcStages = VK_PIPELINE_STAGE_2_NONE;
+            VkAccessFlags2 srcAccess = VK_ACCESS_2_NONE;
+            VkPipelineStageFlags2 dstStages = VK_PIPELINE_STAGE_2_NONE;
+            VkAccessFlags2 dstAccess = VK_ACCESS_2_NONE;
+            VkImageLayout oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkImageLayout newLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        };
+
+        struct Pass {
+            const char* name = "";
+            PassKind kind = PassKind::Graphics;
+            std::function<void(RenderPassContext&)> execute;
+            std::vector<Access> accesses;
+            std::vector<Attachment> colorAttachments;
+            Attachment depthAttachment;
+            VkRenderingFlags renderingFlags = 0;
+            bool sideEffect = false;
+
+            // Filled by compile()
+            bool live = false;
+            bool async = false;
+            std::vector<BarrierTemplate> barriers;
+        };
+
+        struct UsageInfo {
+            VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE;
+            VkAccessFlags2 access = VK_ACCESS_2_NONE;
+            VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkImageUsageFlags imageUsage = 0;
+            VkBufferUsageFlags bufferUsage = 0;
+        };
+
+        // Hazard tracking for one resource while walking the passes in order.
+        struct ResourceState {
+            VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkPipelineStageFlags2 writeStages = VK_PIPELINE_STAGE_2_NONE;
+            VkAccessFlags2 writeAccess = VK_ACCESS_2_NONE;
+            VkPipelineStageFlags2 readStages = VK_PIPELINE_STAGE_2_NONE;    // reads since the last write
+            VkPipelineStageFlags2 visibleStages = VK_PIPELINE_STAGE_2_NONE; // where the last write is already visible
+            VkAccessFlags2 visibleAccess = VK_ACCESS_2_NONE;
+            bool async = false;                                              // last touched on the compute queue
+        };
+
+        // Transient images sharing one allocation; members never overlap in both memory and lifetime.
+        struct AliasBlock {
+            VkDeviceSize size = 0;
+            VkDeviceSize alignment = 1;
+            uint32_t memoryTypeBits = 0;
+            std::vector<RenderResource> members;
+            DeviceAllocation* allocation = nullptr;
+        };
+
+        struct AsyncFrame {
+            VkCommandPool commandPool = VK_NULL_HANDLE;
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        };
+
+        static bool isWriteUsage(ResourceUsage usage) {
+            return usage == ResourceUsage::ColorAttachment || usage == ResourceUsage::DepthAttachment ||
+                usage == ResourceUsage::StorageWrite || usage == ResourceUsage::TransferDst;
+        }
+
+        static UsageInfo describeUsage(ResourceUsage usage, PassKind kind, bool write) {
+            VkPipelineStageFlags2 shaderStages = kind == PassKind::Graphics
+                ? VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT
+                : VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+            UsageInfo info;
+            switch (usage) {
+            case ResourceUsage::ColorAttachment:
+                info.stages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+                info.access = VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | (write ? VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT : 0);
+                info.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+                break;
+            case ResourceUsage::DepthAttachment:
+            case ResourceUsage::DepthRead:
+                info.stages = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+                info.access = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | (write ? VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT : 0);
+                info.layout = usage == ResourceUsage::DepthRead ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+                info.imageUsage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+                break;
+            case ResourceUsage::Sampled:
+                info.stages = shaderStages;
+                info.access = VK_ACCESS_2_SHADER_READ_BIT;
+                info.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                info.imageUsage = VK_IMAGE_USAGE_SAMPLED_BIT;
+                break;
+            case ResourceUsage::StorageRead:
+            case ResourceUsage::StorageWrite:
+                info.stages = shaderStages;
+                info.access = VK_ACCESS_2_SHADER_READ_BIT | (write ? VK_ACCESS_2_SHADER_WRITE_BIT : 0);
+                info.layout = VK_IMAGE_LAYOUT_GENERAL;
+                info.imageUsage = VK_IMAGE_USAGE_STORAGE_BIT;
+                info.bufferUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+                break;
+            case ResourceUsage::TransferSrc:
+                info.stages = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+                info.access = VK_ACCESS_2_TRANSFER_READ_BIT;
+                info.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+                info.imageUsage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+                info.bufferUsage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+                break;
+            case ResourceUsage::TransferDst:
+                info.stages = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+                info.access = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+                info.layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                info.imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+                info.bufferUsage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+                break;
+            case ResourceUsage::IndirectRead:
+                info.stages = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT;
+                info.access = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT;
+                info.bufferUsage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+                break;
+            case ResourceUsage::VertexRead:
+                info.stages = VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT;
+                info.access = VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT;
+                info.bufferUsage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+                break;
+            case ResourceUsage::UniformRead:
+                info.stages = shaderStages;
+                info.access = VK_ACCESS_2_UNIFORM_READ_BIT;
+                info.bufferUsage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+                break;
+            }
+            return info;
+        }
+
+        RenderResource addTransient(const Resource& resource) {
+            resources.push_back(resource);
+            compiled = false;
+            return static_cast<RenderResource>(resources.size() - 1);
+        }
+
+        void addAccess(uint32_t passIndex, RenderResource id, ResourceUsage usage, bool write, bool discards) {
+            if (id >= resources.size()) {
+                throw std::runtime_error("Render graph pass uses an unknown resource!");
+            }
+            Pass& pass = passes[passIndex];
+            for (const Access& access : pass.accesses) {
+                if (access.resource == id) {
+                    throw std::runtime_error(std::string("Render graph pass ") + pass.name + " uses " + resources[id].name + " twice!");
+                }
+            }
+            Access access;
+            access.resource = id;
+            access.usage = usage;
+            access.write = write;
+            access.discards = discards;
+            pass.accesses.push_back(access);
+        }
+
+        // Walks the passes backwards. A pass is live when it has a side effect or writes something a
+        // later live pass (or, for imported resources, the outside world) still needs.
+        void cullPasses() {
+            std::vector<bool> needed(resources.size(), false);
+            for (uint32_t i = 0; i < resources.size(); i++) {
+                needed[i] = resources[i].imported;
+            }
+            for (size_t p = passes.size(); p-- > 0;) {
+                Pass& pass = passes[p];
+                pass.live = pass.sideEffect;
+                for (const Access& access : pass.accesses) {
+                    if (access.write && needed[access.resource]) {
+                        pass.live = true;
+                    }
+                }
+                if (!pass.live) {
+                    continue;
+                }
+                for (const Access& access : pass.accesses) {
+                    if (access.write) {
+                        needed[access.resource] = !access.discards;
+                    }
+                    else {
+                        needed[access.resource] = true;
+                    }
+                }
+            }
+        }
+
+        // Async compute only takes passes whose resources are private to the compute queue so far this
+        // frame; the graphics queue then waits for them once, at the first stage that consumes them.
+        void assignQueues() {
+            std::vector<bool> touchedByGraphics(resources.size(), false);
+            asyncPassCount = 0;
+            for (Pass& pass : passes) {
+                pass.async = false;
+                if (!pass.live) {
+                    continue;
+                }
+                bool eligible = pass.kind == PassKind::AsyncCompute && asyncQueueAvailable;
+                for (const Access& access : pass.accesses) {
+                    const Resource& resource = resources[access.resource];
+                    if (touchedByGraphics[access.resource] || (resource.imported && (!resource.sharedWithCompute || access.write))) {
+                        eligible = false;
+                    }
+                }
+                pass.async = eligible;
+                if (eligible) {
+                    asyncPassCount++;
+                    continue;
+                }
+                for (const Access& access : pass.accesses) {
+                    touchedByGraphics[access.resource] = true;
+                }
+            }
+        }
+
+        void computeLifetimes() {
+            for (Resource& resource : resources) {
+                resource.used = false;
+                resource.asyncTouched = false;
+                resource.firstPass = UINT32_MAX;
+                resource.lastPass = 0;
+                resource.imageUsage = 0;
+                resource.bufferUsage = 0;
+            }
+            for (uint32_t p = 0; p < passes.size(); p++) {
+                const Pass& pass = passes[p];
+                if (!pass.live) {
+                    continue;
+                }
+                for (const Access& access : pass.accesses) {
+                    Resource& resource = resources[access.resource];
+                    UsageInfo info = describeUsage(access.usage, pass.kind, access.write);
+                    resource.used = true;
+                    resource.asyncTouched = resource.asyncTouched || (pass.async && !resource.imported);
+                    resource.firstPass = std::min(resource.firstPass, p);
+                    resource.lastPass = std::max(resource.lastPass, p);
+                    resource.imageUsage |= info.imageUsage;
+                    resource.bufferUsage |= info.bufferUsage;
+                }
+            }
+        }
+
+        void createPhysicalResources() {
+            uint32_t families[2] = { queues->graphics.family, queues->compute.family };
+            bool concurrent = families[0] != families[1];
+            std::vector<RenderResource> aliasable;
+            for (uint32_t id = 0; id < resources.size(); id++) {
+                Resource& resource = resources[id];
+                if (resource.imported || !resource.used) {
+                    continue;
+                }
+                resource.physical.assign(resource.asyncTouched ? frameCount : 1, Physical{});
+                bool shared = resource.asyncTouched && concurrent;
+                for (Physical& physical : resource.physical) {
+                    if (resource.isImage) {
+                        VkImageCreateInfo imageInfo{};
+                        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+                        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+                        imageInfo.format = resource.image.format;
+                        imageInfo.extent = { resource.image.extent.width, resource.image.extent.height, 1 };
+                        imageInfo.mipLevels = 1;
+                        imageInfo.arrayLayers = 1;
+                        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+                        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+                        imageInfo.usage = resource.imageUsage;
+                        imageInfo.sharingMode = shared ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+                        imageInfo.queueFamilyIndexCount = shared ? 2 : 0;
+                        imageInfo.pQueueFamilyIndices = shared ? families : nullptr;
+                        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                        Allocator::ScopedAllocationTag allocationTag("vkCreateImage");
+                        if (dispatch->vkCreateImage(device, &imageInfo, callbacks, &physical.image) != VK_SUCCESS) {
+                            throw std::runtime_error(std::string("Failed to create render graph image ") + resource.name + "!");
+                        }
+                    }
+                    else {
+                        VkBufferCreateInfo bufferInfo{};
+                        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+                        bufferInfo.size = resource.buffer.size;
+                        bufferInfo.usage = resource.bufferUsage;
+                        bufferInfo.sharingMode = shared ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+                        bufferInfo.queueFamilyIndexCount = shared ? 2 : 0;
+                        bufferInfo.pQueueFamilyIndices = shared ? families : nullptr;
+                        Allocator::ScopedAllocationTag allocationTag("vkCreateBuffer");
+                        if (dispatch->vkCreateBuffer(device, &bufferInfo, callbacks, &physical.buffer) != VK_SUCCESS) {
+                            throw std::runtime_error(std::string("Failed to create render graph buffer ") + resource.name + "!");
+                        }
+                    }
+                }
+
+                if (resource.isImage) {
+                    dispatch->vkGetImageMemoryRequirements(device, resource.physical[0].image, &resource.requirements);
+                    resource.memorySize = resource.requirements.size;
+                }
+                if (resource.isImage && !resource.asyncTouched) {
+                    aliasable.push_back(id);
+                    continue;
+                }
+                for (Physical& physical : resource.physical) {
+                    physical.allocation = resource.isImage
+                        ? memory->allocateForImage(physical.image, MemoryUsage::GpuOnly)
+                        : memory->allocateForBuffer(physical.buffer, MemoryUsage::GpuOnly);
+                }
+            }
+
+            placeAliasedImages(aliasable);
+            for (RenderResource id : aliasable) {
+                Resource& resource = resources[id];
+                const AliasBlock& block = aliasBlocks[resource.aliasBlock];
+                if (dispatch->vkBindImageMemory(device, resource.physical[0].image, block.allocation->memory,
+                    block.allocation->offset + resource.aliasOffset) != VK_SUCCESS) {
+                    throw std::runtime_error(std::string("Failed to bind render graph image ") + resource.name + "!");
+                }
+            }
+
+            for (Resource& resource : resources) {
+                if (resource.imported || !resource.used || !resource.isImage) {
+                    continue;
+                }
+                for (Physical& physical : resource.physical) {
+                    VkImageViewCreateInfo viewInfo{};
+                    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+                    viewInfo.image = physical.image;
+                    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+                    viewInfo.format = resource.image.format;
+                    viewInfo.subresourceRange = { resource.image.aspect, 0, 1, 0, 1 };
+                    Allocator::ScopedAllocationTag allocationTag("vkCreateImageView");
+                    if (dispatch->vkCreateImageView(device, &viewInfo, callbacks, &physical.view) != VK_SUCCESS) {
+                        throw std::runtime_error(std::string("Failed to create render graph image view ") + resource.name + "!");
+                    }
+                }
+            }
+
+            if (asyncPassCount > 0) {
+                createAsyncFrames();
+            }
+        }
+
+        // Largest first; each image takes the lowest offset in the first compatible block where it does
+        // not overlap, in memory, anything alive at the same time.
+        void placeAliasedImages(std::vector<RenderResource> order) {
+            std::sort(order.begin(), order.end(), [this](RenderResource a, RenderResource b) {
+                return resources[a].memorySize > resources[b].memorySize;
+            });
+            for (RenderResource id : order) {
+                Resource& resource = resources[id];
+                bool placed = false;
+                for (uint32_t b = 0; b < aliasBlocks.size() && !placed; b++) {
+                    AliasBlock& block = aliasBlocks[b];
+                    if ((block.memoryTypeBits & resource.requirements.memoryTypeBits) == 0) {
+                        continue;
+                    }
+                    std::vector<std::pair<VkDeviceSize, VkDeviceSize>> occupied;
+                    for (RenderResource other : block.members) {
+                        const Resource& member = resources[other];
+                        if (member.firstPass <= resource.lastPass && resource.firstPass <= member.lastPass) {
+                            occupied.push_back({ member.aliasOffset, member.aliasOffset + member.memorySize });
+                        }
+                    }
+                    std::sort(occupied.begin(), occupied.end());
+                    VkDeviceSize offset = 0;
+                    for (const auto& range : occupied) {
+                        if (alignDeviceSize(offset, resource.requirements.alignment) + resource.memorySize <= range.first) {
+                            break;
+                        }
+                        offset = std::max(offset, range.second);
+                    }
+                    offset = alignDeviceSize(offset, resource.requirements.alignment);
+                    if (offset + resource.memorySize <= block.size) {
+                        resource.aliasBlock = b;
+                        resource.aliasOffset = offset;
+                        block.memoryTypeBits &= resource.requirements.memoryTypeBits;
+                        block.alignment = std::max(block.alignment, resource.requirements.alignment);
+                        block.members.push_back(id);
+                        placed = true;
+                    }
+                }
+                if (!placed) {
+                    AliasBlock block;
+                    block.size = resource.memorySize;
+                    block.alignment = resource.requirements.alignment;
+                    block.memoryTypeBits = resource.requirements.memoryTypeBits;
+                    block.members.push_back(id);
+                    resource.aliasBlock = static_cast<uint32_t>(aliasBlocks.size());
+                    resource.aliasOffset = 0;
+                    aliasBlocks.push_back(block);
+                }
+            }
+            for (AliasBlock& block : aliasBlocks) {
+                VkMemoryRequirements requirements{};
+                requirements.size = block.size;
+                requirements.alignment = block.alignment;
+                requirements.memoryTypeBits = block.memoryTypeBits;
+                block.allocation = memory->allocate(requirements, MemoryUsage::GpuOnly, ResourceKind::Optimal);
+            }
+        }
+
+        void createAsyncFrames() {
+            if (!asyncFrames.empty()) {
+                return;
+            }
+            VkSemaphoreTypeCreateInfo typeInfo{};
+            typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+            typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+            typeInfo.initialValue = 0;
+            VkSemaphoreCreateInfo semaphoreInfo{};
+            semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            semaphoreInfo.pNext = &typeInfo;
+            Allocator::ScopedAllocationTag semaphoreTag("vkCreateSemaphore");
+            if (dispatch->vkCreateSemaphore(device, &semaphoreInfo, callbacks, &asyncTimeline) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create async compute timeline semaphore!");
+            }
+
+            asyncFrames.resize(frameCount);
+            for (AsyncFrame& frame : asyncFrames) {
+                VkCommandPoolCreateInfo poolInfo{};
+                poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+                poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+                poolInfo.queueFamilyIndex = queues->compute.family;
+                Allocator::ScopedAllocationTag poolTag("vkCreateCommandPool");
+                if (dispatch->vkCreateCommandPool(device, &poolInfo, callbacks, &frame.commandPool) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create async compute command pool!");
+                }
+                VkCommandBufferAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocInfo.commandPool = frame.commandPool;
+                allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                allocInfo.commandBufferCount = 1;
+                if (dispatch->vkAllocateCommandBuffers(device, &allocInfo, &frame.commandBuffer) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to allocate async compute command buffer!");
+                }
+            }
+        }
+
+        void destroyPhysicalResources() {
+            for (Resource& resource : resources) {
+                if (resource.imported) {
+                    continue;
+                }
+                for (Physical& physical : resource.physical) {
+                    if (deletion != nullptr) {
+                        uint64_t lastUse = deletion->lastSubmitted();
+                        deletion->retire(physical.view, lastUse);
+                        if (physical.image != VK_NULL_HANDLE) {
+                            deletion->retire(physical.image, physical.allocation, lastUse);
+                        }
+                        else if (physical.buffer != VK_NULL_HANDLE) {
+                            deletion->retire(physical.buffer, physical.allocation, lastUse);
+                        }
+                        else {
+                            deletion->retire(physical.allocation, lastUse);
+                        }
+                        continue;
+                    }
+                    if (physical.view != VK_NULL_HANDLE) {
+                        dispatch->vkDestroyImageView(device, physical.view, callbacks);
+                    }
+                    if (physical.image != VK_NULL_HANDLE) {
+                        dispatch->vkDestroyImage(device, physical.image, callbacks);
+                    }
+                    if (physical.buffer != VK_NULL_HANDLE) {
+                        dispatch->vkDestroyBuffer(device, physical.buffer, callbacks);
+                    }
+                    memory->free(physical.allocation);
+                }
+                resource.physical.clear();
+                resource.aliasBlock = UINT32_MAX;
+                resource.aliasOffset = 0;
+            }
+            for (AliasBlock& block : aliasBlocks) {
+                if (deletion != nullptr) {
+                    deletion->retire(block.allocation, deletion->lastSubmitted());
+                }
+                else {
+                    memory->free(block.allocation);
+                }
+            }
+            aliasBlocks.clear();
+        }
+
+        // State a resource is in before the frame's first pass. Transient resources are discarded each
+        // frame, but their memory may still be in use by the previous frame or by an image aliasing it,
+        // so the first barrier waits for whatever those left pending.
+        ResourceState initialState(RenderResource id, const std::vector<ResourceState>* endOfFrame) const {
+            const Resource& resource = resources[id];
+            ResourceState state;
+            if (resource.imported) {
+                state.layout = resource.initial.layout;
+                state.writeStages = resource.initial.stages;
+                state.writeAccess = resource.initial.access;
+                return state;
+            }
+            if (endOfFrame == nullptr || resource.asyncTouched || !resource.used) {
+                return state; // Per-frame instances: the frame fence already covers their last use
+            }
+            auto addPending = [&state, endOfFrame](RenderResource other) {
+                const ResourceState& last = (*endOfFrame)[other];
+                state.writeStages |= last.writeStages | last.readStages;
+                state.writeAccess |= last.writeAccess;
+            };
+            addPending(id);
+            if (resource.aliasBlock != UINT32_MAX) {
+                for (RenderResource other : aliasBlocks[resource.aliasBlock].members) {
+                    const Resource& member = resources[other];
+                    if (other != id && member.aliasOffset < resource.aliasOffset + resource.memorySize &&
+                        resource.aliasOffset < member.aliasOffset + member.memorySize) {
+                        addPending(other);
+                    }
+                }
+            }
+            return state;
+        }
+
+        // Walks the live passes in order and records, per pass, the barriers its accesses need. Returns
+        // each resource's state after the last pass.
+        std::vector<ResourceState> simulate(std::vector<ResourceState> states) {
+            asyncConsumerStages = 0;
+            for (Pass& pass : passes) {
+                pass.barriers.clear();
+                if (!pass.live) {
+                    continue;
+                }
+                for (const Access& access : pass.accesses) {
+                    const Resource& resource = resources[access.resource];
+                    ResourceState& state = states[access.resource];
+                    UsageInfo info = describeUsage(access.usage, pass.kind, access.write);
+                    VkImageLayout layout = resource.isImage ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+                    bool layoutChange = resource.isImage && state.layout != layout;
+
+                    BarrierTemplate barrier;
+                    barrier.resource = access.resource;
+                    barrier.dstStages = info.stages;
+                    barrier.dstAccess = info.access;
+                    barrier.oldLayout = access.discards ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+                    barrier.newLayout = layout;
+                    bool needed = false;
+
+                    if (pass.async && resource.imported) {
+                        // Only stable, shared imports reach the compute queue; nothing to wait for
+                        needed = false;
+                    }
+                    else if (state.async && !pass.async) {
+                        // The queue submission waits on the async timeline at these stages, which makes
+                        // the compute writes visible; only a layout change still needs a barrier.
+                        asyncConsumerStages |= info.stages;
+                        barrier.srcStages = info.stages;
+                        needed = layoutChange;
+                    }
+                    else if (layoutChange || access.write) {
+                        // Write-after-write, write-after-read, or a layout transition (which is a write)
+                        barrier.srcStages = state.writeStages | state.readStages;
+                        barrier.srcAccess = state.writeAccess;
+                        needed = layoutChange || barrier.srcStages != VK_PIPELINE_STAGE_2_NONE;
+                    }
+                    else if ((info.stages & ~state.visibleStages) != 0 || (info.access & ~state.visibleAccess) != 0) {
+                        // Read-after-write not yet made visible to this stage
+                        barrier.srcStages = state.writeStages;
+                        barrier.srcAccess = state.writeAccess;
+                        needed = barrier.srcStages != VK_PIPELINE_STAGE_2_NONE;
+                    }
+                    if (needed) {
+                        pass.barriers.push_back(barrier);
+                    }
+
+                    state.layout = layout;
+                    state.async = pass.async;
+                    if (access.write) {
+                        state.writeStages = info.stages;
+                        state.writeAccess = info.access & ~(VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                            VK_ACCESS_2_SHADER_READ_BIT);
+                        state.readStages = VK_PIPELINE_STAGE_2_NONE;
+                        state.visibleStages = info.stages;
+                        state.visibleAccess = info.access;
+                    }
+                    else {
+                        state.readStages |= info.stages;
+                        if (needed || layoutChange) {
+                            state.visibleStages |= info.stages;
+                            state.visibleAccess |= info.access;
+                        }
+                    }
+                }
+            }
+
+            finalBarriers.clear();
+            for (RenderResource id = 0; id < resources.size(); id++) {
+                const Resource& resource = resources[id];
+                const ResourceState& state = states[id];
+                if (!resource.imported || !resource.isImage || !resource.used) {
+                    continue;
+                }
+                if (state.layout == resource.final.layout && resource.final.stages == VK_PIPELINE_STAGE_2_NONE) {
+                    continue;
+                }
+                BarrierTemplate barrier;
+                barrier.resource = id;
+                barrier.srcStages = state.writeStages | state.readStages;
+                barrier.srcAccess = state.writeAccess;
+                barrier.dstStages = resource.final.stages;
+                barrier.dstAccess = resource.final.access;
+                barrier.oldLayout = state.layout;
+                barrier.newLayout = resource.final.layout;
+                finalBarriers.push_back(barrier);
+            }
+            return states;
+        }
+
+        const Physical& physicalFor(RenderResource id, uint32_t frameIndex) const {
+            const Resource& resource = resources.at(id);
+            return resource.physical[resource.physical.size() > 1 ? frameIndex : 0];
+        }
+
+        void recordBarriers(VkCommandBuffer commandBuffer, const std::vector<BarrierTemplate>& barriers, uint32_t frameIndex) {
+            if (barriers.empty()) {
+                return;
+            }
+            imageBarriers.clear();
+            bufferBarriers.clear();
+            for (const BarrierTemplate& barrier : barriers) {
+                const Resource& resource = resources[barrier.resource];
+                const Physical& physical = physicalFor(barrier.resource, frameIndex);
+                if (resource.isImage) {
+                    VkImageMemoryBarrier2 imageBarrier{};
+                    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+                    imageBarrier.srcStageMask = barrier.srcStages;
+                    imageBarrier.srcAccessMask = barrier.srcAccess;
+                    imageBarrier.dstStageMask = barrier.dstStages;
+                    imageBarrier.dstAccessMask = barrier.dstAccess;
+                    imageBarrier.oldLayout = barrier.oldLayout;
+                    imageBarrier.newLayout = barrier.newLayout;
+                    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    imageBarrier.image = physical.image;
+                    imageBarrier.subresourceRange = { resource.image.aspect, 0, 1, 0, 1 };
+                    imageBarriers.push_back(imageBarrier);
+                }
+                else {
+                    VkBufferMemoryBarrier2 bufferBarrier{};
+                    bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+                    bufferBarrier.srcStageMask = barrier.srcStages;
+                    bufferBarrier.srcAccessMask = barrier.srcAccess;
+                    bufferBarrier.dstStageMask = barrier.dstStages;
+                    bufferBarrier.dstAccessMask = barrier.dstAccess;
+                    bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    bufferBarrier.buffer = physical.buffer;
+                    bufferBarrier.offset = 0;
+                    bufferBarrier.size = VK_WHOLE_SIZE;
+                    bufferBarriers.push_back(bufferBarrier);
+                }
+            }
+            VkDependencyInfo dependency{};
+            dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+            dependency.bufferMemoryBarrierCount = static_cast<uint32_t>(bufferBarriers.size());
+            dependency.pBufferMemoryBarriers = bufferBarriers.data();
+            dependency.imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size());
+            dependency.pImageMemoryBarriers = imageBarriers.data();
+            dispatch->vkCmdPipelineBarrier2(commandBuffer, &dependency);
+        }
+
+        void recordPass(VkCommandBuffer commandBuffer, Pass& pass, uint32_t frameIndex) {
+            recordBarriers(commandBuffer, pass.barriers, frameIndex);
+            RenderPassContext context;
+            context.commandBuffer = commandBuffer;
+            context.frameIndex = frameIndex;
+            context.graph = this;
+
+            bool rendering = !pass.colorAttachments.empty() || pass.depthAttachment.resource != InvalidRenderResource;
+            if (!rendering) {
+                pass.execute(context);
+                return;
+            }
+            VkRenderingAttachmentInfo colorInfos[8]{};
+            VkRenderingAttachmentInfo depthInfo{};
+            VkExtent2D extent{};
+            for (size_t i = 0; i < pass.colorAttachments.size(); i++) {
+                const Attachment& attachment = pass.colorAttachments[i];
+                colorInfos[i].sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+                colorInfos[i].imageView = physicalFor(attachment.resource, frameIndex).view;
+                colorInfos[i].imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+                colorInfos[i].loadOp = attachment.loadOp;
+                colorInfos[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+                colorInfos[i].clearValue = attachment.clear;
+                extent = resources[attachment.resource].image.extent;
+            }
+            if (pass.depthAttachment.resource != InvalidRenderResource) {
+                depthInfo.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+                depthInfo.imageView = physicalFor(pass.depthAttachment.resource, frameIndex).view;
+                depthInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+                depthInfo.loadOp = pass.depthAttachment.loadOp;
+                depthInfo.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+                depthInfo.clearValue = pass.depthAttachment.clear;
+                extent = resources[pass.depthAttachment.resource].image.extent;
+            }
+            VkRenderingInfo renderingInfo{};
+            renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+            renderingInfo.flags = pass.renderingFlags;
+            renderingInfo.renderArea = { { 0, 0 }, extent };
+            renderingInfo.layerCount = 1;
+            renderingInfo.colorAttachmentCount = static_cast<uint32_t>(pass.colorAttachments.size());
+            renderingInfo.pColorAttachments = colorInfos;
+            renderingInfo.pDepthAttachment = pass.depthAttachment.resource != InvalidRenderResource ? &depthInfo : nullptr;
+            dispatch->vkCmdBeginRendering(commandBuffer, &renderingInfo);
+            pass.execute(context);
+            dispatch->vkCmdEndRendering(commandBuffer);
+        }
+
+        void submitAsyncPasses(uint32_t frameIndex) {
+            CpuZone zone("RecordAsyncCompute");
+            AsyncFrame& frame = asyncFrames[frameIndex];
+            // The caller's frame fence covers this slot's last submission, which waited on our timeline
+            dispatch->vkResetCommandPool(device, frame.commandPool, 0);
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            if (dispatch->vkBeginCommandBuffer(frame.commandBuffer, &beginInfo) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to begin recording async compute command buffer!");
+            }
+            for (Pass& pass : passes) {
+                if (pass.live && pass.async) {
+                    recordPass(frame.commandBuffer, pass, frameIndex);
+                }
+            }
+            if (dispatch->vkEndCommandBuffer(frame.commandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to record async compute command buffer!");
+            }
+
+            uint64_t signalValue = ++asyncValue;
+            VkTimelineSemaphoreSubmitInfo timelineInfo{};
+            timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timelineInfo.signalSemaphoreValueCount = 1;
+            timelineInfo.pSignalSemaphoreValues = &signalValue;
+            VkSubmitInfo submitInfo{};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.pNext = &timelineInfo;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &frame.commandBuffer;
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &asyncTimeline;
+            if (queues->submit(QueueRole::Compute, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to submit async compute command buffer!");
+            }
+            lastAsyncValue = signalValue;
+        }
+
+        DeviceMemoryAllocator* memory = nullptr;
+        DeletionQueue* deletion = nullptr;
+        const DeviceDispatch* dispatch = nullptr;
+        VkDevice device = VK_NULL_HANDLE;
+        const VkAllocationCallbacks* callbacks = nullptr;
+        QueueSet* queues = nullptr;
+        uint32_t frameCount = 1;
+        bool asyncQueueAvailable = false;
+        bool compiled = false;
+
+        std::vector<Pass> passes;
+        std::vector<Resource> resources;
+        std::vector<AliasBlock> aliasBlocks;
+        std::vector<BarrierTemplate> finalBarriers;
+        uint32_t asyncPassCount = 0;
+        VkPipelineStageFlags2 asyncConsumerStages = VK_PIPELINE_STAGE_2_NONE;
+
+        std::vector<AsyncFrame> asyncFrames;
+        VkSemaphore asyncTimeline = VK_NULL_HANDLE;
+        uint64_t asyncValue = 0;
+        uint64_t lastAsyncValue = 0;
+
+        std::vector<VkImageMemoryBarrier2> imageBarriers;   // scratch for recordBarriers()
+        std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+    };
+
+    inline RenderResource RenderPassBuilder::createImage(const char* name, const RenderImageDesc& desc) {
+        RenderGraph::Resource resource;
+        resource.name = name;
+        resource.isImage = true;
+        resource.image = desc;
+        return graph.addTransient(resource);
+    }
+
+    inline RenderResource RenderPassBuilder::createBuffer(const char* name, const RenderBufferDesc& desc) {
+        RenderGraph::Resource resource;
+        resource.name = name;
+        resource.isImage = false;
+        resource.buffer = desc;
+        return graph.addTransient(resource);
+    }
+
+    inline RenderPassBuilder& RenderPassBuilder::read(RenderResource resource, ResourceUsage usage) {
+        graph.addAccess(pass, resource, usage, false, false);
+        return *this;
+    }
+
+    inline RenderPassBuilder& RenderPassBuilder::write(RenderResource resource, ResourceUsage usage) {
+        if (!RenderGraph::isWriteUsage(usage)) {
+            throw std::runtime_error("Render graph write() needs a writable usage!");
+        }
+        graph.addAccess(pass, resource, usage, true, false);
+        return *this;
+    }
+
+    inline RenderPassBuilder& RenderPassBuilder::colorAttachment(RenderResource resource, VkAttachmentLoadOp loadOp, VkClearColorValue clear) {
+        RenderGraph::Pass& target = graph.passes[pass];
+        if (target.colorAttachments.size() >= 8) {
+            throw std::runtime_error("Render graph pass has too many color attachments!");
+        }
+        graph.addAccess(pass, resource, ResourceUsage::ColorAttachment, true, loadOp != VK_ATTACHMENT_LOAD_OP_LOAD);
+        RenderGraph::Attachment attachment;
+        attachment.resource = resource;
+        attachment.loadOp = loadOp;
+        attachment.clear.color = clear;
+        target.colorAttachments.push_back(attachment);
+        return *this;
+    }
+
+    inline RenderPassBuilder& RenderPassBuilder::depthAttachment(RenderResource resource, VkAttachmentLoadOp loadOp, VkClearDepthStencilValue clear) {
+        graph.addAccess(pass, resource, ResourceUsage::DepthAttachment, true, loadOp != VK_ATTACHMENT_LOAD_OP_LOAD);
+        RenderGraph::Attachment& attachment = graph.passes[pass].depthAttachment;
+        attachment.resource = resource;
+        attachment.loadOp = loadOp;
+        attachment.clear.depthStencil = clear;
+        return *this;
+    }
+
+    inline RenderPassBuilder& RenderPassBuilder::secondaryCommandBuffers() {
+        graph.passes[pass].renderingFlags |= VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+        return *this;
+    }
+
+    inline RenderPassBuilder& RenderPassBuilder::sideEffect() {
+        graph.passes[pass].sideEffect = true;
+        return *this;
+    }
+
+    inline VkImage RenderPassContext::image(RenderResource resource) const {
+        return graph->physicalFor(resource, frameIndex).image;
+    }
+
+    inline VkImageView RenderPassContext::imageView(RenderResource resource) const {
+        return graph->physicalFor(resource, frameIndex).view;
+    }
+
+    inline VkBuffer RenderPassContext::buffer(RenderResource resource) const {
+        return graph->physicalFor(resource, frameIndex).buffer;
+    }
+
+    inline VkExtent2D RenderPassContext::extent(RenderResource resource) const {
+        return graph->resources.at(resource).image.extent;
+    }
+
+} // namespace vulkan
@@ -0,0 +1,354 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+#include "JobSystem.hpp"
+#include "SceneMath.hpp"
+
+namespace vulkan {
+
+    // CPU-side transform hierarchy stored as structure-of-arrays columns, so the SceneMath kernels
+    // process 4 (SSE2) or 8 (AVX2) objects per instruction. Nodes are kept sorted by depth: update()
+    // walks one depth level at a time, splitting each level across the job system, and a level only
+    // reads world matrices of the level above it. Setters only mark a node dirty; update() pushes the
+    // dirty flag down to descendants and skips batches where nothing changed, so static subtrees cost
+    // a flag check per node.
+    //
+    // NodeIds are stable. Slots are not: creating nodes re-sorts the columns on the next update().
+    class Scene {
+    public:
+        using NodeId = uint32_t;
+        static constexpr NodeId InvalidNode = ~0u;
+        static constexpr uint32_t UpdateGranularity = 4096;  // nodes per job
+        static constexpr uint32_t CullGranularity = 8192;
+
+        explicit Scene(SimdLevel level = detectSimdLevel()) : kernels(sceneKernels(level)) {
+            // Slot 0: identity world transform that roots use as their parent
+            const float zero[3] = { 0.0f, 0.0f, 0.0f };
+            const float identity[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+            pushSlot(0, zero, identity, 1.0f, zero, zero);
+            for (int row = 0; row < 3; row++) {
+                world[row * 4 + row][0] = 1.0f;
+            }
+            dirty[0] = 0;
+            depth.push_back(0);
+            slotToId.push_back(InvalidNode);
+        }
+
+        void setSimdLevel(SimdLevel level) {
+            kernels = sceneKernels(level);
+        }
+
+        SimdLevel simdLevel() const {
+            return kernels.level;
+        }
+
+        void reserve(uint32_t nodeCount) {
+            for (std::vector<float>* column : floatColumns()) {
+                column->reserve(nodeCount + 1);
+            }
+            parent.reserve(nodeCount + 1);
+            dirty.reserve(nodeCount + 1);
+            changed.reserve(nodeCount + 1);
+            depth.reserve(nodeCount + 1);
+            slotToId.reserve(nodeCount + 1);
+            idToSlot.reserve(nodeCount);
+        }
+
+        uint32_t nodeCount() const {
+            return static_cast<uint32_t>(idToSlot.size());
+        }
+
+        // parentNode InvalidNode makes a root. Bounds are a local AABB; the bounding sphere encloses it.
+        NodeId createNode(NodeId parentNode, const float position[3], const float rotation[4], float scale,
+            const float boundsCenter[3], const float boundsExtent[3]) {
+            uint32_t parentSlot = 0;
+            if (parentNode != InvalidNode) {
+                if (parentNode >= idToSlot.size()) {
+                    throw std::runtime_error("Scene node parent does not exist!");
+                }
+                parentSlot = idToSlot[parentNode];
+            }
+            NodeId id = static_cast<NodeId>(idToSlot.size());
+            uint32_t slot = static_cast<uint32_t>(parent.size());
+            pushSlot(parentSlot, position, rotation, scale, boundsCenter, boundsExtent);
+            depth.push_back(depth[parentSlot] + 1);
+            slotToId.push_back(id);
+            idToSlot.push_back(slot);
+            // A parent's level is already before its child's, but levels have to be contiguous again
+            orderDirty |= slot > 1 && depth[slot] < depth[slot - 1];
+            levelsDirty = true;
+            anyDirty = true;
+            return id;
+        }
+
+        void setPosition(NodeId node, const float value[3]) {
+            uint32_t slot = idToSlot[node];
+            for (int k = 0; k < 3; k++) {
+                position[k][slot] = value[k];
+            }
+            markDirty(slot);
+        }
+
+        // value is a unit quaternion (x, y, z, w).
+        void setRotation(NodeId node, const float value[4]) {
+            uint32_t slot = idToSlot[node];
+            for (int k = 0; k < 4; k++) {
+                rotation[k][slot] = value[k];
+            }
+            markDirty(slot);
+        }
+
+        void setScale(NodeId node, float value) {
+            uint32_t slot = idToSlot[node];
+            scale[slot] = value;
+            markDirty(slot);
+        }
+
+        // Recomputes world matrices and bounds of every node whose transform or ancestor changed.
+        void update(Jobs::JobSystem& jobs) {
+            if (orderDirty) {
+                sortByDepth();
+            }
+            if (levelsDirty) {
+                buildLevels();
+            }
+            if (!anyDirty) {
+                return;
+            }
+            SceneColumns columns = makeColumns();
+            UpdateWorldKernel updateWorld = kernels.updateWorld;
+            for (size_t level = 0; level + 1 < levelStart.size(); level++) {
+                uint32_t begin = levelStart[level];
+                uint32_t count = levelStart[level + 1] - begin;
+                if (count <= UpdateGranularity) {
+                    updateWorld(columns, begin, begin + count);
+                    continue;
+                }
+                std::function<void(uint32_t, uint32_t)> body = [&columns, updateWorld, begin](uint32_t first, uint32_t last) {
+                    updateWorld(columns, begin + first, begin + last);
+                };
+                Jobs::Counter counter;
+                jobs.parallelFor(count, UpdateGranularity, body, counter);
+                jobs.wait(counter);
+            }
+            anyDirty = false;
+        }
+
+        // Frustum-culls world bounds as of the last update() against inward-facing planes (see
+        // extractFrustumPlanes). Returns the visible nodes in slot order.
+        const std::vector<NodeId>& cull(const float planes[6][4], Jobs::JobSystem& jobs) {
+            uint32_t count = static_cast<uint32_t>(parent.size()) - 1;
+            visibleSlots.resize(count);
+            visible.clear();
+            if (count == 0) {
+                return visible;
+            }
+            SceneColumns columns = makeColumns();
+            CullKernel cullKernel = kernels.cull;
+            uint32_t visibleCount = 0;
+            if (count <= CullGranularity) {
+                visibleCount = cullKernel(columns, planes, 1, count + 1, visibleSlots.data());
+            }
+            else {
+                // Each range writes its survivors at its own offset, then the runs are packed together
+                granuleCounts.assign((count + CullGranularity - 1) / CullGranularity, 0);
+                std::function<void(uint32_t, uint32_t)> body = [this, &columns, planes, cullKernel](uint32_t first, uint32_t last) {
+                    granuleCounts[first / CullGranularity] = cullKernel(columns, planes, first + 1, last + 1, visibleSlots.data() + first);
+                };
+                Jobs::Counter counter;
+                jobs.parallelFor(count, CullGranularity, body, counter);
+                jobs.wait(counter);
+                for (size_t granule = 0; granule < granuleCounts.size(); granule++) {
+                    uint32_t* run = visibleSlots.data() + granule * CullGranularity;
+                    std::memmove(visibleSlots.data() + visibleCount, run, granuleCounts[granule] * sizeof(uint32_t));
+                    visibleCount += granuleCounts[granule];
+                }
+            }
+            visible.resize(visibleCount);
+            for (uint32_t i = 0; i < visibleCount; i++) {
+                visible[i] = slotToId[visibleSlots[i]];
+            }
+            return visible;
+        }
+
+        const std::vector<NodeId>& visibleNodes() const {
+            return visible;
+        }
+
+        // Column-major 4x4, as of the last update().
+        void worldMatrix(NodeId node, float out[16]) const {
+            uint32_t slot = idToSlot[node];
+            for (int column = 0; column < 4; column++) {
+                for (int row = 0; row < 3; row++) {
+                    out[column * 4 + row] = world[row * 4 + column][slot];
+                }
+                out[column * 4 + 3] = column == 3 ? 1.0f : 0.0f;
+            }
+        }
+
+        // xyz = center, w = radius, as of the last update().
+        void worldSphere(NodeId node, float out[4]) const {
+            uint32_t slot = idToSlot[node];
+            out[0] = worldCenter[0][slot];
+            out[1] = worldCenter[1][slot];
+            out[2] = worldCenter[2][slot];
+            out[3] = worldRadius[slot];
+        }
+
+    private:
+        SceneKernels kernels;
+        std::vector<float> position[3];
+        std::vector<float> rotation[4];
+        std::vector<float> scale;
+        std::vector<float> boundsCenter[3];
+        std::vector<float> boundsExtent[3];
+        std::vector<float> boundsRadius;
+        std::vector<uint32_t> parent;       // slot of the parent; 0 for roots
+        std::vector<uint8_t> dirty;
+        std::vector<uint8_t> changed;
+        std::vector<float> world[12];
+        std::vector<float> worldCenter[3];
+        std::vector<float> worldExtent[3];
+        std::vector<float> worldRadius;
+        std::vector<uint32_t> depth;        // 0 for the sentinel, 1 for roots
+        std::vector<NodeId> slotToId;
+        std::vector<uint32_t> idToSlot;
+        std::vector<uint32_t> levelStart;   // first slot of each depth level, plus the end
+        std::vector<uint32_t> visibleSlots;
+        std::vector<uint32_t> granuleCounts;
+        std::vector<NodeId> visible;
+        bool orderDirty = false;
+        bool levelsDirty = false;
+        bool anyDirty = false;
+
+        std::vector<std::vector<float>*> floatColumns() {
+            std::vector<std::vector<float>*> columns = { &scale, &boundsRadius, &worldRadius };
+            for (int k = 0; k < 3; k++) {
+                columns.insert(columns.end(), { &position[k], &boundsCenter[k], &boundsExtent[k], &worldCenter[k], &worldExtent[k] });
+            }
+            for (int k = 0; k < 4; k++) {
+                columns.push_back(&rotation[k]);
+            }
+            for (int k = 0; k < 12; k++) {
+                columns.push_back(&world[k]);
+            }
+            return columns;
+        }
+
+        void pushSlot(uint32_t parentSlot, const float nodePosition[3], const float nodeRotation[4], float nodeScale,
+            const float center[3], const float extent[3]) {
+            for (int k = 0; k < 3; k++) {
+                position[k].push_back(nodePosition[k]);
+                boundsCenter[k].push_back(center[k]);
+                boundsExtent[k].push_back(extent[k]);
+                worldCenter[k].push_back(0.0f);
+                worldExtent[k].push_back(0.0f);
+            }
+            for (int k = 0; k < 4; k++) {
+                rotation[k].push_back(nodeRotation[k]);
+            }
+            for (int k = 0; k < 12; k++) {
+                world[k].push_back(0.0f);
+            }
+            scale.push_back(nodeScale);
+            boundsRadius.push_back(std::sqrt(extent[0] * extent[0] + extent[1] * extent[1] + extent[2] * extent[2]));
+            worldRadius.push_back(0.0f);
+            parent.push_back(parentSlot);
+            dirty.push_back(1);
+            changed.push_back(0);
+        }
+
+        void markDirty(uint32_t slot) {
+            dirty[slot] = 1;
+            anyDirty = true;
+        }
+
+        SceneColumns makeColumns() {
+            SceneColumns columns;
+            for (int k = 0; k < 3; k++) {
+                columns.position[k] = position[k].data();
+                columns.boundsCenter[k] = boundsCenter[k].data();
+                columns.boundsExtent[k] = boundsExtent[k].data();
+                columns.worldCenter[k] = worldCenter[k].data();
+                columns.worldExtent[k] = worldExtent[k].data();
+            }
+            for (int k = 0; k < 4; k++) {
+                columns.rotation[k] = rotation[k].data();
+            }
+            for (int k = 0; k < 12; k++) {
+                columns.world[k] = world[k].data();
+            }
+            columns.scale = scale.data();
+            columns.boundsRadius = boundsRadius.data();
+            columns.parent = parent.data();
+            columns.dirty = dirty.data();
+            columns.changed = changed.data();
+            columns.worldRadius = worldRadius.data();
+            return columns;
+        }
+
+        // Stable counting sort by depth; parents keep preceding their children. Everything is marked
+        // dirty afterwards since the flags are cheaper to reset than to permute.
+        void sortByDepth() {
+            uint32_t slotCount = static_cast<uint32_t>(parent.size());
+            uint32_t maxDepth = *std::max_element(depth.begin(), depth.end());
+            std::vector<uint32_t> next(maxDepth + 2, 0);
+            for (uint32_t slot = 1; slot < slotCount; slot++) {
+                next[depth[slot] + 1]++;
+            }
+            next[1] = 1; // Depth 0 is only the sentinel
+            for (uint32_t d = 1; d <= maxDepth; d++) {
+                next[d + 1] += next[d];
+            }
+            std::vector<uint32_t> newSlot(slotCount, 0);
+            for (uint32_t slot = 1; slot < slotCount; slot++) {
+                newSlot[slot] = next[depth[slot]]++;
+            }
+
+            for (std::vector<float>* column : floatColumns()) {
+                permute(*column, newSlot);
+            }
+            std::vector<uint32_t> oldParent = parent;
+            for (uint32_t slot = 1; slot < slotCount; slot++) {
+                parent[newSlot[slot]] = newSlot[oldParent[slot]];
+            }
+            permute(depth, newSlot);
+            permute(slotToId, newSlot);
+            for (uint32_t slot = 1; slot < slotCount; slot++) {
+                idToSlot[slotToId[slot]] = slot;
+            }
+            std::fill(dirty.begin() + 1, dirty.end(), uint8_t(1));
+            anyDirty = true;
+            orderDirty = false;
+            levelsDirty = true;
+        }
+
+        template <typename T>
+        static void permute(std::vector<T>& column, const std::vector<uint32_t>& newSlot) {
+            std::vector<T> sorted(column.size());
+            sorted[0] = column[0];
+            for (size_t slot = 1; slot < column.size(); slot++) {
+                sorted[newSlot[slot]] = column[slot];
+            }
+            column.swap(sorted);
+        }
+
+        void buildLevels() {
+            levelStart.clear();
+            uint32_t slotCount = static_cast<uint32_t>(parent.size());
+            for (uint32_t slot = 1; slot < slotCount; slot++) {
+                if (slot == 1 || depth[slot] != depth[slot - 1]) {
+                    levelStart.push_back(slot);
+                }
+            }
+            levelStart.push_back(slotCount);
+            levelsDirty = false;
+        }
+    };
+
+} // namespace vulkan
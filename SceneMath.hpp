@@ -0,0 +1,491 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#if defined(__x86_64__) || defined(_M_X64)
+#define VKL_SCENE_SIMD 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define VKL_TARGET_AVX2
+#else
+#define VKL_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#else
+#define VKL_SCENE_SIMD 0
+#endif
+
+namespace vulkan {
+
+    // Column-major view-projection for Vulkan clip space (y down, depth 0..1), right-handed view.
+    inline void makeViewProjection(const float eye[3], const float target[3], float fovYRadians, float aspect,
+        float nearPlane, float farPlane, float out[16]) {
+        float forward[3] = { target[0] - eye[0], target[1] - eye[1], target[2] - eye[2] };
+        float length = std::sqrt(forward[0] * forward[0] + forward[1] * forward[1] + forward[2] * forward[2]);
+        for (float& component : forward) {
+            component /= length;
+        }
+        // Up is +y; side = forward x up, then re-orthogonalized up = side x forward
+        float side[3] = { -forward[2], 0.0f, forward[0] };
+        length = std::sqrt(side[0] * side[0] + side[2] * side[2]);
+        if (length < 1e-6f) {
+            side[0] = 1.0f;
+            length = 1.0f;
+        }
+        side[0] /= length;
+        side[2] /= length;
+        float up[3] = {
+            side[1] * forward[2] - side[2] * forward[1],
+            side[2] * forward[0] - side[0] * forward[2],
+            side[0] * forward[1] - side[1] * forward[0]
+        };
+        float view[16] = {
+            side[0], up[0], -forward[0], 0.0f,
+            side[1], up[1], -forward[1], 0.0f,
+            side[2], up[2], -forward[2], 0.0f,
+            -(side[0] * eye[0] + side[1] * eye[1] + side[2] * eye[2]),
+            -(up[0] * eye[0] + up[1] * eye[1] + up[2] * eye[2]),
+            forward[0] * eye[0] + forward[1] * eye[1] + forward[2] * eye[2],
+            1.0f
+        };
+        float f = 1.0f / std::tan(fovYRadians * 0.5f);
+        float projection[16] = {
+            f / aspect, 0.0f, 0.0f, 0.0f,
+            0.0f, -f, 0.0f, 0.0f,
+            0.0f, 0.0f, farPlane / (nearPlane - farPlane), -1.0f,
+            0.0f, 0.0f, nearPlane * farPlane / (nearPlane - farPlane), 0.0f
+        };
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 4; row++) {
+                float sum = 0.0f;
+                for (int k = 0; k < 4; k++) {
+                    sum += projection[k * 4 + row] * view[column * 4 + k];
+                }
+                out[column * 4 + row] = sum;
+            }
+        }
+    }
+
+    // Gribb-Hartmann plane extraction for a 0..1 depth range; planes face inward and are normalized,
+    // so dot(plane.xyz, p) + plane.w is a signed distance.
+    inline void extractFrustumPlanes(const float viewProjection[16], float planes[6][4]) {
+        auto row = [viewProjection](int r, int column) { return viewProjection[column * 4 + r]; };
+        for (int column = 0; column < 4; column++) {
+            planes[0][column] = row(3, column) + row(0, column);   // left
+            planes[1][column] = row(3, column) - row(0, column);   // right
+            planes[2][column] = row(3, column) + row(1, column);   // bottom
+            planes[3][column] = row(3, column) - row(1, column);   // top
+            planes[4][column] = row(2, column);                    // near
+            planes[5][column] = row(3, column) - row(2, column);   // far
+        }
+        for (int plane = 0; plane < 6; plane++) {
+            float* p = planes[plane];
+            float length = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+            for (int component = 0; component < 4; component++) {
+                p[component] /= length;
+            }
+        }
+    }
+
+    // Unit quaternion for a rotation of angle radians about a unit axis.
+    inline void quaternionFromAxisAngle(const float axis[3], float angle, float out[4]) {
+        float s = std::sin(angle * 0.5f);
+        out[0] = axis[0] * s;
+        out[1] = axis[1] * s;
+        out[2] = axis[2] * s;
+        out[3] = std::cos(angle * 0.5f);
+    }
+
+    enum class SimdLevel {
+        Scalar,
+        Sse,        // SSE2, 4 objects per instruction
+        Avx2        // AVX2 + FMA, 8 objects per instruction
+    };
+
+    inline const char* simdLevelName(SimdLevel level) {
+        switch (level) {
+        case SimdLevel::Avx2: return "avx2";
+        case SimdLevel::Sse: return "sse2";
+        default: return "scalar";
+        }
+    }
+
+    inline bool parseSimdLevel(const char* name, SimdLevel& level) {
+        for (SimdLevel candidate : { SimdLevel::Scalar, SimdLevel::Sse, SimdLevel::Avx2 }) {
+            if (std::strcmp(name, simdLevelName(candidate)) == 0) {
+                level = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Best level this CPU and OS support. SSE2 is part of x86-64; AVX2 also needs the OS to save
+    // the YMM registers, which both checks below include.
+    inline SimdLevel detectSimdLevel() {
+#if VKL_SCENE_SIMD
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 1);
+        bool fma = (info[2] & (1 << 12)) != 0;
+        bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        bool avx2 = (info[1] & (1 << 5)) != 0;
+        return avx2 && fma && osSavesYmm ? SimdLevel::Avx2 : SimdLevel::Sse;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? SimdLevel::Avx2 : SimdLevel::Sse;
+#endif
+#else
+        return SimdLevel::Scalar;
+#endif
+    }
+
+    // Never above what detectSimdLevel() reports.
+    inline SimdLevel clampSimdLevel(SimdLevel requested) {
+        return std::min(requested, detectSimdLevel());
+    }
+
+    // SoA columns the scene kernels work on, indexed by slot. Slot 0 is an identity sentinel that
+    // roots use as their parent, so every lane of a batch can gather a parent. Parents always sit in
+    // lower slots than their children, and slots are grouped by depth.
+    struct SceneColumns {
+        const float* position[3];
+        const float* rotation[4];       // x, y, z, w of a unit quaternion
+        const float* scale;             // uniform, so bounding spheres stay spheres
+        const float* boundsCenter[3];   // local AABB center, also the bounding sphere's center
+        const float* boundsExtent[3];   // local AABB half extents
+        const float* boundsRadius;      // local bounding sphere radius
+        const uint32_t* parent;
+        uint8_t* dirty;                 // local transform changed; cleared by updateWorld
+        uint8_t* changed;               // world transform changed in this update
+        float* world[12];               // row-major 3x4 affine (rotation-scale | translation)
+        float* worldCenter[3];
+        float* worldExtent[3];
+        float* worldRadius;
+    };
+
+    // updateWorld recomputes [begin, end) of one depth level: world = parent world * local(TRS),
+    // then world-space AABB and sphere. Lanes whose own and parent's transforms did not change are
+    // skipped a batch at a time. cull writes the slots in [begin, end) whose sphere and AABB both
+    // intersect the frustum to visible, returning how many it wrote.
+    using UpdateWorldKernel = void (*)(const SceneColumns& columns, uint32_t begin, uint32_t end);
+    using CullKernel = uint32_t (*)(const SceneColumns& columns, const float planes[6][4], uint32_t begin, uint32_t end, uint32_t* visible);
+
+    struct SceneKernels {
+        SimdLevel level = SimdLevel::Scalar;
+        UpdateWorldKernel updateWorld = nullptr;
+        CullKernel cull = nullptr;
+    };
+
+    namespace SceneKernelsScalar {
+
+        inline void updateNode(const SceneColumns& c, uint32_t i) {
+            uint8_t changed = c.dirty[i] | c.changed[c.parent[i]];
+            c.changed[i] = changed;
+            c.dirty[i] = 0;
+            if (!changed) {
+                return;
+            }
+            float x = c.rotation[0][i], y = c.rotation[1][i], z = c.rotation[2][i], w = c.rotation[3][i];
+            float s = c.scale[i];
+            float local[3][4] = {
+                { s * (1.0f - 2.0f * (y * y + z * z)), s * 2.0f * (x * y - w * z), s * 2.0f * (x * z + w * y), c.position[0][i] },
+                { s * 2.0f * (x * y + w * z), s * (1.0f - 2.0f * (x * x + z * z)), s * 2.0f * (y * z - w * x), c.position[1][i] },
+                { s * 2.0f * (x * z - w * y), s * 2.0f * (y * z + w * x), s * (1.0f - 2.0f * (x * x + y * y)), c.position[2][i] }
+            };
+            uint32_t p = c.parent[i];
+            float world[3][4];
+            for (int r = 0; r < 3; r++) {
+                float p0 = c.world[r * 4 + 0][p], p1 = c.world[r * 4 + 1][p], p2 = c.world[r * 4 + 2][p];
+                for (int column = 0; column < 4; column++) {
+                    world[r][column] = p0 * local[0][column] + p1 * local[1][column] + p2 * local[2][column];
+                }
+                world[r][3] += c.world[r * 4 + 3][p];
+            }
+            for (int k = 0; k < 12; k++) {
+                c.world[k][i] = world[k / 4][k % 4];
+            }
+
+            float center[3] = { c.boundsCenter[0][i], c.boundsCenter[1][i], c.boundsCenter[2][i] };
+            float extent[3] = { c.boundsExtent[0][i], c.boundsExtent[1][i], c.boundsExtent[2][i] };
+            float maxScale2 = 0.0f;
+            for (int r = 0; r < 3; r++) {
+                c.worldCenter[r][i] = world[r][0] * center[0] + world[r][1] * center[1] + world[r][2] * center[2] + world[r][3];
+                c.worldExtent[r][i] = std::fabs(world[r][0]) * extent[0] + std::fabs(world[r][1]) * extent[1] + std::fabs(world[r][2]) * extent[2];
+                maxScale2 = std::max(maxScale2, world[0][r] * world[0][r] + world[1][r] * world[1][r] + world[2][r] * world[2][r]);
+            }
+            c.worldRadius[i] = c.boundsRadius[i] * std::sqrt(maxScale2);
+        }
+
+        inline bool visible(const SceneColumns& c, const float planes[6][4], uint32_t i) {
+            float x = c.worldCenter[0][i], y = c.worldCenter[1][i], z = c.worldCenter[2][i];
+            for (int p = 0; p < 6; p++) {
+                const float* plane = planes[p];
+                float distance = plane[0] * x + plane[1] * y + plane[2] * z + plane[3];
+                float reach = std::fabs(plane[0]) * c.worldExtent[0][i] + std::fabs(plane[1]) * c.worldExtent[1][i] + std::fabs(plane[2]) * c.worldExtent[2][i];
+                if (distance < -c.worldRadius[i] || distance < -reach) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        inline void updateWorld(const SceneColumns& c, uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                updateNode(c, i);
+            }
+        }
+
+        inline uint32_t cull(const SceneColumns& c, const float planes[6][4], uint32_t begin, uint32_t end, uint32_t* out) {
+            uint32_t count = 0;
+            for (uint32_t i = begin; i < end; i++) {
+                if (visible(c, planes, i)) {
+                    out[count++] = i;
+                }
+            }
+            return count;
+        }
+
+    } // namespace SceneKernelsScalar
+
+    // Flags for a batch of lanes: marks changed = dirty | parent changed, clears dirty, and returns
+    // whether any lane needs recomputing.
+    inline bool propagateFlags(const SceneColumns& c, uint32_t i, uint32_t lanes) {
+        bool any = false;
+        for (uint32_t lane = 0; lane < lanes; lane++) {
+            uint8_t changed = c.dirty[i + lane] | c.changed[c.parent[i + lane]];
+            c.changed[i + lane] = changed;
+            any |= changed != 0;
+        }
+        std::memset(c.dirty + i, 0, lanes);
+        return any;
+    }
+
+#if VKL_SCENE_SIMD
+    // Index of the lowest set bit of a non-zero lane mask.
+    inline uint32_t lowestLane(unsigned mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<uint32_t>(index);
+#else
+        return static_cast<uint32_t>(__builtin_ctz(mask));
+#endif
+    }
+
+    namespace SceneKernelsSse {
+
+        inline __m128 gather(const float* column, const uint32_t* index) {
+            return _mm_setr_ps(column[index[0]], column[index[1]], column[index[2]], column[index[3]]);
+        }
+
+        inline __m128 absolute(__m128 value) {
+            return _mm_andnot_ps(_mm_set1_ps(-0.0f), value);
+        }
+
+        inline void updateWorld(const SceneColumns& c, uint32_t begin, uint32_t end) {
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128 two = _mm_set1_ps(2.0f);
+            uint32_t i = begin;
+            for (; i + 4 <= end; i += 4) {
+                if (!propagateFlags(c, i, 4)) {
+                    continue; // Static batch: world and bounds are still valid
+                }
+                __m128 x = _mm_loadu_ps(c.rotation[0] + i), y = _mm_loadu_ps(c.rotation[1] + i);
+                __m128 z = _mm_loadu_ps(c.rotation[2] + i), w = _mm_loadu_ps(c.rotation[3] + i);
+                __m128 s = _mm_loadu_ps(c.scale + i);
+                __m128 s2 = _mm_mul_ps(s, two);
+                __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+                __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+                __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+                __m128 local[3][4] = {
+                    { _mm_mul_ps(s, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)))), _mm_mul_ps(s2, _mm_sub_ps(xy, wz)),
+                      _mm_mul_ps(s2, _mm_add_ps(xz, wy)), _mm_loadu_ps(c.position[0] + i) },
+                    { _mm_mul_ps(s2, _mm_add_ps(xy, wz)), _mm_mul_ps(s, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz)))),
+                      _mm_mul_ps(s2, _mm_sub_ps(yz, wx)), _mm_loadu_ps(c.position[1] + i) },
+                    { _mm_mul_ps(s2, _mm_sub_ps(xz, wy)), _mm_mul_ps(s2, _mm_add_ps(yz, wx)),
+                      _mm_mul_ps(s, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)))), _mm_loadu_ps(c.position[2] + i) }
+                };
+                const uint32_t* parents = c.parent + i;
+                __m128 world[3][4];
+                for (int r = 0; r < 3; r++) {
+                    __m128 p0 = gather(c.world[r * 4 + 0], parents), p1 = gather(c.world[r * 4 + 1], parents), p2 = gather(c.world[r * 4 + 2], parents);
+                    for (int column = 0; column < 4; column++) {
+                        world[r][column] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p0, local[0][column]), _mm_mul_ps(p1, local[1][column])), _mm_mul_ps(p2, local[2][column]));
+                    }
+                    world[r][3] = _mm_add_ps(world[r][3], gather(c.world[r * 4 + 3], parents));
+                    for (int column = 0; column < 4; column++) {
+                        _mm_storeu_ps(c.world[r * 4 + column] + i, world[r][column]);
+                    }
+                }
+
+                __m128 center[3] = { _mm_loadu_ps(c.boundsCenter[0] + i), _mm_loadu_ps(c.boundsCenter[1] + i), _mm_loadu_ps(c.boundsCenter[2] + i) };
+                __m128 extent[3] = { _mm_loadu_ps(c.boundsExtent[0] + i), _mm_loadu_ps(c.boundsExtent[1] + i), _mm_loadu_ps(c.boundsExtent[2] + i) };
+                __m128 maxScale2 = _mm_setzero_ps();
+                for (int r = 0; r < 3; r++) {
+                    __m128 worldCenter = _mm_add_ps(_mm_add_ps(_mm_mul_ps(world[r][0], center[0]), _mm_mul_ps(world[r][1], center[1])),
+                        _mm_add_ps(_mm_mul_ps(world[r][2], center[2]), world[r][3]));
+                    __m128 worldExtent = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absolute(world[r][0]), extent[0]), _mm_mul_ps(absolute(world[r][1]), extent[1])),
+                        _mm_mul_ps(absolute(world[r][2]), extent[2]));
+                    _mm_storeu_ps(c.worldCenter[r] + i, worldCenter);
+                    _mm_storeu_ps(c.worldExtent[r] + i, worldExtent);
+                    __m128 columnLength2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(world[0][r], world[0][r]), _mm_mul_ps(world[1][r], world[1][r])),
+                        _mm_mul_ps(world[2][r], world[2][r]));
+                    maxScale2 = _mm_max_ps(maxScale2, columnLength2);
+                }
+                _mm_storeu_ps(c.worldRadius + i, _mm_mul_ps(_mm_loadu_ps(c.boundsRadius + i), _mm_sqrt_ps(maxScale2)));
+            }
+            SceneKernelsScalar::updateWorld(c, i, end);
+        }
+
+        inline uint32_t cull(const SceneColumns& c, const float planes[6][4], uint32_t begin, uint32_t end, uint32_t* out) {
+            __m128 normal[6][3], offset[6], reachNormal[6][3];
+            for (int p = 0; p < 6; p++) {
+                for (int k = 0; k < 3; k++) {
+                    normal[p][k] = _mm_set1_ps(planes[p][k]);
+                    reachNormal[p][k] = _mm_set1_ps(std::fabs(planes[p][k]));
+                }
+                offset[p] = _mm_set1_ps(planes[p][3]);
+            }
+            uint32_t count = 0;
+            uint32_t i = begin;
+            for (; i + 4 <= end; i += 4) {
+                __m128 x = _mm_loadu_ps(c.worldCenter[0] + i), y = _mm_loadu_ps(c.worldCenter[1] + i), z = _mm_loadu_ps(c.worldCenter[2] + i);
+                __m128 ex = _mm_loadu_ps(c.worldExtent[0] + i), ey = _mm_loadu_ps(c.worldExtent[1] + i), ez = _mm_loadu_ps(c.worldExtent[2] + i);
+                __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(c.worldRadius + i));
+                __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                for (int p = 0; p < 6; p++) {
+                    __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normal[p][0], x), _mm_mul_ps(normal[p][1], y)),
+                        _mm_add_ps(_mm_mul_ps(normal[p][2], z), offset[p]));
+                    __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(reachNormal[p][0], ex), _mm_mul_ps(reachNormal[p][1], ey)), _mm_mul_ps(reachNormal[p][2], ez));
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+                }
+                for (int mask = _mm_movemask_ps(inside); mask != 0; mask &= mask - 1) {
+                    out[count++] = i + lowestLane(static_cast<unsigned>(mask));
+                }
+            }
+            return count + SceneKernelsScalar::cull(c, planes, i, end, out + count);
+        }
+
+    } // namespace SceneKernelsSse
+
+    namespace SceneKernelsAvx2 {
+
+        VKL_TARGET_AVX2 inline __m256 gather(const float* column, __m256i index) {
+            return _mm256_i32gather_ps(column, index, 4);
+        }
+
+        VKL_TARGET_AVX2 inline __m256 absolute(__m256 value) {
+            return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), value);
+        }
+
+        VKL_TARGET_AVX2 inline void updateWorld(const SceneColumns& c, uint32_t begin, uint32_t end) {
+            const __m256 one = _mm256_set1_ps(1.0f);
+            const __m256 two = _mm256_set1_ps(2.0f);
+            uint32_t i = begin;
+            for (; i + 8 <= end; i += 8) {
+                if (!propagateFlags(c, i, 8)) {
+                    continue; // Static batch: world and bounds are still valid
+                }
+                __m256 x = _mm256_loadu_ps(c.rotation[0] + i), y = _mm256_loadu_ps(c.rotation[1] + i);
+                __m256 z = _mm256_loadu_ps(c.rotation[2] + i), w = _mm256_loadu_ps(c.rotation[3] + i);
+                __m256 s = _mm256_loadu_ps(c.scale + i);
+                __m256 s2 = _mm256_mul_ps(s, two);
+                __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+                __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+                __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+                __m256 local[3][4] = {
+                    { _mm256_mul_ps(s, _mm256_fnmadd_ps(two, _mm256_add_ps(yy, zz), one)), _mm256_mul_ps(s2, _mm256_sub_ps(xy, wz)),
+                      _mm256_mul_ps(s2, _mm256_add_ps(xz, wy)), _mm256_loadu_ps(c.position[0] + i) },
+                    { _mm256_mul_ps(s2, _mm256_add_ps(xy, wz)), _mm256_mul_ps(s, _mm256_fnmadd_ps(two, _mm256_add_ps(xx, zz), one)),
+                      _mm256_mul_ps(s2, _mm256_sub_ps(yz, wx)), _mm256_loadu_ps(c.position[1] + i) },
+                    { _mm256_mul_ps(s2, _mm256_sub_ps(xz, wy)), _mm256_mul_ps(s2, _mm256_add_ps(yz, wx)),
+                      _mm256_mul_ps(s, _mm256_fnmadd_ps(two, _mm256_add_ps(xx, yy), one)), _mm256_loadu_ps(c.position[2] + i) }
+                };
+                __m256i parents = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(c.parent + i));
+                __m256 world[3][4];
+                for (int r = 0; r < 3; r++) {
+                    __m256 p0 = gather(c.world[r * 4 + 0], parents), p1 = gather(c.world[r * 4 + 1], parents), p2 = gather(c.world[r * 4 + 2], parents);
+                    for (int column = 0; column < 4; column++) {
+                        world[r][column] = _mm256_fmadd_ps(p2, local[2][column], _mm256_fmadd_ps(p1, local[1][column], _mm256_mul_ps(p0, local[0][column])));
+                    }
+                    world[r][3] = _mm256_add_ps(world[r][3], gather(c.world[r * 4 + 3], parents));
+                    for (int column = 0; column < 4; column++) {
+                        _mm256_storeu_ps(c.world[r * 4 + column] + i, world[r][column]);
+                    }
+                }
+
+                __m256 center[3] = { _mm256_loadu_ps(c.boundsCenter[0] + i), _mm256_loadu_ps(c.boundsCenter[1] + i), _mm256_loadu_ps(c.boundsCenter[2] + i) };
+                __m256 extent[3] = { _mm256_loadu_ps(c.boundsExtent[0] + i), _mm256_loadu_ps(c.boundsExtent[1] + i), _mm256_loadu_ps(c.boundsExtent[2] + i) };
+                __m256 maxScale2 = _mm256_setzero_ps();
+                for (int r = 0; r < 3; r++) {
+                    __m256 worldCenter = _mm256_fmadd_ps(world[r][2], center[2], _mm256_fmadd_ps(world[r][1], center[1], _mm256_fmadd_ps(world[r][0], center[0], world[r][3])));
+                    __m256 worldExtent = _mm256_fmadd_ps(absolute(world[r][2]), extent[2], _mm256_fmadd_ps(absolute(world[r][1]), extent[1], _mm256_mul_ps(absolute(world[r][0]), extent[0])));
+                    _mm256_storeu_ps(c.worldCenter[r] + i, worldCenter);
+                    _mm256_storeu_ps(c.worldExtent[r] + i, worldExtent);
+                    __m256 columnLength2 = _mm256_fmadd_ps(world[2][r], world[2][r], _mm256_fmadd_ps(world[1][r], world[1][r], _mm256_mul_ps(world[0][r], world[0][r])));
+                    maxScale2 = _mm256_max_ps(maxScale2, columnLength2);
+                }
+                _mm256_storeu_ps(c.worldRadius + i, _mm256_mul_ps(_mm256_loadu_ps(c.boundsRadius + i), _mm256_sqrt_ps(maxScale2)));
+            }
+            SceneKernelsScalar::updateWorld(c, i, end);
+        }
+
+        VKL_TARGET_AVX2 inline uint32_t cull(const SceneColumns& c, const float planes[6][4], uint32_t begin, uint32_t end, uint32_t* out) {
+            __m256 normal[6][3], offset[6], reachNormal[6][3];
+            for (int p = 0; p < 6; p++) {
+                for (int k = 0; k < 3; k++) {
+                    normal[p][k] = _mm256_set1_ps(planes[p][k]);
+                    reachNormal[p][k] = _mm256_set1_ps(std::fabs(planes[p][k]));
+                }
+                offset[p] = _mm256_set1_ps(planes[p][3]);
+            }
+            uint32_t count = 0;
+            uint32_t i = begin;
+            for (; i + 8 <= end; i += 8) {
+                __m256 x = _mm256_loadu_ps(c.worldCenter[0] + i), y = _mm256_loadu_ps(c.worldCenter[1] + i), z = _mm256_loadu_ps(c.worldCenter[2] + i);
+                __m256 ex = _mm256_loadu_ps(c.worldExtent[0] + i), ey = _mm256_loadu_ps(c.worldExtent[1] + i), ez = _mm256_loadu_ps(c.worldExtent[2] + i);
+                __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(c.worldRadius + i));
+                __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+                for (int p = 0; p < 6; p++) {
+                    __m256 distance = _mm256_fmadd_ps(normal[p][2], z, _mm256_fmadd_ps(normal[p][1], y, _mm256_fmadd_ps(normal[p][0], x, offset[p])));
+                    __m256 reach = _mm256_fmadd_ps(reachNormal[p][2], ez, _mm256_fmadd_ps(reachNormal[p][1], ey, _mm256_mul_ps(reachNormal[p][0], ex)));
+                    inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+                    inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, reach), _mm256_setzero_ps(), _CMP_GE_OQ));
+                }
+                for (int mask = _mm256_movemask_ps(inside); mask != 0; mask &= mask - 1) {
+                    out[count++] = i + lowestLane(static_cast<unsigned>(mask));
+                }
+            }
+            return count + SceneKernelsScalar::cull(c, planes, i, end, out + count);
+        }
+
+    } // namespace SceneKernelsAvx2
+#endif
+
+    inline SceneKernels sceneKernels(SimdLevel level) {
+        SceneKernels kernels;
+        kernels.level = clampSimdLevel(level);
+        switch (kernels.level) {
+#if VKL_SCENE_SIMD
+        case SimdLevel::Avx2:
+            kernels.updateWorld = SceneKernelsAvx2::updateWorld;
+            kernels.cull = SceneKernelsAvx2::cull;
+            break;
+        case SimdLevel::Sse:
+            kernels.updateWorld = SceneKernelsSse::updateWorld;
+            kernels.cull = SceneKernelsSse::cull;
+            break;
+#endif
+        default:
+            kernels.updateWorld = SceneKernelsScalar::updateWorld;
+            kernels.cull = SceneKernelsScalar::cull;
+            break;
+        }
+        return kernels;
+    }
+
+} // namespace vulkan
@@ -0,0 +1,520 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "DeferredDeletion.hpp"
+#include "JobSystem.hpp"
+#include "PipelineCache.hpp"
+#include "VulkanDispatch.hpp"
+
+namespace vulkan {
+
+    enum class ShaderStage {
+        Vertex,
+        Fragment,
+        Compute
+    };
+
+    struct ShaderDesc {
+        std::string path;                           // relative to the shader directory
+        ShaderStage stage = ShaderStage::Compute;   // GLSL takes it from the extension; .hlsl needs it set
+        std::string entryPoint = "main";            // HLSL only; GLSL entry points are always main
+        std::vector<std::pair<std::string, std::string>> defines;   // [A-Za-z0-9_] names, [A-Za-z0-9_.] values
+    };
+
+    using ShaderId = uint32_t;
+    constexpr ShaderId InvalidShader = UINT32_MAX;
+
+    // GLSL (.vert/.frag/.comp, through glslangValidator) and HLSL (.hlsl, through dxc) to SPIR-V.
+    //
+    // request() schedules the compile on the job system, so a cold start builds every permutation in
+    // parallel. Results are cached in cacheDirectory under a hash of the source with its includes
+    // expanded, the defines, stage, entry point and the compiler's version string; a cache hit skips
+    // the compiler entirely. VkShaderModules are created on first use by module(). When the compiler
+    // is not installed, a prebuilt "<path>.spv" next to the source is used instead.
+    //
+    // With hot reload on, a watcher thread polls the sources and includes and recompiles changed
+    // shaders itself: the frame loop helps run job system jobs while it waits, so a compiler process
+    // on the pool could stall a frame. poll() publishes finished reloads on the frame thread and bumps
+    // version(); consumers rebuild their pipelines when it changes. A failed reload keeps the old SPIR-V.
+    //
+    // request(), module() and version() are thread-safe.
+    class ShaderSystem {
+    public:
+        ShaderSystem() = default;
+        ShaderSystem(const ShaderSystem&) = delete;
+        ShaderSystem& operator=(const ShaderSystem&) = delete;
+
+        ~ShaderSystem() {
+            stopWatcher();
+        }
+
+        void init(const DeviceDispatch& dispatch, const VkAllocationCallbacks* callbacks, DeletionQueue& deletion,
+            Jobs::JobSystem& jobs, const std::string& shaderDirectory, const std::string& cacheDirectory, bool hotReload) {
+            this->dispatch = &dispatch;
+            this->callbacks = callbacks;
+            this->deletion = &deletion;
+            this->jobs = &jobs;
+            this->shaderDirectory = shaderDirectory;
+            this->cacheDirectory = cacheDirectory;
+            std::error_code error;
+            std::filesystem::create_directories(cacheDirectory, error);
+
+            glslangVersion = probeCompiler("glslangValidator --version");
+            dxcVersion = probeCompiler("dxc --version");
+            std::cout << "Shaders: glslangValidator " << (glslangVersion.empty() ? "not found" : "found") << ", dxc "
+                << (dxcVersion.empty() ? "not found" : "found") << ", cache in " << cacheDirectory << "." << std::endl;
+            if (hotReload) {
+                running = true;
+                watcher = std::thread([this]() { watcherMain(); });
+            }
+        }
+
+        // Expects the device to be idle.
+        void destroy() {
+            if (dispatch == nullptr) {
+                return;
+            }
+            stopWatcher();
+            jobs->wait(compiles);
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const std::unique_ptr<Entry>& entry : entries) {
+                if (entry->module != VK_NULL_HANDLE) {
+                    dispatch->vkDestroyShaderModule(dispatch->device, entry->module, callbacks);
+                }
+            }
+            entries.clear();
+            lookup.clear();
+            std::cout << "Shaders: " << cacheHits.load() << " cache hits, " << compiled.load() << " compiled." << std::endl;
+            dispatch = nullptr;
+        }
+
+        // Identical requests share one entry. The compile starts right away on the job system.
+        ShaderId request(ShaderDesc desc) {
+            // These go onto the compiler's command line as they are
+            if (!isToken(desc.entryPoint, false)) {
+                throw std::runtime_error("Invalid shader entry point \"" + desc.entryPoint + "\"!");
+            }
+            for (const auto& define : desc.defines) {
+                if (!isToken(define.first, false) || !isToken(define.second, true)) {
+                    throw std::runtime_error("Invalid shader define \"" + define.first + "=" + define.second + "\"!");
+                }
+            }
+            desc.stage = stageFromPath(desc.path, desc.stage);
+            std::string name = describe(desc);
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = lookup.find(name);
+            if (found != lookup.end()) {
+                return found->second;
+            }
+            ShaderId id = static_cast<ShaderId>(entries.size());
+            entries.push_back(std::make_unique<Entry>());
+            Entry* entry = entries.back().get();
+            entry->desc = std::move(desc);
+            // Scheduled under the lock so that a concurrent identical request never sees the entry
+            // without its job; schedule() only queues, and the job takes the lock once it is released.
+            entry->job = jobs->schedule([this, entry]() {
+                Build build = compile(entry->desc);
+                std::lock_guard<std::mutex> lock(mutex);
+                entry->spirv = std::move(build.spirv);
+                entry->files = std::move(build.files);
+                entry->stamps = std::move(build.stamps);
+            }, &compiles);
+            lookup.emplace(name, id);
+            return id;
+        }
+
+        // Blocks until every requested shader has been built; a cold start calls it once.
+        void waitIdle() {
+            jobs->wait(compiles);
+        }
+
+        // Creates the module on first use, waiting for the compile if it is still running. Returns
+        // VK_NULL_HANDLE if the shader failed to build.
+        VkShaderModule module(ShaderId id) {
+            Jobs::JobHandle job;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                job = entries.at(id)->job;
+            }
+            if (job) {
+                jobs->wait(job);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            Entry& entry = *entries[id];
+            if (entry.module == VK_NULL_HANDLE && !entry.spirv.empty()) {
+                VkShaderModuleCreateInfo createInfo{};
+                createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+                createInfo.codeSize = entry.spirv.size() * sizeof(uint32_t);
+                createInfo.pCode = entry.spirv.data();
+                Allocator::ScopedAllocationTag allocationTag("vkCreateShaderModule");
+                if (dispatch->vkCreateShaderModule(dispatch->device, &createInfo, callbacks, &entry.module) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to create shader module for " + entry.desc.path + "!");
+                }
+            }
+            return entry.module;
+        }
+
+        uint64_t version(ShaderId id) const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return entries.at(id)->version;
+        }
+
+        // Call once per frame. Swaps in reloaded SPIR-V; returns true when anything changed.
+        bool poll() {
+            if (!reloadReady.exchange(false, std::memory_order_acquire)) {
+                return false;
+            }
+            bool changed = false;
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const std::unique_ptr<Entry>& entry : entries) {
+                if (entry->reloaded.empty()) {
+                    continue;
+                }
+                // Another thread may be creating a pipeline from the old module right now
+                deletion->retire(entry->module);
+                entry->module = VK_NULL_HANDLE;
+                entry->spirv = std::move(entry->reloaded);
+                entry->reloaded.clear();
+                entry->version++;
+                changed = true;
+                std::cout << "Shaders: reloaded " << entry->desc.path << "." << std::endl;
+            }
+            return changed;
+        }
+
+    private:
+        struct Entry {
+            ShaderDesc desc;
+            std::vector<uint32_t> spirv;
+            std::vector<uint32_t> reloaded;         // waiting for poll()
+            std::vector<std::string> files;         // source and every include, for hot reload
+            std::vector<std::filesystem::file_time_type> stamps;
+            VkShaderModule module = VK_NULL_HANDLE;
+            uint64_t version = 0;
+            Jobs::JobHandle job;
+        };
+
+        struct Build {
+            std::vector<uint32_t> spirv;
+            std::vector<std::string> files;
+            std::vector<std::filesystem::file_time_type> stamps;
+        };
+
+        static bool isHlsl(const std::string& path) {
+            return std::filesystem::path(path).extension() == ".hlsl";
+        }
+
+        static ShaderStage stageFromPath(const std::string& path, ShaderStage fallback) {
+            std::string extension = std::filesystem::path(path).extension().string();
+            if (extension == ".vert") {
+                return ShaderStage::Vertex;
+            }
+            if (extension == ".frag") {
+                return ShaderStage::Fragment;
+            }
+            if (extension == ".comp") {
+                return ShaderStage::Compute;
+            }
+            return fallback;
+        }
+
+        static const char* glslangStage(ShaderStage stage) {
+            switch (stage) {
+            case ShaderStage::Vertex: return "vert";
+            case ShaderStage::Fragment: return "frag";
+            default: return "comp";
+            }
+        }
+
+        static const char* hlslProfile(ShaderStage stage) {
+            switch (stage) {
+            case ShaderStage::Vertex: return "vs_6_0";
+            case ShaderStage::Fragment: return "ps_6_0";
+            default: return "cs_6_0";
+            }
+        }
+
+        static std::string describe(const ShaderDesc& desc) {
+            std::string name = desc.path + "|" + glslangStage(desc.stage) + "|" + desc.entryPoint;
+            for (const auto& define : desc.defines) {
+                name += "|" + define.first + "=" + define.second;
+            }
+            return name;
+        }
+
+        static bool isToken(const std::string& text, bool allowDot) {
+            if (text.empty() && !allowDot) {
+                return false;
+            }
+            return std::all_of(text.begin(), text.end(), [allowDot](char c) {
+                return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_' || (allowDot && c == '.');
+            });
+        }
+
+        // Scratch file name that no other thread or process sharing the cache directory picks.
+        static std::string uniqueName(const std::string& prefix) {
+            static std::atomic<uint64_t> counter{ 0 };
+            static const uint64_t process = (uint64_t(std::random_device{}()) << 32) ^
+                uint64_t(std::chrono::steady_clock::now().time_since_epoch().count());
+            char suffix[40];
+            std::snprintf(suffix, sizeof(suffix), "%016llx-%llu", static_cast<unsigned long long>(process),
+                static_cast<unsigned long long>(counter.fetch_add(1)));
+            return prefix + "." + suffix;
+        }
+
+        static std::string quote(const std::string& text) {
+            return "\"" + text + "\"";
+        }
+
+        static bool readText(const std::string& path, std::string& text) {
+            std::ifstream file(path, std::ios::binary);
+            if (!file) {
+                return false;
+            }
+            std::stringstream stream;
+            stream << file.rdbuf();
+            text = stream.str();
+            return true;
+        }
+
+        static std::vector<uint32_t> readSpirv(const std::string& path) {
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file) {
+                return {};
+            }
+            std::streamoff size = file.tellg();
+            if (size <= 0 || size % 4 != 0) {
+                return {};
+            }
+            std::vector<uint32_t> code(static_cast<size_t>(size) / 4);
+            file.seekg(0);
+            if (!file.read(reinterpret_cast<char*>(code.data()), size) || code[0] != 0x07230203) {
+                return {};
+            }
+            return code;
+        }
+
+        // First line the command prints, or empty if it could not be run.
+        std::string probeCompiler(const std::string& command) const {
+            std::string output = (std::filesystem::path(cacheDirectory) / uniqueName("probe")).string() + ".txt";
+            if (std::system((command + " > " + quote(output) + " 2>&1").c_str()) != 0) {
+                return {};
+            }
+            std::string text;
+            readText(output, text);
+            std::error_code error;
+            std::filesystem::remove(output, error);
+            return text.substr(0, text.find('\n'));
+        }
+
+        // Appends the file and, recursively, its quoted or angled includes to source, resolving them
+        // against the including file's directory and then the shader directory.
+        bool expandIncludes(const std::filesystem::path& path, std::string& source, Build& build, std::set<std::string>& visited) const {
+            std::string key = path.lexically_normal().string();
+            if (!visited.insert(key).second) {
+                return true;
+            }
+            std::string text;
+            if (!readText(key, text)) {
+                return false;
+            }
+            std::error_code error;
+            build.files.push_back(key);
+            build.stamps.push_back(std::filesystem::last_write_time(key, error));
+            source += "\n// " + key + "\n" + text;
+
+            std::istringstream lines(text);
+            std::string line;
+            while (std::getline(lines, line)) {
+                size_t start = line.find_first_not_of(" \t");
+                if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+                    continue;
+                }
+                size_t open = line.find_first_of("\"<", start + 8);
+                size_t close = open == std::string::npos ? open : line.find_first_of("\">", open + 1);
+                if (close == std::string::npos) {
+                    continue;
+                }
+                std::string name = line.substr(open + 1, close - open - 1);
+                std::filesystem::path local = path.parent_path() / name;
+                std::filesystem::path include = std::filesystem::exists(local, error) ? local : std::filesystem::path(shaderDirectory) / name;
+                if (!expandIncludes(include, source, build, visited)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Runs on a job system thread (cold builds) or the watcher thread (reloads).
+        Build compile(const ShaderDesc& desc) {
+            Build build;
+            std::filesystem::path sourcePath = std::filesystem::path(shaderDirectory) / desc.path;
+            std::string source;
+            std::set<std::string> visited;
+            if (!expandIncludes(sourcePath, source, build, visited)) {
+                std::cout << "Shaders: cannot read " << sourcePath.string() << " or one of its includes." << std::endl;
+                return build;
+            }
+
+            bool hlsl = isHlsl(desc.path);
+            const std::string& compilerVersion = hlsl ? dxcVersion : glslangVersion;
+            if (compilerVersion.empty()) {
+                build.spirv = readSpirv(sourcePath.string() + ".spv");
+                if (build.spirv.empty()) {
+                    std::cout << "Shaders: no " << (hlsl ? "dxc" : "glslangValidator") << " and no prebuilt " << desc.path << ".spv." << std::endl;
+                }
+                return build;
+            }
+
+            std::string keyText = source + "\n" + describe(desc) + "\n" + compilerVersion + "\nvulkan1.2";
+            char key[17];
+            std::snprintf(key, sizeof(key), "%016llx",
+                static_cast<unsigned long long>(fnv1a64(reinterpret_cast<const uint8_t*>(keyText.data()), keyText.size())));
+            std::filesystem::path cached = std::filesystem::path(cacheDirectory) / (std::string(key) + ".spv");
+            build.spirv = readSpirv(cached.string());
+            if (!build.spirv.empty()) {
+                cacheHits++;
+                return build;
+            }
+
+            std::string scratch = (std::filesystem::path(cacheDirectory) / uniqueName(key)).string();
+            std::string temp = scratch + ".tmp";
+            std::string log = scratch + ".log";
+            std::string command;
+            if (hlsl) {
+                command = std::string("dxc -spirv -fspv-target-env=vulkan1.2 -T ") + hlslProfile(desc.stage) + " -E " + desc.entryPoint +
+                    " -I " + quote(shaderDirectory);
+                for (const auto& define : desc.defines) {
+                    command += " -D " + define.first + "=" + define.second;
+                }
+                command += " -Fo " + quote(temp) + " " + quote(sourcePath.string());
+            }
+            else {
+                command = std::string("glslangValidator -V --target-env vulkan1.2 -S ") + glslangStage(desc.stage) +
+                    " -I" + quote(shaderDirectory);
+                for (const auto& define : desc.defines) {
+                    command += " -D" + define.first + "=" + define.second;
+                }
+                command += " -o " + quote(temp) + " " + quote(sourcePath.string());
+            }
+            int status = std::system((command + " > " + quote(log) + " 2>&1").c_str());
+            std::error_code error;
+            if (status != 0) {
+                std::string output;
+                readText(log, output);
+                std::cout << "Shaders: " << desc.path << " failed to compile:\n" << output << std::endl;
+                std::filesystem::remove(temp, error);
+                std::filesystem::remove(log, error);
+                return build;
+            }
+            std::filesystem::remove(log, error);
+            std::filesystem::rename(temp, cached, error); // Other processes never see a partial file
+            if (error) {
+                build.spirv = readSpirv(temp);
+                std::filesystem::remove(temp, error);
+            }
+            else {
+                build.spirv = readSpirv(cached.string());
+            }
+            compiled++;
+            return build;
+        }
+
+        void watcherMain() {
+            std::unique_lock<std::mutex> lock(watcherMutex);
+            while (running) {
+                watcherWake.wait_for(lock, std::chrono::milliseconds(250), [this]() { return !running; });
+                if (!running) {
+                    break;
+                }
+                lock.unlock();
+                checkForChanges();
+                lock.lock();
+            }
+        }
+
+        void checkForChanges() {
+            std::vector<std::pair<Entry*, ShaderDesc>> changed;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (const std::unique_ptr<Entry>& entry : entries) {
+                    if (entry->job && !Jobs::JobSystem::isFinished(entry->job)) {
+                        continue;   // Still on its first build
+                    }
+                    for (size_t i = 0; i < entry->files.size(); i++) {
+                        std::error_code error;
+                        if (std::filesystem::last_write_time(entry->files[i], error) != entry->stamps[i] && !error) {
+                            changed.push_back({ entry.get(), entry->desc });
+                            break;
+                        }
+                    }
+                }
+            }
+            for (auto& change : changed) {
+                Build build = compile(change.second);
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!build.files.empty()) {
+                    change.first->files = std::move(build.files);
+                    change.first->stamps = std::move(build.stamps);
+                }
+                if (!build.spirv.empty() && build.spirv != change.first->spirv) {
+                    change.first->reloaded = std::move(build.spirv);
+                    reloadReady.store(true, std::memory_order_release);
+                }
+            }
+        }
+
+        void stopWatcher() {
+            {
+                std::lock_guard<std::mutex> lock(watcherMutex);
+                running = false;
+            }
+            watcherWake.notify_all();
+            if (watcher.joinable()) {
+                watcher.join();
+            }
+        }
+
+        const DeviceDispatch* dispatch = nullptr;
+        const VkAllocationCallbacks* callbacks = nullptr;
+        DeletionQueue* deletion = nullptr;
+        Jobs::JobSystem* jobs = nullptr;
+        std::string shaderDirectory;
+        std::string cacheDirectory;
+        std::string glslangVersion;     // empty when the compiler is not installed
+        std::string dxcVersion;
+
+        mutable std::mutex mutex;
+        std::vector<std::unique_ptr<Entry>> entries;
+        std::unordered_map<std::string, ShaderId> lookup;
+        Jobs::Counter compiles;
+        std::atomic<uint32_t> cacheHits{ 0 };
+        std::atomic<uint32_t> compiled{ 0 };
+
+        std::mutex watcherMutex;
+        std::condition_variable watcherWake;
+        bool running = false;
+        std::atomic<bool> reloadReady{ false };
+        std::thread watcher;
+    };
+
+} // namespace vulkan
@@ -0,0 +1,625 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "DeviceMemory.hpp"
+#include "DeviceSelection.hpp"
+#include "VulkanDispatch.hpp"
+
+namespace vulkan {
+
+    // Timeline value of the batch that finishes an upload; 0 until that batch is submitted.
+    struct UploadState {
+        std::atomic<uint64_t> value{ 0 };
+    };
+
+    struct UploadTicket {
+        std::shared_ptr<UploadState> state;
+
+        bool valid() const {
+            return state != nullptr;
+        }
+    };
+
+    // A reserved piece of the staging ring. Write to mapped, then hand it to UploadManager::copy().
+    struct StagingSpan {
+        void* mapped = nullptr;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+
+        explicit operator bool() const {
+            return mapped != nullptr;
+        }
+    };
+
+    // Streams data to device-local resources through one persistently mapped staging ring.
+    //
+    // Copies are recorded into a batch on the transfer queue (or the graphics queue when the device has
+    // no separate one) and submitted by flush()/pump(); each batch signals the next value of a timeline
+    // semaphore. Ring space is reclaimed in FIFO order once its batch value completes, and a full ring
+    // makes reserve() wait (or fail, for the non-blocking path) instead of growing.
+    //
+    // When the transfer family differs from the graphics family, destinations are released to the
+    // graphics family at the end of the upload; recordAcquireBarriers() records the matching acquires
+    // in the frame's command buffer and returns the timeline value that frame must wait on.
+    //
+    // All members are thread-safe. Destinations must be EXCLUSIVE and not in use by the GPU while
+    // they are being written.
+    class UploadManager {
+    public:
+        void init(DeviceMemoryAllocator& memory, const DeviceDispatch& dispatch, const VkAllocationCallbacks* callbacks, QueueSet& queues,
+            VkDeviceSize ringSize, VkDeviceSize streamBudgetPerFrame) {
+            this->memory = &memory;
+            this->dispatch = &dispatch;
+            this->device = dispatch.device;
+            this->callbacks = callbacks;
+            this->queues = &queues;
+            this->streamBudget = streamBudgetPerFrame;
+            transferFamily = queues.transfer.family;
+            graphicsFamily = queues.graphics.family;
+
+            ringBuffer = memory.createBuffer(ringSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryUsage::Upload, ringAllocation);
+            if (ringAllocation->mapped == nullptr) {
+                throw std::runtime_error("Staging ring needs host-visible memory!");
+            }
+            ringMapped = static_cast<char*>(ringAllocation->mapped);
+            capacity = ringSize;
+            maxChunk = std::max<VkDeviceSize>(ringSize / 4, 1);
+
+            VkSemaphoreTypeCreateInfo typeInfo{};
+            typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+            typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+            typeInfo.initialValue = 0;
+            VkSemaphoreCreateInfo semaphoreInfo{};
+            semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            semaphoreInfo.pNext = &typeInfo;
+            Allocator::ScopedAllocationTag semaphoreTag("vkCreateSemaphore");
+            if (dispatch.vkCreateSemaphore(device, &semaphoreInfo, callbacks, &timelineSemaphore) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create upload timeline semaphore!");
+            }
+
+            VkCommandPoolCreateInfo poolInfo{};
+            poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            poolInfo.queueFamilyIndex = transferFamily;
+            Allocator::ScopedAllocationTag poolTag("vkCreateCommandPool");
+            if (dispatch.vkCreateCommandPool(device, &poolInfo, callbacks, &commandPool) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create upload command pool!");
+            }
+            std::cout << "Upload: " << (ringSize >> 20) << " MiB staging ring on queue family " << transferFamily
+                << (transferFamily != graphicsFamily ? " (ownership transfers to graphics)" : "") << std::endl;
+        }
+
+        // Expects the device to be idle.
+        void destroy() {
+            if (device == VK_NULL_HANDLE) {
+                return;
+            }
+            dispatch->vkDestroyCommandPool(device, commandPool, callbacks);
+            dispatch->vkDestroySemaphore(device, timelineSemaphore, callbacks);
+            memory->destroyBuffer(ringBuffer, ringAllocation);
+            device = VK_NULL_HANDLE;
+        }
+
+        VkSemaphore timeline() const {
+            return timelineSemaphore;
+        }
+
+        // Largest span worth reserving in one piece; bigger uploads are split into chunks of this size.
+        VkDeviceSize chunkSize() const {
+            return maxChunk;
+        }
+
+        // With wait == false an empty span means the ring is full: try again next frame.
+        StagingSpan reserve(VkDeviceSize size, VkDeviceSize alignment, bool wait) {
+            std::unique_lock<std::mutex> lock(mutex);
+            return reserveLocked(lock, size, alignment, wait);
+        }
+
+        // Records the copy of a filled span. Multi-chunk uploads call this per chunk, then finish().
+        void copy(const StagingSpan& span, VkBuffer dst, VkDeviceSize dstOffset) {
+            std::lock_guard<std::mutex> lock(mutex);
+            copyLocked(span, dst, dstOffset);
+        }
+
+        // Gives back a reserved span that will not be copied, e.g. because its source data was bad.
+        void cancel(const StagingSpan& span) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto it = regions.rbegin(); it != regions.rend(); ++it) {
+                if (it->begin == span.offset && !it->recorded && !it->cancelled) {
+                    it->cancelled = true;
+                    return;
+                }
+            }
+        }
+
+        // Marks [offset, offset + size) of dst as fully written: releases it to the graphics family if
+        // needed and returns the ticket that completes with the current batch.
+        UploadTicket finish(VkBuffer dst, VkDeviceSize offset, VkDeviceSize size) {
+            std::lock_guard<std::mutex> lock(mutex);
+            UploadTicket ticket{ std::make_shared<UploadState>() };
+            finishBufferLocked(dst, offset, size, ticket.state);
+            return ticket;
+        }
+
+        // Blocking helper for load time: copies data through the ring, waiting for space as needed.
+        UploadTicket uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size) {
+            std::unique_lock<std::mutex> lock(mutex);
+            const char* source = static_cast<const char*>(data);
+            for (VkDeviceSize done = 0; done < size; ) {
+                VkDeviceSize chunk = std::min(maxChunk, size - done);
+                StagingSpan span = reserveLocked(lock, chunk, 16, true);
+                std::memcpy(span.mapped, source + done, static_cast<size_t>(chunk));
+                copyLocked(span, dst, dstOffset + done);
+                done += chunk;
+            }
+            UploadTicket ticket{ std::make_shared<UploadState>() };
+            finishBufferLocked(dst, dstOffset, size, ticket.state);
+            return ticket;
+        }
+
+        // Uploads mip 0 of a 2D colour image with a tightly packed texel size, in row bands that fit
+        // the ring. The image ends in finalLayout, owned by the graphics family.
+        UploadTicket uploadImage(VkImage image, uint32_t width, uint32_t height, uint32_t bytesPerTexel, const void* data, VkImageLayout finalLayout) {
+            VkDeviceSize rowBytes = VkDeviceSize(width) * bytesPerTexel;
+            if (rowBytes > maxChunk) {
+                throw std::runtime_error("Image row does not fit in the staging ring!");
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            beginImageLocked(image);
+            uint32_t rowsPerChunk = static_cast<uint32_t>(maxChunk / rowBytes);
+            const char* source = static_cast<const char*>(data);
+            for (uint32_t row = 0; row < height; row += rowsPerChunk) {
+                uint32_t rows = std::min(rowsPerChunk, height - row);
+                VkDeviceSize bytes = rowBytes * rows;
+                StagingSpan span = reserveLocked(lock, bytes, imageAlignment(bytesPerTexel), true);
+                std::memcpy(span.mapped, source + rowBytes * row, static_cast<size_t>(bytes));
+                copyRowsLocked(span, image, width, row, rows);
+            }
+            UploadTicket ticket{ std::make_shared<UploadState>() };
+            finishImageLocked(image, finalLayout, ticket.state);
+            return ticket;
+        }
+
+        // The same in pieces, for callers that fill spans themselves: beginImage() once, copyRows()
+        // per band of whole rows (reserved with imageAlignment()), finishImage() after the last band.
+        void beginImage(VkImage image) {
+            std::lock_guard<std::mutex> lock(mutex);
+            beginImageLocked(image);
+        }
+
+        void copyRows(const StagingSpan& span, VkImage image, uint32_t width, uint32_t firstRow, uint32_t rows) {
+            std::lock_guard<std::mutex> lock(mutex);
+            copyRowsLocked(span, image, width, firstRow, rows);
+        }
+
+        UploadTicket finishImage(VkImage image, VkImageLayout finalLayout) {
+            std::lock_guard<std::mutex> lock(mutex);
+            UploadTicket ticket{ std::make_shared<UploadState>() };
+            finishImageLocked(image, finalLayout, ticket.state);
+            return ticket;
+        }
+
+        // Buffer-to-image copies need offsets that are texel and 4-byte aligned.
+        static VkDeviceSize imageAlignment(uint32_t bytesPerTexel) {
+            return VkDeviceSize(bytesPerTexel) * 4;
+        }
+
+        // False when the ring is write-combined, where reading spans back (as a decompressor does
+        // with its own output) is very slow.
+        bool ringIsCached() const {
+            return memory->isHostCached(ringAllocation);
+        }
+
+        // Queues an upload that pump() feeds through the ring in chunks, never blocking the frame.
+        UploadTicket streamBuffer(VkBuffer dst, VkDeviceSize dstOffset, std::vector<uint8_t> data) {
+            std::lock_guard<std::mutex> lock(mutex);
+            UploadTicket ticket{ std::make_shared<UploadState>() };
+            StreamRequest request;
+            request.dst = dst;
+            request.dstOffset = dstOffset;
+            request.data = std::move(data);
+            request.state = ticket.state;
+            streams.push_back(std::move(request));
+            return ticket;
+        }
+
+        // Called once per frame: reclaims finished batches, advances streams within the per-frame
+        // budget, and submits whatever was recorded.
+        void pump() {
+            std::unique_lock<std::mutex> lock(mutex);
+            reclaim(completedValue());
+            VkDeviceSize budget = streamBudget;
+            while (!streams.empty() && budget > 0) {
+                StreamRequest& request = streams.front();
+                VkDeviceSize remaining = request.data.size() - request.done;
+                VkDeviceSize chunk = std::min({ remaining, maxChunk, budget });
+                StagingSpan span = reserveLocked(lock, chunk, 16, false);
+                if (!span) {
+                    break; // Ring is full: back off until batches retire
+                }
+                std::memcpy(span.mapped, request.data.data() + request.done, static_cast<size_t>(chunk));
+                copyLocked(span, request.dst, request.dstOffset + request.done);
+                request.done += chunk;
+                budget -= chunk;
+                if (request.done == request.data.size()) {
+                    finishBufferLocked(request.dst, request.dstOffset, request.data.size(), request.state);
+                    streams.pop_front();
+                }
+            }
+            flushLocked();
+        }
+
+        void flush() {
+            std::lock_guard<std::mutex> lock(mutex);
+            flushLocked();
+        }
+
+        // True once the upload is visible to the frame being recorded (see recordAcquireBarriers()).
+        bool isComplete(const UploadTicket& ticket) const {
+            uint64_t value = ticket.state->value.load(std::memory_order_acquire);
+            return value != 0 && value <= graphicsVisibleValue.load(std::memory_order_acquire);
+        }
+
+        // Blocks until the copies have executed, submitting them first if needed. The destination can
+        // be used from the next recorded frame on.
+        void wait(const UploadTicket& ticket) {
+            uint64_t value = ticket.state->value.load(std::memory_order_acquire);
+            while (value == 0) {
+                pump(); // Submits the open batch, or feeds the stream this ticket belongs to
+                value = ticket.state->value.load(std::memory_order_acquire);
+                if (value == 0) {
+                    std::this_thread::yield();
+                }
+            }
+            waitValue(value);
+        }
+
+        // Records the queue-family acquires for every finished batch into a graphics command buffer.
+        // The submission of commandBuffer must wait on timeline() at the returned value (0 = no wait).
+        uint64_t recordAcquireBarriers(VkCommandBuffer commandBuffer) {
+            std::lock_guard<std::mutex> lock(mutex);
+            uint64_t completed = completedValue();
+            std::vector<VkBufferMemoryBarrier> bufferBarriers;
+            std::vector<VkImageMemoryBarrier> imageBarriers;
+            while (!readyAcquires.empty() && readyAcquires.front().value <= completed) {
+                const PendingAcquire& acquire = readyAcquires.front();
+                if (acquire.isImage) {
+                    imageBarriers.push_back(acquire.image);
+                }
+                else {
+                    bufferBarriers.push_back(acquire.buffer);
+                }
+                readyAcquires.pop_front();
+            }
+            if (!bufferBarriers.empty() || !imageBarriers.empty()) {
+                dispatch->vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+                    static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+                    static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+            }
+            // Waiting on an already-reached value costs nothing and makes the transfer writes visible
+            graphicsVisibleValue.store(completed, std::memory_order_release);
+            return completed;
+        }
+
+    private:
+        struct Region {
+            VkDeviceSize begin;
+            VkDeviceSize end;
+            uint64_t value;      // batch that reads it; 0 while unsubmitted
+            bool recorded;       // its copy is in a batch
+            bool cancelled;      // never copied; free once the regions before it are
+        };
+
+        struct PendingAcquire {
+            bool isImage = false;
+            VkBufferMemoryBarrier buffer{};
+            VkImageMemoryBarrier image{};
+            uint64_t value = 0;
+        };
+
+        struct StreamRequest {
+            VkBuffer dst = VK_NULL_HANDLE;
+            VkDeviceSize dstOffset = 0;
+            std::vector<uint8_t> data;
+            VkDeviceSize done = 0;
+            std::shared_ptr<UploadState> state;
+        };
+
+        struct InFlightBatch {
+            VkCommandBuffer commandBuffer;
+            uint64_t value;
+        };
+
+        uint64_t completedValue() const {
+            uint64_t value = 0;
+            dispatch->vkGetSemaphoreCounterValue(device, timelineSemaphore, &value);
+            return value;
+        }
+
+        void waitValue(uint64_t value) const {
+            VkSemaphoreWaitInfo waitInfo{};
+            waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+            waitInfo.semaphoreCount = 1;
+            waitInfo.pSemaphores = &timelineSemaphore;
+            waitInfo.pValues = &value;
+            dispatch->vkWaitSemaphores(device, &waitInfo, UINT64_MAX);
+        }
+
+        bool tryAllocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+            if (regions.empty()) {
+                head = 0;
+                offset = 0;
+                return size <= capacity;
+            }
+            VkDeviceSize tail = regions.front().begin;
+            VkDeviceSize start = alignDeviceSize(head, alignment);
+            if (head > tail) {
+                if (start + size <= capacity) {
+                    offset = start;
+                    return true;
+                }
+                offset = 0;
+                return size <= tail; // Wrap to the start of the ring
+            }
+            offset = start;
+            return start + size <= tail;
+        }
+
+        StagingSpan reserveLocked(std::unique_lock<std::mutex>& lock, VkDeviceSize size, VkDeviceSize alignment, bool wait) {
+            if (size == 0 || size > capacity) {
+                throw std::runtime_error("Staging reservation does not fit in the ring!");
+            }
+            VkDeviceSize offset = 0;
+            while (!tryAllocate(size, alignment, offset)) {
+                if (!wait) {
+                    return {};
+                }
+                // Back-pressure: submit what is recorded, then wait for the oldest region to retire
+                const Region& oldest = regions.front();
+                if (oldest.value == 0 && oldest.recorded) {
+                    flushLocked();
+                }
+                uint64_t value = regions.front().value;
+                lock.unlock();
+                if (value == 0) {
+                    std::this_thread::yield(); // Another thread is still filling it
+                }
+                else {
+                    waitValue(value);
+                }
+                lock.lock();
+                reclaim(completedValue());
+            }
+            regions.push_back({ offset, offset + size, 0, false, false });
+            head = offset + size;
+
+            StagingSpan span;
+            span.mapped = ringMapped + offset;
+            span.buffer = ringBuffer;
+            span.offset = offset;
+            span.size = size;
+            return span;
+        }
+
+        void reclaim(uint64_t completed) {
+            while (!regions.empty() && (regions.front().cancelled || (regions.front().value != 0 && regions.front().value <= completed))) {
+                regions.pop_front();
+            }
+            while (!inFlight.empty() && inFlight.front().value <= completed) {
+                freeCommandBuffers.push_back(inFlight.front().commandBuffer);
+                inFlight.pop_front();
+            }
+        }
+
+        void markRecorded(VkDeviceSize offset) {
+            for (auto it = regions.rbegin(); it != regions.rend(); ++it) {
+                if (it->begin == offset && !it->recorded) {
+                    it->recorded = true;
+                    return;
+                }
+            }
+        }
+
+        void copyLocked(const StagingSpan& span, VkBuffer dst, VkDeviceSize dstOffset) {
+            memory->flush(ringAllocation, span.offset, span.size);
+            markRecorded(span.offset);
+            VkBufferCopy region{};
+            region.srcOffset = span.offset;
+            region.dstOffset = dstOffset;
+            region.size = span.size;
+            dispatch->vkCmdCopyBuffer(recordingBuffer(), ringBuffer, dst, 1, &region);
+        }
+
+        void finishBufferLocked(VkBuffer dst, VkDeviceSize offset, VkDeviceSize size, const std::shared_ptr<UploadState>& state) {
+            if (transferFamily != graphicsFamily) {
+                VkBufferMemoryBarrier release{};
+                release.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                release.dstAccessMask = 0;
+                release.srcQueueFamilyIndex = transferFamily;
+                release.dstQueueFamilyIndex = graphicsFamily;
+                release.buffer = dst;
+                release.offset = offset;
+                release.size = size;
+                dispatch->vkCmdPipelineBarrier(recordingBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &release, 0, nullptr);
+                PendingAcquire acquire{};
+                acquire.buffer = release;
+                acquire.buffer.srcAccessMask = 0;
+                acquire.buffer.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+                batchAcquires.push_back(acquire);
+            }
+            else {
+                recordingBuffer(); // The ticket still needs a batch to complete with
+            }
+            batchTickets.push_back(state);
+        }
+
+        void beginImageLocked(VkImage image) {
+            VkImageMemoryBarrier toTransfer = imageBarrier(image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+            toTransfer.srcAccessMask = 0;
+            toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            dispatch->vkCmdPipelineBarrier(recordingBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+        }
+
+        void copyRowsLocked(const StagingSpan& span, VkImage image, uint32_t width, uint32_t firstRow, uint32_t rows) {
+            memory->flush(ringAllocation, span.offset, span.size);
+            markRecorded(span.offset);
+            VkBufferImageCopy region{};
+            region.bufferOffset = span.offset;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.layerCount = 1;
+            region.imageOffset = { 0, static_cast<int32_t>(firstRow), 0 };
+            region.imageExtent = { width, rows, 1 };
+            dispatch->vkCmdCopyBufferToImage(recordingBuffer(), ringBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        }
+
+        void finishImageLocked(VkImage image, VkImageLayout finalLayout, const std::shared_ptr<UploadState>& state) {
+            VkImageMemoryBarrier release = imageBarrier(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, finalLayout);
+            release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            if (transferFamily != graphicsFamily) {
+                release.dstAccessMask = 0;
+                release.srcQueueFamilyIndex = transferFamily;
+                release.dstQueueFamilyIndex = graphicsFamily;
+                dispatch->vkCmdPipelineBarrier(recordingBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &release);
+                PendingAcquire acquire{};
+                acquire.isImage = true;
+                acquire.image = release;
+                acquire.image.srcAccessMask = 0;
+                acquire.image.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+                batchAcquires.push_back(acquire);
+            }
+            else {
+                release.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+                dispatch->vkCmdPipelineBarrier(recordingBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &release);
+            }
+            batchTickets.push_back(state);
+        }
+
+        VkImageMemoryBarrier imageBarrier(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout) const {
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.oldLayout = oldLayout;
+            barrier.newLayout = newLayout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = image;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.levelCount = 1;
+            barrier.subresourceRange.layerCount = 1;
+            return barrier;
+        }
+
+        // The batch command buffer, begun on first use.
+        VkCommandBuffer recordingBuffer() {
+            if (recording != VK_NULL_HANDLE) {
+                return recording;
+            }
+            if (freeCommandBuffers.empty()) {
+                VkCommandBufferAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocInfo.commandPool = commandPool;
+                allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                allocInfo.commandBufferCount = 1;
+                VkCommandBuffer commandBuffer;
+                if (dispatch->vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+                    throw std::runtime_error("Failed to allocate upload command buffer!");
+                }
+                freeCommandBuffers.push_back(commandBuffer);
+            }
+            recording = freeCommandBuffers.back();
+            freeCommandBuffers.pop_back();
+            VkCommandBufferBeginInfo beginInfo{};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            if (dispatch->vkBeginCommandBuffer(recording, &beginInfo) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to begin upload command buffer!");
+            }
+            return recording;
+        }
+
+        void flushLocked() {
+            if (recording == VK_NULL_HANDLE) {
+                return;
+            }
+            if (dispatch->vkEndCommandBuffer(recording) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to record upload command buffer!");
+            }
+            uint64_t value = ++submittedValue;
+            VkTimelineSemaphoreSubmitInfo timelineInfo{};
+            timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timelineInfo.signalSemaphoreValueCount = 1;
+            timelineInfo.pSignalSemaphoreValues = &value;
+            VkSubmitInfo submitInfo{};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.pNext = &timelineInfo;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &recording;
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &timelineSemaphore;
+            if (queues->submit(QueueRole::Transfer, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to submit upload batch!");
+            }
+            inFlight.push_back({ recording, value });
+            recording = VK_NULL_HANDLE;
+
+            for (Region& region : regions) {
+                if (region.recorded && region.value == 0) {
+                    region.value = value;
+                }
+            }
+            for (PendingAcquire& acquire : batchAcquires) {
+                acquire.value = value;
+                readyAcquires.push_back(acquire);
+            }
+            batchAcquires.clear();
+            for (const auto& state : batchTickets) {
+                state->value.store(value, std::memory_order_release);
+            }
+            batchTickets.clear();
+        }
+
+        DeviceMemoryAllocator* memory = nullptr;
+        const DeviceDispatch* dispatch = nullptr;
+        VkDevice device = VK_NULL_HANDLE;
+        const VkAllocationCallbacks* callbacks = nullptr;
+        QueueSet* queues = nullptr;
+        uint32_t transferFamily = 0;
+        uint32_t graphicsFamily = 0;
+
+        VkBuffer ringBuffer = VK_NULL_HANDLE;
+        DeviceAllocation* ringAllocation = nullptr;
+        char* ringMapped = nullptr;
+        VkDeviceSize capacity = 0;
+        VkDeviceSize maxChunk = 0;
+        VkDeviceSize head = 0;
+        std::deque<Region> regions;
+
+        VkSemaphore timelineSemaphore = VK_NULL_HANDLE;
+        uint64_t submittedValue = 0;
+        std::atomic<uint64_t> graphicsVisibleValue{ 0 };
+
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+        VkCommandBuffer recording = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> freeCommandBuffers;
+        std::deque<InFlightBatch> inFlight;
+
+        std::vector<PendingAcquire> batchAcquires;
+        std::deque<PendingAcquire> readyAcquires;
+        std::vector<std::shared_ptr<UploadState>> batchTickets;
+        std::deque<StreamRequest> streams;
+        VkDeviceSize streamBudget = 0;
+        std::mutex mutex;
+    };
+
+} // namespace vulkan
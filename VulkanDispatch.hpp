@@ -0,0 +1,159 @@
+#pragma once
+#include <vulkan/vulkan.hpp>
+#include <stdexcept>
+
+// Function pointers resolved straight from the driver, so hot-path calls skip the loader's
+// trampoline (and, for vkCmd*, its per-call dispatch lookup on the command buffer).
+//
+// Instance functions come from vkGetInstanceProcAddr once the instance exists; device functions come
+// from vkGetDeviceProcAddr of the device they belong to. A DeviceDispatch is only valid for its own
+// VkDevice, so each device gets its own table and subsystems keep a pointer to the table of the
+// device they were initialized with. Extension or 1.3 functions the device does not expose stay null.
+
+#define VKL_INSTANCE_FUNCTIONS(X) \
+    X(vkDestroyInstance) \
+    X(vkEnumeratePhysicalDevices) \
+    X(vkGetPhysicalDeviceProperties) \
+    X(vkGetPhysicalDeviceProperties2) \
+    X(vkGetPhysicalDeviceFeatures) \
+    X(vkGetPhysicalDeviceFeatures2) \
+    X(vkGetPhysicalDeviceQueueFamilyProperties) \
+    X(vkGetPhysicalDeviceMemoryProperties) \
+    X(vkEnumerateDeviceExtensionProperties) \
+    X(vkCreateDevice) \
+    X(vkGetDeviceProcAddr) \
+    X(vkDestroySurfaceKHR) \
+    X(vkGetPhysicalDeviceSurfaceSupportKHR) \
+    X(vkGetPhysicalDeviceSurfaceCapabilitiesKHR) \
+    X(vkGetPhysicalDeviceSurfaceFormatsKHR) \
+    X(vkGetPhysicalDeviceSurfacePresentModesKHR)
+
+#define VKL_DEVICE_FUNCTIONS(X) \
+    X(vkDestroyDevice) \
+    X(vkGetDeviceQueue) \
+    X(vkDeviceWaitIdle) \
+    X(vkQueueSubmit) \
+    X(vkCreateFence) \
+    X(vkDestroyFence) \
+    X(vkWaitForFences) \
+    X(vkResetFences) \
+    X(vkCreateSemaphore) \
+    X(vkDestroySemaphore) \
+    X(vkGetSemaphoreCounterValue) \
+    X(vkWaitSemaphores) \
+    X(vkCreateCommandPool) \
+    X(vkDestroyCommandPool) \
+    X(vkResetCommandPool) \
+    X(vkAllocateCommandBuffers) \
+    X(vkBeginCommandBuffer) \
+    X(vkEndCommandBuffer) \
+    X(vkCreateImage) \
+    X(vkDestroyImage) \
+    X(vkCreateImageView) \
+    X(vkDestroyImageView) \
+    X(vkCreateBuffer) \
+    X(vkDestroyBuffer) \
+    X(vkDestroySampler) \
+    X(vkAllocateMemory) \
+    X(vkFreeMemory) \
+    X(vkMapMemory) \
+    X(vkFlushMappedMemoryRanges) \
+    X(vkInvalidateMappedMemoryRanges) \
+    X(vkGetImageMemoryRequirements) \
+    X(vkGetBufferMemoryRequirements2) \
+    X(vkGetImageMemoryRequirements2) \
+    X(vkBindBufferMemory) \
+    X(vkBindImageMemory) \
+    X(vkCreateRenderPass) \
+    X(vkDestroyRenderPass) \
+    X(vkCreateFramebuffer) \
+    X(vkDestroyFramebuffer) \
+    X(vkCreateDescriptorSetLayout) \
+    X(vkDestroyDescriptorSetLayout) \
+    X(vkCreateDescriptorPool) \
+    X(vkDestroyDescriptorPool) \
+    X(vkResetDescriptorPool) \
+    X(vkAllocateDescriptorSets) \
+    X(vkUpdateDescriptorSets) \
+    X(vkCreatePipelineLayout) \
+    X(vkDestroyPipelineLayout) \
+    X(vkCreateShaderModule) \
+    X(vkDestroyShaderModule) \
+    X(vkCreatePipelineCache) \
+    X(vkDestroyPipelineCache) \
+    X(vkGetPipelineCacheData) \
+    X(vkMergePipelineCaches) \
+    X(vkCreateComputePipelines) \
+    X(vkCreateGraphicsPipelines) \
+    X(vkDestroyPipeline) \
+    X(vkCreateQueryPool) \
+    X(vkDestroyQueryPool) \
+    X(vkGetQueryPoolResults) \
+    X(vkCmdPipelineBarrier) \
+    X(vkCmdBindDescriptorSets) \
+    X(vkCmdBindPipeline) \
+    X(vkCmdPushConstants) \
+    X(vkCmdBindIndexBuffer) \
+    X(vkCmdSetViewport) \
+    X(vkCmdSetScissor) \
+    X(vkCmdDispatch) \
+    X(vkCmdDrawIndexedIndirectCount) \
+    X(vkCmdBeginRenderPass) \
+    X(vkCmdEndRenderPass) \
+    X(vkCmdExecuteCommands) \
+    X(vkCmdClearAttachments) \
+    X(vkCmdCopyBuffer) \
+    X(vkCmdCopyBufferToImage) \
+    X(vkCmdCopyImageToBuffer) \
+    X(vkCmdResetQueryPool) \
+    X(vkCmdWriteTimestamp) \
+    X(vkCmdBeginQuery) \
+    X(vkCmdEndQuery) \
+    X(vkCmdPipelineBarrier2) \
+    X(vkCmdBeginRendering) \
+    X(vkCmdEndRendering) \
+    X(vkCreateSwapchainKHR) \
+    X(vkDestroySwapchainKHR) \
+    X(vkGetSwapchainImagesKHR) \
+    X(vkAcquireNextImageKHR) \
+    X(vkQueuePresentKHR) \
+    X(vkWaitForPresentKHR) \
+    X(vkGetCalibratedTimestampsEXT)
+
+#define VKL_DECLARE_FUNCTION(name) PFN_##name name = nullptr;
+
+namespace vulkan {
+
+    struct InstanceDispatch {
+        VkInstance instance = VK_NULL_HANDLE;
+        VKL_INSTANCE_FUNCTIONS(VKL_DECLARE_FUNCTION)
+
+        void load(VkInstance instance) {
+            this->instance = instance;
+#define VKL_LOAD_FUNCTION(name) name = reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(instance, #name));
+            VKL_INSTANCE_FUNCTIONS(VKL_LOAD_FUNCTION)
+#undef VKL_LOAD_FUNCTION
+            if (vkCreateDevice == nullptr || vkGetDeviceProcAddr == nullptr) {
+                throw std::runtime_error("Failed to load instance functions!");
+            }
+        }
+    };
+
+    struct DeviceDispatch {
+        VkDevice device = VK_NULL_HANDLE;
+        VKL_DEVICE_FUNCTIONS(VKL_DECLARE_FUNCTION)
+
+        void load(const InstanceDispatch& instance, VkDevice device) {
+            this->device = device;
+#define VKL_LOAD_FUNCTION(name) name = reinterpret_cast<PFN_##name>(instance.vkGetDeviceProcAddr(device, #name));
+            VKL_DEVICE_FUNCTIONS(VKL_LOAD_FUNCTION)
+#undef VKL_LOAD_FUNCTION
+            if (vkQueueSubmit == nullptr || vkCmdPipelineBarrier == nullptr) {
+                throw std::runtime_error("Failed to load device functions!");
+            }
+        }
+    };
+
+} // namespace vulkan
+
+#undef VKL_DECLARE_FUNCTION
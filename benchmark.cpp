@@ -0,0 +1,444 @@
+#include "Classheader.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Startup, frame and host-allocation benchmarks. Runs headless by default, so it works on lavapipe
+// (VK_ICD_FILENAMES=.../lvp_icd.json, or --device llvmpipe when several devices are present).
+//
+//   benchmark [--out results.json] [--frames N] [--draws 0,1000,10000] [--size WxH] [--device <index|name>]
+//             [--windowed [--recreate-every N]] [--alloc-ops N] [--alloc-threads N] [--asset-mb N]
+//             [--scene-objects N]
+//
+// --asset-mb writes a synthetic asset pack of about N MiB (0 = skip), once raw and once LZ4-compressed,
+// and measures how long each takes to stream in and how far the resident set grows meanwhile.
+//
+// --scene-objects times the CPU scene update and cull on a hierarchy of about N nodes (0 = skip), once per
+// SIMD level the CPU supports.
+//
+// Results are written as JSON so runs from different builds can be diffed by a script.
+
+struct BenchmarkOptions {
+    std::string outPath = "benchmark_results.json";
+    uint32_t frames = 500;
+    std::vector<uint32_t> drawCounts = { 0, 1000, 10000 };
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    std::string device;
+    bool windowed = false;
+    uint32_t recreateEvery = 100;
+    uint32_t allocOps = 2000000;
+    uint32_t allocThreads = std::max(1u, std::thread::hardware_concurrency());
+    uint32_t assetMegabytes = 64;
+    uint32_t sceneObjects = 100000;
+};
+
+struct AppRunResult {
+    uint32_t drawCount = 0;
+    std::vector<PhaseTiming> phases;
+    uint64_t frames = 0;
+    double seconds = 0.0;
+};
+
+struct AssetLoadResult {
+    bool compressed = false;
+    uint64_t fileBytes = 0;
+    vulkan::AssetLoadStats stats;
+};
+
+struct SceneResult {
+    vulkan::SimdLevel level = vulkan::SimdLevel::Scalar;
+    uint32_t nodes = 0;
+    double fullUpdateMs = 0.0;     // every root moved, so every node is recomputed
+    double partialUpdateMs = 0.0;  // a quarter of the roots moved
+    double cullMs = 0.0;
+    size_t visible = 0;
+};
+
+struct AllocatorResult {
+    std::string name;
+    uint32_t threads = 0;
+    uint64_t operations = 0;
+    double seconds = 0.0;
+};
+
+BenchmarkOptions parseOptions(int argc, char** argv) {
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            options.outPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            options.frames = static_cast<uint32_t>(std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--draws") == 0 && i + 1 < argc) {
+            options.drawCounts.clear();
+            std::stringstream list(argv[++i]);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                options.drawCounts.push_back(static_cast<uint32_t>(std::atoi(item.c_str())));
+            }
+        }
+        else if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            unsigned width = 0, height = 0;
+            if (std::sscanf(argv[++i], "%ux%u", &width, &height) == 2 && width > 0 && height > 0) {
+                options.width = width;
+                options.height = height;
+            }
+        }
+        else if (std::strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+            options.device = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--windowed") == 0) {
+            options.windowed = true;
+        }
+        else if (std::strcmp(argv[i], "--recreate-every") == 0 && i + 1 < argc) {
+            options.recreateEvery = static_cast<uint32_t>(std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--alloc-ops") == 0 && i + 1 < argc) {
+            options.allocOps = static_cast<uint32_t>(std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--alloc-threads") == 0 && i + 1 < argc) {
+            options.allocThreads = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+        }
+        else if (std::strcmp(argv[i], "--asset-mb") == 0 && i + 1 < argc) {
+            options.assetMegabytes = static_cast<uint32_t>(std::max(0, std::atoi(argv[++i])));
+        }
+        else if (std::strcmp(argv[i], "--scene-objects") == 0 && i + 1 < argc) {
+            options.sceneObjects = static_cast<uint32_t>(std::max(0, std::atoi(argv[++i])));
+        }
+    }
+    return options;
+}
+
+// One full VulkanApp lifetime: every startup phase, then a fixed number of frames.
+AppRunResult runApp(const BenchmarkOptions& options, uint32_t drawCount) {
+    AppConfig config;
+    config.headless = !options.windowed;
+    config.headlessWidth = options.width;
+    config.headlessHeight = options.height;
+    config.headlessFrameCount = options.frames;
+    config.maxFrames = options.frames;
+    config.recreateEveryNFrames = options.windowed ? options.recreateEvery : 0;
+    config.syntheticDrawCount = drawCount;
+    config.device = options.device;
+    config.pipelineCacheSaveInterval = 0.0; // Keep file I/O out of the frame loop
+
+    vulkan::VulkanApp app(config);
+    AppRunResult result;
+    result.drawCount = drawCount;
+    result.phases = app.getPhaseTimings();
+    result.frames = app.getLoopFrameCount();
+    result.seconds = app.getLoopSeconds();
+    return result;
+}
+
+// Half textures, half meshes: 1024x1024 RGBA8 gradients with noisy low bits, and grids with
+// position/normal/uv vertices. Both compress, but not trivially.
+bool writeBenchmarkPack(const std::string& path, uint32_t megabytes, bool compress) {
+    const uint32_t textureSize = 1024;
+    const uint32_t gridSize = 256;
+    std::vector<uint8_t> texels(size_t(textureSize) * textureSize * 4);
+    std::vector<float> vertices(size_t(gridSize) * gridSize * 8);
+    std::vector<uint32_t> indices;
+    for (uint32_t y = 0; y + 1 < gridSize; y++) {
+        for (uint32_t x = 0; x + 1 < gridSize; x++) {
+            uint32_t corner = y * gridSize + x;
+            for (uint32_t index : { corner, corner + gridSize, corner + 1, corner + 1, corner + gridSize, corner + gridSize + 1 }) {
+                indices.push_back(index);
+            }
+        }
+    }
+    uint32_t state = 12345;
+    vulkan::AssetPackWriter writer;
+    uint64_t written = 0;
+    for (uint32_t asset = 0; written < (uint64_t(megabytes) << 20); asset++) {
+        for (size_t i = 0; i < texels.size(); i++) {
+            state = state * 1664525u + 1013904223u;
+            size_t texel = i / 4;
+            texels[i] = static_cast<uint8_t>(((texel % textureSize + asset * 7) ^ (texel / textureSize)) + ((state >> 28) & 3));
+        }
+        writer.addTexture("texture" + std::to_string(asset), textureSize, textureSize, VK_FORMAT_R8G8B8A8_UNORM, 4, texels.data());
+        for (uint32_t i = 0; i < gridSize * gridSize; i++) {
+            float x = static_cast<float>(i % gridSize);
+            float z = static_cast<float>(i / gridSize);
+            float vertex[8] = { x, std::sin(x * 0.1f + asset) * std::cos(z * 0.1f), z, 0.0f, 1.0f, 0.0f, x / gridSize, z / gridSize };
+            std::memcpy(&vertices[size_t(i) * 8], vertex, sizeof(vertex));
+        }
+        writer.addMesh("mesh" + std::to_string(asset), vertices.data(), gridSize * gridSize, 8 * sizeof(float), indices.data(), static_cast<uint32_t>(indices.size()));
+        written += texels.size() + vertices.size() * sizeof(float) + indices.size() * sizeof(uint32_t);
+    }
+    return writer.write(path, compress);
+}
+
+// Streams the pack while rendering empty frames; the loader reports when the last asset is ready.
+AssetLoadResult runAssetLoad(const BenchmarkOptions& options, bool compress) {
+    AssetLoadResult result;
+    result.compressed = compress;
+    std::string path = compress ? "benchmark_assets_lz4.pack" : "benchmark_assets_raw.pack";
+    if (!writeBenchmarkPack(path, options.assetMegabytes, compress)) {
+        return result;
+    }
+    std::error_code error;
+    result.fileBytes = std::filesystem::file_size(path, error);
+
+    AppConfig config;
+    config.headless = true;
+    config.headlessWidth = options.width;
+    config.headlessHeight = options.height;
+    config.headlessFrameCount = options.frames;
+    config.maxFrames = options.frames;
+    config.device = options.device;
+    config.pipelineCacheSaveInterval = 0.0;
+    config.assetPackPath = path;
+    {
+        vulkan::VulkanApp app(config);
+        result.stats = app.getAssetLoadStats();
+    }
+    std::filesystem::remove(path, error);
+    return result;
+}
+
+// Driver-like traffic: mostly small object allocations, some command-scope scratch, a few large
+// cache blocks, with a bounded live set so frees interleave with allocations.
+template <typename AllocateFn, typename FreeFn>
+double runAllocationWorkload(uint32_t operations, uint32_t seed, AllocateFn allocate, FreeFn release) {
+    static const VkSystemAllocationScope scopes[] = {
+        VK_SYSTEM_ALLOCATION_SCOPE_OBJECT, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT, VK_SYSTEM_ALLOCATION_SCOPE_COMMAND,
+        VK_SYSTEM_ALLOCATION_SCOPE_CACHE, VK_SYSTEM_ALLOCATION_SCOPE_DEVICE,
+    };
+    std::vector<void*> live(1024, nullptr);
+    uint32_t state = seed * 2654435761u + 1;
+    auto next = [&state]() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t op = 0; op < operations; op++) {
+        uint32_t r = next();
+        size_t slot = r % live.size();
+        if (live[slot]) {
+            release(live[slot]);
+            live[slot] = nullptr;
+        }
+        uint32_t bucket = (r >> 10) % 100;
+        size_t size = bucket < 70 ? 16 + (r >> 16) % 240 : bucket < 95 ? 256 + (r >> 16) % 3840 : 4096 + (r >> 12) % 61440;
+        size_t alignment = (r & 0x300) == 0x300 ? 64 : 16;
+        live[slot] = allocate(size, alignment, scopes[(r >> 20) % 5]);
+    }
+    for (void* ptr : live) {
+        if (ptr) {
+            release(ptr);
+        }
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename AllocateFn, typename FreeFn>
+AllocatorResult benchmarkAllocator(const char* name, uint32_t threads, uint32_t operations, AllocateFn allocate, FreeFn release) {
+    std::vector<std::thread> workers;
+    uint32_t perThread = operations / threads;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t t = 0; t < threads; t++) {
+        workers.emplace_back([=]() { runAllocationWorkload(perThread, t + 1, allocate, release); });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    AllocatorResult result;
+    result.name = name;
+    result.threads = threads;
+    result.operations = uint64_t(perThread) * threads;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+std::vector<AllocatorResult> runAllocatorBenchmarks(const BenchmarkOptions& options) {
+    void* heap = &Allocator::HostHeap::Instance();
+    auto customAllocate = [heap](size_t size, size_t alignment, VkSystemAllocationScope scope) {
+        return Allocator::CustomAllocation(heap, size, alignment, scope);
+    };
+    auto customFree = [heap](void* ptr) { Allocator::CustomFree(heap, ptr); };
+    // malloc ignores the alignment request beyond its own guarantee; it is the floor to beat
+    auto mallocAllocate = [](size_t size, size_t, VkSystemAllocationScope) { return std::malloc(size); };
+    auto mallocFree = [](void* ptr) { std::free(ptr); };
+    auto alignedAllocate = [](size_t size, size_t alignment, VkSystemAllocationScope) { return Allocator::AlignedSystemAlloc(size, alignment); };
+    auto alignedFree = [](void* ptr) { Allocator::AlignedSystemFree(ptr); };
+
+    std::vector<AllocatorResult> results;
+    for (uint32_t threads : { 1u, options.allocThreads }) {
+        results.push_back(benchmarkAllocator("Allocator::CustomAllocation", threads, options.allocOps, customAllocate, customFree));
+        results.push_back(benchmarkAllocator("malloc", threads, options.allocOps, mallocAllocate, mallocFree));
+        results.push_back(benchmarkAllocator("aligned system alloc", threads, options.allocOps, alignedAllocate, alignedFree));
+        if (options.allocThreads == 1) {
+            break;
+        }
+    }
+    return results;
+}
+
+// Clusters of a root, a ring of 15 children and a grandchild under each, as in VulkanApp::createScene().
+SceneResult runSceneBenchmark(uint32_t objectCount, vulkan::SimdLevel level, Jobs::JobSystem& jobs) {
+    using vulkan::Scene;
+    const uint32_t iterations = 50;
+    Scene scene(level);
+    scene.reserve(objectCount);
+    std::vector<Scene::NodeId> roots;
+    const float identity[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    const float zero[3] = { 0.0f, 0.0f, 0.0f };
+    const float extent[3] = { 0.5f, 0.5f, 0.5f };
+    const float yAxis[3] = { 0.0f, 1.0f, 0.0f };
+    uint32_t clusterCount = std::max(1u, objectCount / 31);
+    uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(clusterCount))));
+    for (uint32_t cluster = 0; cluster < clusterCount; cluster++) {
+        float center[3] = { static_cast<float>(cluster % side) * 12.0f, 0.0f, static_cast<float>(cluster / side) * 12.0f };
+        Scene::NodeId root = scene.createNode(Scene::InvalidNode, center, identity, 1.0f, zero, extent);
+        roots.push_back(root);
+        for (uint32_t i = 0; i < 15; i++) {
+            float angle = 6.2831853f * static_cast<float>(i) / 15.0f;
+            float offset[3] = { 4.0f * std::cos(angle), 0.0f, 4.0f * std::sin(angle) };
+            float rotation[4];
+            vulkan::quaternionFromAxisAngle(yAxis, -angle, rotation);
+            Scene::NodeId child = scene.createNode(root, offset, rotation, 0.5f, zero, extent);
+            float above[3] = { 0.0f, 1.5f, 0.0f };
+            scene.createNode(child, above, identity, 0.5f, zero, extent);
+        }
+    }
+    scene.update(jobs);
+
+    auto timeUpdates = [&](uint32_t stride) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t iteration = 0; iteration < iterations; iteration++) {
+            float rotation[4];
+            vulkan::quaternionFromAxisAngle(yAxis, static_cast<float>(iteration) * 0.01f, rotation);
+            for (size_t root = 0; root < roots.size(); root += stride) {
+                scene.setRotation(roots[root], rotation);
+            }
+            scene.update(jobs);
+        }
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+    };
+    SceneResult result;
+    result.level = scene.simdLevel();
+    result.nodes = scene.nodeCount();
+    result.fullUpdateMs = timeUpdates(1);
+    result.partialUpdateMs = timeUpdates(4);
+
+    float extentWorld = side * 12.0f;
+    float eye[3] = { extentWorld * 0.5f, 20.0f, -10.0f };
+    float target[3] = { extentWorld * 0.5f, 0.0f, extentWorld * 0.5f };
+    float viewProjection[16];
+    float planes[6][4];
+    vulkan::makeViewProjection(eye, target, 1.0472f, 16.0f / 9.0f, 0.1f, extentWorld, viewProjection);
+    vulkan::extractFrustumPlanes(viewProjection, planes);
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t iteration = 0; iteration < iterations; iteration++) {
+        result.visible = scene.cull(planes, jobs).size();
+    }
+    result.cullMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+    std::cout << "Scene " << vulkan::simdLevelName(result.level) << ": " << result.nodes << " nodes, update " << result.fullUpdateMs
+        << " ms (quarter moving " << result.partialUpdateMs << " ms), cull " << result.cullMs << " ms" << std::endl;
+    return result;
+}
+
+std::vector<SceneResult> runSceneBenchmarks(const BenchmarkOptions& options) {
+    std::vector<SceneResult> results;
+    Jobs::JobSystem jobs;
+    for (vulkan::SimdLevel level : { vulkan::SimdLevel::Scalar, vulkan::SimdLevel::Sse, vulkan::SimdLevel::Avx2 }) {
+        if (vulkan::clampSimdLevel(level) == level) {
+            results.push_back(runSceneBenchmark(options.sceneObjects, level, jobs));
+        }
+    }
+    return results;
+}
+
+bool writeJson(const std::string& path, const BenchmarkOptions& options, const std::vector<AppRunResult>& runs, const std::vector<AllocatorResult>& allocators,
+    const std::vector<AssetLoadResult>& assetLoads, const std::vector<SceneResult>& scenes) {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+    file << "{\n  \"version\": 1,\n";
+    file << "  \"config\": {\"headless\": " << (options.windowed ? "false" : "true") << ", \"width\": " << options.width
+        << ", \"height\": " << options.height << ", \"frames\": " << options.frames << "},\n";
+    file << "  \"runs\": [\n";
+    for (size_t i = 0; i < runs.size(); i++) {
+        const AppRunResult& run = runs[i];
+        double fps = run.seconds > 0.0 ? run.frames / run.seconds : 0.0;
+        file << "    {\"drawCount\": " << run.drawCount << ", \"frames\": " << run.frames << ", \"seconds\": " << run.seconds
+            << ", \"fps\": " << fps << ", \"msPerFrame\": " << (run.frames ? run.seconds * 1000.0 / run.frames : 0.0) << ",\n";
+        file << "     \"phases\": [";
+        for (size_t p = 0; p < run.phases.size(); p++) {
+            file << (p ? ", " : "") << "{\"name\": \"" << run.phases[p].name << "\", \"ms\": " << run.phases[p].ms << "}";
+        }
+        file << "]}" << (i + 1 < runs.size() ? "," : "") << "\n";
+    }
+    file << "  ],\n  \"allocators\": [\n";
+    for (size_t i = 0; i < allocators.size(); i++) {
+        const AllocatorResult& result = allocators[i];
+        double nsPerOp = result.operations ? result.seconds * 1e9 / result.operations : 0.0;
+        file << "    {\"name\": \"" << result.name << "\", \"threads\": " << result.threads << ", \"operations\": " << result.operations
+            << ", \"seconds\": " << result.seconds << ", \"nsPerOp\": " << nsPerOp << "}" << (i + 1 < allocators.size() ? "," : "") << "\n";
+    }
+    file << "  ],\n  \"assetLoads\": [\n";
+    for (size_t i = 0; i < assetLoads.size(); i++) {
+        const AssetLoadResult& result = assetLoads[i];
+        file << "    {\"compressed\": " << (result.compressed ? "true" : "false") << ", \"fileBytes\": " << result.fileBytes
+            << ", \"bytes\": " << result.stats.bytes << ", \"complete\": " << (result.stats.complete ? "true" : "false")
+            << ", \"ms\": " << result.stats.seconds * 1000.0 << ", \"peakResidentGrowthBytes\": " << result.stats.peakResidentGrowth << "}"
+            << (i + 1 < assetLoads.size() ? "," : "") << "\n";
+    }
+    file << "  ],\n  \"scenes\": [\n";
+    for (size_t i = 0; i < scenes.size(); i++) {
+        const SceneResult& result = scenes[i];
+        file << "    {\"simd\": \"" << vulkan::simdLevelName(result.level) << "\", \"nodes\": " << result.nodes
+            << ", \"fullUpdateMs\": " << result.fullUpdateMs << ", \"partialUpdateMs\": " << result.partialUpdateMs
+            << ", \"cullMs\": " << result.cullMs << ", \"visible\": " << result.visible << "}"
+            << (i + 1 < scenes.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n}\n";
+    return true;
+}
+
+int main(int argc, char** argv) {
+    BenchmarkOptions options = parseOptions(argc, argv);
+    std::vector<AppRunResult> runs;
+    std::vector<AllocatorResult> allocators;
+    std::vector<AssetLoadResult> assetLoads;
+    std::vector<SceneResult> scenes;
+    try {
+        allocators = runAllocatorBenchmarks(options);
+        if (options.sceneObjects > 0) {
+            scenes = runSceneBenchmarks(options);
+        }
+        for (uint32_t drawCount : options.drawCounts) {
+            runs.push_back(runApp(options, drawCount));
+        }
+        if (options.assetMegabytes > 0) {
+            assetLoads.push_back(runAssetLoad(options, false));
+            assetLoads.push_back(runAssetLoad(options, true));
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (!writeJson(options.outPath, options, runs, allocators, assetLoads, scenes)) {
+        std::cerr << "Failed to write " << options.outPath << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Benchmark results written to " << options.outPath << std::endl;
+    return EXIT_SUCCESS;
+}
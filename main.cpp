@@ -1,11 +1,109 @@
+#include "Classheader.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
+// Startup options: --headless [--frames N] [--size WxH], --frames-in-flight N, --fps N, --device <index|name>,
+// --profile <trace.json>, --backend dynamic|renderpass, --present-policy low-latency|max-throughput|power-saving.
+// VKL_HEADLESS=1 selects headless mode, VKL_PROFILE=<trace.json> enables profiling, and VKL_RENDER_BACKEND
+// and VKL_PRESENT_POLICY override the backend and present policy without touching the command line.
+// --frames-in-flight pins the frame count that the present policy would otherwise choose. --track-leaks
+// (or VKL_TRACK_LEAKS=1) lists Vulkan handles that were never destroyed at shutdown. --gpu-culling N draws N
+// grid objects through GPU culling. Shaders are compiled from --shader-dir (default "shaders") into the SPIR-V
+// cache in --shader-cache (default "shader_cache"); --shader-hot-reload on|off overrides the build-type default.
+// --asset-pack <file> streams a packed asset file into device memory while frames render.
+// --scene-objects N animates and culls a CPU scene hierarchy of about N nodes each frame; --simd scalar|sse2|avx2
+// caps the instruction set its kernels use (default: the best the CPU supports).
+RenderBackend parseRenderBackend(const char* name) {
+    if (std::strcmp(name, "dynamic") == 0) {
+        return RenderBackend::DynamicRendering;
+    }
+    if (std::strcmp(name, "renderpass") == 0) {
+        return RenderBackend::RenderPass;
+    }
+    return RenderBackend::Auto;
+}
 
+AppConfig parseArguments(int argc, char** argv) {
+    AppConfig config;
+    const char* headless = std::getenv("VKL_HEADLESS");
+    config.headless = headless != nullptr && std::strcmp(headless, "0") != 0;
+    if (const char* profile = std::getenv("VKL_PROFILE")) {
+        config.profileTracePath = profile;
+    }
+    if (const char* backend = std::getenv("VKL_RENDER_BACKEND")) {
+        config.renderBackend = parseRenderBackend(backend);
+    }
+    const char* trackLeaks = std::getenv("VKL_TRACK_LEAKS");
+    config.trackLeaks = trackLeaks != nullptr && std::strcmp(trackLeaks, "0") != 0;
+    if (const char* policy = std::getenv("VKL_PRESENT_POLICY")) {
+        vulkan::parsePresentPolicy(policy, config.presentPolicy);
+    }
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--headless") == 0) {
+            config.headless = true;
+        }
+        else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            config.headlessFrameCount = static_cast<uint32_t>(std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            unsigned width = 0, height = 0;
+            if (std::sscanf(argv[++i], "%ux%u", &width, &height) == 2 && width > 0 && height > 0) {
+                config.headlessWidth = width;
+                config.headlessHeight = height;
+            }
+        }
+        else if (std::strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc) {
+            config.framesInFlight = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+        }
+        else if (std::strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            config.targetFps = std::atof(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--device") == 0 && i + 1 < argc) {
+            config.device = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            config.profileTracePath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            config.renderBackend = parseRenderBackend(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--track-leaks") == 0) {
+            config.trackLeaks = true;
+        }
+        else if (std::strcmp(argv[i], "--gpu-culling") == 0 && i + 1 < argc) {
+            config.gpuCullingObjectCount = static_cast<uint32_t>(std::max(0, std::atoi(argv[++i])));
+        }
+        else if (std::strcmp(argv[i], "--shader-dir") == 0 && i + 1 < argc) {
+            config.shaderDirectory = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--asset-pack") == 0 && i + 1 < argc) {
+            config.assetPackPath = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--scene-objects") == 0 && i + 1 < argc) {
+            config.sceneObjectCount = static_cast<uint32_t>(std::max(0, std::atoi(argv[++i])));
+        }
+        else if (std::strcmp(argv[i], "--simd") == 0 && i + 1 < argc) {
+            vulkan::parseSimdLevel(argv[++i], config.sceneSimdLevel);
+        }
+        else if (std::strcmp(argv[i], "--shader-cache") == 0 && i + 1 < argc) {
+            config.shaderCacheDirectory = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--shader-hot-reload") == 0 && i + 1 < argc) {
+            config.shaderHotReload = std::strcmp(argv[++i], "off") != 0;
+        }
+        else if (std::strcmp(argv[i], "--present-policy") == 0 && i + 1 < argc) {
+            if (!vulkan::parsePresentPolicy(argv[++i], config.presentPolicy)) {
+                std::cerr << "Unknown present policy " << argv[i] << ", keeping " << vulkan::presentPolicyName(config.presentPolicy) << std::endl;
+            }
+        }
+    }
+    return config;
+}
 
-#include "classheader.hpp"
-int main() {
+int main(int argc, char** argv) {
     try {
-        vulkan::VulkanApp app;
-        app.run();
+        vulkan::VulkanApp app(parseArguments(argc, argv)); // The constructor runs the app to completion
         
     }
     catch (const std::exception& e) {
@@ -14,4 +112,4 @@ int main() {
     }
     
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,10 @@
+#version 460
+// Compiled at startup by ShaderSystem. Where no compiler is installed it loads a prebuilt
+// cull_draw.frag.spv instead: glslangValidator -V --target-env vulkan1.2 cull_draw.frag -o cull_draw.frag.spv
+
+layout(location = 0) in vec3 color;
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = vec4(color, 1.0);
+}
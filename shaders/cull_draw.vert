@@ -0,0 +1,36 @@
+#version 460
+// Draws the objects that survived cull.comp; gl_InstanceIndex is the compacted slot.
+// Compiled at startup by ShaderSystem. Where no compiler is installed it loads a prebuilt
+// cull_draw.vert.spv instead: glslangValidator -V --target-env vulkan1.2 cull_draw.vert -o cull_draw.vert.spv
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+struct VisibleInstance {
+    vec4 sphere;
+    uint objectIndex;
+    uint pad0;
+    uint pad1;
+    uint pad2;
+};
+
+layout(set = 0, binding = 1) readonly buffer VisibleInstances { VisibleInstance instances[]; } visibleInstances[];
+
+// Mirrors CullDrawPushConstants.
+layout(push_constant) uniform DrawParams {
+    mat4 viewProjection;
+    uint instanceBuffer;
+} params;
+
+layout(location = 0) out vec3 color;
+
+void main() {
+    VisibleInstance instance = visibleInstances[params.instanceBuffer].instances[gl_InstanceIndex];
+    // The stand-in mesh is a cube whose vertex index bits are its corner; it fits inside the bounding sphere
+    vec3 corner = vec3(gl_VertexIndex & 1, (gl_VertexIndex >> 1) & 1, (gl_VertexIndex >> 2) & 1) * 2.0 - 1.0;
+    vec3 position = instance.sphere.xyz + corner * (instance.sphere.w * 0.57735);
+    gl_Position = params.viewProjection * vec4(position, 1.0);
+
+    uint hash = instance.objectIndex * 2654435761u;
+    vec3 base = vec3(hash & 255u, (hash >> 8) & 255u, (hash >> 16) & 255u) / 255.0;
+    color = base * (0.55 + 0.45 * (corner.y * 0.5 + 0.5));
+}
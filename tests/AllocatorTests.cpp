@@ -0,0 +1,100 @@
+// Host allocator callbacks: live bytes per scope must return to their starting value after
+// allocations, reallocations that grow, shrink or move between scopes, and frees.
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include "../Alloctor.hpp"
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (0)
+
+static const VkSystemAllocationScope kScopes[] = {
+    VK_SYSTEM_ALLOCATION_SCOPE_COMMAND,
+    VK_SYSTEM_ALLOCATION_SCOPE_OBJECT,
+    VK_SYSTEM_ALLOCATION_SCOPE_CACHE,
+    VK_SYSTEM_ALLOCATION_SCOPE_DEVICE,
+    VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE,
+};
+
+static uint64_t liveBytes(VkSystemAllocationScope scope) {
+    return Allocator::AllocationTelemetry::Instance().query().scopes[scope].liveBytes;
+}
+
+static void snapshot(uint64_t* live) {
+    for (VkSystemAllocationScope scope : kScopes) {
+        live[scope] = liveBytes(scope);
+    }
+}
+
+static void checkUnchanged(const uint64_t* before, const char* step) {
+    for (VkSystemAllocationScope scope : kScopes) {
+        if (liveBytes(scope) != before[scope]) {
+            std::printf("%s: %s scope leaked %lld bytes\n", step, Allocator::scopeName(scope),
+                static_cast<long long>(liveBytes(scope) - before[scope]));
+            failures++;
+        }
+    }
+}
+
+// A small block moved to another scope must not be resized in place: its pool belongs to the old scope.
+static void testReallocAcrossScopes() {
+    uint64_t before[VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1];
+    snapshot(before);
+    for (VkSystemAllocationScope from : kScopes) {
+        for (VkSystemAllocationScope to : kScopes) {
+            for (size_t size : { size_t(24), size_t(200), size_t(70000) }) {
+                void* block = Allocator::CustomAllocation(nullptr, size, 16, from);
+                CHECK(block != nullptr);
+                std::memset(block, 0x5a, size);
+                CHECK(liveBytes(from) == before[from] + size);
+
+                size_t smaller = size / 2;
+                void* moved = Allocator::CustomReallocation(nullptr, block, smaller, 16, to);
+                CHECK(moved != nullptr);
+                CHECK(static_cast<unsigned char*>(moved)[smaller - 1] == 0x5a);
+                CHECK(Allocator::headerOf(moved)->scope == to);
+                if (from != to) {
+                    CHECK(liveBytes(from) == before[from]);
+                }
+                CHECK(liveBytes(to) == before[to] + smaller);
+
+                void* grown = Allocator::CustomReallocation(nullptr, moved, size * 3, 16, from);
+                CHECK(grown != nullptr);
+                CHECK(static_cast<unsigned char*>(grown)[0] == 0x5a);
+                CHECK(liveBytes(from) == before[from] + size * 3);
+
+                Allocator::CustomFree(nullptr, grown);
+                checkUnchanged(before, "alloc/realloc/free");
+            }
+        }
+    }
+}
+
+// Realloc to zero frees the block and realloc of null allocates, both through the telemetry.
+static void testReallocEdges() {
+    uint64_t before[VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1];
+    snapshot(before);
+    void* block = Allocator::CustomReallocation(nullptr, nullptr, 96, 16, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+    CHECK(block != nullptr);
+    CHECK(liveBytes(VK_SYSTEM_ALLOCATION_SCOPE_OBJECT) == before[VK_SYSTEM_ALLOCATION_SCOPE_OBJECT] + 96);
+    CHECK(Allocator::CustomReallocation(nullptr, block, 0, 16, VK_SYSTEM_ALLOCATION_SCOPE_DEVICE) == nullptr);
+    checkUnchanged(before, "realloc edges");
+}
+
+int main() {
+    testReallocAcrossScopes();
+    testReallocEdges();
+    if (failures != 0) {
+        std::printf("%d allocator checks failed\n", failures);
+        return 1;
+    }
+    std::printf("allocator tests passed\n");
+    return 0;
+}
@@ -0,0 +1,220 @@
+// Asset packs: writer/reader round trips, and the checks open() and read() make on damaged files.
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../AssetPack.hpp"
+
+using namespace vulkan;
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (0)
+
+struct Vertex {
+    float position[3];
+    float uv[2];
+};
+
+static std::vector<uint8_t> readFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string& path, const std::vector<uint8_t>& bytes) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+}
+
+// Rewrites the table checksum so that only the edit under test can make open() fail.
+static void resealTables(std::vector<uint8_t>& bytes) {
+    AssetPackHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    header.tableChecksum = fnv1a64(bytes.data() + header.assetTableOffset, header.assetCount * sizeof(PackAsset)) ^
+        fnv1a64(bytes.data() + header.chunkTableOffset, header.chunkCount * sizeof(PackChunk));
+    std::memcpy(bytes.data(), &header, sizeof(header));
+}
+
+static PackAsset* assetEntry(std::vector<uint8_t>& bytes, uint32_t index) {
+    AssetPackHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    return reinterpret_cast<PackAsset*>(bytes.data() + header.assetTableOffset) + index;
+}
+
+static PackChunk* chunkEntry(std::vector<uint8_t>& bytes, uint32_t index) {
+    AssetPackHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    return reinterpret_cast<PackChunk*>(bytes.data() + header.chunkTableOffset) + index;
+}
+
+// Decodes every chunk of the asset back into one buffer; false if any chunk is corrupt.
+static bool readAsset(const AssetPack& pack, uint32_t index, std::vector<uint8_t>& out) {
+    const PackAsset& asset = pack.asset(index);
+    out.assign(asset.size, 0);
+    for (uint32_t c = asset.firstChunk; c < asset.firstChunk + asset.chunkCount; c++) {
+        if (!pack.read(c, out.data() + pack.chunk(c).assetOffset)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    std::string directory = (std::filesystem::temp_directory_path() / "vkl-asset-pack-tests").string();
+    std::filesystem::create_directories(directory);
+    std::string path = directory + "/test.pack";
+
+    // A mesh, a texture that spans several chunks and compresses well, and one that does not
+    std::vector<Vertex> vertices(3000);
+    for (size_t i = 0; i < vertices.size(); i++) {
+        vertices[i] = { { float(i), float(i % 7), 1.0f }, { float(i % 2), 0.5f } };
+    }
+    std::vector<uint32_t> indices(9000);
+    for (size_t i = 0; i < indices.size(); i++) {
+        indices[i] = static_cast<uint32_t>(i % vertices.size());
+    }
+    const uint32_t gradientSize = 512;
+    std::vector<uint8_t> gradient(size_t(gradientSize) * gradientSize * 4);
+    for (size_t i = 0; i < gradient.size(); i++) {
+        gradient[i] = static_cast<uint8_t>((i / 4) % gradientSize);
+    }
+    const uint32_t noiseSize = 64;
+    std::vector<uint8_t> noise(size_t(noiseSize) * noiseSize * 16);
+    uint32_t state = 1;
+    for (uint8_t& value : noise) {
+        state = state * 1664525u + 1013904223u;
+        value = static_cast<uint8_t>(state >> 24);
+    }
+    std::vector<uint8_t> meshBytes(vertices.size() * sizeof(Vertex) + indices.size() * sizeof(uint32_t));
+    std::memcpy(meshBytes.data(), vertices.data(), vertices.size() * sizeof(Vertex));
+    std::memcpy(meshBytes.data() + vertices.size() * sizeof(Vertex), indices.data(), indices.size() * sizeof(uint32_t));
+
+    AssetPackWriter writer;
+    writer.addMesh("mesh", vertices.data(), uint32_t(vertices.size()), sizeof(Vertex), indices.data(), uint32_t(indices.size()));
+    writer.addTexture("gradient", gradientSize, gradientSize, VK_FORMAT_R8G8B8A8_UNORM, 4, gradient.data());
+    writer.addTexture("noise", noiseSize, noiseSize, VK_FORMAT_R32G32B32A32_SFLOAT, 16, noise.data());
+
+    bool rejected = false;
+    try {
+        writer.addTexture("mismatch", 4, 4, VK_FORMAT_R8G8B8A8_UNORM, 8, gradient.data());
+    }
+    catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    CHECK(rejected);
+
+    for (bool compress : { false, true }) {
+        CHECK(writer.write(path, compress));
+        AssetPack pack;
+        CHECK(pack.open(path));
+        if (!pack.isOpen()) {
+            continue;
+        }
+        CHECK(pack.assetCount() == 3);
+        CHECK(pack.find("gradient") == 1);
+        CHECK(pack.find("missing") == UINT32_MAX);
+        CHECK(pack.asset(1).chunkCount > 1);
+        bool anyLz4 = false;
+        for (uint32_t c = 0; c < pack.chunkCount(); c++) {
+            anyLz4 |= pack.chunk(c).codec == ChunkCodec::Lz4;
+        }
+        CHECK(anyLz4 == compress);
+        const PackAsset& mesh = pack.asset(0);
+        CHECK(mesh.kind == AssetKind::Mesh && mesh.vertexCount == vertices.size() && mesh.indexCount == indices.size());
+        const PackAsset& texture = pack.asset(2);
+        CHECK(texture.kind == AssetKind::Texture && texture.width == noiseSize && texture.format == VK_FORMAT_R32G32B32A32_SFLOAT);
+
+        std::vector<uint8_t> decoded;
+        CHECK(readAsset(pack, 0, decoded) && decoded == meshBytes);
+        CHECK(readAsset(pack, 1, decoded) && decoded == gradient);
+        CHECK(readAsset(pack, 2, decoded) && decoded == noise);
+    }
+
+    const std::vector<uint8_t> good = readFile(path);
+    auto opens = [&](const std::vector<uint8_t>& bytes) {
+        writeFile(path, bytes);
+        AssetPack pack;
+        return pack.open(path);
+    };
+    CHECK(opens(good));
+
+    std::vector<uint8_t> bytes = good;
+    bytes.resize(bytes.size() - 1);
+    CHECK(!opens(bytes));
+    bytes = good;
+    bytes[0] = 'X';
+    CHECK(!opens(bytes));
+
+    // Any table edit without a matching checksum
+    bytes = good;
+    assetEntry(bytes, 1)->width++;
+    CHECK(!opens(bytes));
+
+    // Consistent checksum, inconsistent contents
+    bytes = good;
+    assetEntry(bytes, 1)->bytesPerTexel = 8;
+    assetEntry(bytes, 1)->width /= 2;
+    resealTables(bytes);
+    CHECK(!opens(bytes));
+    bytes = good;
+    assetEntry(bytes, 2)->format = VK_FORMAT_UNDEFINED;
+    resealTables(bytes);
+    CHECK(!opens(bytes));
+    bytes = good;
+    chunkEntry(bytes, 0)->fileOffset = bytes.size();
+    resealTables(bytes);
+    CHECK(!opens(bytes));
+    bytes = good;
+    chunkEntry(bytes, 1)->assetOffset += 4;
+    resealTables(bytes);
+    CHECK(!opens(bytes));
+    bytes = good;
+    assetEntry(bytes, 0)->chunkCount = 1000;
+    resealTables(bytes);
+    CHECK(!opens(bytes));
+    bytes = good;
+    std::memset(assetEntry(bytes, 0)->name, 'a', sizeof(PackAsset::name));
+    resealTables(bytes);
+    CHECK(!opens(bytes));
+
+    // Chunk data is not covered by the checksum: open() succeeds, and read() reports the bad chunk
+    bytes = good;
+    writeFile(path, good);
+    AssetPack reference;
+    reference.open(path);
+    uint32_t lz4Chunk = UINT32_MAX;
+    for (uint32_t c = 0; c < reference.chunkCount() && lz4Chunk == UINT32_MAX; c++) {
+        if (reference.chunk(c).codec == ChunkCodec::Lz4 && reference.chunk(c).storedSize > 16) {
+            lz4Chunk = c;
+        }
+    }
+    CHECK(lz4Chunk != UINT32_MAX);
+    if (lz4Chunk != UINT32_MAX) {
+        PackChunk chunk = reference.chunk(lz4Chunk);
+        reference.close();
+        std::memset(bytes.data() + chunk.fileOffset + chunk.storedSize - 8, 0xff, 8);
+        writeFile(path, bytes);
+        AssetPack pack;
+        CHECK(pack.open(path));
+        std::vector<uint8_t> out(chunk.size);
+        CHECK(pack.isOpen() && !pack.read(lz4Chunk, out.data()));
+    }
+
+    std::error_code error;
+    std::filesystem::remove_all(directory, error);
+    if (failures != 0) {
+        std::printf("%d asset pack checks failed\n", failures);
+        return 1;
+    }
+    std::printf("Asset pack tests passed\n");
+    return 0;
+}
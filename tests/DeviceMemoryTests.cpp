@@ -0,0 +1,212 @@
+// Device memory allocator without a device: vkAllocateMemory/vkFreeMemory are faked, so the TLSF
+// pools and the defragmentation planner run on bookkeeping alone.
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <set>
+#include <vector>
+#include "../DeviceMemory.hpp"
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (0)
+
+static std::set<VkDeviceMemory> liveMemory;
+static uint64_t nextMemory = 1;
+
+static VKAPI_ATTR VkResult VKAPI_CALL fakeAllocateMemory(VkDevice, const VkMemoryAllocateInfo*, const VkAllocationCallbacks*, VkDeviceMemory* memory) {
+    *memory = (VkDeviceMemory)(uintptr_t)(nextMemory++ * 16);
+    liveMemory.insert(*memory);
+    return VK_SUCCESS;
+}
+
+static VKAPI_ATTR void VKAPI_CALL fakeFreeMemory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks*) {
+    CHECK(liveMemory.erase(memory) == 1);
+}
+
+static const VkDeviceSize kHeapSize = 64ull << 20;   // gives 8 MiB blocks
+static const VkDeviceSize kSlot = 256ull << 10;      // 32 slots per block
+
+static void initAllocator(vulkan::DeviceMemoryAllocator& memory, vulkan::DeviceDispatch& dispatch) {
+    dispatch.vkAllocateMemory = fakeAllocateMemory;
+    dispatch.vkFreeMemory = fakeFreeMemory;
+    VkPhysicalDeviceMemoryProperties properties{};
+    properties.memoryTypeCount = 1;
+    properties.memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    properties.memoryTypes[0].heapIndex = 0;
+    properties.memoryHeapCount = 1;
+    properties.memoryHeaps[0].size = kHeapSize;
+    properties.memoryHeaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+    VkPhysicalDeviceLimits limits{};
+    limits.maxMemoryAllocationCount = 4096;
+    limits.nonCoherentAtomSize = 64;
+    limits.minStorageBufferOffsetAlignment = 16;
+    memory.init(properties, limits, dispatch, nullptr, false);
+}
+
+static vulkan::DeviceAllocation* allocateSlot(vulkan::DeviceMemoryAllocator& memory) {
+    VkMemoryRequirements requirements{};
+    requirements.size = kSlot;
+    requirements.alignment = 1; // with padding the last slot of a block would not fit
+    requirements.memoryTypeBits = 1;
+    return memory.allocate(requirements, vulkan::MemoryUsage::GpuOnly, vulkan::ResourceKind::Linear);
+}
+
+static VkDeviceSize allocatedBytes(vulkan::DeviceMemoryAllocator& memory) {
+    return memory.queryBudget()[0].allocatedBytes;
+}
+
+static bool overlaps(const vulkan::DeviceAllocation* a, const vulkan::DeviceAllocation* b) {
+    return a->memory == b->memory && a->offset < b->offset + b->size && b->offset < a->offset + a->size;
+}
+
+// Checks the invariants every plan must keep: destinations are fresh ranges in another, fuller block,
+// never overlap anything live, and no allocation is both a source and a destination.
+static void checkPlan(const std::vector<vulkan::DefragmentationMove>& moves, const std::vector<vulkan::DeviceAllocation*>& live) {
+    std::set<const vulkan::DeviceAllocation*> sources;
+    std::set<const vulkan::DeviceAllocation*> destinations;
+    for (const vulkan::DefragmentationMove& move : moves) {
+        CHECK(sources.insert(move.source).second);
+        CHECK(destinations.insert(move.destination).second);
+        CHECK(move.destination->block != move.source->block);
+        CHECK(move.destination->block->metadata.used() >= move.source->block->metadata.used());
+        CHECK(move.destination->size == move.source->size);
+        CHECK(move.destination->offset % move.source->alignment == 0);
+        CHECK(!move.destination->movable);
+        for (const vulkan::DeviceAllocation* allocation : live) {
+            CHECK(!overlaps(move.destination, allocation));
+        }
+    }
+    for (const vulkan::DefragmentationMove& move : moves) {
+        CHECK(destinations.count(move.source) == 0);
+        for (const vulkan::DefragmentationMove& other : moves) {
+            CHECK(&move == &other || !overlaps(move.destination, other.destination));
+        }
+    }
+}
+
+// Four full blocks thinned out to 24, 8, 4 and 4 slots: the two sparsest empty into the fullest, one
+// of their sources is freed mid-pass, and the emptied blocks go back once the sources are retired.
+static void testDefragmentFragmentedPool() {
+    vulkan::DeviceDispatch dispatch;
+    vulkan::DeviceMemoryAllocator memory;
+    initAllocator(memory, dispatch);
+
+    std::vector<vulkan::DeviceAllocation*> slots;
+    for (int i = 0; i < 128; i++) {
+        slots.push_back(allocateSlot(memory));
+    }
+    CHECK(liveMemory.size() == 4);
+    const int keep[4] = { 24, 8, 4, 4 };
+    std::vector<vulkan::DeviceAllocation*> live;
+    for (int block = 0; block < 4; block++) {
+        int stride = 32 / keep[block];
+        for (int slot = 0; slot < 32; slot++) {
+            vulkan::DeviceAllocation* allocation = slots[block * 32 + slot];
+            if (block == 0 ? slot % 4 == 3 : slot % stride != 0) {
+                memory.free(allocation);
+                continue;
+            }
+            allocation->movable = true;
+            live.push_back(allocation);
+        }
+    }
+    CHECK(live.size() == 40);
+    CHECK(liveMemory.size() == 4);
+    CHECK(allocatedBytes(memory) == 40 * kSlot);
+
+    std::vector<vulkan::DefragmentationMove> moves = memory.beginDefragmentation(VK_WHOLE_SIZE);
+    CHECK(moves.size() == 8);
+    checkPlan(moves, live);
+    CHECK(allocatedBytes(memory) == 48 * kSlot);
+
+    // Freeing a source drops its reserved range; the rest are carried out
+    vulkan::DeviceAllocation* dropped = moves[0].source;
+    vulkan::MemoryBlock* destinationBlock = moves[0].destination->block;
+    VkDeviceSize destinationUsed = destinationBlock->metadata.used();
+    memory.free(dropped);
+    live.erase(std::find(live.begin(), live.end(), dropped));
+    CHECK(destinationBlock->metadata.used() == destinationUsed - kSlot);
+    CHECK(allocatedBytes(memory) == 46 * kSlot);
+    std::vector<vulkan::DeviceAllocation*> retired;
+    for (size_t i = 1; i < moves.size(); i++) {
+        moves[i].done = true;
+        retired.push_back(moves[i].source);
+        live.erase(std::find(live.begin(), live.end(), moves[i].source));
+        live.push_back(moves[i].destination);
+    }
+    memory.endDefragmentation(moves);
+    for (size_t i = 1; i < moves.size(); i++) {
+        CHECK(moves[i].destination->movable);
+        CHECK(!moves[i].source->movable);
+    }
+
+    // What the deletion queue does once the copies have executed
+    for (vulkan::DeviceAllocation* source : retired) {
+        memory.free(source);
+    }
+    CHECK(allocatedBytes(memory) == 39 * kSlot);
+    CHECK(liveMemory.size() == 3); // one emptied block is kept for reuse, the other is freed
+
+    // A second pass never plans a retired source, and undone moves give their reservation back
+    moves = memory.beginDefragmentation(VK_WHOLE_SIZE);
+    CHECK(moves.size() == 1); // the fullest block has one slot left
+    checkPlan(moves, live);
+    for (const vulkan::DefragmentationMove& move : moves) {
+        CHECK(std::find(live.begin(), live.end(), move.source) != live.end());
+    }
+    memory.endDefragmentation(moves);
+    CHECK(allocatedBytes(memory) == 39 * kSlot);
+
+    // The byte limit stops planning before the move that would exceed it
+    moves = memory.beginDefragmentation(0);
+    CHECK(moves.empty());
+    memory.endDefragmentation(moves);
+
+    for (vulkan::DeviceAllocation* allocation : live) {
+        memory.free(allocation);
+    }
+    CHECK(allocatedBytes(memory) == 0);
+    memory.destroy();
+    CHECK(liveMemory.empty());
+}
+
+// Reservations still held by an unfinished pass are released exactly once by destroy().
+static void testDestroyDuringPass() {
+    vulkan::DeviceDispatch dispatch;
+    vulkan::DeviceMemoryAllocator memory;
+    initAllocator(memory, dispatch);
+    std::vector<vulkan::DeviceAllocation*> slots;
+    for (int i = 0; i < 64; i++) {
+        slots.push_back(allocateSlot(memory));
+    }
+    for (int i = 0; i < 64; i++) {
+        if (i < 32 ? i % 2 == 0 : i % 8 != 0) {
+            memory.free(slots[i]);
+        }
+        else {
+            slots[i]->movable = true;
+        }
+    }
+    std::vector<vulkan::DefragmentationMove> moves = memory.beginDefragmentation(VK_WHOLE_SIZE);
+    CHECK(moves.size() == 4);
+    memory.destroy();
+    CHECK(liveMemory.empty());
+}
+
+int main() {
+    testDefragmentFragmentedPool();
+    testDestroyDuringPass();
+    if (failures != 0) {
+        std::printf("%d device memory checks failed\n", failures);
+        return 1;
+    }
+    std::printf("device memory tests passed\n");
+    return 0;
+}
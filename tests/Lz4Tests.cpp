@@ -0,0 +1,105 @@
+// LZ4 block codec: round trips over inputs with different redundancy, and decoding of damaged
+// blocks, which must fail cleanly rather than read or write out of bounds.
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "../Lz4.hpp"
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (0)
+
+static std::vector<uint8_t> compressed(const std::vector<uint8_t>& input) {
+    std::vector<uint8_t> block(lz4::compressBound(input.size()));
+    size_t size = lz4::compress(input.data(), input.size(), block.data(), block.size());
+    block.resize(size);
+    return block;
+}
+
+static void roundTrip(const char* name, const std::vector<uint8_t>& input) {
+    std::vector<uint8_t> block = compressed(input);
+    std::vector<uint8_t> output(input.size());
+    bool decoded = lz4::decompress(block.data(), block.size(), output.data(), output.size());
+    if (!decoded || output != input) {
+        std::printf("round trip of %s (%zu bytes) failed\n", name, input.size());
+        failures++;
+    }
+}
+
+int main() {
+    std::mt19937 random(1234);
+    auto bytes = [&random](size_t size, uint32_t alphabet) {
+        std::vector<uint8_t> data(size);
+        for (uint8_t& value : data) {
+            value = static_cast<uint8_t>(random() % alphabet);
+        }
+        return data;
+    };
+
+    roundTrip("one byte", { 42 });
+    roundTrip("twelve bytes", bytes(12, 256));
+    roundTrip("zeros", std::vector<uint8_t>(256 << 10, 0));
+    roundTrip("noise", bytes(256 << 10, 256));
+    roundTrip("small alphabet", bytes(100000, 4));
+    std::vector<uint8_t> pattern;
+    for (uint32_t i = 0; i < 70000; i++) {
+        pattern.push_back(static_cast<uint8_t>(i % 251));
+    }
+    roundTrip("long repeat", pattern);
+    // Matches further back than the 64 KiB window must not be used
+    std::vector<uint8_t> farRepeat = bytes(70000, 256);
+    farRepeat.insert(farRepeat.end(), farRepeat.begin(), farRepeat.begin() + 1000);
+    roundTrip("repeat beyond window", farRepeat);
+
+    // Incompressible data does not fit in less than its own size
+    std::vector<uint8_t> noise = bytes(4096, 256);
+    std::vector<uint8_t> small(noise.size() - 1);
+    CHECK(lz4::compress(noise.data(), noise.size(), small.data(), small.size()) == 0);
+
+    std::vector<uint8_t> input = bytes(50000, 8);
+    std::vector<uint8_t> block = compressed(input);
+    CHECK(block.size() < input.size());
+    std::vector<uint8_t> output(input.size());
+
+    // Wrong decoded size either way
+    CHECK(!lz4::decompress(block.data(), block.size(), output.data(), output.size() - 1));
+    std::vector<uint8_t> larger(input.size() + 1);
+    CHECK(!lz4::decompress(block.data(), block.size(), larger.data(), larger.size()));
+
+    // Every truncation
+    for (size_t size = 0; size < block.size(); size += 1 + size / 64) {
+        CHECK(!lz4::decompress(block.data(), size, output.data(), output.size()));
+    }
+
+    // Offset pointing before the start of the output
+    const uint8_t badOffset[] = { 0x14, 'a', 0x10, 0x00, 0x50, 'b', 'c', 'd', 'e', 'f' };
+    std::vector<uint8_t> target(32);
+    CHECK(!lz4::decompress(badOffset, sizeof(badOffset), target.data(), target.size()));
+
+    // Random damage may still decode to something, but must stay within the buffers
+    for (int trial = 0; trial < 2000; trial++) {
+        std::vector<uint8_t> damaged = block;
+        for (int flips = 1 + trial % 4; flips > 0; flips--) {
+            damaged[random() % damaged.size()] ^= static_cast<uint8_t>(1 + random() % 255);
+        }
+        lz4::decompress(damaged.data(), damaged.size(), output.data(), output.size());
+    }
+    for (int trial = 0; trial < 500; trial++) {
+        std::vector<uint8_t> garbage = bytes(1 + random() % 512, 256);
+        lz4::decompress(garbage.data(), garbage.size(), target.data(), target.size());
+    }
+
+    if (failures != 0) {
+        std::printf("%d LZ4 checks failed\n", failures);
+        return 1;
+    }
+    std::printf("LZ4 tests passed\n");
+    return 0;
+}
@@ -0,0 +1,251 @@
+// Scene transforms: every SIMD level available on this CPU must produce the same world matrices,
+// bounds and visible set as the scalar kernels, for full updates, partial (dirty) updates and
+// updates that re-sort the hierarchy by depth.
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <set>
+#include <vector>
+#include "../Scene.hpp"
+
+using namespace vulkan;
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (0)
+
+// Inputs of one node, so a fresh scene can be built from the state an incremental one reached.
+struct NodeDesc {
+    Scene::NodeId parent;
+    float position[3];
+    float rotation[4];
+    float scale;
+    float center[3];
+    float extent[3];
+};
+
+static const float Tolerance = 1e-4f;
+
+static NodeDesc randomNode(std::mt19937& random, const std::vector<NodeDesc>& nodes, bool root) {
+    std::uniform_real_distribution<float> range(-10.0f, 10.0f);
+    const float axis[3] = { 0.267f, 0.535f, 0.802f };
+    NodeDesc node{};
+    node.parent = root || nodes.empty() ? Scene::InvalidNode : static_cast<Scene::NodeId>(random() % nodes.size());
+    for (int k = 0; k < 3; k++) {
+        node.position[k] = range(random);
+    }
+    quaternionFromAxisAngle(axis, range(random), node.rotation);
+    node.scale = 0.5f + std::fabs(range(random)) * 0.1f;
+    node.center[0] = range(random) * 0.1f;
+    node.extent[0] = 1.0f;
+    node.extent[1] = 0.5f;
+    node.extent[2] = 0.25f;
+    return node;
+}
+
+static void addNode(Scene& scene, const NodeDesc& node) {
+    scene.createNode(node.parent, node.position, node.rotation, node.scale, node.center, node.extent);
+}
+
+static std::unique_ptr<Scene> buildScene(SimdLevel level, const std::vector<NodeDesc>& nodes) {
+    auto scene = std::make_unique<Scene>(level);
+    scene->reserve(static_cast<uint32_t>(nodes.size()));
+    for (const NodeDesc& node : nodes) {
+        addNode(*scene, node);
+    }
+    return scene;
+}
+
+static float maxDifference(const Scene& a, const Scene& b) {
+    float worst = 0.0f;
+    for (Scene::NodeId id = 0; id < a.nodeCount(); id++) {
+        float ma[16], mb[16], sa[4], sb[4];
+        a.worldMatrix(id, ma);
+        b.worldMatrix(id, mb);
+        a.worldSphere(id, sa);
+        b.worldSphere(id, sb);
+        for (int k = 0; k < 16; k++) {
+            worst = std::max(worst, std::fabs(ma[k] - mb[k]) / std::max(1.0f, std::fabs(ma[k])));
+        }
+        for (int k = 0; k < 4; k++) {
+            worst = std::max(worst, std::fabs(sa[k] - sb[k]) / std::max(1.0f, std::fabs(sa[k])));
+        }
+    }
+    return worst;
+}
+
+// Rounding differences may only flip nodes whose bounding sphere straddles a frustum plane.
+static bool sameVisibleSet(const Scene& reference, const std::vector<Scene::NodeId>& a, const std::vector<Scene::NodeId>& b,
+    const float planes[6][4]) {
+    std::set<Scene::NodeId> left(a.begin(), a.end()), right(b.begin(), b.end());
+    std::vector<Scene::NodeId> differing;
+    std::set_symmetric_difference(left.begin(), left.end(), right.begin(), right.end(), std::back_inserter(differing));
+    for (Scene::NodeId id : differing) {
+        float sphere[4];
+        reference.worldSphere(id, sphere);
+        bool straddles = false;
+        for (int p = 0; p < 6; p++) {
+            float distance = planes[p][0] * sphere[0] + planes[p][1] * sphere[1] + planes[p][2] * sphere[2] + planes[p][3];
+            straddles |= std::fabs(distance) <= sphere[3] + Tolerance;
+        }
+        if (!straddles) {
+            std::printf("node %u is visible at one SIMD level only\n", id);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    Jobs::JobSystem jobs(3);
+    std::vector<SimdLevel> levels = { SimdLevel::Scalar };
+    for (SimdLevel level : { SimdLevel::Sse, SimdLevel::Avx2 }) {
+        if (level <= detectSimdLevel()) {
+            levels.push_back(level);
+        }
+    }
+    std::printf("Comparing against scalar:");
+    for (size_t i = 1; i < levels.size(); i++) {
+        std::printf(" %s", simdLevelName(levels[i]));
+    }
+    std::printf("\n");
+
+    // Enough nodes that levels and culling are split into jobs; the random parents leave the
+    // nodes out of depth order, so the first update already sorts
+    std::mt19937 random(7);
+    std::vector<NodeDesc> nodes;
+    for (uint32_t i = 0; i < 40000; i++) {
+        nodes.push_back(randomNode(random, nodes, i < 50 || random() % 4 == 0));
+    }
+    std::vector<std::unique_ptr<Scene>> scenes;
+    for (SimdLevel level : levels) {
+        scenes.push_back(buildScene(level, nodes));
+        CHECK(scenes.back()->simdLevel() == level);
+    }
+
+    float eye[3] = { 0.0f, 5.0f, 30.0f }, target[3] = { 0.0f, 0.0f, 0.0f }, viewProjection[16], planes[6][4];
+    makeViewProjection(eye, target, 1.0f, 1.5f, 0.1f, 100.0f, viewProjection);
+    extractFrustumPlanes(viewProjection, planes);
+
+    auto compareLevels = [&](const char* step) {
+        const Scene& reference = *scenes[0];
+        std::vector<Scene::NodeId> referenceVisible = scenes[0]->cull(planes, jobs);
+        CHECK(!referenceVisible.empty() && referenceVisible.size() < reference.nodeCount());
+        for (size_t i = 1; i < scenes.size(); i++) {
+            float difference = maxDifference(reference, *scenes[i]);
+            if (difference > Tolerance) {
+                std::printf("%s: %s differs from scalar by %g\n", step, simdLevelName(levels[i]), difference);
+                failures++;
+            }
+            CHECK(sameVisibleSet(reference, referenceVisible, scenes[i]->cull(planes, jobs), planes));
+        }
+    };
+    // An incrementally updated scene must match one built from scratch with the same inputs.
+    auto compareFresh = [&](const char* step) {
+        for (size_t i = 0; i < scenes.size(); i++) {
+            std::unique_ptr<Scene> fresh = buildScene(levels[i], nodes);
+            fresh->update(jobs);
+            float difference = maxDifference(*fresh, *scenes[i]);
+            if (difference > Tolerance) {
+                std::printf("%s: incremental %s update differs from a full one by %g\n", step, simdLevelName(levels[i]), difference);
+                failures++;
+            }
+        }
+    };
+
+    for (auto& scene : scenes) {
+        scene->update(jobs);
+    }
+    compareLevels("full update");
+
+    // Partial update: a sparse set of rotations, a few roots moved (dragging their subtrees) and
+    // some inner nodes rescaled
+    const float up[3] = { 0.0f, 1.0f, 0.0f };
+    float turn[4];
+    quaternionFromAxisAngle(up, 0.3f, turn);
+    for (Scene::NodeId id = 0; id < nodes.size(); id++) {
+        NodeDesc& node = nodes[id];
+        bool rotate = id % 97 == 0;
+        bool move = node.parent == Scene::InvalidNode && id % 5 == 0;
+        bool rescale = node.parent != Scene::InvalidNode && id % 211 == 0;
+        if (rotate) {
+            std::memcpy(node.rotation, turn, sizeof(turn));
+        }
+        if (move) {
+            node.position[1] += 2.0f;
+        }
+        if (rescale) {
+            node.scale *= 1.5f;
+        }
+        for (auto& scene : scenes) {
+            if (rotate) {
+                scene->setRotation(id, node.rotation);
+            }
+            if (move) {
+                scene->setPosition(id, node.position);
+            }
+            if (rescale) {
+                scene->setScale(id, node.scale);
+            }
+        }
+    }
+    for (auto& scene : scenes) {
+        scene->update(jobs);
+    }
+    compareLevels("partial update");
+    compareFresh("partial update");
+
+    // New roots and leaves after the scene is sorted put shallower nodes behind deeper ones, so
+    // the next update re-sorts the columns; NodeIds must keep pointing at the same nodes
+    for (uint32_t i = 0; i < 3000; i++) {
+        NodeDesc node = randomNode(random, nodes, i % 3 == 0);
+        nodes.push_back(node);
+        for (auto& scene : scenes) {
+            addNode(*scene, node);
+        }
+    }
+    for (auto& scene : scenes) {
+        scene->setPosition(0, nodes[0].position);
+        scene->update(jobs);
+        CHECK(scene->nodeCount() == nodes.size());
+    }
+    compareLevels("re-sorted update");
+    compareFresh("re-sorted update");
+
+    // Hand-checked hierarchy: the child inherits its parent's scale and translation
+    for (SimdLevel level : levels) {
+        Scene scene(level);
+        const float zero[3] = { 0.0f, 0.0f, 0.0f }, identity[4] = { 0.0f, 0.0f, 0.0f, 1.0f }, one[3] = { 1.0f, 1.0f, 1.0f };
+        const float rootPosition[3] = { 1.0f, 0.0f, 0.0f }, childPosition[3] = { 0.0f, 1.0f, 0.0f }, moved[3] = { 5.0f, 0.0f, 0.0f };
+        Scene::NodeId root = scene.createNode(Scene::InvalidNode, rootPosition, identity, 2.0f, zero, one);
+        Scene::NodeId child = scene.createNode(root, childPosition, identity, 1.0f, zero, one);
+        scene.createNode(Scene::InvalidNode, childPosition, identity, 1.0f, zero, one);
+        scene.update(jobs);
+        float world[16];
+        scene.worldMatrix(child, world);
+        CHECK(std::fabs(world[12] - 1.0f) < 1e-6f && std::fabs(world[13] - 2.0f) < 1e-6f && std::fabs(world[14]) < 1e-6f);
+        CHECK(std::fabs(world[0] - 2.0f) < 1e-6f);
+        scene.setPosition(root, moved);
+        scene.update(jobs);
+        scene.worldMatrix(child, world);
+        CHECK(std::fabs(world[12] - 5.0f) < 1e-6f && std::fabs(world[13] - 2.0f) < 1e-6f);
+    }
+
+    if (failures != 0) {
+        std::printf("%d scene checks failed\n", failures);
+        return 1;
+    }
+    std::printf("Scene tests passed\n");
+    return 0;
+}